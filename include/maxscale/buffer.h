@@ -87,7 +87,8 @@ typedef enum
  */
 typedef enum
 {
-    GWBUF_PARSING_INFO
+    GWBUF_PARSING_INFO,
+    GWBUF_MAPPED_DATA
 } bufobj_id_t;
 
 typedef struct buffer_object_st buffer_object_t;
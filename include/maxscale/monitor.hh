@@ -218,6 +218,15 @@ protected:
      */
     virtual bool immediate_tick_required() const;
 
+    /**
+     * @brief Called when the monitor worker wakes up but no tick is ran
+     *
+     * This function is called every MXS_MON_BASE_INTERVAL_MS (100 ms) between the monitor ticks. A monitor
+     * can override this to refresh some information more often than once per monitor interval. The
+     * default implementation does nothing.
+     */
+    virtual void between_ticks();
+
     MXS_MONITOR*          m_monitor;    /**< The generic monitor structure. */
     MXS_MONITORED_SERVER* m_master;     /**< Master server */
 
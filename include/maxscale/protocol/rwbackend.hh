@@ -12,6 +12,7 @@
  */
 #pragma once
 
+#include <deque>
 #include <map>
 #include <memory>
 
@@ -114,6 +115,43 @@ public:
         return mxs::Backend::write(buffer, Backend::NO_RESPONSE);
     }
 
+    /**
+     * Write a query while the reply to a previous one is still being read
+     *
+     * The reply to the query is expected to follow the reply to the command that
+     * is currently being executed. Only commands whose replies can be tracked without
+     * knowing the result of the previous command, i.e. COM_QUERY, can be pipelined.
+     *
+     * @param buffer Buffer to write
+     *
+     * @return True if writing was successful
+     */
+    bool write_pipelined(GWBUF* buffer);
+
+    /**
+     * Get the number of pipelined commands waiting for a reply
+     *
+     * @return Number of commands whose replies follow the reply to the current command
+     */
+    size_t pipeline_size() const
+    {
+        return m_pipeline.size();
+    }
+
+    /**
+     * Get the number of pipelined replies completed by the last processed buffer
+     *
+     * A buffer can contain the end of one reply and the start of the next one. Only
+     * replies that were followed by the reply to a pipelined command are counted,
+     * the completion of the last one is signaled by reply_is_complete().
+     *
+     * @return Number of replies that were completed and followed by another reply
+     */
+    int completed_pipelined_replies() const
+    {
+        return m_completed_pipelined;
+    }
+
     void close(close_type type = CLOSE_NORMAL);
 
     // For COM_STMT_FETCH processing
@@ -158,6 +196,9 @@ private:
     uint64_t         m_num_coldefs = 0;
     bool             m_skip_next = false;
 
+    std::deque<uint8_t> m_pipeline;                 /**< Pipelined commands waiting for a reply */
+    int                 m_completed_pipelined = 0;  /**< Pipelined replies completed by the last buffer */
+
     inline bool is_opening_cursor() const
     {
         return m_opening_cursor;
@@ -172,5 +213,7 @@ private:
     {
         m_reply_state = state;
     }
+
+    void start_next_pipelined_reply();
 };
 }
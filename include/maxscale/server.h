@@ -78,6 +78,17 @@ typedef struct
     uint64_t packets;       /**< Number of packets routed to this server */
 } SERVER_STATS;
 
+/**
+ * Load signals read by a monitor from the server status variables. A negative value
+ * means that the signal has not been sampled.
+ */
+typedef struct
+{
+    int    threads_running;     /**< Value of Threads_running */
+    int    row_lock_waits;      /**< Value of Innodb_row_lock_current_waits */
+    double bp_miss_rate;        /**< Fraction of InnoDB buffer pool read requests that missed the cache */
+} SERVER_LOAD;
+
 /**
  * The server version.
  */
@@ -166,6 +177,8 @@ typedef struct server
                                                              * */
     unsigned long node_ts;                                  /**< Last timestamp set from M/S monitor module */
     long          master_id;                                /**< Master server id of this node */
+    SERVER_LOAD   load;                                     /**< Load signals set by the monitor, access
+                                                             * with server_set_load() and server_get_load() */
 
     // Misc fields
     bool master_err_is_logged;    /**< If node failed, this indicates whether it is logged. Only used
@@ -496,6 +509,27 @@ bool server_set_disk_space_threshold(SERVER* server, const char* disk_space_thre
  */
 void server_add_response_average(SERVER* server, double ave, int num_samples);
 
+/**
+ * @brief Set the load signals of a server
+ *
+ * The signals are published as a whole, a concurrent server_get_load() returns either
+ * the old or the new signals but never a mix of them. Only one thread, the monitor
+ * of the server, may set the signals.
+ *
+ * @param server The server.
+ * @param load   The new load signals.
+ */
+void server_set_load(SERVER* server, const SERVER_LOAD* load);
+
+/**
+ * @brief Get the load signals of a server
+ *
+ * @param server The server.
+ *
+ * @return A consistent copy of the latest load signals set by the monitor.
+ */
+SERVER_LOAD server_get_load(const SERVER* server);
+
 extern int     server_free(SERVER* server);
 extern SERVER* server_find_by_unique_name(const char* name);
 extern int     server_find_by_unique_names(char** server_names, int size, SERVER*** output);
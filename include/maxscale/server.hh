@@ -16,6 +16,7 @@
 
 #include <string>
 #include <cstdlib>
+#include <unordered_map>
 
 #include <maxscale/server.h>
 
@@ -24,4 +25,50 @@ namespace maxscale
 
 bool server_set_status(SERVER* server, int bit, std::string* errmsg_out = NULL);
 bool server_clear_status(SERVER* server, int bit, std::string* errmsg_out = NULL);
+
+/**
+ * A parsed GTID position, maps each replication domain to its highest sequence number
+ */
+using GtidPos = std::unordered_map<uint32_t, uint64_t>;
+
+/**
+ * Parse a GTID position
+ *
+ * @param gtid_pos Comma-separated list of domain-server_id-sequence triplets
+ *
+ * @return The highest sequence number of each domain
+ */
+GtidPos gtid_pos_parse(const std::string& gtid_pos);
+
+/**
+ * Set the GTID position of a server
+ *
+ * Monitors call this to publish the latest known `@@gtid_current_pos` of the server. Routers can
+ * use it to check whether a server has already replicated a transaction. The position is parsed
+ * only when it changes.
+ *
+ * @param server   The server to update
+ * @param gtid_pos The GTID position as a comma-separated list of domain-server_id-sequence triplets
+ */
+void server_set_gtid_pos(SERVER* server, const std::string& gtid_pos);
+
+/**
+ * Get the GTID position of a server
+ *
+ * @param server The server to inspect
+ *
+ * @return The latest GTID position set by the monitor or an empty string if it is not known
+ */
+std::string server_get_gtid_pos(const SERVER* server);
+
+/**
+ * Check if a server has replicated a GTID position
+ *
+ * @param server The server to inspect
+ * @param target The GTID position that must be reached, parsed with gtid_pos_parse()
+ *
+ * @return True if the latest GTID position set by the monitor includes all domains of the target
+ *         with an equal or higher sequence number
+ */
+bool server_gtid_pos_reached(const SERVER* server, const GtidPos& target);
 }
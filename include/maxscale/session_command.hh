@@ -73,22 +73,14 @@ public:
     std::string to_string();
 
     /**
-     * @brief Equality comparison
+     * Share the data of this command with identical commands of other sessions
      *
-     * @return True if @c rhs is equal
+     * The command buffers are stored in a per-thread store keyed by their contents.
+     * If an identical command has already been stored by a session on the same
+     * thread, this command will refer to the same data. Data that is no longer used
+     * by any session command is removed from the store when it grows.
      */
-    bool eq(const SessionCommand& rhs) const;
-
-    /**
-     * Mark the session command as a re-execution of another command
-     *
-     * This function makes the current command's buffer a reference to the other
-     * command's buffer. The commands will still have separate positions and
-     * reply statuses.
-     *
-     * @param rhs Session command whose data is used
-     */
-    void mark_as_duplicate(const SessionCommand& rhs);
+    void intern();
 
 private:
     mxs::Buffer m_buffer;       /**< The buffer containing the command */
@@ -96,14 +88,4 @@ private:
     uint64_t    m_pos;          /**< Unique position identifier */
     bool        m_reply_sent;   /**< Whether the session command reply has been sent */
 };
-
-inline bool operator==(const SessionCommand& lhs, const SessionCommand& rhs)
-{
-    return lhs.eq(rhs);
-}
-
-inline bool operator!=(const SessionCommand& lhs, const SessionCommand& rhs)
-{
-    return !lhs.eq(rhs);
-}
 }
@@ -0,0 +1,173 @@
+/**
+ * Readwritesplit query pipelining test
+ *
+ * - Send a batch of INSERTs without reading the results
+ * - Read the results, all of them should be OK packets
+ * - Send a batch of SELECTs without reading the results
+ * - Read the results, they should be in the same order as the queries
+ * - Pipeline a LOAD DATA LOCAL INFILE between other queries, the file must be
+ *   sent before the next query is executed
+ * - Pipeline queries that can't be pipelined (transactions, prepared
+ *   statements, user variables) after reads, they must be routed only once
+ */
+
+#include "testconnections.h"
+#include <fstream>
+#include <vector>
+
+using namespace std;
+
+namespace
+{
+
+void send_queries(TestConnections& test, MYSQL* conn, const vector<string>& queries)
+{
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        test.expect(mysql_send_query(conn, queries[i].c_str(), queries[i].length()) == 0,
+                    "Failed to send query %lu '%s': %s", i, queries[i].c_str(), mysql_error(conn));
+    }
+}
+
+void read_results(TestConnections& test, MYSQL* conn, const vector<string>& queries)
+{
+    for (size_t i = 0; i < queries.size(); i++)
+    {
+        test.expect(mysql_read_query_result(conn) == 0,
+                    "Failed to read result %lu for '%s': %s", i, queries[i].c_str(), mysql_error(conn));
+
+        if (MYSQL_RES* res = mysql_store_result(conn))
+        {
+            mysql_free_result(res);
+        }
+    }
+}
+
+void test_ordering(TestConnections& test, MYSQL* conn)
+{
+    const int N_QUERIES = 100;
+
+    test.try_query(conn, "CREATE OR REPLACE TABLE test.t1(id INT)");
+
+    for (int i = 0; i < N_QUERIES; i++)
+    {
+        std::string query = "INSERT INTO test.t1 VALUES (" + std::to_string(i) + ")";
+        test.expect(mysql_send_query(conn, query.c_str(), query.length()) == 0,
+                    "Failed to send query %d: %s", i, mysql_error(conn));
+    }
+
+    for (int i = 0; i < N_QUERIES; i++)
+    {
+        test.expect(mysql_read_query_result(conn) == 0,
+                    "Failed to read result %d: %s", i, mysql_error(conn));
+    }
+
+    test.repl->sync_slaves();
+
+    for (int i = 0; i < N_QUERIES; i++)
+    {
+        std::string query = "SELECT " + std::to_string(i) + ", COUNT(*) FROM test.t1 WHERE id <= "
+            + std::to_string(i);
+        test.expect(mysql_send_query(conn, query.c_str(), query.length()) == 0,
+                    "Failed to send query %d: %s", i, mysql_error(conn));
+    }
+
+    for (int i = 0; i < N_QUERIES; i++)
+    {
+        test.expect(mysql_read_query_result(conn) == 0,
+                    "Failed to read result %d: %s", i, mysql_error(conn));
+
+        if (MYSQL_RES* res = mysql_store_result(conn))
+        {
+            MYSQL_ROW row = mysql_fetch_row(res);
+            std::string expected = std::to_string(i);
+            std::string count = std::to_string(i + 1);
+            test.expect(row && expected == row[0] && count == row[1],
+                        "At %d: expected '%s %s', got '%s %s'", i, expected.c_str(), count.c_str(),
+                        row ? row[0] : "NULL", row ? row[1] : "NULL");
+            mysql_free_result(res);
+        }
+    }
+}
+
+void test_load_data_local_infile(TestConnections& test, MYSQL* conn)
+{
+    const char* filename = "./rwsplit_pipeline.csv";
+    unlink(filename);
+    ofstream file(filename);
+    file << "1\n2\n3" << endl;
+    file.close();
+
+    test.try_query(conn, "CREATE OR REPLACE TABLE test.t1(id INT)");
+    vector<string> queries = {
+        "INSERT INTO test.t1 VALUES (0)",
+        "INSERT INTO test.t1 VALUES (0)",
+        "LOAD DATA LOCAL INFILE './rwsplit_pipeline.csv' INTO TABLE test.t1",
+        "INSERT INTO test.t1 VALUES (0)",
+        "INSERT INTO test.t1 VALUES (0)"
+    };
+
+    send_queries(test, conn, queries);
+    read_results(test, conn, queries);
+
+    Row row = get_row(conn, "SELECT COUNT(*), SUM(id) FROM test.t1 FOR UPDATE");
+    test.expect(!row.empty() && row[0] == "7" && row[1] == "6",
+                "Expected 7 rows with a sum of 6, got %s rows with a sum of %s",
+                row.empty() ? "no" : row[0].c_str(), row.empty() ? "no" : row[1].c_str());
+    unlink(filename);
+}
+
+void test_classified_once(TestConnections& test, MYSQL* conn)
+{
+    test.try_query(conn, "CREATE OR REPLACE TABLE test.t1(id INT)");
+    test.repl->sync_slaves();
+
+    // Each of the statements after the SELECTs is classified while the SELECTs are
+    // being executed and it then waits in the query queue
+    vector<string> queries = {
+        "SELECT SLEEP(0.1)",
+        "SELECT 1",
+        "SET @a = 5",
+        "SELECT 2",
+        "PREPARE ps FROM 'SELECT ?'",
+        "SELECT 3",
+        "START TRANSACTION",
+        "INSERT INTO test.t1 VALUES (@a)",
+        "COMMIT",
+        "SELECT 4"
+    };
+
+    send_queries(test, conn, queries);
+    read_results(test, conn, queries);
+
+    Row row = get_row(conn, "SELECT @a");
+    test.expect(!row.empty() && row[0] == "5", "@a should be 5, got %s", row.empty() ? "no" : row[0].c_str());
+
+    test.try_query(conn, "EXECUTE ps USING @a");
+    test.try_query(conn, "DEALLOCATE PREPARE ps");
+
+    // The session must not be in a transaction anymore
+    row = get_row(conn, "SELECT @@in_transaction");
+    test.expect(!row.empty() && row[0] == "0", "The session should not be in a transaction");
+
+    row = get_row(conn, "SELECT COUNT(*) FROM test.t1 WHERE id = 5 FOR UPDATE");
+    test.expect(!row.empty() && row[0] == "1", "The transaction should have inserted one row");
+}
+}
+
+int main(int argc, char** argv)
+{
+    TestConnections test(argc, argv);
+
+    test.maxscales->connect();
+    MYSQL* conn = test.maxscales->conn_rwsplit[0];
+
+    test_ordering(test, conn);
+    test_load_data_local_infile(test, conn);
+    test_classified_once(test, conn);
+
+    test.try_query(conn, "DROP TABLE test.t1");
+    test.maxscales->disconnect();
+
+    return test.global_result;
+}
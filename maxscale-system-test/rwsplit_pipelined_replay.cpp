@@ -0,0 +1,60 @@
+/**
+ * Readwritesplit transaction replay with pipelined statements
+ *
+ * A transaction that mixes writes with statements that change the session state
+ * is replayed with transaction_replay_window=10. The statements that change the
+ * session state must be routed only after the preceding statements have
+ * completed and the ones that follow must see their effects.
+ */
+
+#include "testconnections.h"
+#include <string>
+
+int main(int argc, char** argv)
+{
+    TestConnections test(argc, argv);
+    test.maxscales->connect();
+    MYSQL* conn = test.maxscales->conn_rwsplit[0];
+
+    test.try_query(conn, "CREATE OR REPLACE TABLE test.t1(id INT, val INT)");
+    test.try_query(conn, "BEGIN");
+    test.try_query(conn, "SET @a = 1");
+
+    for (int i = 0; i < 20; i++)
+    {
+        test.try_query(conn, "INSERT INTO test.t1 VALUES (%d, @a)", i);
+    }
+
+    test.try_query(conn, "SET @a = 2");
+    test.try_query(conn, "PREPARE ps FROM 'INSERT INTO test.t1 VALUES (?, @a)'");
+
+    for (int i = 20; i < 40; i++)
+    {
+        test.try_query(conn, "SET @id = %d", i);
+        test.try_query(conn, "EXECUTE ps USING @id");
+    }
+
+    test.try_query(conn, "SELECT COUNT(*) FROM test.t1");
+
+    test.tprintf("Block and unblock the master to trigger a replay");
+    test.repl->block_node(0);
+    test.maxscales->wait_for_monitor(2);
+    test.repl->unblock_node(0);
+    test.maxscales->wait_for_monitor(2);
+
+    Row row = get_row(conn, "SELECT COUNT(*), SUM(val) FROM test.t1");
+    test.expect(!row.empty() && row[0] == "40" && row[1] == "60",
+                "Expected 40 rows with a sum of 60, got %s rows with a sum of %s",
+                row.empty() ? "no" : row[0].c_str(), row.empty() ? "no" : row[1].c_str());
+    test.try_query(conn, "COMMIT");
+
+    row = get_row(conn, "SELECT @a, @id");
+    test.expect(!row.empty() && row[0] == "2" && row[1] == "39",
+                "Expected variables to be '2 39', got '%s %s'",
+                row.empty() ? "" : row[0].c_str(), row.empty() ? "" : row[1].c_str());
+
+    test.try_query(conn, "DROP TABLE test.t1");
+    test.maxscales->disconnect();
+
+    return test.global_result;
+}
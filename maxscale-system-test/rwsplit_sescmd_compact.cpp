@@ -0,0 +1,114 @@
+/**
+ * Readwritesplit session command history compaction
+ *
+ * The history size is limited to 16 commands. Repeated simple SET statements of
+ * the same variable must replace each other in the history so that older commands
+ * are not pruned. SET statements that are not simple, assignments of other
+ * variables and SQL mode changes must be kept as is and must not be moved past.
+ */
+
+#include "testconnections.h"
+
+std::vector<int> ids;
+
+void block_by_id(TestConnections& test, int id)
+{
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        if (ids[i] == id)
+        {
+            test.repl->block_node(i);
+        }
+    }
+}
+
+void unblock_by_id(TestConnections& test, int id)
+{
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        if (ids[i] == id)
+        {
+            test.repl->unblock_node(i);
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    TestConnections test(argc, argv);
+
+    test.repl->connect();
+    ids = test.repl->get_all_server_ids();
+    test.repl->disconnect();
+
+    int master_id = test.get_master_server_id();
+    Connection conn = test.maxscales->rwsplit();
+    test.expect(conn.connect(), "Connection failed: %s", conn.error());
+
+    int first_id = std::stoi(conn.field("SELECT @@server_id"));
+
+    std::vector<std::string> queries = {
+        "SET @x = 'keep'",
+        // A value that depends on an earlier one is not superseded by a later SET
+        "SET @b = 1",
+        "SET @c = @b",
+        "SET @b = 2",
+        // Multiple assignments are not simple
+        "SET @d = 1, @e = 2",
+        "SET @d = 3",
+        // An assignment of another variable in between
+        "SET @h = 1",
+        "SET @i = 1",
+        "SET @h = 2",
+        // Quoting and comments
+        "SET @f = 'it''s'",
+        "SET @g = 1 /* comment */",
+        // The SQL mode is never compacted
+        "SET @@session.sql_mode = 'ANSI'",
+        "SET SESSION sql_mode = ''",
+    };
+
+    for (const auto& q : queries)
+    {
+        test.expect(conn.query(q), "Query '%s' failed: %s", q.c_str(), conn.error());
+    }
+
+    test.tprintf("Repeatedly set the same variable, the history should not grow");
+    for (int i = 0; i < 20; i++)
+    {
+        test.expect(conn.query("SET @a = " + std::to_string(i)), "SET failed: %s", conn.error());
+    }
+
+    block_by_id(test, first_id);
+    test.maxscales->wait_for_monitor();
+
+    int second_id = std::stoi(conn.field("SELECT @@server_id"));
+    test.expect(first_id != second_id && second_id > 0, "Invalid server ID: %d", second_id);
+    test.expect(master_id != second_id, "SELECT should not go to the master");
+
+    std::vector<std::pair<std::string, std::string>> expected = {
+        {"@x",         "keep"},
+        {"@a",         "19"  },
+        {"@b",         "2"   },
+        {"@c",         "1"   },
+        {"@d",         "3"   },
+        {"@e",         "2"   },
+        {"@f",         "it's"},
+        {"@g",         "1"   },
+        {"@h",         "2"   },
+        {"@i",         "1"   },
+        {"@@sql_mode", ""    },
+    };
+
+    for (const auto& e : expected)
+    {
+        std::string query = "SELECT IFNULL(" + e.first + ", 'NULL')";
+        std::string value = conn.field(query);
+        test.expect(value == e.second, "Expected %s to be '%s', got '%s'",
+                    e.first.c_str(), e.second.c_str(), value.c_str());
+    }
+
+    unblock_by_id(test, first_id);
+
+    return test.global_result;
+}
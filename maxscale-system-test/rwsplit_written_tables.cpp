@@ -0,0 +1,51 @@
+/**
+ * Readwritesplit table-granular read-your-writes tracking test
+ *
+ * - Write to a table with an unqualified name and read it with a qualified name in
+ *   a different case, the read must go to the master
+ * - Read a table that was not written, the read must go to a slave
+ * - Write with a qualified name without a default database and read it with an
+ *   unqualified name after selecting the database, the read must go to the master
+ */
+
+#include "testconnections.h"
+
+int main(int argc, char** argv)
+{
+    TestConnections test(argc, argv);
+    test.repl->connect();
+    std::string master_id = test.repl->get_server_id_str(0);
+    test.try_query(test.repl->nodes[0], "CREATE OR REPLACE TABLE test.t1(id INT)");
+    test.try_query(test.repl->nodes[0], "CREATE OR REPLACE TABLE test.t2(id INT)");
+    test.try_query(test.repl->nodes[0], "INSERT INTO test.t1 VALUES (1)");
+    test.try_query(test.repl->nodes[0], "INSERT INTO test.t2 VALUES (1)");
+    test.repl->sync_slaves();
+
+    auto conn = test.maxscales->rwsplit();
+    test.expect(conn.connect(), "Connection should work");
+
+    test.expect(conn.field("SELECT @@server_id FROM test.t1") != master_id,
+                "Read of an unwritten table should go to a slave");
+    test.expect(conn.query("INSERT INTO t1 VALUES (2)"), "INSERT should work");
+    test.expect(conn.field("SELECT @@server_id FROM TEST.T1 LIMIT 1") == master_id,
+                "Read of a written table should go to the master");
+    test.expect(conn.field("SELECT @@server_id FROM test.t2") != master_id,
+                "Read of an unwritten table should still go to a slave");
+
+    auto conn_no_db = test.maxscales->rwsplit(0, "");
+    test.expect(conn_no_db.connect(), "Connection without a default database should work");
+    test.expect(conn_no_db.query("INSERT INTO test.t2 VALUES (2)"), "INSERT should work");
+    test.expect(!conn_no_db.query("INSERT INTO t2 VALUES (3)"),
+                "INSERT without a default database should fail");
+    test.expect(conn_no_db.query("USE test"), "USE should work");
+    test.expect(conn_no_db.field("SELECT @@server_id FROM t2 LIMIT 1") == master_id,
+                "Read of a written table should go to the master");
+    test.expect(conn_no_db.field("SELECT @@server_id FROM t1 LIMIT 1") != master_id,
+                "Read of a table written by another session should go to a slave");
+
+    test.try_query(test.repl->nodes[0], "DROP TABLE test.t1");
+    test.try_query(test.repl->nodes[0], "DROP TABLE test.t2");
+    test.repl->disconnect();
+
+    return test.global_result;
+}
@@ -579,8 +579,12 @@ void gwbuf_add_buffer_object(GWBUF* buf,
         p_b = &(*p_b)->bo_next;
     }
     *p_b = newb;
-    /** Set flag */
-    buf->sbuf->info |= GWBUF_INFO_PARSED;
+
+    if (id == GWBUF_PARSING_INFO)
+    {
+        /** Set flag */
+        buf->sbuf->info |= GWBUF_INFO_PARSED;
+    }
 }
 
 void* gwbuf_get_buffer_object_data(GWBUF* buf, bufobj_id_t id)
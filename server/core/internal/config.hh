@@ -207,20 +207,6 @@ bool export_config_file(const char* filename);
 
 bool is_normal_server_parameter(const char* param);
 
-/**
- * Converts a string into the corresponding value, interpreting
- * IEC or SI prefixes used as suffixes appropriately.
- *
- * @param value A numerical string, possibly suffixed by a IEC binary prefix or
- *              SI prefix.
- * @param dest  Pointer where the result is stored. If set to NULL, only the
- *              validity of value is checked.
- *
- * @return True on success, false on invalid input in which case contents of
- *         `dest` are left in an undefined state
- */
-bool get_suffixed_size(const char* value, uint64_t* dest);
-
 // Dump a parameter list into a file as `key=value` pairs
 void dump_param_list(int file,
                      MXS_CONFIG_PARAMETER* list,
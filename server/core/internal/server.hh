@@ -18,10 +18,13 @@
 
 #include <maxbase/ccdefs.hh>
 
+#include <memory>
 #include <mutex>
+#include <string>
 
 #include <maxbase/average.hh>
 #include <maxscale/server.h>
+#include <maxscale/server.hh>
 #include <maxscale/resultset.hh>
 #include <maxscale/routingworker.hh>
 
@@ -49,10 +52,26 @@ public:
 
     void response_time_add(double ave, int num_samples);
 
+    void        set_load(const SERVER_LOAD& load);
+    SERVER_LOAD get_load() const;
+
+    void        set_gtid_pos(const std::string& gtid_pos);
+    std::string gtid_pos() const;
+    bool        gtid_pos_reached(const maxscale::GtidPos& target) const;
+
     mutable std::mutex m_lock;
 
 private:
     maxbase::EMAverage m_response_time;
+    uint32_t           m_load_seq = 0;  /**< Sequence number of `load`, odd while it is being updated */
+    struct GtidState
+    {
+        std::string       str;  /**< The GTID position as reported by the monitor */
+        maxscale::GtidPos pos;  /**< The parsed GTID position */
+    };
+
+    std::shared_ptr<const GtidState> m_gtid;        /**< Latest gtid_current_pos reported by the monitor */
+    mutable std::mutex               m_gtid_lock;   /**< Protects the m_gtid pointer */
 };
 
 void server_free(Server* server);
@@ -2945,6 +2945,11 @@ bool MonitorInstance::call_run_one_tick(Worker::Call::action_t action)
             run_one_tick();
             now = get_time_ms();
         }
+        else
+        {
+            between_ticks();
+            now = get_time_ms();
+        }
 
         int64_t ms_to_next_call = m_monitor->interval - (now - m_loop_called);
         // ms_to_next_call will be negative, if the run_one_tick() call took
@@ -2976,4 +2981,8 @@ bool MonitorInstance::immediate_tick_required() const
 {
     return false;
 }
+
+void MonitorInstance::between_ticks()
+{
+}
 }
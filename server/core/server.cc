@@ -25,6 +25,7 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include <algorithm>
 #include <string>
 #include <list>
 #include <mutex>
@@ -180,6 +181,9 @@ SERVER* server_alloc(const char* name, MXS_CONFIG_PARAMETER* params)
     server->node_id = -1;
     server->rlag = MXS_RLAG_UNDEFINED;
     server->node_ts = 0;
+    server->load.threads_running = -1;
+    server->load.row_lock_waits = -1;
+    server->load.bp_miss_rate = -1;
     server->master_id = -1;
     server->master_err_is_logged = false;
     server->warn_ssl_not_enabled = true;
@@ -535,6 +539,13 @@ void dprintServer(DCB* dcb, const SERVER* srv)
             dcb_printf(dcb, "\tSlave delay:                         %d\n", server->rlag);
         }
     }
+    SERVER_LOAD load = server_get_load(server);
+    if (load.threads_running >= 0)
+    {
+        dcb_printf(dcb, "\tThreads running:                     %d\n", load.threads_running);
+        dcb_printf(dcb, "\tRow lock waits:                      %d\n", load.row_lock_waits);
+        dcb_printf(dcb, "\tBuffer pool miss rate:               %.4f\n", load.bp_miss_rate);
+    }
     if (server->node_ts > 0)
     {
         struct tm result;
@@ -1440,6 +1451,17 @@ static json_t* server_json_attributes(const SERVER* server)
         json_object_set_new(attr, "replication_lag", json_integer(server->rlag));
     }
 
+    SERVER_LOAD load = server_get_load(server);
+
+    if (load.threads_running >= 0)
+    {
+        json_t* load_json = json_object();
+        json_object_set_new(load_json, "threads_running", json_integer(load.threads_running));
+        json_object_set_new(load_json, "row_lock_waits", json_integer(load.row_lock_waits));
+        json_object_set_new(load_json, "buffer_pool_miss_rate", json_real(load.bp_miss_rate));
+        json_object_set_new(attr, "load", load_json);
+    }
+
     if (server->node_ts > 0)
     {
         struct tm result;
@@ -1576,6 +1598,147 @@ double server_response_time_average(const SERVER* srv)
     return server->response_time_average();
 }
 
+/**
+ * The load signals are published with a sequence lock. The writer makes the sequence number
+ * odd for the duration of the update and the readers retry if the number was odd or changed
+ * while they copied the signals. The signals are stored with release and loaded with acquire
+ * semantics which keeps them between the two accesses of the sequence number.
+ */
+void Server::set_load(const SERVER_LOAD& new_load)
+{
+    uint32_t seq = mxb::atomic::load(&m_load_seq, mxb::atomic::RELAXED);
+    mxb::atomic::store(&m_load_seq, seq + 1, mxb::atomic::RELAXED);
+
+    mxb::atomic::store(&load.threads_running, new_load.threads_running, mxb::atomic::RELEASE);
+    mxb::atomic::store(&load.row_lock_waits, new_load.row_lock_waits, mxb::atomic::RELEASE);
+    __atomic_store(&load.bp_miss_rate, &new_load.bp_miss_rate, __ATOMIC_RELEASE);
+
+    mxb::atomic::store(&m_load_seq, seq + 2, mxb::atomic::RELEASE);
+}
+
+SERVER_LOAD Server::get_load() const
+{
+    SERVER_LOAD rval;
+    uint32_t seq;
+
+    do
+    {
+        seq = mxb::atomic::load(&m_load_seq, mxb::atomic::ACQUIRE);
+        rval.threads_running = mxb::atomic::load(&load.threads_running, mxb::atomic::ACQUIRE);
+        rval.row_lock_waits = mxb::atomic::load(&load.row_lock_waits, mxb::atomic::ACQUIRE);
+        __atomic_load(&load.bp_miss_rate, &rval.bp_miss_rate, __ATOMIC_ACQUIRE);
+    }
+    while ((seq & 1) || seq != mxb::atomic::load(&m_load_seq, mxb::atomic::RELAXED));
+
+    return rval;
+}
+
+void server_set_load(SERVER* srv, const SERVER_LOAD* load)
+{
+    static_cast<Server*>(srv)->set_load(*load);
+}
+
+SERVER_LOAD server_get_load(const SERVER* srv)
+{
+    return static_cast<const Server*>(srv)->get_load();
+}
+
+mxs::GtidPos mxs::gtid_pos_parse(const std::string& gtid_pos)
+{
+    GtidPos rval;
+    const char* ptr = gtid_pos.c_str();
+
+    while (*ptr)
+    {
+        char* end;
+        uint32_t domain = strtoul(ptr, &end, 10);
+
+        if (*end != '-')
+        {
+            break;
+        }
+
+        strtoul(end + 1, &end, 10);
+
+        if (*end != '-')
+        {
+            break;
+        }
+
+        uint64_t sequence = strtoull(end + 1, &end, 10);
+        uint64_t& value = rval[domain];
+        value = std::max(value, sequence);
+
+        while (*end == ',' || isspace(*end))
+        {
+            end++;
+        }
+
+        ptr = end;
+    }
+
+    return rval;
+}
+
+void Server::set_gtid_pos(const std::string& gtid_pos)
+{
+    std::shared_ptr<const GtidState> current;
+
+    {
+        std::lock_guard<std::mutex> guard(m_gtid_lock);
+        current = m_gtid;
+    }
+
+    if (!current || current->str != gtid_pos)
+    {
+        // Only the monitor updates the position, parse it outside of the lock
+        std::shared_ptr<const GtidState> state(new GtidState{gtid_pos, mxs::gtid_pos_parse(gtid_pos)});
+        std::lock_guard<std::mutex> guard(m_gtid_lock);
+        m_gtid = std::move(state);
+    }
+}
+
+std::string Server::gtid_pos() const
+{
+    std::lock_guard<std::mutex> guard(m_gtid_lock);
+    return m_gtid ? m_gtid->str : std::string();
+}
+
+bool Server::gtid_pos_reached(const mxs::GtidPos& target) const
+{
+    std::shared_ptr<const GtidState> state;
+
+    {
+        std::lock_guard<std::mutex> guard(m_gtid_lock);
+        state = m_gtid;
+    }
+
+    bool rval = state && !state->pos.empty() && !target.empty();
+
+    for (auto it = target.begin(); rval && it != target.end(); ++it)
+    {
+        auto current = state->pos.find(it->first);
+        rval = current != state->pos.end() && current->second >= it->second;
+    }
+
+    return rval;
+}
+
+void mxs::server_set_gtid_pos(SERVER* srv, const std::string& gtid_pos)
+{
+    static_cast<Server*>(srv)->set_gtid_pos(gtid_pos);
+}
+
+std::string mxs::server_get_gtid_pos(const SERVER* srv)
+{
+    return static_cast<const Server*>(srv)->gtid_pos();
+}
+
+bool mxs::server_gtid_pos_reached(const SERVER* srv, const GtidPos& target)
+{
+    return static_cast<const Server*>(srv)->gtid_pos_reached(target);
+}
+
 /** Apply backend average and adjust sample_max, which determines the weight of a new average
  *  applied to EMAverage.
  *  Sample max is raised if the server is fast, aggresively lowered if the incoming average is clearly
@@ -13,9 +13,48 @@
 
 #include <maxscale/session_command.hh>
 
+#include <unordered_map>
+
 #include <maxscale/modutil.h>
 #include <maxscale/protocol/mysql.h>
 
+namespace
+{
+
+// Larger commands are not interned, they are rarely shared between sessions
+const size_t MAX_INTERNED_SIZE = 4096;
+
+// The minimum number of stored buffers before unused ones are removed
+const size_t MIN_PRUNE_LIMIT = 1024;
+
+struct InternStore
+{
+    std::unordered_map<std::string, mxs::Buffer> buffers;
+    size_t                                       prune_limit = MIN_PRUNE_LIMIT;
+
+    void prune()
+    {
+        for (auto it = buffers.begin(); it != buffers.end();)
+        {
+            if (it->second.get()->sbuf->refcount == 1)
+            {
+                // Only the store refers to the data
+                it = buffers.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        prune_limit = std::max(MIN_PRUNE_LIMIT, buffers.size() * 2);
+    }
+};
+
+// Session commands are only used by the routing worker of the session so each worker has its own store
+thread_local InternStore intern_store;
+}
+
 namespace maxscale
 {
 
@@ -53,11 +92,6 @@ SessionCommand::~SessionCommand()
 {
 }
 
-bool SessionCommand::eq(const SessionCommand& rhs) const
-{
-    return rhs.m_buffer.compare(m_buffer) == 0;
-}
-
 std::string SessionCommand::to_string()
 {
     std::string str;
@@ -82,10 +116,32 @@ std::string SessionCommand::to_string()
     return str;
 }
 
-void SessionCommand::mark_as_duplicate(const SessionCommand& rhs)
+void SessionCommand::intern()
 {
-    mxb_assert(eq(rhs));
-    // The commands now share the mxs::Buffer that contains the actual command
-    m_buffer = rhs.m_buffer;
+    size_t len = m_buffer.length();
+
+    if (len <= MAX_INTERNED_SIZE && m_command != MXS_COM_CHANGE_USER)
+    {
+        std::string key(len, '\0');
+        gwbuf_copy_data(m_buffer.get(), 0, len, (uint8_t*)&key[0]);
+
+        auto it = intern_store.buffers.find(key);
+
+        if (it != intern_store.buffers.end())
+        {
+            m_buffer = it->second;
+        }
+        else
+        {
+            if (intern_store.buffers.size() >= intern_store.prune_limit)
+            {
+                intern_store.prune();
+            }
+
+            // The stored data must be in one shared buffer for the reference count to be meaningful
+            m_buffer.make_contiguous();
+            intern_store.buffers.emplace(std::move(key), m_buffer);
+        }
+    }
 }
 }
@@ -33,6 +33,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 #include <maxscale/alloc.h>
 #include <maxscale/server.h>
 #include <maxscale/log.h>
@@ -176,6 +180,99 @@ bool test_serialize()
     return true;
 }
 
+bool test_gtid_pos()
+{
+    mxs::GtidPos pos = mxs::gtid_pos_parse("0-1-10, 1-2-5,0-3-12");
+    TEST(pos.size() == 2, "Two domains should be parsed");
+    TEST(pos[0] == 12, "The highest sequence of domain 0 should be used");
+    TEST(pos[1] == 5, "Domain 1 should be parsed");
+    TEST(mxs::gtid_pos_parse("").empty(), "Empty position should parse to nothing");
+    TEST(mxs::gtid_pos_parse("garbage").empty(), "Invalid position should parse to nothing");
+
+    SERVER* server = server_alloc("gtidserver", params.params());
+    TEST(server, "Allocating the server should not fail");
+    TEST(mxs::server_get_gtid_pos(server).empty(), "Position should be unknown by default");
+    TEST(!mxs::server_gtid_pos_reached(server, mxs::gtid_pos_parse("0-1-1")),
+         "Unknown position should not reach anything");
+
+    mxs::server_set_gtid_pos(server, "0-1-10,1-1-3");
+    TEST(mxs::server_get_gtid_pos(server) == "0-1-10,1-1-3", "Position should be stored as is");
+    TEST(mxs::server_gtid_pos_reached(server, mxs::gtid_pos_parse("0-1-10")), "Equal position is reached");
+    TEST(mxs::server_gtid_pos_reached(server, mxs::gtid_pos_parse("0-2-9,1-1-3")),
+         "Lower positions are reached");
+    TEST(!mxs::server_gtid_pos_reached(server, mxs::gtid_pos_parse("0-1-11")),
+         "Higher position is not reached");
+    TEST(!mxs::server_gtid_pos_reached(server, mxs::gtid_pos_parse("2-1-1")),
+         "Unknown domain is not reached");
+    TEST(!mxs::server_gtid_pos_reached(server, mxs::GtidPos()), "Empty target is not reached");
+
+    mxs::server_set_gtid_pos(server, "0-1-11");
+    TEST(mxs::server_gtid_pos_reached(server, mxs::gtid_pos_parse("0-1-11")),
+         "Updated position should be used");
+    TEST(!mxs::server_gtid_pos_reached(server, mxs::gtid_pos_parse("1-1-3")),
+         "Domains missing from the updated position are not reached");
+
+    mxs::server_set_gtid_pos(server, "");
+    TEST(!mxs::server_gtid_pos_reached(server, mxs::gtid_pos_parse("0-1-1")),
+         "Cleared position should not reach anything");
+
+    server_free((Server*)server);
+    return true;
+}
+
+bool test_load()
+{
+    SERVER* server = server_alloc("loadserver", params.params());
+    TEST(server, "Allocating the server should not fail");
+
+    SERVER_LOAD load = server_get_load(server);
+    TEST(load.threads_running < 0 && load.row_lock_waits < 0 && load.bp_miss_rate < 0,
+         "Load should not be sampled by default");
+
+    const int N_UPDATES = 100000;
+    std::atomic<bool> running {true};
+    std::atomic<int> torn {0};
+    std::vector<std::thread> readers;
+
+    for (int i = 0; i < 4; i++)
+    {
+        readers.emplace_back([&]() {
+                                 while (running)
+                                 {
+                                     // All signals of one update have the same value
+                                     SERVER_LOAD l = server_get_load(server);
+
+                                     if (l.threads_running != l.row_lock_waits
+                                         || l.threads_running != (int)l.bp_miss_rate)
+                                     {
+                                         torn++;
+                                     }
+                                 }
+                             });
+    }
+
+    for (int i = 0; i < N_UPDATES; i++)
+    {
+        SERVER_LOAD l = {i, i, (double)i};
+        server_set_load(server, &l);
+    }
+
+    running = false;
+
+    for (auto& t : readers)
+    {
+        t.join();
+    }
+
+    TEST(torn == 0, "Load signals should never be read in the middle of an update");
+
+    load = server_get_load(server);
+    TEST(load.threads_running == N_UPDATES - 1, "The latest load should be returned");
+
+    server_free((Server*)server);
+    return true;
+}
+
 int main(int argc, char** argv)
 {
     /**
@@ -198,6 +295,16 @@ int main(int argc, char** argv)
         result++;
     }
 
+    if (!test_gtid_pos())
+    {
+        result++;
+    }
+
+    if (!test_load())
+    {
+        result++;
+    }
+
     mxs_log_finish();
     exit(result);
 }
@@ -13,6 +13,7 @@
 
 #define MXS_MODULE_NAME "cache"
 #include "cache.hh"
+#include <algorithm>
 #include <new>
 #include <set>
 #include <string>
@@ -35,11 +36,18 @@ Cache::Cache(const std::string& name,
     , m_config(*pConfig)
     , m_rules(rules)
     , m_sFactory(sFactory)
+    , m_epoch(0)
+    , m_all_epoch(0)
+    , m_last_table_epoch(0)
+    , m_invalidations(0)
+    , m_invalidated(0)
 {
+    pthread_rwlock_init(&m_epochs_lock, NULL);
 }
 
 Cache::~Cache()
 {
+    pthread_rwlock_destroy(&m_epochs_lock);
 }
 
 // static
@@ -162,6 +170,62 @@ cache_result_t Cache::get_default_key(const char* zDefault_db,
     return CACHE_RESULT_OK;
 }
 
+cache_result_t Cache::get_key(const char* zDefault_db,
+                              const GWBUF* pStmt,
+                              const uint8_t* pParams,
+                              size_t nParams,
+                              CACHE_KEY* pKey) const
+{
+    // TODO: Take config into account.
+    return get_default_key(zDefault_db, pStmt, pParams, nParams, pKey);
+}
+
+// static
+cache_result_t Cache::get_default_key(const char* zDefault_db,
+                                      const GWBUF* pStmt,
+                                      const uint8_t* pParams,
+                                      size_t nParams,
+                                      CACHE_KEY* pKey)
+{
+    mxb_assert(GWBUF_IS_CONTIGUOUS(pStmt));
+
+    char* pSql;
+    int length;
+
+    modutil_extract_SQL(const_cast<GWBUF*>(pStmt), &pSql, &length);
+
+    uint64_t crc1 = crc32(0, Z_NULL, 0);
+
+    const Bytef* pData;
+
+    if (zDefault_db)
+    {
+        pData = reinterpret_cast<const Bytef*>(zDefault_db);
+        crc1 = crc32(crc1, pData, strlen(zDefault_db));
+    }
+
+    pData = reinterpret_cast<const Bytef*>(pSql);
+
+    crc1 = crc32(crc1, pData, length);
+    uint64_t crc2 = crc32(crc1, pData, length);
+
+    // The command byte separates the key from that of the same statement as a COM_QUERY.
+    const Bytef command = MXS_COM_STMT_EXECUTE;
+
+    crc1 = crc32(crc1, &command, 1);
+    crc2 = crc32(crc2, &command, 1);
+
+    if (nParams != 0)
+    {
+        crc1 = crc32(crc1, pParams, nParams);
+        crc2 = crc32(crc2, pParams, nParams);
+    }
+
+    pKey->data = (crc1 << 32 | crc2);
+
+    return CACHE_RESULT_OK;
+}
+
 const CacheRules* Cache::should_store(const char* zDefaultDb, const GWBUF* pQuery)
 {
     CacheRules* pRules = NULL;
@@ -183,6 +247,232 @@ const CacheRules* Cache::should_store(const char* zDefaultDb, const GWBUF* pQuer
     return pRules;
 }
 
+uint64_t Cache::epoch() const
+{
+    return m_epoch.load(std::memory_order_acquire);
+}
+
+void Cache::invalidate(const Tables& tables)
+{
+    pthread_rwlock_wrlock(&m_epochs_lock);
+
+    uint64_t epoch = m_epoch.load(std::memory_order_relaxed) + 1;
+    ++m_invalidations;
+
+    if (tables.empty())
+    {
+        // The table specific epochs are all older than the one of everything.
+        m_table_epochs.clear();
+        m_all_epoch.store(epoch, std::memory_order_release);
+    }
+    else
+    {
+        for (const auto& table : tables)
+        {
+            m_table_epochs[table] = epoch;
+        }
+
+        if (m_table_epochs.size() > MAX_TABLE_EPOCHS)
+        {
+            prune_table_epochs();
+        }
+
+        m_last_table_epoch.store(epoch, std::memory_order_release);
+    }
+
+    m_epoch.store(epoch, std::memory_order_release);
+
+    pthread_rwlock_unlock(&m_epochs_lock);
+}
+
+/**
+ * Removes the older half of the table epochs. All values requested before the
+ * newest removed epoch are treated as invalid, which at worst causes values that
+ * did not depend upon the removed tables to be refetched. Values requested after
+ * it are not affected, as the removed tables were not invalidated after them.
+ */
+void Cache::prune_table_epochs()
+{
+    std::vector<uint64_t> epochs;
+    epochs.reserve(m_table_epochs.size());
+
+    for (const auto& kv : m_table_epochs)
+    {
+        epochs.push_back(kv.second);
+    }
+
+    auto middle = epochs.begin() + epochs.size() / 2;
+    std::nth_element(epochs.begin(), middle, epochs.end());
+    uint64_t limit = *middle;
+
+    for (auto it = m_table_epochs.begin(); it != m_table_epochs.end();)
+    {
+        if (it->second <= limit)
+        {
+            it = m_table_epochs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    if (limit > m_all_epoch.load(std::memory_order_relaxed))
+    {
+        m_all_epoch.store(limit, std::memory_order_release);
+    }
+}
+
+void Cache::raise_epoch(uint64_t epoch)
+{
+    pthread_rwlock_wrlock(&m_epochs_lock);
+
+    if (epoch > m_epoch.load(std::memory_order_relaxed))
+    {
+        m_epoch.store(epoch, std::memory_order_release);
+    }
+
+    pthread_rwlock_unlock(&m_epochs_lock);
+}
+
+/**
+ * The invalidation information precedes the actual value and is laid out as
+ *
+ *   uint64_t epoch;
+ *   uint16_t n_tables;
+ *   n_tables * { uint16_t length; char name[length]; }
+ */
+
+// static
+GWBUF* Cache::wrap_value(const GWBUF* pValue, const Tables& tables, uint64_t epoch)
+{
+    mxb_assert(GWBUF_IS_CONTIGUOUS(pValue));
+
+    if (tables.size() > UINT16_MAX)
+    {
+        return NULL;
+    }
+
+    size_t header_len = sizeof(uint64_t) + sizeof(uint16_t);
+
+    for (const auto& table : tables)
+    {
+        if (table.length() > UINT16_MAX)
+        {
+            return NULL;
+        }
+
+        header_len += sizeof(uint16_t) + table.length();
+    }
+
+    size_t value_len = GWBUF_LENGTH(pValue);
+    GWBUF* pWrapped = gwbuf_alloc(header_len + value_len);
+
+    if (pWrapped)
+    {
+        uint8_t* pData = GWBUF_DATA(pWrapped);
+        uint16_t n_tables = tables.size();
+
+        memcpy(pData, &epoch, sizeof(epoch));
+        pData += sizeof(epoch);
+        memcpy(pData, &n_tables, sizeof(n_tables));
+        pData += sizeof(n_tables);
+
+        for (const auto& table : tables)
+        {
+            uint16_t len = table.length();
+            memcpy(pData, &len, sizeof(len));
+            pData += sizeof(len);
+            memcpy(pData, table.data(), len);
+            pData += len;
+        }
+
+        memcpy(pData, GWBUF_DATA(pValue), value_len);
+    }
+
+    return pWrapped;
+}
+
+bool Cache::unwrap_value(GWBUF** ppValue) const
+{
+    GWBUF* pValue = *ppValue;
+    mxb_assert(GWBUF_IS_CONTIGUOUS(pValue));
+
+    const uint8_t* pData = GWBUF_DATA(pValue);
+    const uint8_t* pEnd = pData + GWBUF_LENGTH(pValue);
+
+    uint64_t epoch;
+    uint16_t n_tables;
+    bool valid = (pEnd - pData >= (ptrdiff_t)(sizeof(epoch) + sizeof(n_tables)));
+
+    if (valid)
+    {
+        memcpy(&epoch, pData, sizeof(epoch));
+        pData += sizeof(epoch);
+        memcpy(&n_tables, pData, sizeof(n_tables));
+        pData += sizeof(n_tables);
+
+        valid = (epoch >= m_all_epoch.load(std::memory_order_acquire));
+
+        // The table epochs need to be consulted only if some table has been
+        // invalidated after the value was requested.
+        bool lookup = valid && n_tables != 0
+            && epoch < m_last_table_epoch.load(std::memory_order_acquire);
+
+        if (lookup)
+        {
+            pthread_rwlock_rdlock(&m_epochs_lock);
+        }
+
+        for (uint16_t i = 0; i < n_tables && pEnd - pData >= (ptrdiff_t)sizeof(uint16_t); ++i)
+        {
+            uint16_t len;
+            memcpy(&len, pData, sizeof(len));
+            pData += sizeof(len);
+
+            if (lookup && valid && (pEnd - pData >= (ptrdiff_t)len))
+            {
+                auto it = m_table_epochs.find(std::string(reinterpret_cast<const char*>(pData), len));
+
+                if (it != m_table_epochs.end() && it->second > epoch)
+                {
+                    valid = false;
+                }
+            }
+
+            pData += len;
+        }
+
+        if (lookup)
+        {
+            pthread_rwlock_unlock(&m_epochs_lock);
+        }
+
+        if (pData >= pEnd)
+        {
+            // Header without any value; the entry is broken.
+            valid = false;
+        }
+
+        if (!valid)
+        {
+            m_invalidated.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    if (valid)
+    {
+        *ppValue = gwbuf_consume(pValue, pData - GWBUF_DATA(pValue));
+    }
+    else
+    {
+        gwbuf_free(pValue);
+        *ppValue = NULL;
+    }
+
+    return valid;
+}
+
 json_t* Cache::do_get_info(uint32_t what) const
 {
     json_t* pInfo = json_object();
@@ -205,6 +495,24 @@ json_t* Cache::do_get_info(uint32_t what) const
                 json_object_set(pInfo, "rules", pArray);
             }
         }
+
+        if ((what & INFO_INVALIDATION) && invalidates())
+        {
+            json_t* pInvalidation = json_object();
+
+            if (pInvalidation)
+            {
+                pthread_rwlock_rdlock(&m_epochs_lock);
+
+                json_object_set_new(pInvalidation, "invalidations", json_integer(m_invalidations));
+                json_object_set_new(pInvalidation, "invalidated", json_integer(m_invalidated.load()));
+                json_object_set_new(pInvalidation, "tables", json_integer(m_table_epochs.size()));
+
+                pthread_rwlock_unlock(&m_epochs_lock);
+
+                json_object_set_new(pInfo, "invalidation", pInvalidation);
+            }
+        }
     }
 
     return pInfo;
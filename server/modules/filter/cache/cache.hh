@@ -13,10 +13,14 @@
 #pragma once
 
 #include <maxscale/ccdefs.hh>
+#include <pthread.h>
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <vector>
+#include <maxbase/worker.hh>
 #include <maxscale/buffer.h>
 #include <maxscale/session.h>
 #include "cachefilter.h"
@@ -25,19 +29,47 @@
 class CacheFilterSession;
 class StorageFactory;
 
+/**
+ * A session waiting for the data of a key to be fetched, either by another
+ * session or by a connection the session itself uses for refreshing the data
+ * in the background. The session clears pSession when it no longer waits, so
+ * that a notification already posted to its worker is ignored.
+ */
+struct CacheWaiter
+{
+    CacheFilterSession* pSession;   /*< The waiting session, NULL if no longer waiting. */
+    mxb::Worker*        pWorker;    /*< The worker of the waiting session. */
+};
+
+typedef std::shared_ptr<CacheWaiter> SCacheWaiter;
+
 class Cache
 {
 public:
     enum what_info_t
     {
-        INFO_RULES   = 0x01,/*< Include information about the rules. */
-        INFO_PENDING = 0x02,/*< Include information about any pending items. */
-        INFO_STORAGE = 0x04,/*< Include information about the storage. */
-        INFO_ALL     = (INFO_RULES | INFO_PENDING | INFO_STORAGE)
+        INFO_RULES        = 0x01,/*< Include information about the rules. */
+        INFO_PENDING      = 0x02,/*< Include information about any pending items. */
+        INFO_STORAGE      = 0x04,/*< Include information about the storage. */
+        INFO_INVALIDATION = 0x08,/*< Include information about the invalidation. */
+        INFO_COMPRESSION  = 0x10,/*< Include information about the compression. */
+        INFO_ALL          = (INFO_RULES | INFO_PENDING | INFO_STORAGE | INFO_INVALIDATION
+                             | INFO_COMPRESSION)
     };
 
     typedef std::shared_ptr<CacheRules>     SCacheRules;
     typedef std::shared_ptr<StorageFactory> SStorageFactory;
+    typedef std::vector<std::string>        Tables;
+
+    /**
+     * Called for each value when the values of the cache are visited. The
+     * value is provided as stored; possibly compressed and preceded by the
+     * invalidation information. Returning false stops the visiting.
+     */
+    typedef std::function<bool (const CACHE_KEY& key,
+                                const uint8_t* pData,
+                                size_t len,
+                                uint32_t time)> Visitor;
 
     virtual ~Cache();
 
@@ -79,6 +111,28 @@ public:
      */
     virtual void refreshed(const CACHE_KEY& key, const CacheFilterSession* pSession) = 0;
 
+    /**
+     * Register a session to be notified when the data of a key, being fetched
+     * by another session, has been stored or the fetching has ended. The
+     * notification is delivered on the worker of the waiting session and only
+     * once; a session that must wait further must register again.
+     *
+     * @param key      The hashed key for a query.
+     * @param sWaiter  The waiting session.
+     *
+     * @return True, if the data is being fetched and the session will be
+     *         notified, false otherwise.
+     */
+    virtual bool add_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter) = 0;
+
+    /**
+     * Unregister a session waiting for the data of a key.
+     *
+     * @param key      The hashed key for a query.
+     * @param sWaiter  The waiting session.
+     */
+    virtual void remove_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter) = 0;
+
     /**
      * Returns a key for the statement. Takes the current config into account.
      *
@@ -92,6 +146,18 @@ public:
                            const GWBUF* pQuery,
                            CACHE_KEY*   pKey) const;
 
+    /**
+     * Returns a key for the execution of a prepared statement. Takes the
+     * current config into account.
+     *
+     * @see get_default_key
+     */
+    cache_result_t get_key(const char* zDefault_db,
+                           const GWBUF* pStmt,
+                           const uint8_t* pParams,
+                           size_t nParams,
+                           CACHE_KEY* pKey) const;
+
     /**
      * Returns a key for the statement. Does not take the current config
      * into account.
@@ -106,6 +172,25 @@ public:
                                           const GWBUF* pQuery,
                                           CACHE_KEY*   pKey);
 
+    /**
+     * Returns a key for the execution of a prepared statement. The key is
+     * different from that of the same statement executed as a COM_QUERY, as
+     * the result is sent using the binary protocol.
+     *
+     * @param zDefault_db  The default database, can be NULL.
+     * @param pStmt        A COM_STMT_PREPARE packet.
+     * @param pParams      The parameter types and values of the execution.
+     * @param nParams      The length of @c pParams.
+     * @param pKey         On output a key.
+     *
+     * @return CACHE_RESULT_OK if a key could be created.
+     */
+    static cache_result_t get_default_key(const char* zDefault_db,
+                                          const GWBUF* pStmt,
+                                          const uint8_t* pParams,
+                                          size_t nParams,
+                                          CACHE_KEY* pKey);
+
     /**
      * See @Storage::get_value
      */
@@ -125,6 +210,87 @@ public:
      */
     virtual cache_result_t del_value(const CACHE_KEY& key) = 0;
 
+    /**
+     * Visits all values in the cache. With a thread specific cache, must not
+     * be called while the cache is being used.
+     *
+     * @param visitor  Function to call for each value.
+     *
+     * @return CACHE_RESULT_OK if the values were visited.
+     */
+    virtual cache_result_t visit_values(const Visitor& visitor) const = 0;
+
+    /**
+     * Restores a value obtained using @c visit_values.
+     *
+     * @see Storage::restore_value
+     */
+    virtual cache_result_t restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time) = 0;
+
+    /**
+     * Whether writes invalidate the entries that depend upon the written tables.
+     */
+    bool invalidates() const
+    {
+        return m_config.invalidate != CACHE_INVALIDATE_NEVER;
+    }
+
+    /**
+     * The maximum number of tables whose invalidation epoch is tracked. When
+     * exceeded, the older half of them is forgotten.
+     */
+    static const size_t MAX_TABLE_EPOCHS = 10000;
+
+    /**
+     * Returns the current invalidation epoch. A value is valid as long as none
+     * of the tables it depends upon has been invalidated after the epoch that
+     * was current when the value was requested from the server.
+     *
+     * @return The current epoch.
+     */
+    uint64_t epoch() const;
+
+    /**
+     * Invalidates all values that depend upon any of the provided tables.
+     *
+     * @param tables  Fully qualified and lower-case table names. If empty,
+     *                all values are invalidated.
+     */
+    void invalidate(const Tables& tables);
+
+    /**
+     * Ensures that the current epoch is at least the provided one. Used when
+     * values stored by an earlier instance are restored, so that subsequent
+     * invalidations are ordered after the epochs of those values.
+     *
+     * @param epoch  The epoch of the earlier instance.
+     */
+    void raise_epoch(uint64_t epoch);
+
+    /**
+     * Creates a value that, in addition to the actual value, contains the
+     * information needed for checking whether the value is still valid.
+     *
+     * @param pValue  The value to be stored.
+     * @param tables  The tables the value depends upon.
+     * @param epoch   The epoch when the value was requested from the server.
+     *
+     * @return A new contiguous buffer, or NULL if memory allocation fails or if
+     *         there are more than 65535 tables or a name longer than 65535 bytes.
+     */
+    static GWBUF* wrap_value(const GWBUF* pValue, const Tables& tables, uint64_t epoch);
+
+    /**
+     * Checks whether a value created with @c wrap_value is still valid and if
+     * it is, removes the invalidation information from it.
+     *
+     * @param ppValue  Pointer to a value obtained from the storage. If the value
+     *                 is no longer valid, it will be freed and set to NULL.
+     *
+     * @return True, if the value is still valid.
+     */
+    bool unwrap_value(GWBUF** ppValue) const;
+
 protected:
     Cache(const std::string& name,
           const CACHE_CONFIG* pConfig,
@@ -146,4 +312,17 @@ protected:
     const CACHE_CONFIG&      m_config;  // The configuration of the cache instance.
     std::vector<SCacheRules> m_rules;   // The rules of the cache instance.
     SStorageFactory          m_sFactory;// The storage factory.
+
+private:
+    typedef std::unordered_map<std::string, uint64_t> Epochs;
+
+    void prune_table_epochs();
+
+    mutable pthread_rwlock_t      m_epochs_lock;     // Protects m_table_epochs and m_invalidations.
+    std::atomic<uint64_t>         m_epoch;           // The current invalidation epoch.
+    std::atomic<uint64_t>         m_all_epoch;       // When everything was last invalidated.
+    std::atomic<uint64_t>         m_last_table_epoch;// When any table was last invalidated.
+    Epochs                        m_table_epochs;    // When a particular table was last invalidated.
+    uint64_t                      m_invalidations;   // The number of invalidations.
+    mutable std::atomic<uint64_t> m_invalidated;     // The number of values found to be invalid.
 };
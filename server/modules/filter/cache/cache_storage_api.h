@@ -29,7 +29,7 @@ typedef enum cache_result_bits
     CACHE_RESULT_OUT_OF_RESOURCES = 0x04,
 
     CACHE_RESULT_STALE     = 0x10000,   /*< Possibly combined with OK and NOT_FOUND. */
-    CACHE_RESULT_DISCARDED = 0x20000,   /*< Possibly combined with NOT_FOUND. */
+    CACHE_RESULT_DISCARDED = 0x20000,   /*< Possibly combined with NOT_FOUND and OK. */
 } cache_result_bits_t;
 
 typedef uint32_t cache_result_t;
@@ -59,6 +59,12 @@ typedef enum cache_thread_model
     CACHE_THREAD_MODEL_MT
 } cache_thread_model_t;
 
+typedef enum cache_admission
+{
+    CACHE_ADMISSION_ALL,        /*< All items are admitted. */
+    CACHE_ADMISSION_FREQUENCY   /*< Only items more frequent than the eviction victim are admitted. */
+} cache_admission_t;
+
 typedef void* CACHE_STORAGE;
 
 typedef struct cache_key
@@ -139,8 +145,33 @@ typedef struct cache_storage_config_t
      * specify 0, unless CACHE_STORAGE_CAP_MAX_SIZE is returned at initialization.
      */
     uint64_t max_size;
+
+    /**
+     * Specifies which new items are admitted when the storage is full. With
+     * CACHE_ADMISSION_FREQUENCY, a new item is stored only if it has been
+     * requested more frequently than the item that would be evicted. A storage
+     * that does not estimate frequencies may ignore this and admit all items.
+     */
+    cache_admission_t admission;
 } CACHE_STORAGE_CONFIG;
 
+/**
+ * A function called for each item when the items of a storage are visited.
+ *
+ * @param context  The context provided to @c visitValues.
+ * @param key      The key of the item.
+ * @param data     The value of the item. Only valid during the call.
+ * @param len      The length of the value.
+ * @param time     When the item was stored, in seconds since the Epoch.
+ *
+ * @return True, if the visiting should continue, false otherwise.
+ */
+typedef bool (* cache_storage_visitor_t)(void* context,
+                                         const CACHE_KEY* key,
+                                         const uint8_t* data,
+                                         size_t len,
+                                         uint32_t time);
+
 typedef struct cache_storage_api
 {
     /**
@@ -236,11 +267,13 @@ typedef struct cache_storage_api
      * @param storage    Pointer to a CACHE_STORAGE.
      * @param key        A key generated with get_key.
      * @param value      Pointer to GWBUF containing the value to be stored.
-     *                   Must be one contiguous buffer.
+     *                   May be a chain of buffers.
      *
      * @return CACHE_RESULT_OK if item was successfully put,
      *         CACHE_RESULT_OUT_OF_RESOURCES if item could not be put, due to
      *         some resource having become exhausted, or some other error code.
+     *         CACHE_RESULT_OK | CACHE_RESULT_DISCARDED if the item was not
+     *         admitted, due to the admission policy.
      */
     cache_result_t (* putValue)(CACHE_STORAGE* storage,
                                 const CACHE_KEY* key,
@@ -337,6 +370,49 @@ typedef struct cache_storage_api
      */
     cache_result_t (* getItems)(CACHE_STORAGE* storage,
                                 uint64_t* items);
+
+    /**
+     * Visit all items in the storage, e.g. for creating a snapshot. Items whose
+     * hard TTL has passed need not be visited. If the storage is used by several
+     * threads, it may be locked while the items are visited, so the visitor
+     * should not block.
+     *
+     * @param storage  Pointer to a CACHE_STORAGE.
+     * @param visitor  The function to call for each item.
+     * @param context  Provided as such to the visitor.
+     *
+     * @return CACHE_RESULT_OK if all items were visited or if the visitor
+     *         stopped the visiting,
+     *         CACHE_RESULT_OUT_OF_RESOURCES if the storage is incapable of
+     *         visiting the items, and
+     *         CACHE_RESULT_ERROR otherwise.
+     */
+    cache_result_t (* visitValues)(CACHE_STORAGE* storage,
+                                   cache_storage_visitor_t visitor,
+                                   void* context);
+
+    /**
+     * Put a value to the cache, as if it had been put at a particular time. The
+     * TTLs of the value are counted from that time. Intended for restoring items
+     * obtained using @c visitValues. A value already in the storage is more
+     * recent than the restored one, so an existing value is not replaced.
+     *
+     * @param storage  Pointer to a CACHE_STORAGE.
+     * @param key      A key generated with get_key.
+     * @param value    Pointer to GWBUF containing the value to be stored.
+     *                 May be a chain of buffers.
+     * @param time     When the value was originally stored, in seconds since
+     *                 the Epoch.
+     *
+     * @return As for @c putValue, CACHE_RESULT_OK | CACHE_RESULT_DISCARDED if
+     *         the storage already contained a value for the key, and
+     *         CACHE_RESULT_OUT_OF_RESOURCES if the storage is incapable of
+     *         restoring values.
+     */
+    cache_result_t (* restoreValue)(CACHE_STORAGE* storage,
+                                    const CACHE_KEY* key,
+                                    const GWBUF* value,
+                                    uint32_t time);
 } CACHE_STORAGE_API;
 
 #if defined __cplusplus
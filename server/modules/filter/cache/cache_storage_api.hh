@@ -69,13 +69,15 @@ public:
                        uint32_t hard_ttl = 0,
                        uint32_t soft_ttl = 0,
                        uint32_t max_count = 0,
-                       uint64_t max_size = 0)
+                       uint64_t max_size = 0,
+                       cache_admission_t admission = CACHE_ADMISSION_ALL)
     {
         this->thread_model = thread_model;
         this->hard_ttl = hard_ttl;
         this->soft_ttl = soft_ttl;
         this->max_count = max_count;
         this->max_size = max_size;
+        this->admission = admission;
     }
 
     CacheStorageConfig()
@@ -85,6 +87,7 @@ public:
         soft_ttl = 0;
         max_count = 0;
         max_size = 0;
+        admission = CACHE_ADMISSION_ALL;
     }
 
     CacheStorageConfig(const CACHE_STORAGE_CONFIG& config)
@@ -94,5 +97,6 @@ public:
         soft_ttl = config.soft_ttl;
         max_count = config.max_count;
         max_size = config.max_size;
+        admission = config.admission;
     }
 };
@@ -22,6 +22,7 @@
 
 #include "cachemt.hh"
 #include "cachept.hh"
+#include "cachesnapshot.hh"
 
 using std::auto_ptr;
 using std::string;
@@ -42,6 +43,7 @@ void cache_config_finish(CACHE_CONFIG& config)
     MXS_FREE(config.storage);
     MXS_FREE(config.storage_options);
     MXS_FREE(config.storage_argv);      // The items need not be freed, they point into storage_options.
+    MXS_FREE(config.snapshot);
 
     config.max_resultset_rows = 0;
     config.max_resultset_size = 0;
@@ -50,11 +52,17 @@ void cache_config_finish(CACHE_CONFIG& config)
     config.storage_options = NULL;
     config.storage_argc = 0;
     config.storage_argv = NULL;
+    config.snapshot = NULL;
     config.hard_ttl = 0;
     config.soft_ttl = 0;
     config.debug = 0;
     config.thread_model = CACHE_DEFAULT_THREAD_MODEL;
     config.selects = CACHE_DEFAULT_SELECTS;
+    config.invalidate = CACHE_INVALIDATE_NEVER;
+    config.compression = CACHE_COMPRESSION_NONE;
+    config.compression_threshold = 0;
+    config.admission = CACHE_ADMISSION_ALL;
+    config.background_refresh = false;
 }
 
 /**
@@ -94,9 +102,9 @@ void cache_config_reset(CACHE_CONFIG& config)
 bool cache_command_show(const MODULECMD_ARG* pArgs, json_t** output)
 {
     mxb_assert(pArgs->argc == 1);
-    mxb_assert(MODULECMD_GET_TYPE(&pArgs->argv[1].type) == MODULECMD_ARG_FILTER);
+    mxb_assert(MODULECMD_GET_TYPE(&pArgs->argv[0].type) == MODULECMD_ARG_FILTER);
 
-    const MXS_FILTER_DEF* pFilterDef = pArgs->argv[1].value.filter;
+    const MXS_FILTER_DEF* pFilterDef = pArgs->argv[0].value.filter;
     mxb_assert(pFilterDef);
     CacheFilter* pFilter = reinterpret_cast<CacheFilter*>(filter_def_get_instance(pFilterDef));
 
@@ -105,6 +113,50 @@ bool cache_command_show(const MODULECMD_ARG* pArgs, json_t** output)
     return true;
 }
 
+/**
+ * Implement "call command cache snapshot ..."
+ *
+ * @param pArgs  The arguments of the command.
+ *
+ * @return True, if the snapshot was saved.
+ */
+bool cache_command_snapshot(const MODULECMD_ARG* pArgs, json_t** output)
+{
+    mxb_assert(pArgs->argc == 1);
+    mxb_assert(MODULECMD_GET_TYPE(&pArgs->argv[0].type) == MODULECMD_ARG_FILTER);
+
+    const MXS_FILTER_DEF* pFilterDef = pArgs->argv[0].value.filter;
+    mxb_assert(pFilterDef);
+    CacheFilter* pFilter = reinterpret_cast<CacheFilter*>(filter_def_get_instance(pFilterDef));
+
+    const Cache& cache = pFilter->cache();
+    const CACHE_CONFIG& config = cache.config();
+
+    bool rv = false;
+
+    if (!config.snapshot)
+    {
+        modulecmd_set_error("The parameter 'snapshot' has not been specified for the cache.");
+    }
+    else if (config.thread_model != CACHE_THREAD_MODEL_MT)
+    {
+        // The thread specific caches can only be accessed by their own threads.
+        modulecmd_set_error("A snapshot can be saved on demand only if the value of "
+                            "'cached_data' is 'shared'.");
+    }
+    else
+    {
+        MXS_EXCEPTION_GUARD(rv = CacheSnapshot::save(cache, config.snapshot));
+
+        if (!rv)
+        {
+            modulecmd_set_error("Could not save the snapshot, see the log for details.");
+        }
+    }
+
+    return rv;
+}
+
 int cache_process_init()
 {
     uint32_t jit_available;
@@ -149,6 +201,30 @@ static const MXS_ENUM_VALUE parameter_cache_in_trxs_values[] =
     {NULL}
 };
 
+// Enumeration values for `invalidate`
+static const MXS_ENUM_VALUE parameter_invalidate_values[] =
+{
+    {"never",   CACHE_INVALIDATE_NEVER  },
+    {"current", CACHE_INVALIDATE_CURRENT},
+    {NULL}
+};
+
+// Enumeration values for `compression`
+static const MXS_ENUM_VALUE parameter_compression_values[] =
+{
+    {"none", CACHE_COMPRESSION_NONE},
+    {"zlib", CACHE_COMPRESSION_ZLIB},
+    {NULL}
+};
+
+// Enumeration values for `admission`
+static const MXS_ENUM_VALUE parameter_admission_values[] =
+{
+    {"all",       CACHE_ADMISSION_ALL      },
+    {"frequency", CACHE_ADMISSION_FREQUENCY},
+    {NULL}
+};
+
 extern "C" MXS_MODULE* MXS_CREATE_MODULE()
 {
     static modulecmd_arg_type_t show_argv[] =
@@ -164,6 +240,19 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
                                show_argv,
                                "Show cache filter statistics");
 
+    static modulecmd_arg_type_t snapshot_argv[] =
+    {
+        {MODULECMD_ARG_FILTER | MODULECMD_ARG_NAME_MATCHES_DOMAIN, "Cache name"}
+    };
+
+    modulecmd_register_command(MXS_MODULE_NAME,
+                               "snapshot",
+                               MODULECMD_TYPE_ACTIVE,
+                               cache_command_snapshot,
+                               MXS_ARRAY_NELEMS(snapshot_argv),
+                               snapshot_argv,
+                               "Save the cached values to the snapshot file");
+
     MXS_NOTICE("Initialized cache module %s.\n", VERSION_STRING);
 
     static MXS_MODULE info =
@@ -254,6 +343,51 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
                 MXS_MODULE_PARAM_BOOL,
                 CACHE_ZDEFAULT_ENABLED
             },
+            {
+                "invalidate",
+                MXS_MODULE_PARAM_ENUM,
+                CACHE_ZDEFAULT_INVALIDATE,
+                MXS_MODULE_OPT_NONE,
+                parameter_invalidate_values
+            },
+            {
+                "shards",
+                MXS_MODULE_PARAM_COUNT,
+                CACHE_ZDEFAULT_SHARDS
+            },
+            {
+                "coalesce_timeout",
+                MXS_MODULE_PARAM_COUNT,
+                CACHE_ZDEFAULT_COALESCE_TIMEOUT
+            },
+            {
+                "compression",
+                MXS_MODULE_PARAM_ENUM,
+                CACHE_ZDEFAULT_COMPRESSION,
+                MXS_MODULE_OPT_NONE,
+                parameter_compression_values
+            },
+            {
+                "compression_threshold",
+                MXS_MODULE_PARAM_SIZE,
+                CACHE_ZDEFAULT_COMPRESSION_THRESHOLD
+            },
+            {
+                "admission",
+                MXS_MODULE_PARAM_ENUM,
+                CACHE_ZDEFAULT_ADMISSION,
+                MXS_MODULE_OPT_NONE,
+                parameter_admission_values
+            },
+            {
+                "background_refresh",
+                MXS_MODULE_PARAM_BOOL,
+                CACHE_ZDEFAULT_BACKGROUND_REFRESH
+            },
+            {
+                "snapshot",
+                MXS_MODULE_PARAM_STRING
+            },
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -266,12 +400,26 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
 //
 
 CacheFilter::CacheFilter()
+    : m_stop_restoring(false)
 {
     cache_config_reset(m_config);
 }
 
 CacheFilter::~CacheFilter()
 {
+    if (m_restorer.joinable())
+    {
+        m_stop_restoring.store(true);
+        m_restorer.join();
+    }
+
+    if (m_sCache.get() && m_config.snapshot)
+    {
+        // At shutdown all workers have stopped, so also thread specific caches
+        // can be accessed.
+        MXS_EXCEPTION_GUARD(CacheSnapshot::save(*m_sCache.get(), m_config.snapshot));
+    }
+
     cache_config_finish(m_config);
 }
 
@@ -306,6 +454,11 @@ CacheFilter* CacheFilter::create(const char* zName, MXS_CONFIG_PARAMETER* ppPara
         if (pCache)
         {
             pFilter->m_sCache = auto_ptr<Cache>(pCache);
+
+            if (pFilter->m_config.snapshot)
+            {
+                pFilter->restore_snapshot();
+            }
         }
         else
         {
@@ -340,6 +493,39 @@ uint64_t CacheFilter::getCapabilities()
     return RCAP_TYPE_NONE;
 }
 
+void CacheFilter::restore_snapshot()
+{
+    std::shared_ptr<CacheSnapshot> sSnapshot;
+
+    MXS_EXCEPTION_GUARD(sSnapshot = CacheSnapshot::open(*m_sCache.get(), m_config.snapshot));
+
+    if (sSnapshot)
+    {
+        if (m_config.thread_model == CACHE_THREAD_MODEL_MT)
+        {
+            // The shared cache can be used while it is being restored, so the
+            // sessions need not wait for it.
+            try
+            {
+                m_restorer = std::thread([this, sSnapshot]() {
+                                             MXS_EXCEPTION_GUARD(sSnapshot->restore(m_stop_restoring));
+                                         });
+            }
+            catch (const std::exception& x)
+            {
+                MXS_ERROR("Could not start restoring the cache snapshot in the background: %s",
+                          x.what());
+            }
+        }
+        else
+        {
+            // A thread specific cache may only be accessed by its own thread, but
+            // as the filter is not yet in use, it can be restored here.
+            MXS_EXCEPTION_GUARD(sSnapshot->restore(m_stop_restoring));
+        }
+    }
+}
+
 // static
 bool CacheFilter::process_params(MXS_CONFIG_PARAMETER* ppParams, CACHE_CONFIG& config)
 {
@@ -363,6 +549,20 @@ bool CacheFilter::process_params(MXS_CONFIG_PARAMETER* ppParams, CACHE_CONFIG& c
                                                                         "cache_in_transactions",
                                                                         parameter_cache_in_trxs_values));
     config.enabled = config_get_bool(ppParams, "enabled");
+    config.invalidate = static_cast<cache_invalidate_t>(config_get_enum(ppParams,
+                                                                        "invalidate",
+                                                                        parameter_invalidate_values));
+    config.shards = config_get_integer(ppParams, "shards");
+    config.coalesce_timeout = config_get_integer(ppParams, "coalesce_timeout");
+    config.compression = static_cast<cache_compression_t>(config_get_enum(ppParams,
+                                                                          "compression",
+                                                                          parameter_compression_values));
+    config.compression_threshold = config_get_size(ppParams, "compression_threshold");
+    config.admission = static_cast<cache_admission_t>(config_get_enum(ppParams,
+                                                                      "admission",
+                                                                      parameter_admission_values));
+    config.background_refresh = config_get_bool(ppParams, "background_refresh");
+    config.snapshot = config_copy_string(ppParams, "snapshot");
 
     if (!config.storage)
     {
@@ -407,7 +607,7 @@ bool CacheFilter::process_params(MXS_CONFIG_PARAMETER* ppParams, CACHE_CONFIG& c
                 arg = config.storage_options;
                 config.storage_argv[i++] = arg;
 
-                while ((arg = strchr(config.storage_options, ',')))
+                while ((arg = strchr(arg, ',')))
                 {
                     *arg = 0;
                     ++arg;
@@ -461,6 +661,12 @@ bool CacheFilter::process_params(MXS_CONFIG_PARAMETER* ppParams, CACHE_CONFIG& c
                 config.max_resultset_size = config.max_size;
             }
         }
+
+        if ((config.admission != CACHE_ADMISSION_ALL) && (config.max_count == 0) && (config.max_size == 0))
+        {
+            MXS_WARNING("'admission' has no effect unless 'max_count' or 'max_size' is specified, "
+                        "as items are then never evicted.");
+        }
     }
 
     if (error)
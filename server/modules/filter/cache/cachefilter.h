@@ -70,6 +70,20 @@ const cache_selects_t CACHE_DEFAULT_SELECTS = CACHE_SELECTS_ASSUME_CACHEABLE;
 #define CACHE_ZDEFAULT_CACHE_IN_TRXS "all_transactions"
 // Enabled
 #define CACHE_ZDEFAULT_ENABLED "true"
+// Invalidation
+#define CACHE_ZDEFAULT_INVALIDATE "never"
+// Positive integer, 0 means one per thread
+#define CACHE_ZDEFAULT_SHARDS "1"
+// Milliseconds, 0 means disabled
+#define CACHE_ZDEFAULT_COALESCE_TIMEOUT "0"
+// Compression
+#define CACHE_ZDEFAULT_COMPRESSION "none"
+// Bytes
+#define CACHE_ZDEFAULT_COMPRESSION_THRESHOLD "1024"
+// Admission
+#define CACHE_ZDEFAULT_ADMISSION "all"
+// Background refresh
+#define CACHE_ZDEFAULT_BACKGROUND_REFRESH "false"
 
 typedef enum cache_in_trxs
 {
@@ -79,6 +93,18 @@ typedef enum cache_in_trxs
     CACHE_IN_TRXS_ALL,
 } cache_in_trxs_t;
 
+typedef enum cache_invalidate
+{
+    CACHE_INVALIDATE_NEVER,     /*< Entries are removed only due to TTL or eviction. */
+    CACHE_INVALIDATE_CURRENT,   /*< Writes seen by this filter invalidate dependent entries. */
+} cache_invalidate_t;
+
+typedef enum cache_compression
+{
+    CACHE_COMPRESSION_NONE,     /*< Values are stored as such. */
+    CACHE_COMPRESSION_ZLIB,     /*< Values are compressed using zlib. */
+} cache_compression_t;
+
 typedef struct cache_config
 {
     uint64_t max_resultset_rows;            /**< The maximum number of rows of a resultset for it to be
@@ -98,4 +124,12 @@ typedef struct cache_config
     cache_selects_t      selects;           /**< Assume/verify that selects are cacheable. */
     cache_in_trxs_t      cache_in_trxs;     /**< To cache or not to cache inside transactions. */
     bool                 enabled;           /**< Whether the cache is enabled or not. */
+    cache_invalidate_t   invalidate;        /**< How entries should be invalidated. */
+    uint32_t             shards;            /**< Number of shards of a shared cache, 0 means one per thread. */
+    uint32_t             coalesce_timeout;  /**< How long to wait for data fetched by another session. */
+    cache_compression_t  compression;       /**< How values should be compressed. */
+    uint64_t             compression_threshold; /**< The minimum size of a value to be compressed. */
+    cache_admission_t    admission;         /**< Which new items are admitted to a full cache. */
+    bool                 background_refresh;/**< Whether stale entries are refreshed in the background. */
+    char*                snapshot;          /**< Where the cache is saved at shutdown, or NULL. */
 } CACHE_CONFIG;
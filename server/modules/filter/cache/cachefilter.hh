@@ -13,6 +13,8 @@
 #pragma once
 
 #include <maxscale/ccdefs.hh>
+#include <atomic>
+#include <thread>
 #include <maxscale/filter.hh>
 #include "cachefilter.h"
 #include "cachefiltersession.hh"
@@ -50,7 +52,11 @@ private:
 
     static bool process_params(MXS_CONFIG_PARAMETER* ppParams, CACHE_CONFIG& config);
 
+    void restore_snapshot();
+
 private:
     CACHE_CONFIG         m_config;
     std::auto_ptr<Cache> m_sCache;
+    std::thread          m_restorer;        // Restores the snapshot of a shared cache.
+    std::atomic<bool>    m_stop_restoring;  // Tells the restorer to stop.
 };
@@ -13,10 +13,12 @@
 
 #define MXS_MODULE_NAME "cache"
 #include "cachefiltersession.hh"
+#include <algorithm>
 #include <new>
 #include <maxscale/alloc.h>
 #include <maxscale/modutil.h>
 #include <maxscale/mysql_utils.h>
+#include <maxscale/poll.h>
 #include <maxscale/query_classifier.h>
 #include "storage.hh"
 
@@ -42,6 +44,23 @@ const char SV_MAXSCALE_CACHE_USE[] = "@maxscale.cache.use";
 const char SV_MAXSCALE_CACHE_SOFT_TTL[] = "@maxscale.cache.soft_ttl";
 const char SV_MAXSCALE_CACHE_HARD_TTL[] = "@maxscale.cache.hard_ttl";
 
+// For how long, in seconds, a session waits for an entry to be refreshed in
+// the background before letting some other session refresh it.
+const int32_t BACKGROUND_REFRESH_TIMEOUT = 10;
+
+// For how long, in seconds, a session waits before trying again to create the
+// background connection, if it could not be created. The time is doubled on
+// each consecutive failure.
+const int32_t REFRESHER_BACKOFF_MIN = 1;
+const int32_t REFRESHER_BACKOFF_MAX = 60;
+
+// Sent on the background connection, so that the cache filter of that session
+// fetches the data from the server and stores it, instead of using the stale entry.
+const char BACKGROUND_REFRESH_SETUP[] = "SET @maxscale.cache.populate=true, @maxscale.cache.use=false";
+
+// The statement id of a COM_STMT_EXECUTE referring to the most recently prepared statement.
+const uint32_t DIRECT_EXEC_STMT_ID = 0xffffffff;
+
 const char* NON_CACHEABLE_FUNCTIONS[] =
 {
     "benchmark",
@@ -177,6 +196,49 @@ bool is_select_statement(GWBUF* pStmt)
 
     return is_select;
 }
+
+/**
+ * Get the names of the tables a statement refers to.
+ *
+ * @param pStmt       A contiguous COM_QUERY or COM_STMT_PREPARE packet.
+ * @param zDefaultDb  The current default database, may be NULL.
+ * @param pTables     On return, the fully qualified lower-case table names.
+ *
+ * @return True, if the statement could be parsed completely, false otherwise.
+ */
+bool get_table_names(GWBUF* pStmt, const char* zDefaultDb, Cache::Tables* pTables)
+{
+    bool parsed = (qc_parse(pStmt, QC_COLLECT_TABLES) == QC_QUERY_PARSED);
+
+    int n = 0;
+    char** pzNames = qc_get_table_names(pStmt, &n, true);
+
+    for (int i = 0; i < n; ++i)
+    {
+        std::string name;
+
+        if (zDefaultDb && !strchr(pzNames[i], '.'))
+        {
+            name = zDefaultDb;
+            name += '.';
+        }
+
+        name += pzNames[i];
+        std::transform(name.begin(), name.end(), name.begin(), tolower);
+
+        pTables->push_back(name);
+    }
+
+    if (pzNames)
+    {
+        qc_free_table_names(pzNames, n);
+    }
+
+    std::sort(pTables->begin(), pTables->end());
+    pTables->erase(std::unique(pTables->begin(), pTables->end()), pTables->end());
+
+    return parsed;
+}
 }
 
 CacheFilterSession::CacheFilterSession(MXS_SESSION* pSession, Cache* pCache, char* zDefaultDb)
@@ -191,6 +253,18 @@ CacheFilterSession::CacheFilterSession(MXS_SESSION* pSession, Cache* pCache, cha
     , m_populate(pCache->config().enabled)
     , m_soft_ttl(pCache->config().soft_ttl)
     , m_hard_ttl(pCache->config().hard_ttl)
+    , m_epoch(0)
+    , m_written_all(false)
+    , m_preparing_all(false)
+    , m_unknown_all(false)
+    , m_pWaiting(NULL)
+    , m_wait_call_id(0)
+    , m_pipelined(false)
+    , m_pRefresher(NULL)
+    , m_refresher_backoff(0)
+    , m_refresh_call_id(0)
+    , m_pPreparing(NULL)
+    , m_last_stmt_id(0)
 {
     m_key.data = 0;
 
@@ -243,6 +317,12 @@ CacheFilterSession::CacheFilterSession(MXS_SESSION* pSession, Cache* pCache, cha
 
 CacheFilterSession::~CacheFilterSession()
 {
+    for (auto& kv : m_prepared_stmts)
+    {
+        gwbuf_free(kv.second.pPrepare);
+    }
+
+    gwbuf_free(m_pPreparing);
     MXS_FREE(m_zUseDb);
     MXS_FREE(m_zDefaultDb);
 }
@@ -278,6 +358,19 @@ CacheFilterSession* CacheFilterSession::Create(Cache* pCache, MXS_SESSION* pSess
 
 void CacheFilterSession::close()
 {
+    end_waiting();
+
+    gwbuf_free(m_pWaiting);
+    m_pWaiting = NULL;
+
+    if (m_refreshing)
+    {
+        // Let some other session fetch the data.
+        m_pCache->refreshed(m_key, this);
+        m_refreshing = false;
+    }
+
+    end_background_refreshes();
 }
 
 int CacheFilterSession::routeQuery(GWBUF* pPacket)
@@ -291,8 +384,28 @@ int CacheFilterSession::routeQuery(GWBUF* pPacket)
 
     routing_action_t action = ROUTING_CONTINUE;
 
+    if (m_pWaiting)
+    {
+        // The client did not wait for the response before sending more. The waiting
+        // SELECT is routed now and its response will arrive first, so the state it
+        // set up must be retained.
+        stop_waiting();
+
+        return route_pipelined(pPacket);
+    }
+
     reset_response_state();
     m_state = CACHE_IGNORING_RESPONSE;
+    m_pipelined = false;
+
+    if (m_pPreparing)
+    {
+        // The client did not wait for the response of the COM_STMT_PREPARE,
+        // the statement will not be cached.
+        gwbuf_free(m_pPreparing);
+        m_pPreparing = NULL;
+        add_unknown_writes();
+    }
 
     int rv = 1;
 
@@ -323,19 +436,62 @@ int CacheFilterSession::routeQuery(GWBUF* pPacket)
         break;
 
     case MXS_COM_STMT_PREPARE:
-        if (log_decisions())
+        if (m_pCache->invalidates())
+        {
+            invalidate_tables(pPacket);
+        }
+
+        // The statement is needed when it is executed, which is done using
+        // the id found in the response.
+        m_pPreparing = gwbuf_deep_clone(pPacket);
+
+        if (m_pPreparing)
         {
-            MXS_NOTICE("COM_STMT_PREPARE, ignoring.");
+            m_state = CACHE_EXPECTING_PREPARE_RESPONSE;
+        }
+        else
+        {
+            add_unknown_writes();
         }
         break;
 
     case MXS_COM_STMT_EXECUTE:
-        if (log_decisions())
+        if (m_pCache->invalidates())
+        {
+            invalidate_prepared(pPacket);
+        }
+
+        action = route_COM_STMT_EXECUTE(pPacket);
+        break;
+
+    case MXS_COM_STMT_SEND_LONG_DATA:
+        {
+            // The parameter values of the next execution will not all be in the
+            // COM_STMT_EXECUTE packet, so it cannot be used for creating the key.
+            PreparedStmt* pStmt = get_prepared_stmt(pPacket);
+
+            if (pStmt)
+            {
+                pStmt->long_data = true;
+            }
+        }
+        break;
+
+    case MXS_COM_STMT_RESET:
         {
-            MXS_NOTICE("COM_STMT_EXECUTE, ignoring.");
+            PreparedStmt* pStmt = get_prepared_stmt(pPacket);
+
+            if (pStmt)
+            {
+                pStmt->long_data = false;
+            }
         }
         break;
 
+    case MXS_COM_STMT_CLOSE:
+        close_prepared_stmt(mxs_mysql_extract_ps_id(pPacket));
+        break;
+
     case MXS_COM_QUERY:
         action = route_COM_QUERY(pPacket);
         break;
@@ -356,7 +512,44 @@ int CacheFilterSession::clientReply(GWBUF* pData)
 {
     int rv;
 
-    if (m_res.pData)
+    if ((m_written_all || !m_written_tables.empty()) && !session_trx_is_active(m_pSession))
+    {
+        reinvalidate_tables();
+    }
+
+    int rv_upstream = 1;
+    bool streamed = false;
+
+    if (is_collecting_response())
+    {
+        // The response is forwarded to the client immediately and a copy is retained
+        // for storing once the response is complete. The data must not be shared, as
+        // the buffer forwarded upstream may be modified.
+        GWBUF* pClone = gwbuf_deep_clone(pData);
+
+        rv_upstream = m_up.clientReply(pData);
+        streamed = true;
+
+        if (pClone)
+        {
+            pData = pClone;
+            m_res.sent = true;
+        }
+        else
+        {
+            // Not a reason to disturb the client, just stop collecting the response.
+            gwbuf_free(m_res.pData);
+            reset_response_state();
+            m_state = CACHE_IGNORING_RESPONSE;
+            pData = NULL;
+        }
+    }
+
+    if (!pData)
+    {
+        // Nothing to process.
+    }
+    else if (m_res.pData)
     {
         gwbuf_append(m_res.pData, pData);
         m_res.pData_last = pData;
@@ -371,7 +564,7 @@ int CacheFilterSession::clientReply(GWBUF* pData)
         m_res.length = gwbuf_length(pData);
     }
 
-    if (m_state != CACHE_IGNORING_RESPONSE)
+    if (pData && (m_state != CACHE_IGNORING_RESPONSE))
     {
         if (cache_max_resultset_size_exceeded(m_pCache->config(), m_res.length))
         {
@@ -409,8 +602,12 @@ int CacheFilterSession::clientReply(GWBUF* pData)
         rv = handle_expecting_use_response();
         break;
 
+    case CACHE_EXPECTING_PREPARE_RESPONSE:
+        rv = handle_expecting_prepare_response();
+        break;
+
     case CACHE_IGNORING_RESPONSE:
-        rv = handle_ignoring_response();
+        rv = pData ? handle_ignoring_response() : 1;
         break;
 
     default:
@@ -421,6 +618,26 @@ int CacheFilterSession::clientReply(GWBUF* pData)
         m_state = CACHE_IGNORING_RESPONSE;
     }
 
+    if (m_refreshing && ((m_state == CACHE_IGNORING_RESPONSE) || (m_state == CACHE_EXPECTING_NOTHING)))
+    {
+        // The response was not stored, so let some other session fetch the data.
+        m_pCache->refreshed(m_key, this);
+        m_refreshing = false;
+    }
+
+    if (m_pipelined && (m_state == CACHE_EXPECTING_NOTHING))
+    {
+        // What follows are the responses to packets that were not inspected.
+        m_state = CACHE_IGNORING_RESPONSE;
+        m_pipelined = false;
+    }
+
+    if (streamed)
+    {
+        // What the client got in response is what matters.
+        rv = rv_upstream;
+    }
+
     return rv;
 }
 
@@ -713,6 +930,80 @@ int CacheFilterSession::handle_expecting_use_response()
     return rv;
 }
 
+/**
+ * Called when a response to a COM_STMT_PREPARE is received from the server.
+ */
+int CacheFilterSession::handle_expecting_prepare_response()
+{
+    mxb_assert(m_state == CACHE_EXPECTING_PREPARE_RESPONSE);
+    mxb_assert(m_res.pData);
+    mxb_assert(m_pPreparing);
+
+    int rv = 1;
+
+    // COM_STMT_PREPARE_OK: status, statement id (4), columns (2), parameters (2).
+    const size_t PREPARE_OK_LEN = MYSQL_HEADER_LEN + 1 + 4 + 2 + 2;
+
+    size_t buflen = m_res.length;
+    mxb_assert(m_res.length == gwbuf_length(m_res.pData));
+
+    uint8_t header[PREPARE_OK_LEN];
+
+    if (buflen >= MYSQL_HEADER_LEN + 1)     // We need the command byte.
+    {
+        copy_data(0, MYSQL_HEADER_LEN + 1, header);
+
+        bool complete = true;
+
+        if (header[MYSQL_HEADER_LEN] != MYSQL_REPLY_OK)
+        {
+            // An error, nothing to remember.
+        }
+        else if (buflen >= PREPARE_OK_LEN)
+        {
+            copy_data(0, PREPARE_OK_LEN, header);
+
+            uint32_t id = gw_mysql_get_byte4(&header[MYSQL_HEADER_LEN + 1]);
+            uint16_t nParams = gw_mysql_get_byte2(&header[MYSQL_HEADER_LEN + 7]);
+
+            close_prepared_stmt(id);
+
+            try
+            {
+                m_prepared_stmts.insert(std::make_pair(id, PreparedStmt {m_pPreparing, nParams, {}, false,
+                                                                         m_preparing_tables,
+                                                                         m_preparing_all}));
+                m_pPreparing = NULL;
+                m_last_stmt_id = id;
+            }
+            catch (const std::exception&)
+            {
+                // Just means that the statement will not be cached.
+                MXS_OOM();
+                add_unknown_writes();
+            }
+        }
+        else
+        {
+            // We need more data. We will be called again, when data is available.
+            complete = false;
+        }
+
+        if (complete)
+        {
+            gwbuf_free(m_pPreparing);
+            m_pPreparing = NULL;
+            m_preparing_tables.clear();
+            m_preparing_all = false;
+
+            rv = send_upstream();
+            m_state = CACHE_IGNORING_RESPONSE;
+        }
+    }
+
+    return rv;
+}
+
 /**
  * Called when all data from the server is ignored.
  */
@@ -733,12 +1024,36 @@ int CacheFilterSession::send_upstream()
 {
     mxb_assert(m_res.pData != NULL);
 
-    int rv = m_up.clientReply(m_res.pData);
+    int rv = 1;
+
+    if (m_res.sent)
+    {
+        // The data has already been streamed to the client, what remains is a clone.
+        gwbuf_free(m_res.pData);
+        m_res.sent = false;
+    }
+    else
+    {
+        rv = m_up.clientReply(m_res.pData);
+    }
+
     m_res.pData = NULL;
 
     return rv;
 }
 
+/**
+ * Whether the response currently being received may be stored in the cache.
+ *
+ * @return True, if the response should be collected.
+ */
+bool CacheFilterSession::is_collecting_response() const
+{
+    return (m_state == CACHE_EXPECTING_RESPONSE)
+           || (m_state == CACHE_EXPECTING_FIELDS)
+           || (m_state == CACHE_EXPECTING_ROWS);
+}
+
 /**
  * Reset cache response state
  */
@@ -752,6 +1067,7 @@ void CacheFilterSession::reset_response_state()
     m_res.nFields = 0;
     m_res.nRows = 0;
     m_res.offset = 0;
+    m_res.sent = false;
 }
 
 /**
@@ -769,7 +1085,19 @@ void CacheFilterSession::store_result()
     {
         m_res.pData = pData;
 
-        cache_result_t result = m_pCache->put_value(m_key, m_res.pData);
+        GWBUF* pValue = m_res.pData;
+
+        if (m_pCache->invalidates())
+        {
+            pValue = Cache::wrap_value(m_res.pData, m_tables, m_epoch);
+        }
+
+        cache_result_t result = pValue ? m_pCache->put_value(m_key, pValue) : CACHE_RESULT_OUT_OF_RESOURCES;
+
+        if (pValue != m_res.pData)
+        {
+            gwbuf_free(pValue);
+        }
 
         if (!CACHE_RESULT_IS_OK(result))
         {
@@ -791,6 +1119,110 @@ void CacheFilterSession::store_result()
     }
 }
 
+/**
+ * Invalidate the tables a statement modifies, if it is a write.
+ *
+ * @param pPacket  A contiguous COM_QUERY or COM_STMT_PREPARE packet.
+ */
+void CacheFilterSession::invalidate_tables(GWBUF* pPacket)
+{
+    uint32_t type_mask = qc_get_type_mask(pPacket);
+
+    if (qc_query_is_type(type_mask, QUERY_TYPE_WRITE))
+    {
+        Cache::Tables tables;
+        bool all = !get_table_names(pPacket, m_zDefaultDb, &tables)
+            || tables.empty()
+            || (qc_get_operation(pPacket) == QUERY_OP_CALL);
+
+        if (MYSQL_GET_COMMAND(GWBUF_DATA(pPacket)) == MXS_COM_STMT_PREPARE)
+        {
+            // Nothing is modified until the statement is executed, which is
+            // done using the id found in the response.
+            m_preparing_all = all;
+            m_preparing_tables = std::move(tables);
+        }
+        else
+        {
+            invalidate(all, tables);
+        }
+    }
+}
+
+/**
+ * Invalidate the tables a prepared statement modifies, if it is a write.
+ *
+ * @param pPacket  A contiguous COM_STMT_EXECUTE packet.
+ */
+void CacheFilterSession::invalidate_prepared(GWBUF* pPacket)
+{
+    PreparedStmt* pStmt = get_prepared_stmt(pPacket);
+
+    if (pStmt)
+    {
+        if (pStmt->written_all || !pStmt->written_tables.empty())
+        {
+            invalidate(pStmt->written_all, pStmt->written_tables);
+        }
+    }
+    else if (m_unknown_all || !m_unknown_tables.empty())
+    {
+        // The statement may be any of the writes whose id was not seen.
+        invalidate(m_unknown_all, m_unknown_tables);
+    }
+}
+
+/**
+ * Remember the tables modified by the statement being prepared as those of
+ * a statement whose id is not known, as its response will not be inspected.
+ */
+void CacheFilterSession::add_unknown_writes()
+{
+    m_unknown_all = m_unknown_all || m_preparing_all;
+    m_unknown_tables.insert(m_unknown_tables.end(), m_preparing_tables.begin(), m_preparing_tables.end());
+
+    std::sort(m_unknown_tables.begin(), m_unknown_tables.end());
+    m_unknown_tables.erase(std::unique(m_unknown_tables.begin(), m_unknown_tables.end()),
+                           m_unknown_tables.end());
+
+    m_preparing_tables.clear();
+    m_preparing_all = false;
+}
+
+/**
+ * Invalidate the entries depending upon modified tables.
+ *
+ * @param all     Whether all entries should be invalidated.
+ * @param tables  The modified tables, if not all.
+ */
+void CacheFilterSession::invalidate(bool all, const Cache::Tables& tables)
+{
+    if (log_decisions())
+    {
+        MXS_NOTICE("Write, invalidating %s.", all ? "all entries" : "dependent entries");
+    }
+
+    m_pCache->invalidate(all ? Cache::Tables() : tables);
+
+    // An entry populated after this but before the write has become visible
+    // to other sessions would be stale, so the invalidation is repeated once
+    // the write has been committed.
+    m_written_all = m_written_all || all;
+    m_written_tables.insert(m_written_tables.end(), tables.begin(), tables.end());
+}
+
+/**
+ * Repeat the invalidation made when the write was sent, now that the write
+ * has become visible to other sessions.
+ */
+void CacheFilterSession::reinvalidate_tables()
+{
+    m_pCache->invalidate(m_written_all ? Cache::Tables() : m_written_tables);
+
+    m_written_tables.clear();
+    m_written_all = false;
+}
+
 /**
  * Whether the cache should be consulted.
  *
@@ -965,7 +1397,8 @@ CacheFilterSession::cache_action_t CacheFilterSession::get_cache_action(GWBUF* p
             int length;
             const int max_length = 40;
 
-            // At this point we know it's a COM_QUERY and that the buffer is contiguous
+            // At this point we know it's a COM_QUERY or a COM_STMT_PREPARE
+            // and that the buffer is contiguous.
             modutil_extract_SQL(pPacket, &pSql, &length);
 
             const char* zFormat;
@@ -1011,81 +1444,195 @@ CacheFilterSession::routing_action_t CacheFilterSession::route_COM_QUERY(GWBUF*
     MXB_AT_DEBUG(uint8_t * pData = static_cast<uint8_t*>(GWBUF_DATA(pPacket)));
     mxb_assert((int)MYSQL_GET_COMMAND(pData) == MXS_COM_QUERY);
 
-    routing_action_t routing_action = ROUTING_CONTINUE;
     cache_action_t cache_action = get_cache_action(pPacket);
 
-    if (cache_action != CACHE_IGNORE)
+    if (m_pCache->invalidates() && (cache_action == CACHE_IGNORE) && !is_select_statement(pPacket))
     {
-        const CacheRules* pRules = m_pCache->should_store(m_zDefaultDb, pPacket);
-
-        if (pRules)
-        {
-            cache_result_t result = m_pCache->get_key(m_zDefaultDb, pPacket, &m_key);
-
-            if (CACHE_RESULT_IS_OK(result))
-            {
-                routing_action = route_SELECT(cache_action, *pRules, pPacket);
-            }
-            else
-            {
-                MXS_ERROR("Could not create cache key.");
-                m_state = CACHE_IGNORING_RESPONSE;
-            }
-        }
-        else
-        {
-            m_state = CACHE_IGNORING_RESPONSE;
-        }
+        invalidate_tables(pPacket);
     }
 
-    return routing_action;
+    return route_statement(cache_action, pPacket, NULL, pPacket);
 }
 
-
 /**
- * Routes a SELECT packet.
+ * Routes a COM_STMT_EXECUTE packet.
  *
- * @param cache_action  The desired action.
- * @param rules         The current rules.
- * @param pPacket       A contiguous COM_QUERY packet containing a SELECT.
+ * @param pPacket  A contiguous COM_STMT_EXECUTE packet.
  *
  * @return ROUTING_ABORT if the processing of the packet should be aborted
  *         (as the data is obtained from the cache) or
  *         ROUTING_CONTINUE if the normal processing should continue.
  */
-CacheFilterSession::routing_action_t CacheFilterSession::route_SELECT(cache_action_t cache_action,
-                                                                      const CacheRules& rules,
-                                                                      GWBUF* pPacket)
+CacheFilterSession::routing_action_t CacheFilterSession::route_COM_STMT_EXECUTE(GWBUF* pPacket)
 {
+    MXB_AT_DEBUG(uint8_t * pData = static_cast<uint8_t*>(GWBUF_DATA(pPacket)));
+    mxb_assert((int)MYSQL_GET_COMMAND(pData) == MXS_COM_STMT_EXECUTE);
+
     routing_action_t routing_action = ROUTING_CONTINUE;
 
-    if (should_use(cache_action) && rules.should_use(m_pSession))
-    {
-        uint32_t flags = CACHE_FLAGS_INCLUDE_STALE;
-        GWBUF* pResponse;
-        cache_result_t result = m_pCache->get_value(m_key, flags, m_soft_ttl, m_hard_ttl, &pResponse);
+    PreparedStmt* pStmt = get_prepared_stmt(pPacket);
+    std::vector<uint8_t> params;
 
-        if (CACHE_RESULT_IS_OK(result))
+    if (!pStmt)
+    {
+        if (log_decisions())
         {
-            if (CACHE_RESULT_IS_STALE(result))
-            {
-                // The value was found, but it was stale. Now we need to
-                // figure out whether somebody else is already fetching it.
-
+            MXS_NOTICE("COM_STMT_EXECUTE of a statement whose preparation was not seen, ignoring.");
+        }
+    }
+    else if (!get_execute_params(pPacket, pStmt, &params))
+    {
+        if (log_decisions())
+        {
+            MXS_NOTICE("COM_STMT_EXECUTE using a cursor or parameters sent separately, ignoring.");
+        }
+    }
+    else
+    {
+        // The decision is made based upon the statement that was prepared.
+        cache_action_t cache_action = get_cache_action(pStmt->pPrepare);
+
+        routing_action = route_statement(cache_action, pStmt->pPrepare, &params, pPacket);
+    }
+
+    return routing_action;
+}
+
+/**
+ * Routes a statement that may be cacheable.
+ *
+ * @param cache_action  The desired action.
+ * @param pStmt         A contiguous COM_QUERY or COM_STMT_PREPARE packet.
+ * @param pParams       The parameters of a COM_STMT_EXECUTE, or NULL if @c pStmt
+ *                      is the COM_QUERY that is routed.
+ * @param pPacket       The COM_QUERY or COM_STMT_EXECUTE packet being routed.
+ *
+ * @return ROUTING_ABORT if the processing of the packet should be aborted
+ *         (as the data is obtained from the cache) or
+ *         ROUTING_CONTINUE if the normal processing should continue.
+ */
+CacheFilterSession::routing_action_t CacheFilterSession::route_statement(cache_action_t cache_action,
+                                                                         GWBUF* pStmt,
+                                                                         const std::vector<uint8_t>* pParams,
+                                                                         GWBUF* pPacket)
+{
+    routing_action_t routing_action = ROUTING_CONTINUE;
+
+    if (m_pCache->invalidates() && (cache_action != CACHE_IGNORE))
+    {
+        // The epoch must be obtained before the SELECT is sent, so that a write
+        // that is made while the SELECT is being executed invalidates the result.
+        m_epoch = m_pCache->epoch();
+        m_tables.clear();
+
+        if (!get_table_names(pStmt, m_zDefaultDb, &m_tables))
+        {
+            if (log_decisions())
+            {
+                MXS_NOTICE("Statement could not be parsed, the dependent tables are not known. "
+                           "Not using or populating the cache.");
+            }
+
+            cache_action = CACHE_IGNORE;
+        }
+    }
+
+    if (cache_action != CACHE_IGNORE)
+    {
+        const CacheRules* pRules = m_pCache->should_store(m_zDefaultDb, pStmt);
+
+        if (pRules)
+        {
+            cache_result_t result;
+
+            if (pParams)
+            {
+                result = m_pCache->get_key(m_zDefaultDb, pStmt, pParams->data(), pParams->size(), &m_key);
+            }
+            else
+            {
+                result = m_pCache->get_key(m_zDefaultDb, pStmt, &m_key);
+            }
+
+            if (CACHE_RESULT_IS_OK(result))
+            {
+                routing_action = route_SELECT(cache_action, *pRules, pPacket);
+            }
+            else
+            {
+                MXS_ERROR("Could not create cache key.");
+                m_state = CACHE_IGNORING_RESPONSE;
+            }
+        }
+        else
+        {
+            m_state = CACHE_IGNORING_RESPONSE;
+        }
+    }
+
+    return routing_action;
+}
+
+/**
+ * Routes a SELECT packet.
+ *
+ * @param cache_action  The desired action.
+ * @param rules         The current rules.
+ * @param pPacket       A contiguous COM_QUERY packet containing a SELECT, or
+ *                      a COM_STMT_EXECUTE of a prepared SELECT.
+ *
+ * @return ROUTING_ABORT if the processing of the packet should be aborted
+ *         (as the data is obtained from the cache) or
+ *         ROUTING_CONTINUE if the normal processing should continue.
+ */
+CacheFilterSession::routing_action_t CacheFilterSession::route_SELECT(cache_action_t cache_action,
+                                                                      const CacheRules& rules,
+                                                                      GWBUF* pPacket)
+{
+    routing_action_t routing_action = ROUTING_CONTINUE;
+
+    if (should_use(cache_action) && rules.should_use(m_pSession))
+    {
+        uint32_t flags = CACHE_FLAGS_INCLUDE_STALE;
+        GWBUF* pResponse;
+        cache_result_t result = get_cached_value(flags, &pResponse);
+
+        if (CACHE_RESULT_IS_OK(result))
+        {
+            if (CACHE_RESULT_IS_STALE(result))
+            {
+                // The value was found, but it was stale. Now we need to
+                // figure out whether somebody else is already fetching it.
+
                 if (m_pCache->must_refresh(m_key, this))
                 {
                     // We were the first ones who hit the stale item. It's
                     // our responsibility now to fetch it.
-                    if (log_decisions())
+                    if (refresh_in_background(pPacket))
                     {
-                        MXS_NOTICE("Cache data is stale, fetching fresh from server.");
+                        // The client gets the stale value, while the fresh
+                        // one is fetched using a separate connection.
+                        if (log_decisions())
+                        {
+                            MXS_NOTICE("Cache data is stale, returning it and fetching "
+                                       "fresh data in the background.");
+                        }
+
+                        routing_action = ROUTING_ABORT;
                     }
+                    else
+                    {
+                        if (log_decisions())
+                        {
+                            MXS_NOTICE("Cache data is stale, fetching fresh from server.");
+                        }
 
-                    // As we don't use the response it must be freed.
-                    gwbuf_free(pResponse);
+                        // As we don't use the response it must be freed.
+                        gwbuf_free(pResponse);
 
-                    m_refreshing = true;
-                    routing_action = ROUTING_CONTINUE;
+                        m_refreshing = true;
+                        routing_action = ROUTING_CONTINUE;
+                    }
                 }
                 else
                 {
@@ -1108,6 +1655,34 @@ CacheFilterSession::routing_action_t CacheFilterSession::route_SELECT(cache_acti
                 routing_action = ROUTING_ABORT;
             }
         }
+        else if (m_populate && (m_pCache->config().coalesce_timeout != 0))
+        {
+            if (m_pCache->must_refresh(m_key, this))
+            {
+                // Nobody else is fetching the data. Other sessions missing the same
+                // key will now wait for this session to fetch it.
+                if (log_decisions())
+                {
+                    MXS_NOTICE("Not found in cache, fetching data from server.");
+                }
+
+                m_refreshing = true;
+                routing_action = ROUTING_CONTINUE;
+            }
+            else if (start_waiting(pPacket))
+            {
+                if (log_decisions())
+                {
+                    MXS_NOTICE("Not found in cache, waiting for the data being fetched "
+                               "by another session.");
+                }
+                routing_action = ROUTING_WAIT;
+            }
+            else
+            {
+                routing_action = ROUTING_CONTINUE;
+            }
+        }
         else
         {
             if (log_decisions())
@@ -1137,7 +1712,7 @@ CacheFilterSession::routing_action_t CacheFilterSession::route_SELECT(cache_acti
                 m_state = CACHE_IGNORING_RESPONSE;
             }
         }
-        else
+        else if (routing_action == ROUTING_ABORT)
         {
             if (log_decisions())
             {
@@ -1175,6 +1750,688 @@ CacheFilterSession::routing_action_t CacheFilterSession::route_SELECT(cache_acti
     return routing_action;
 }
 
+/**
+ * Get the value of the current key from the cache.
+ *
+ * @param flags    Mask of cache_flags_t values.
+ * @param ppValue  On successful return, the value.
+ *
+ * @return The result of the lookup. A value that has been invalidated
+ *         is reported as if the hard TTL had passed.
+ */
+cache_result_t CacheFilterSession::get_cached_value(uint32_t flags, GWBUF** ppValue)
+{
+    cache_result_t result = m_pCache->get_value(m_key, flags, m_soft_ttl, m_hard_ttl, ppValue);
+
+    if (CACHE_RESULT_IS_OK(result) && m_pCache->invalidates() && !m_pCache->unwrap_value(ppValue))
+    {
+        // A table the value depends upon has been modified. It is treated as if
+        // the hard TTL had kicked in, so the entry will be updated.
+        if (log_decisions())
+        {
+            MXS_NOTICE("Cache data has been invalidated, fetching fresh from server.");
+        }
+
+        result = CACHE_RESULT_NOT_FOUND | CACHE_RESULT_DISCARDED;
+    }
+
+    return result;
+}
+
+/**
+ * Start waiting for the data of the current key to be fetched by another session.
+ *
+ * @param pPacket  The SELECT, which will be routed if the waiting times out.
+ *
+ * @return True, if the session is waiting.
+ */
+bool CacheFilterSession::start_waiting(GWBUF* pPacket)
+{
+    mxb_assert(!m_pWaiting);
+    mxb_assert(!m_wait_call_id);
+    mxb_assert(!m_sWaiter);
+
+    mxb::Worker* pWorker = mxb::Worker::get_current();
+    mxb_assert(pWorker);
+
+    CacheWaiter* pWaiter = new(std::nothrow) CacheWaiter;
+
+    if (pWaiter)
+    {
+        pWaiter->pSession = this;
+        pWaiter->pWorker = pWorker;
+        m_sWaiter.reset(pWaiter);
+
+        // If the fetch has already ended, the data is not waited for.
+        if (m_pCache->add_waiter(m_key, m_sWaiter))
+        {
+            m_wait_call_id = pWorker->delayed_call(m_pCache->config().coalesce_timeout,
+                                                   &CacheFilterSession::wait_timed_out,
+                                                   this);
+
+            if (m_wait_call_id)
+            {
+                m_pWaiting = pPacket;
+            }
+        }
+
+        if (!m_pWaiting)
+        {
+            end_waiting();
+        }
+    }
+
+    return m_pWaiting != NULL;
+}
+
+/**
+ * Stop waiting and route the waiting SELECT to the server.
+ */
+void CacheFilterSession::stop_waiting()
+{
+    end_waiting();
+    route_waiting();
+}
+
+/**
+ * Cancel the timeout and any pending notification of the fetch having ended.
+ */
+void CacheFilterSession::end_waiting()
+{
+    if (m_wait_call_id)
+    {
+        mxb::Worker::get_current()->cancel_delayed_call(m_wait_call_id);
+        m_wait_call_id = 0;
+    }
+
+    if (m_sWaiter)
+    {
+        // A notification may already have been posted to this worker.
+        m_sWaiter->pSession = NULL;
+        m_pCache->remove_waiter(m_key, m_sWaiter);
+        m_sWaiter.reset();
+    }
+}
+
+void CacheFilterSession::fetch_ended(const SCacheWaiter& sWaiter)
+{
+    if (sWaiter == m_sWaiter)
+    {
+        data_fetched();
+    }
+    else
+    {
+        refreshed_in_background(sWaiter);
+    }
+}
+
+/**
+ * Called when the data of the waiting SELECT has been stored or is no longer
+ * being fetched by another session.
+ */
+void CacheFilterSession::data_fetched()
+{
+    mxb_assert(m_pWaiting);
+    mxb_assert(m_sWaiter);
+
+    GWBUF* pResponse;
+    cache_result_t result = get_cached_value(CACHE_FLAGS_INCLUDE_STALE, &pResponse);
+
+    if (CACHE_RESULT_IS_OK(result))
+    {
+        if (log_decisions())
+        {
+            MXS_NOTICE("Data fetched by another session found in cache.");
+        }
+
+        end_waiting();
+        gwbuf_free(m_pWaiting);
+        m_pWaiting = NULL;
+
+        m_state = CACHE_EXPECTING_NOTHING;
+        m_up.clientReply(pResponse);
+    }
+    else if (m_pCache->must_refresh(m_key, this))
+    {
+        // The session that was fetching the data did not store it, so
+        // now it is our responsibility.
+        if (log_decisions())
+        {
+            MXS_NOTICE("Data was not fetched by another session, fetching data from server.");
+        }
+
+        end_waiting();
+        m_refreshing = true;
+        route_waiting();
+    }
+    else if (!m_pCache->add_waiter(m_key, m_sWaiter))
+    {
+        // Some other session started and ended fetching the data in the meantime,
+        // without storing it either.
+        end_waiting();
+        route_waiting();
+    }
+}
+
+/**
+ * Called when the session has waited for coalesce_timeout milliseconds
+ * for another session to fetch the data.
+ *
+ * @param action  Whether the call should be executed or cancelled.
+ *
+ * @return False, the function is not called again.
+ */
+bool CacheFilterSession::wait_timed_out(mxb::Worker::Call::action_t action)
+{
+    if (action == mxb::Worker::Call::EXECUTE)
+    {
+        mxb_assert(m_pWaiting);
+
+        if (log_decisions())
+        {
+            MXS_NOTICE("Timed out waiting for data being fetched by another session, "
+                       "fetching data from server.");
+        }
+
+        m_wait_call_id = 0;
+        end_waiting();
+        route_waiting();
+    }
+
+    return false;
+}
+
+/**
+ * Route the waiting SELECT to the server.
+ */
+void CacheFilterSession::route_waiting()
+{
+    mxb_assert(m_pWaiting);
+
+    GWBUF* pPacket = m_pWaiting;
+    m_pWaiting = NULL;
+
+    m_state = (m_populate || m_refreshing) ? CACHE_EXPECTING_RESPONSE : CACHE_IGNORING_RESPONSE;
+
+    if (m_down.routeQuery(pPacket) == 0)
+    {
+        poll_fake_hangup_event(m_pSession->client_dcb);
+    }
+}
+
+/**
+ * Route a packet the client sent while the response to a SELECT, which was
+ * waiting for data fetched by another session, is still expected. The state
+ * of the SELECT is retained, so the packet is not cached and its response is
+ * ignored, but a write still invalidates the entries it affects.
+ *
+ * @param pPacket  The packet to route.
+ *
+ * @return The result of routing the packet.
+ */
+int CacheFilterSession::route_pipelined(GWBUF* pPacket)
+{
+    switch ((int)MYSQL_GET_COMMAND(GWBUF_DATA(pPacket)))
+    {
+    case MXS_COM_INIT_DB:
+        // As the response is not inspected, it is not known whether the default
+        // database changes, so it must be removed to prevent incorrect entries.
+        MXS_FREE(m_zDefaultDb);
+        m_zDefaultDb = NULL;
+        break;
+
+    case MXS_COM_QUERY:
+        if (m_pCache->invalidates())
+        {
+            invalidate_tables(pPacket);
+        }
+        break;
+
+    case MXS_COM_STMT_PREPARE:
+        if (m_pCache->invalidates())
+        {
+            // The id of the statement is in the response, which is not inspected.
+            invalidate_tables(pPacket);
+            add_unknown_writes();
+        }
+        break;
+
+    case MXS_COM_STMT_EXECUTE:
+        if (m_pCache->invalidates())
+        {
+            invalidate_prepared(pPacket);
+        }
+        break;
+
+    case MXS_COM_STMT_CLOSE:
+        close_prepared_stmt(mxs_mysql_extract_ps_id(pPacket));
+        break;
+
+    default:
+        break;
+    }
+
+    m_pipelined = true;
+
+    return m_down.routeQuery(pPacket);
+}
+
+/**
+ * Start refreshing the stale entry of the current key in the background. The
+ * SELECT is sent to the service of the session using a separate connection,
+ * whose cache filter session will store the fresh value.
+ *
+ * Only a shared cache can be refreshed in the background, as the separate
+ * connection may be handled by any routing worker.
+ *
+ * @param pPacket  The SELECT whose result is stale.
+ *
+ * @return True, if the refresh was started. If false is returned, the session
+ *         must refresh the entry itself.
+ */
+bool CacheFilterSession::refresh_in_background(GWBUF* pPacket)
+{
+    const CACHE_CONFIG& config = m_pCache->config();
+
+    bool started = false;
+
+    // A prepared statement cannot be executed using the background connection.
+    bool is_query = (MYSQL_GET_COMMAND(GWBUF_DATA(pPacket)) == MXS_COM_QUERY);
+
+    if (config.background_refresh
+        && (config.thread_model == CACHE_THREAD_MODEL_MT)
+        && is_query
+        && may_create_refresher())
+    {
+        const char* zDefaultDb = m_zDefaultDb ? m_zDefaultDb : "";
+
+        if (m_pRefresher && (m_refresher_db != zDefaultDb))
+        {
+            // The key depends upon the default database, so the connection
+            // must use the same one as this session.
+            m_pRefresher->self_destruct();
+            m_pRefresher = NULL;
+        }
+
+        if (!m_pRefresher)
+        {
+            m_pRefresher = create_refresher(zDefaultDb);
+        }
+
+        if (m_pRefresher && m_pRefresher->queue_query(pPacket))
+        {
+            m_refresher_backoff = 0;
+
+            try
+            {
+                SCacheWaiter sWaiter = std::make_shared<CacheWaiter>();
+                sWaiter->pSession = this;
+                sWaiter->pWorker = mxb::Worker::get_current();
+
+                m_refreshes.push_back(BackgroundRefresh {m_key, mxb::StopWatch(), sWaiter});
+
+                // The entry is pending on behalf of this session, so the session will be
+                // notified when the background connection stores the fresh value.
+                m_pCache->add_waiter(m_key, sWaiter);
+            }
+            catch (const std::exception&)
+            {
+                // The query has been sent, so the entry will be refreshed nonetheless.
+                MXS_OOM();
+                m_pCache->refreshed(m_key, this);
+            }
+
+            schedule_background_refresh_timeout();
+
+            started = true;
+        }
+        else
+        {
+            if (m_pRefresher)
+            {
+                // The connection has been broken, a new one is created the next time.
+                m_pRefresher->self_destruct();
+                m_pRefresher = NULL;
+            }
+
+            refresher_failed();
+        }
+    }
+
+    return started;
+}
+
+/**
+ * Create the connection used for refreshing stale entries in the background.
+ *
+ * @param zDefaultDb  The default database the connection should use.
+ *
+ * @return A new connection, or NULL if one could not be created.
+ */
+LocalClient* CacheFilterSession::create_refresher(const char* zDefaultDb)
+{
+    MYSQL_session client = *static_cast<MYSQL_session*>(m_pSession->client_dcb->data);
+    strncpy(client.db, zDefaultDb, sizeof(client.db) - 1);
+    client.db[sizeof(client.db) - 1] = 0;
+
+    LocalClient* pRefresher = LocalClient::create(&client,
+                                                  static_cast<MySQLProtocol*>(m_pSession->client_dcb->protocol),
+                                                  m_pSession->service);
+
+    GWBUF* pSetup = pRefresher ? modutil_create_query(BACKGROUND_REFRESH_SETUP) : NULL;
+
+    if (pSetup && pRefresher->queue_query(pSetup))
+    {
+        m_refresher_db = zDefaultDb;
+    }
+    else
+    {
+        MXS_WARNING("Could not create a connection to '%s' for refreshing stale cache "
+                    "entries in the background%s. Stale entries will be refreshed by the "
+                    "session hitting them until a connection can be created.",
+                    m_pSession->service->name,
+                    m_pSession->service->ports ? "" : ": Service has no network listeners");
+
+        if (pRefresher)
+        {
+            pRefresher->self_destruct();
+            pRefresher = NULL;
+        }
+    }
+
+    gwbuf_free(pSetup);
+
+    return pRefresher;
+}
+
+/**
+ * Whether an attempt to create the background connection may be made. After
+ * a failure, the session backs off before trying again.
+ *
+ * @return True, if no attempt has failed or the backoff has passed.
+ */
+bool CacheFilterSession::may_create_refresher() const
+{
+    return m_pRefresher
+           || (m_refresher_backoff == 0)
+           || (m_refresher_watch.split() >= std::chrono::seconds(m_refresher_backoff));
+}
+
+/**
+ * Called when the background connection could not be created or has been
+ * broken. Doubles the time to wait before the next attempt.
+ */
+void CacheFilterSession::refresher_failed()
+{
+    m_refresher_backoff = (m_refresher_backoff == 0) ? REFRESHER_BACKOFF_MIN :
+        std::min(2 * m_refresher_backoff, REFRESHER_BACKOFF_MAX);
+    m_refresher_watch.restart();
+}
+
+/**
+ * Ensure the oldest background refresh is timed out once it has been in
+ * progress for too long.
+ */
+void CacheFilterSession::schedule_background_refresh_timeout()
+{
+    if (!m_refreshes.empty() && !m_refresh_call_id)
+    {
+        auto timeout = std::chrono::seconds(BACKGROUND_REFRESH_TIMEOUT);
+        auto left = timeout - m_refreshes.front().watch.split();
+        int32_t delay = std::chrono::duration_cast<std::chrono::milliseconds>(left).count();
+
+        m_refresh_call_id = mxb::Worker::get_current()->delayed_call(std::max(delay, 1),
+                                                                     &CacheFilterSession::background_refresh_timed_out,
+                                                                     this);
+    }
+}
+
+/**
+ * Called when the oldest background refresh may have been in progress for too
+ * long. The entries that have not been refreshed in time may be refreshed by
+ * other sessions.
+ *
+ * @param action  Whether the call should be executed or cancelled.
+ *
+ * @return False, a new call is scheduled if refreshes remain.
+ */
+bool CacheFilterSession::background_refresh_timed_out(mxb::Worker::Call::action_t action)
+{
+    if (action == mxb::Worker::Call::EXECUTE)
+    {
+        m_refresh_call_id = 0;
+
+        auto timeout = std::chrono::seconds(BACKGROUND_REFRESH_TIMEOUT);
+
+        // The refreshes are in the order they were started.
+        while (!m_refreshes.empty() && (m_refreshes.front().watch.split() >= timeout))
+        {
+            if (log_decisions())
+            {
+                MXS_NOTICE("Cache data was not refreshed in the background within %d seconds, "
+                           "letting other sessions refresh it.",
+                           BACKGROUND_REFRESH_TIMEOUT);
+            }
+
+            end_background_refresh(m_refreshes.front());
+            m_refreshes.erase(m_refreshes.begin());
+        }
+
+        schedule_background_refresh_timeout();
+    }
+
+    return false;
+}
+
+/**
+ * Called when the value of an entry refreshed in the background has been stored.
+ *
+ * @param sWaiter  The waiter registered for the refresh.
+ */
+void CacheFilterSession::refreshed_in_background(const SCacheWaiter& sWaiter)
+{
+    auto i = std::find_if(m_refreshes.begin(), m_refreshes.end(),
+                          [&sWaiter](const BackgroundRefresh& refresh) {
+                              return refresh.sWaiter == sWaiter;
+                          });
+
+    if (i != m_refreshes.end())
+    {
+        if (log_decisions())
+        {
+            MXS_NOTICE("Cache data was refreshed in the background.");
+        }
+
+        end_background_refresh(*i);
+        m_refreshes.erase(i);
+
+        if (m_refreshes.empty() && m_refresh_call_id)
+        {
+            mxb::Worker::get_current()->cancel_delayed_call(m_refresh_call_id);
+            m_refresh_call_id = 0;
+        }
+    }
+}
+
+/**
+ * Stop waiting for an entry to be refreshed in the background and let other
+ * sessions refresh it.
+ *
+ * @param refresh  The refresh in progress.
+ */
+void CacheFilterSession::end_background_refresh(BackgroundRefresh& refresh)
+{
+    // A notification may already have been posted to this worker.
+    refresh.sWaiter->pSession = NULL;
+    m_pCache->remove_waiter(refresh.key, refresh.sWaiter);
+    m_pCache->refreshed(refresh.key, this);
+}
+
+/**
+ * Stop tracking the refreshes in progress and close the background connection.
+ * Queries already sent will still be completed.
+ */
+void CacheFilterSession::end_background_refreshes()
+{
+    if (m_refresh_call_id)
+    {
+        mxb::Worker::get_current()->cancel_delayed_call(m_refresh_call_id);
+        m_refresh_call_id = 0;
+    }
+
+    for (auto& refresh : m_refreshes)
+    {
+        end_background_refresh(refresh);
+    }
+
+    m_refreshes.clear();
+
+    if (m_pRefresher)
+    {
+        m_pRefresher->self_destruct();
+        m_pRefresher = NULL;
+    }
+}
+
+/**
+ * Get the prepared statement a COM_STMT_EXECUTE, COM_STMT_SEND_LONG_DATA or
+ * COM_STMT_RESET refers to.
+ *
+ * @param pPacket  A contiguous packet containing a statement id.
+ *
+ * @return The statement, or NULL if its preparation was not seen.
+ */
+CacheFilterSession::PreparedStmt* CacheFilterSession::get_prepared_stmt(GWBUF* pPacket)
+{
+    PreparedStmt* pStmt = NULL;
+
+    if (GWBUF_LENGTH(pPacket) >= MYSQL_PS_ID_OFFSET + MYSQL_PS_ID_SIZE)
+    {
+        uint32_t id = mxs_mysql_extract_ps_id(pPacket);
+
+        if (id == DIRECT_EXEC_STMT_ID)
+        {
+            id = m_last_stmt_id;
+        }
+
+        auto i = m_prepared_stmts.find(id);
+
+        if (i != m_prepared_stmts.end())
+        {
+            pStmt = &i->second;
+        }
+    }
+
+    return pStmt;
+}
+
+/**
+ * Get the parameters of a COM_STMT_EXECUTE in a form suitable for creating
+ * a key; the parameter types followed by the NULL bitmap and the values.
+ *
+ * @param pPacket  A contiguous COM_STMT_EXECUTE packet.
+ * @param pStmt    The statement being executed.
+ * @param pParams  On successful return, the parameters.
+ *
+ * @return True, if the result of the execution may be cached. False, if a
+ *         cursor is used, some parameters were sent separately or the packet
+ *         could not be parsed.
+ */
+bool CacheFilterSession::get_execute_params(GWBUF* pPacket,
+                                            PreparedStmt* pStmt,
+                                            std::vector<uint8_t>* pParams)
+{
+    // Command, statement id (4), flags (1), iteration count (4), and then if there
+    // are parameters, NULL bitmap, new-params-bound flag, types (if the flag is set)
+    // and values.
+    const uint8_t* pData = GWBUF_DATA(pPacket);
+    const uint8_t* pEnd = pData + GWBUF_LENGTH(pPacket);
+    const uint8_t* pFlags = pData + MYSQL_PS_ID_OFFSET + MYSQL_PS_ID_SIZE;
+    const uint8_t* p = pFlags + 1 + 4;
+
+    // Data sent with COM_STMT_SEND_LONG_DATA is used by the next execution only.
+    bool long_data = pStmt->long_data;
+    pStmt->long_data = false;
+
+    bool cacheable = false;
+
+    if (p > pEnd)
+    {
+        // Malformed, let the server complain.
+    }
+    else if (pStmt->nParams == 0)
+    {
+        pParams->clear();
+        cacheable = (*pFlags == 0);
+    }
+    else
+    {
+        size_t bitmap_len = (pStmt->nParams + 7) / 8;
+        size_t types_len = 2 * pStmt->nParams;
+
+        if (p + bitmap_len + 1 <= pEnd)
+        {
+            const uint8_t* pBitmap = p;
+            p += bitmap_len;
+
+            bool types_bound = (*p++ != 0);
+
+            if (types_bound && (p + types_len <= pEnd))
+            {
+                // The types are sent only when they change, so they must be remembered.
+                try
+                {
+                    pStmt->types.assign(p, p + types_len);
+                }
+                catch (const std::exception&)
+                {
+                    pStmt->types.clear();
+                    MXS_OOM();
+                }
+
+                p += types_len;
+            }
+            else if (types_bound)
+            {
+                p = pEnd + 1;   // Malformed.
+            }
+
+            if ((p <= pEnd) && (pStmt->types.size() == types_len) && (*pFlags == 0) && !long_data)
+            {
+                try
+                {
+                    pParams->assign(pStmt->types.begin(), pStmt->types.end());
+                    pParams->insert(pParams->end(), pBitmap, pBitmap + bitmap_len);
+                    pParams->insert(pParams->end(), p, pEnd);
+                    cacheable = true;
+                }
+                catch (const std::exception&)
+                {
+                    MXS_OOM();
+                }
+            }
+        }
+    }
+
+    return cacheable;
+}
+
+/**
+ * Forget a prepared statement.
+ *
+ * @param id  The id of the statement.
+ */
+void CacheFilterSession::close_prepared_stmt(uint32_t id)
+{
+    auto i = m_prepared_stmts.find(id);
+
+    if (i != m_prepared_stmts.end())
+    {
+        gwbuf_free(i->second.pPrepare);
+        m_prepared_stmts.erase(i);
+    }
+}
+
 namespace
 {
 
@@ -13,8 +13,14 @@
 #pragma once
 
 #include <maxscale/ccdefs.hh>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <maxbase/stopwatch.hh>
+#include <maxbase/worker.hh>
 #include <maxscale/buffer.h>
 #include <maxscale/filter.hh>
+#include <maxscale/protocol/mariadb_client.hh>
 #include "cache.hh"
 #include "cachefilter.h"
 #include "cache_storage_api.h"
@@ -33,6 +39,7 @@ public:
         CACHE_EXPECTING_NOTHING,        // We are not expecting anything from the server.
         CACHE_EXPECTING_USE_RESPONSE,   // A "USE DB" was issued.
         CACHE_IGNORING_RESPONSE,        // We are not interested in the data received from the server.
+        CACHE_EXPECTING_PREPARE_RESPONSE,// A COM_STMT_PREPARE was issued.
     };
 
     struct CACHE_RESPONSE_STATE
@@ -45,6 +52,7 @@ public:
         size_t nTotalFields;/**< The number of fields a resultset contains. */
         size_t nFields;     /**< How many fields we have received, <= n_totalfields. */
         size_t nRows;       /**< How many rows we have received. */
+        bool   sent;        /**< Whether pData has already been sent to the client. */
     };
 
     /**
@@ -95,15 +103,25 @@ public:
      */
     json_t* diagnostics_json() const;
 
+    /**
+     * The data the session is waiting for has been stored or its fetch has
+     * ended. Called on the worker of the session.
+     *
+     * @param sWaiter  The waiter the session registered.
+     */
+    void fetch_ended(const SCacheWaiter& sWaiter);
+
 private:
     int handle_expecting_fields();
     int handle_expecting_nothing();
     int handle_expecting_response();
     int handle_expecting_rows();
     int handle_expecting_use_response();
+    int handle_expecting_prepare_response();
     int handle_ignoring_response();
 
     int send_upstream();
+    bool is_collecting_response() const;
 
     void reset_response_state();
 
@@ -114,6 +132,16 @@ private:
 
     void store_result();
 
+    void invalidate_tables(GWBUF* pPacket);
+
+    void invalidate_prepared(GWBUF* pPacket);
+
+    void add_unknown_writes();
+
+    void invalidate(bool all, const Cache::Tables& tables);
+
+    void reinvalidate_tables();
+
     enum cache_action_t
     {
         CACHE_IGNORE           = 0,
@@ -138,11 +166,36 @@ private:
     {
         ROUTING_ABORT,      /**< Abort normal routing activity, data is coming from cache. */
         ROUTING_CONTINUE,   /**< Continue normal routing activity. */
+        ROUTING_WAIT,       /**< Suspend routing, data is being fetched by another session. */
     };
 
     routing_action_t route_COM_QUERY(GWBUF* pPacket);
+    routing_action_t route_COM_STMT_EXECUTE(GWBUF* pPacket);
+    routing_action_t route_statement(cache_action_t cache_action,
+                                     GWBUF* pStmt,
+                                     const std::vector<uint8_t>* pParams,
+                                     GWBUF* pPacket);
     routing_action_t route_SELECT(cache_action_t action, const CacheRules& rules, GWBUF* pPacket);
 
+    cache_result_t get_cached_value(uint32_t flags, GWBUF** ppValue);
+
+    bool start_waiting(GWBUF* pPacket);
+    void stop_waiting();
+    void end_waiting();
+    void data_fetched();
+    bool wait_timed_out(mxb::Worker::Call::action_t action);
+    void route_waiting();
+    int  route_pipelined(GWBUF* pPacket);
+
+    bool refresh_in_background(GWBUF* pPacket);
+    LocalClient* create_refresher(const char* zDefaultDb);
+    bool may_create_refresher() const;
+    void refresher_failed();
+    void schedule_background_refresh_timeout();
+    bool background_refresh_timed_out(mxb::Worker::Call::action_t action);
+    void refreshed_in_background(const SCacheWaiter& sWaiter);
+    void end_background_refreshes();
+
     char* set_cache_populate(const char* zName,
                              const char* pValue_begin,
                              const char* pValue_end);
@@ -180,6 +233,33 @@ private:
 private:
     CacheFilterSession(MXS_SESSION* pSession, Cache* pCache, char* zDefaultDb);
 
+    struct BackgroundRefresh
+    {
+        CACHE_KEY      key;     /**< The key of the stale entry being refreshed. */
+        mxb::StopWatch watch;   /**< For how long the refresh has been in progress. */
+        SCacheWaiter   sWaiter; /**< Notified when the fresh value has been stored. */
+    };
+
+    typedef std::vector<BackgroundRefresh> BackgroundRefreshes;
+
+    void end_background_refresh(BackgroundRefresh& refresh);
+
+    struct PreparedStmt
+    {
+        GWBUF*               pPrepare;  /**< The COM_STMT_PREPARE packet. */
+        uint16_t             nParams;   /**< The number of parameters. */
+        std::vector<uint8_t> types;     /**< The parameter types most recently sent. */
+        bool                 long_data; /**< Whether parameter data has been sent separately. */
+        Cache::Tables        written_tables;/**< The tables the statement modifies. */
+        bool                 written_all;   /**< Whether the statement may modify anything. */
+    };
+
+    typedef std::unordered_map<uint32_t, PreparedStmt> PreparedStmts;
+
+    PreparedStmt* get_prepared_stmt(GWBUF* pPacket);
+    bool          get_execute_params(GWBUF* pPacket, PreparedStmt* pStmt, std::vector<uint8_t>* pParams);
+    void          close_prepared_stmt(uint32_t id);
+
 private:
     cache_session_state_t m_state;          /**< What state is the session in, what data is expected. */
     Cache*                m_pCache;         /**< The cache instance the session is associated with. */
@@ -193,4 +273,25 @@ private:
     bool                  m_populate;       /**< Whether the cache should be populated in this session. */
     uint32_t              m_soft_ttl;       /**< The soft TTL used in the session. */
     uint32_t              m_hard_ttl;       /**< The hard TTL used in the session. */
+    Cache::Tables         m_tables;         /**< The tables the current SELECT depends upon. */
+    uint64_t              m_epoch;          /**< The invalidation epoch when the SELECT was sent. */
+    Cache::Tables         m_written_tables; /**< Tables to invalidate once the write is visible. */
+    bool                  m_written_all;    /**< Whether everything should be invalidated. */
+    Cache::Tables         m_preparing_tables;/**< Tables modified by the statement being prepared. */
+    bool                  m_preparing_all;  /**< Whether the statement being prepared may modify anything. */
+    Cache::Tables         m_unknown_tables; /**< Tables modified by statements whose id is not known. */
+    bool                  m_unknown_all;    /**< Whether such a statement may modify anything. */
+    GWBUF*                m_pWaiting;       /**< SELECT waiting for data fetched by another session. */
+    SCacheWaiter          m_sWaiter;        /**< Registered for being notified when the data is fetched. */
+    uint32_t              m_wait_call_id;   /**< The delayed call ending the waiting. */
+    bool                  m_pipelined;      /**< Whether responses to pipelined packets follow. */
+    LocalClient*          m_pRefresher;     /**< Connection used for refreshing in the background. */
+    std::string           m_refresher_db;   /**< The default database of m_pRefresher. */
+    int32_t               m_refresher_backoff;/**< Seconds to wait before recreating m_pRefresher. */
+    mxb::StopWatch        m_refresher_watch;/**< Since m_pRefresher could not be created. */
+    BackgroundRefreshes   m_refreshes;      /**< The refreshes in progress in the background. */
+    uint32_t              m_refresh_call_id;/**< The delayed call timing out the refreshes. */
+    PreparedStmts         m_prepared_stmts; /**< The prepared statements, by statement id. */
+    GWBUF*                m_pPreparing;     /**< The COM_STMT_PREPARE whose response is expected. */
+    uint32_t              m_last_stmt_id;   /**< The id of the most recently prepared statement. */
 };
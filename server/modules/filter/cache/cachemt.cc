@@ -13,11 +13,61 @@
 
 #define MXS_MODULE_NAME "cache"
 #include "cachemt.hh"
+#include <maxscale/config.h>
 #include "storage.hh"
 #include "storagefactory.hh"
 
 using std::shared_ptr;
 
+namespace
+{
+
+/**
+ * Returns the number of shards the storage should be split into. The limits
+ * are divided evenly between the shards, so the number is capped so that each
+ * shard can hold at least one item and the largest allowed resultset.
+ *
+ * @param config  The cache configuration.
+ *
+ * @return The number of shards.
+ */
+size_t shard_count(const CACHE_CONFIG& config)
+{
+    size_t n_shards = config.shards != 0 ? config.shards : config_threadcount();
+
+    if ((config.max_count != 0) && (config.max_count < n_shards))
+    {
+        n_shards = config.max_count;
+    }
+
+    if (config.max_size != 0)
+    {
+        uint64_t min_size = config.max_resultset_size != 0 ? config.max_resultset_size : 1;
+        uint64_t max_shards = config.max_size / min_size;
+
+        if (max_shards < n_shards)
+        {
+            n_shards = max_shards;
+        }
+    }
+
+    if (n_shards == 0)
+    {
+        n_shards = 1;
+    }
+
+    if ((config.shards != 0) && (n_shards != config.shards))
+    {
+        MXS_WARNING("The value of 'shards' is %u, but with the current values of 'max_count', "
+                    "'max_size' and 'max_resultset_size' at most %lu shards can be used.",
+                    config.shards,
+                    n_shards);
+    }
+
+    return n_shards;
+}
+}
+
 CacheMT::CacheMT(const std::string& name,
                  const CACHE_CONFIG* pConfig,
                  const std::vector<SCacheRules>& rules,
@@ -72,6 +122,27 @@ void CacheMT::refreshed(const CACHE_KEY& key, const CacheFilterSession* pSession
     do_refreshed(key, pSession);
 }
 
+bool CacheMT::add_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter)
+{
+    std::lock_guard<std::mutex> guard(m_lock_pending);
+
+    return do_add_waiter(key, sWaiter);
+}
+
+void CacheMT::remove_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter)
+{
+    std::lock_guard<std::mutex> guard(m_lock_pending);
+
+    do_remove_waiter(key, sWaiter);
+}
+
+void CacheMT::notify_waiters(const CACHE_KEY& key)
+{
+    std::lock_guard<std::mutex> guard(m_lock_pending);
+
+    do_notify_waiters(key);
+}
+
 // static
 CacheMT* CacheMT::Create(const std::string& name,
                          const CACHE_CONFIG* pConfig,
@@ -84,12 +155,15 @@ CacheMT* CacheMT::Create(const std::string& name,
                                       pConfig->hard_ttl,
                                       pConfig->soft_ttl,
                                       pConfig->max_count,
-                                      pConfig->max_size);
+                                      pConfig->max_size,
+                                      pConfig->admission);
 
     int argc = pConfig->storage_argc;
     char** argv = pConfig->storage_argv;
 
-    Storage* pStorage = sFactory->createStorage(name.c_str(), storage_config, argc, argv);
+    size_t n_shards = shard_count(*pConfig);
+
+    Storage* pStorage = sFactory->createShardedStorage(name.c_str(), storage_config, n_shards, argc, argv);
 
     if (pStorage)
     {
@@ -31,6 +31,13 @@ public:
 
     void refreshed(const CACHE_KEY& key, const CacheFilterSession* pSession);
 
+    bool add_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter);
+
+    void remove_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter);
+
+protected:
+    void notify_waiters(const CACHE_KEY& key);
+
 private:
     CacheMT(const std::string& name,
             const CACHE_CONFIG* pConfig,
@@ -14,6 +14,7 @@
 #define MXS_MODULE_NAME "cache"
 #include "cachept.hh"
 
+#include <unordered_set>
 #include <maxbase/atomic.h>
 #include <maxscale/config.h>
 
@@ -91,6 +92,16 @@ void CachePT::refreshed(const CACHE_KEY& key, const CacheFilterSession* pSession
     thread_cache().refreshed(key, pSession);
 }
 
+bool CachePT::add_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter)
+{
+    return thread_cache().add_waiter(key, sWaiter);
+}
+
+void CachePT::remove_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter)
+{
+    thread_cache().remove_waiter(key, sWaiter);
+}
+
 json_t* CachePT::get_info(uint32_t what) const
 {
     json_t* pInfo = Cache::do_get_info(what);
@@ -99,7 +110,9 @@ json_t* CachePT::get_info(uint32_t what) const
     {
         if (what & (INFO_PENDING | INFO_STORAGE))
         {
-            what &= ~INFO_RULES;    // The rules are the same, we don't want them duplicated.
+            // The rules are the same and the invalidation is handled by this
+            // instance, we don't want them duplicated.
+            what &= ~(INFO_RULES | INFO_INVALIDATION);
 
             for (size_t i = 0; i < m_caches.size(); ++i)
             {
@@ -127,6 +140,15 @@ cache_result_t CachePT::get_key(const char* zDefault_db, const GWBUF* pQuery, CA
     return thread_cache().get_key(zDefault_db, pQuery, pKey);
 }
 
+cache_result_t CachePT::get_key(const char* zDefault_db,
+                                const GWBUF* pStmt,
+                                const uint8_t* pParams,
+                                size_t nParams,
+                                CACHE_KEY* pKey) const
+{
+    return thread_cache().get_key(zDefault_db, pStmt, pParams, nParams, pKey);
+}
+
 cache_result_t CachePT::get_value(const CACHE_KEY& key,
                                   uint32_t flags,
                                   uint32_t soft_ttl,
@@ -146,6 +168,45 @@ cache_result_t CachePT::del_value(const CACHE_KEY& key)
     return thread_cache().del_value(key);
 }
 
+cache_result_t CachePT::visit_values(const Visitor& visitor) const
+{
+    cache_result_t result = CACHE_RESULT_OK;
+
+    // The same value is likely to be found in several thread caches, but it is
+    // visited only once.
+    std::unordered_set<CACHE_KEY> visited;
+    bool stopped = false;
+
+    auto visit_once = [&](const CACHE_KEY& key, const uint8_t* pData, size_t len, uint32_t time) {
+            if (visited.insert(key).second)
+            {
+                stopped = !visitor(key, pData, len, time);
+            }
+
+            return !stopped;
+        };
+
+    for (auto it = m_caches.begin(); (it != m_caches.end()) && CACHE_RESULT_IS_OK(result) && !stopped; ++it)
+    {
+        result = (*it)->visit_values(visit_once);
+    }
+
+    return result;
+}
+
+cache_result_t CachePT::restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time)
+{
+    cache_result_t result = CACHE_RESULT_OK;
+
+    // Every thread has a cache of its own, so the value is restored to each.
+    for (auto it = m_caches.begin(); (it != m_caches.end()) && CACHE_RESULT_IS_OK(result); ++it)
+    {
+        result = (*it)->restore_value(key, pValue, time);
+    }
+
+    return result;
+}
+
 // static
 CachePT* CachePT::Create(const std::string& name,
                          const CACHE_CONFIG* pConfig,
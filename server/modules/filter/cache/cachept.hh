@@ -28,9 +28,18 @@ public:
 
     void refreshed(const CACHE_KEY& key, const CacheFilterSession* pSession);
 
+    bool add_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter);
+
+    void remove_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter);
+
     json_t* get_info(uint32_t what) const;
 
     cache_result_t get_key(const char* zDefault_db, const GWBUF* pQuery, CACHE_KEY* pKey) const;
+    cache_result_t get_key(const char* zDefault_db,
+                           const GWBUF* pStmt,
+                           const uint8_t* pParams,
+                           size_t nParams,
+                           CACHE_KEY* pKey) const;
 
     cache_result_t get_value(const CACHE_KEY& key,
                              uint32_t flags,
@@ -42,6 +51,10 @@ public:
 
     cache_result_t del_value(const CACHE_KEY& key);
 
+    cache_result_t visit_values(const Visitor& visitor) const;
+
+    cache_result_t restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time);
+
 private:
     typedef std::shared_ptr<Cache> SCache;
     typedef std::vector<SCache>    Caches;
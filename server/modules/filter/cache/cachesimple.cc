@@ -13,9 +13,28 @@
 
 #define MXS_MODULE_NAME "cache"
 #include "cachesimple.hh"
+#include <algorithm>
+#include <zlib.h>
+#include "cachefiltersession.hh"
 #include "storage.hh"
 #include "storagefactory.hh"
 
+namespace
+{
+
+// When compression is enabled, each value is preceded by the codec. A
+// compressed value is in addition preceded by the length of the original value.
+enum codec_t
+{
+    CODEC_NONE = 0,
+    CODEC_ZLIB = 1
+};
+
+const size_t CODEC_LEN = 1;
+const size_t ZLIB_HEADER_LEN = CODEC_LEN + sizeof(uint32_t);
+
+}
+
 CacheSimple::CacheSimple(const std::string& name,
                          const CACHE_CONFIG* pConfig,
                          const std::vector<SCacheRules>& rules,
@@ -58,13 +77,50 @@ cache_result_t CacheSimple::get_value(const CACHE_KEY& key,
                                       uint32_t hard_ttl,
                                       GWBUF**  ppValue) const
 {
-    return m_pStorage->get_value(key, flags, soft_ttl, hard_ttl, ppValue);
+    cache_result_t result = m_pStorage->get_value(key, flags, soft_ttl, hard_ttl, ppValue);
+
+    if (CACHE_RESULT_IS_OK(result)
+        && (m_config.compression != CACHE_COMPRESSION_NONE)
+        && !decompress_value(ppValue))
+    {
+        result = CACHE_RESULT_NOT_FOUND | CACHE_RESULT_DISCARDED;
+    }
+
+    return result;
 }
 
 cache_result_t CacheSimple::put_value(const CACHE_KEY& key,
                                       const GWBUF* pValue)
 {
-    return m_pStorage->put_value(key, pValue);
+    cache_result_t result;
+
+    if (m_config.compression != CACHE_COMPRESSION_NONE)
+    {
+        GWBUF* pCompressed = compress_value(pValue);
+
+        if (pCompressed)
+        {
+            result = m_pStorage->put_value(key, pCompressed);
+            gwbuf_free(pCompressed);
+        }
+        else
+        {
+            result = CACHE_RESULT_OUT_OF_RESOURCES;
+        }
+    }
+    else
+    {
+        result = m_pStorage->put_value(key, pValue);
+    }
+
+    if (CACHE_RESULT_IS_OK(result))
+    {
+        // A session refreshing the value in the background, or waiting for
+        // it, need not wait until the fetching session has finished.
+        notify_waiters(key);
+    }
+
+    return result;
 }
 
 cache_result_t CacheSimple::del_value(const CACHE_KEY& key)
@@ -72,6 +128,32 @@ cache_result_t CacheSimple::del_value(const CACHE_KEY& key)
     return m_pStorage->del_value(key);
 }
 
+namespace
+{
+
+bool visit_storage_value(void* pContext,
+                         const CACHE_KEY* pKey,
+                         const uint8_t* pData,
+                         size_t len,
+                         uint32_t time)
+{
+    const Cache::Visitor& visitor = *static_cast<const Cache::Visitor*>(pContext);
+
+    return visitor(*pKey, pData, len, time);
+}
+}
+
+cache_result_t CacheSimple::visit_values(const Visitor& visitor) const
+{
+    return m_pStorage->visit_values(visit_storage_value, const_cast<Visitor*>(&visitor));
+}
+
+cache_result_t CacheSimple::restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time)
+{
+    // The value is restored as it was stored, so it is not compressed again.
+    return m_pStorage->restore_value(key, pValue, time);
+}
+
 // protected:
 json_t* CacheSimple::do_get_info(uint32_t what) const
 {
@@ -82,6 +164,23 @@ json_t* CacheSimple::do_get_info(uint32_t what) const
         // TODO: Include information about pending items.
     }
 
+    if ((what & INFO_COMPRESSION) && (m_config.compression != CACHE_COMPRESSION_NONE))
+    {
+        json_t* pCompression = json_object();
+
+        if (pCompression)
+        {
+            const CompressionStats& stats = m_compression_stats;
+
+            json_object_set_new(pCompression, "compressed", json_integer(stats.compressed));
+            json_object_set_new(pCompression, "uncompressed", json_integer(stats.uncompressed));
+            json_object_set_new(pCompression, "original_size", json_integer(stats.original_size));
+            json_object_set_new(pCompression, "compressed_size", json_integer(stats.compressed_size));
+
+            json_object_set_new(pInfo, "compression", pCompression);
+        }
+    }
+
     if (what & INFO_STORAGE)
     {
         json_t* pStorageInfo;
@@ -127,4 +226,205 @@ void CacheSimple::do_refreshed(const CACHE_KEY& key, const CacheFilterSession* p
     mxb_assert(i != m_pending.end());
     mxb_assert(i->second == pSession);
     m_pending.erase(i);
+
+    do_notify_waiters(key);
+}
+
+// protected
+bool CacheSimple::do_add_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter)
+{
+    bool rv = false;
+
+    if (m_pending.find(key) != m_pending.end())
+    {
+        try
+        {
+            m_waiters[key].push_back(sWaiter);
+            rv = true;
+        }
+        catch (const std::exception& x)
+        {
+            rv = false;
+        }
+    }
+
+    return rv;
+}
+
+// protected
+void CacheSimple::do_notify_waiters(const CACHE_KEY& key)
+{
+    Waiters::iterator i = m_waiters.find(key);
+
+    if (i != m_waiters.end())
+    {
+        for (const SCacheWaiter& sWaiter : i->second)
+        {
+            // Always queued, as the waiter may be handled by the current worker and it
+            // will call back into the cache.
+            sWaiter->pWorker->execute([sWaiter]() {
+                                          if (sWaiter->pSession)
+                                          {
+                                              sWaiter->pSession->fetch_ended(sWaiter);
+                                          }
+                                      }, mxb::Worker::EXECUTE_QUEUED);
+        }
+
+        m_waiters.erase(i);
+    }
+}
+
+// protected
+void CacheSimple::do_remove_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter)
+{
+    Waiters::iterator i = m_waiters.find(key);
+
+    if (i != m_waiters.end())
+    {
+        std::vector<SCacheWaiter>& waiters = i->second;
+        waiters.erase(std::remove(waiters.begin(), waiters.end(), sWaiter), waiters.end());
+
+        if (waiters.empty())
+        {
+            m_waiters.erase(i);
+        }
+    }
+}
+
+/**
+ * Creates the value to be stored. Values at least as large as the configured
+ * threshold are compressed, unless compression does not make them smaller.
+ * Other values are stored as such, preceded only by the codec.
+ *
+ * @param pValue  A contiguous value.
+ *
+ * @return A new buffer, or NULL if memory allocation fails. An uncompressed
+ *         value is returned as a chain that shares the data of @c pValue.
+ */
+GWBUF* CacheSimple::compress_value(const GWBUF* pValue)
+{
+    mxb_assert(GWBUF_IS_CONTIGUOUS(pValue));
+    mxb_assert(m_config.compression == CACHE_COMPRESSION_ZLIB);
+
+    const uint8_t* pData = GWBUF_DATA(pValue);
+    uint32_t len = GWBUF_LENGTH(pValue);
+
+    if (len >= m_config.compression_threshold)
+    {
+        uLongf bound = compressBound(len);
+        GWBUF* pStored = gwbuf_alloc(ZLIB_HEADER_LEN + bound);
+
+        if (!pStored)
+        {
+            return NULL;
+        }
+
+        uint8_t* pHeader = GWBUF_DATA(pStored);
+        uint8_t* pCompressed = pHeader + ZLIB_HEADER_LEN;
+        uLongf compressed_len = bound;
+
+        // Speed matters more than the last few percent of compression.
+        if ((compress2(pCompressed, &compressed_len, pData, len, Z_BEST_SPEED) == Z_OK)
+            && (compressed_len < len))
+        {
+            pHeader[0] = CODEC_ZLIB;
+            memcpy(pHeader + 1, &len, sizeof(len));
+            pStored = gwbuf_rtrim(pStored, bound - compressed_len);
+
+            m_compression_stats.compressed.fetch_add(1, std::memory_order_relaxed);
+            m_compression_stats.original_size.fetch_add(len, std::memory_order_relaxed);
+            m_compression_stats.compressed_size.fetch_add(compressed_len, std::memory_order_relaxed);
+
+            return pStored;
+        }
+
+        gwbuf_free(pStored);
+    }
+
+    GWBUF* pStored = gwbuf_alloc(CODEC_LEN);
+
+    if (pStored)
+    {
+        GWBUF_DATA(pStored)[0] = CODEC_NONE;
+
+        GWBUF* pClone = gwbuf_clone(const_cast<GWBUF*>(pValue));
+
+        if (pClone)
+        {
+            pStored = gwbuf_append(pStored, pClone);
+
+            m_compression_stats.uncompressed.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            gwbuf_free(pStored);
+            pStored = NULL;
+        }
+    }
+
+    return pStored;
+}
+
+/**
+ * Restores a value created with @c compress_value.
+ *
+ * @param ppValue  Pointer to a value obtained from the storage. On return
+ *                 the original value, or NULL if the value is broken.
+ *
+ * @return True, if the value could be restored.
+ */
+bool CacheSimple::decompress_value(GWBUF** ppValue) const
+{
+    GWBUF* pStored = *ppValue;
+    mxb_assert(GWBUF_IS_CONTIGUOUS(pStored));
+
+    const uint8_t* pHeader = GWBUF_DATA(pStored);
+    size_t stored_len = GWBUF_LENGTH(pStored);
+
+    GWBUF* pValue = NULL;
+
+    if (stored_len > CODEC_LEN)
+    {
+        switch (pHeader[0])
+        {
+        case CODEC_NONE:
+            pValue = gwbuf_consume(pStored, CODEC_LEN);
+            pStored = NULL;
+            break;
+
+        case CODEC_ZLIB:
+            if (stored_len > ZLIB_HEADER_LEN)
+            {
+                uint32_t len;
+                memcpy(&len, pHeader + 1, sizeof(len));
+
+                pValue = gwbuf_alloc(len);
+
+                if (pValue)
+                {
+                    const uint8_t* pCompressed = pHeader + ZLIB_HEADER_LEN;
+                    uLongf compressed_len = stored_len - ZLIB_HEADER_LEN;
+                    uLongf value_len = len;
+
+                    if ((uncompress(GWBUF_DATA(pValue), &value_len, pCompressed, compressed_len) != Z_OK)
+                        || (value_len != len))
+                    {
+                        gwbuf_free(pValue);
+                        pValue = NULL;
+                    }
+                }
+            }
+            break;
+        }
+    }
+
+    if (!pValue)
+    {
+        MXS_ERROR("Could not restore a cached value of %lu bytes, ignoring it.", stored_len);
+    }
+
+    gwbuf_free(pStored);
+    *ppValue = pValue;
+
+    return pValue != NULL;
 }
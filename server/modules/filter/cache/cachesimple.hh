@@ -13,6 +13,7 @@
 #pragma once
 
 #include <maxscale/ccdefs.hh>
+#include <atomic>
 #include <unordered_map>
 #include "cache.hh"
 #include "cache_storage_api.hh"
@@ -34,6 +35,10 @@ public:
 
     cache_result_t del_value(const CACHE_KEY& key);
 
+    cache_result_t visit_values(const Visitor& visitor) const;
+
+    cache_result_t restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time);
+
 protected:
     CacheSimple(const std::string& name,
                 const CACHE_CONFIG* pConfig,
@@ -52,13 +57,51 @@ protected:
 
     void do_refreshed(const CACHE_KEY& key, const CacheFilterSession* pSession);
 
+    bool do_add_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter);
+
+    void do_remove_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter);
+
+    void do_notify_waiters(const CACHE_KEY& key);
+
+    /**
+     * Notify the sessions waiting for the data of a key, as the data has been
+     * stored or is no longer being fetched.
+     *
+     * @param key  The hashed key for a query.
+     */
+    virtual void notify_waiters(const CACHE_KEY& key) = 0;
+
 private:
     CacheSimple(const Cache&);
     CacheSimple& operator=(const CacheSimple&);
 
+    GWBUF* compress_value(const GWBUF* pValue);
+    bool   decompress_value(GWBUF** ppValue) const;
+
 protected:
     typedef std::unordered_map<CACHE_KEY, const CacheFilterSession*> Pending;
+    typedef std::unordered_map<CACHE_KEY, std::vector<SCacheWaiter>> Waiters;
 
     Pending  m_pending; // Pending items; being fetched from the backend.
+    Waiters  m_waiters; // Sessions waiting for pending items.
     Storage* m_pStorage;// The storage instance to use.
+
+private:
+    struct CompressionStats
+    {
+        CompressionStats()
+            : compressed(0)
+            , uncompressed(0)
+            , original_size(0)
+            , compressed_size(0)
+        {
+        }
+
+        std::atomic<uint64_t> compressed;       // The number of values stored compressed.
+        std::atomic<uint64_t> uncompressed;     // The number of values stored as such.
+        std::atomic<uint64_t> original_size;    // The size of the compressed values before compression.
+        std::atomic<uint64_t> compressed_size;  // The size of the compressed values after compression.
+    };
+
+    CompressionStats m_compression_stats;
 };
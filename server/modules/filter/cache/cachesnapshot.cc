@@ -0,0 +1,271 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#define MXS_MODULE_NAME "cache"
+#include "cachesnapshot.hh"
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+
+const char     SNAPSHOT_MAGIC[8] = {'M', 'X', 'S', 'C', 'A', 'C', 'H', 'E'};
+const uint32_t SNAPSHOT_VERSION = 3;
+
+/**
+ * The snapshot file begins with a header, which is followed by the values,
+ * each preceded by a record header.
+ */
+struct SnapshotHeader
+{
+    char     magic[8];      /*< SNAPSHOT_MAGIC */
+    uint32_t version;       /*< SNAPSHOT_VERSION */
+    uint8_t  compression;   /*< The cache_compression_t of the values. */
+    uint8_t  wrapped;       /*< Whether the values contain invalidation information. */
+    uint16_t reserved;
+    uint64_t epoch;         /*< The epoch of the cache when the snapshot was created. */
+};
+
+struct RecordHeader
+{
+    uint64_t key;           /*< CACHE_KEY::data */
+    uint32_t time;          /*< When the value was stored, in seconds since the Epoch. */
+    uint32_t length;        /*< The length of the value that follows. */
+};
+
+static_assert(sizeof(SnapshotHeader) == 24, "SnapshotHeader must not contain padding.");
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader must not contain padding.");
+
+void init_header(const Cache& cache, SnapshotHeader* pHeader)
+{
+    memset(pHeader, 0, sizeof(*pHeader));
+    memcpy(pHeader->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    pHeader->version = SNAPSHOT_VERSION;
+    pHeader->compression = cache.config().compression;
+    pHeader->wrapped = cache.invalidates();
+    pHeader->epoch = cache.epoch();
+}
+}
+
+CacheSnapshot::CacheSnapshot(Cache& cache, const std::string& path, FILE* pFile)
+    : m_cache(cache)
+    , m_path(path)
+    , m_pFile(pFile)
+{
+}
+
+CacheSnapshot::~CacheSnapshot()
+{
+    fclose(m_pFile);
+}
+
+// static
+bool CacheSnapshot::save(const Cache& cache, const std::string& path)
+{
+    bool saved = false;
+
+    std::string tmp_path = path + ".tmp";
+    FILE* pFile = fopen(tmp_path.c_str(), "w");
+
+    if (pFile)
+    {
+        SnapshotHeader header;
+        init_header(cache, &header);
+
+        bool ok = (fwrite(&header, sizeof(header), 1, pFile) == 1);
+        uint64_t n_values = 0;
+
+        auto write_value = [&](const CACHE_KEY& key, const uint8_t* pData, size_t len, uint32_t time) {
+                RecordHeader record = {key.data, time, static_cast<uint32_t>(len)};
+
+                ok = (len <= UINT32_MAX)
+                    && (fwrite(&record, sizeof(record), 1, pFile) == 1)
+                    && (fwrite(pData, 1, len, pFile) == len);
+
+                if (ok)
+                {
+                    ++n_values;
+                }
+
+                return ok;
+            };
+
+        if (ok && !CACHE_RESULT_IS_OK(cache.visit_values(write_value)))
+        {
+            ok = false;
+        }
+
+        int err = errno;
+
+        if (fclose(pFile) != 0)
+        {
+            err = errno;
+            ok = false;
+        }
+
+        if (ok && (rename(tmp_path.c_str(), path.c_str()) != 0))
+        {
+            err = errno;
+            ok = false;
+        }
+
+        if (ok)
+        {
+            MXS_NOTICE("Saved %lu cached values to the snapshot '%s'.", n_values, path.c_str());
+            saved = true;
+        }
+        else
+        {
+            MXS_ERROR("Could not save the cache snapshot '%s': %d, %s",
+                      path.c_str(),
+                      err,
+                      mxs_strerror(err));
+            unlink(tmp_path.c_str());
+        }
+    }
+    else
+    {
+        MXS_ERROR("Could not open '%s' for writing the cache snapshot: %d, %s",
+                  tmp_path.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+    }
+
+    return saved;
+}
+
+// static
+std::unique_ptr<CacheSnapshot> CacheSnapshot::open(Cache& cache, const std::string& path)
+{
+    std::unique_ptr<CacheSnapshot> sSnapshot;
+
+    FILE* pFile = fopen(path.c_str(), "r");
+
+    if (pFile)
+    {
+        SnapshotHeader expected;
+        init_header(cache, &expected);
+
+        SnapshotHeader header;
+
+        if ((fread(&header, sizeof(header), 1, pFile) != 1)
+            || (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+            || (header.version != SNAPSHOT_VERSION))
+        {
+            MXS_ERROR("'%s' is not a cache snapshot, ignoring it.", path.c_str());
+            fclose(pFile);
+        }
+        else if ((header.compression != expected.compression) || (header.wrapped != expected.wrapped))
+        {
+            // The values are restored as such, so they must be stored the same way.
+            MXS_WARNING("The cache snapshot '%s' was created with a different value for 'compression' "
+                        "or 'invalidate', ignoring it.",
+                        path.c_str());
+            fclose(pFile);
+        }
+        else
+        {
+            // The epochs of the values are those of the instance that created the
+            // snapshot. Unless the current epoch is at least as large, a table could
+            // be invalidated without that affecting the restored values.
+            cache.raise_epoch(header.epoch);
+
+            sSnapshot.reset(new CacheSnapshot(cache, path, pFile));
+        }
+    }
+    else if (errno != ENOENT)
+    {
+        MXS_ERROR("Could not open the cache snapshot '%s': %d, %s",
+                  path.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+    }
+
+    return sSnapshot;
+}
+
+bool CacheSnapshot::restore(const std::atomic<bool>& stop)
+{
+    uint32_t hard_ttl = m_cache.config().hard_ttl;
+    uint32_t now = time(NULL);
+
+    uint64_t n_restored = 0;
+    uint64_t n_expired = 0;
+    bool ok = true;
+    bool eof = false;
+
+    while (ok && !eof && !stop.load(std::memory_order_relaxed))
+    {
+        RecordHeader record;
+
+        if (fread(&record, sizeof(record), 1, m_pFile) != 1)
+        {
+            eof = feof(m_pFile);
+            ok = eof;
+        }
+        else if ((hard_ttl != 0) && (record.time < now) && (now - record.time > hard_ttl))
+        {
+            ++n_expired;
+            ok = (fseek(m_pFile, record.length, SEEK_CUR) == 0);
+        }
+        else
+        {
+            GWBUF* pValue = gwbuf_alloc(record.length);
+
+            if (pValue && (fread(GWBUF_DATA(pValue), 1, record.length, m_pFile) == record.length))
+            {
+                CACHE_KEY key = {record.key};
+                // A value cannot have been stored in the future.
+                uint32_t time = (record.time < now) ? record.time : now;
+
+                cache_result_t result = m_cache.restore_value(key, pValue, time);
+
+                if (CACHE_RESULT_IS_OK(result) && !CACHE_RESULT_IS_DISCARDED(result))
+                {
+                    ++n_restored;
+                }
+            }
+            else
+            {
+                ok = false;
+            }
+
+            gwbuf_free(pValue);
+        }
+    }
+
+    if (ok && eof)
+    {
+        MXS_NOTICE("Restored %lu values from the cache snapshot '%s', %lu had expired.",
+                   n_restored,
+                   m_path.c_str(),
+                   n_expired);
+    }
+    else if (ok)
+    {
+        MXS_NOTICE("Restoring of the cache snapshot '%s' was stopped after %lu values.",
+                   m_path.c_str(),
+                   n_restored);
+    }
+    else
+    {
+        MXS_ERROR("The cache snapshot '%s' is truncated or could not be read, "
+                  "restored %lu values.",
+                  m_path.c_str(),
+                  n_restored);
+    }
+
+    return ok && eof;
+}
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+#pragma once
+
+#include <maxscale/ccdefs.hh>
+#include <atomic>
+#include <memory>
+#include <string>
+#include "cache.hh"
+
+/**
+ * CacheSnapshot saves the values of a cache to a file and restores them, so
+ * that the cache need not be populated from scratch after a restart.
+ *
+ * The values are saved as they are stored, that is, including the tables
+ * they depend upon and possibly compressed, together with the time when they
+ * were stored, so that the TTLs continue to apply after they have been
+ * restored. The file is in native byte order and only intended to be read
+ * on the host where it was created.
+ */
+class CacheSnapshot
+{
+public:
+    ~CacheSnapshot();
+
+    /**
+     * Saves the values of a cache to a file. The values are first written to
+     * a temporary file that then is renamed, so an existing snapshot is
+     * replaced only if the saving succeeds.
+     *
+     * @param cache  The cache whose values should be saved.
+     * @param path   The path of the snapshot file.
+     *
+     * @return True, if the snapshot could be saved.
+     */
+    static bool save(const Cache& cache, const std::string& path);
+
+    /**
+     * Opens a snapshot for restoring it to a cache. If the snapshot can be
+     * used, the epoch of the cache is raised so that invalidations made after
+     * this call also affect the values that are restored.
+     *
+     * @param cache  The cache the snapshot will be restored to.
+     * @param path   The path of the snapshot file.
+     *
+     * @return A snapshot, or NULL if the file does not exist or is not a
+     *         snapshot compatible with the configuration of the cache.
+     */
+    static std::unique_ptr<CacheSnapshot> open(Cache& cache, const std::string& path);
+
+    /**
+     * Restores the values of the snapshot to the cache. Values whose hard TTL
+     * has passed are skipped and values already in the cache are not replaced.
+     *
+     * @param stop  Checked between values; if it becomes true, the restoring
+     *              is stopped.
+     *
+     * @return True, if the snapshot was restored in its entirety.
+     */
+    bool restore(const std::atomic<bool>& stop);
+
+private:
+    CacheSnapshot(Cache& cache, const std::string& path, FILE* pFile);
+
+    CacheSnapshot(const CacheSnapshot&);
+    CacheSnapshot& operator=(const CacheSnapshot&);
+
+    Cache&      m_cache;
+    std::string m_path;
+    FILE*       m_pFile;
+};
@@ -78,6 +78,21 @@ void CacheST::refreshed(const CACHE_KEY& key, const CacheFilterSession* pSession
     CacheSimple::do_refreshed(key, pSession);
 }
 
+bool CacheST::add_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter)
+{
+    return CacheSimple::do_add_waiter(key, sWaiter);
+}
+
+void CacheST::remove_waiter(const CACHE_KEY& key, const SCacheWaiter& sWaiter)
+{
+    CacheSimple::do_remove_waiter(key, sWaiter);
+}
+
+void CacheST::notify_waiters(const CACHE_KEY& key)
+{
+    CacheSimple::do_notify_waiters(key);
+}
+
 // static
 CacheST* CacheST::Create(const std::string& name,
                          const CACHE_CONFIG* pConfig,
@@ -90,7 +105,8 @@ CacheST* CacheST::Create(const std::string& name,
                                       pConfig->hard_ttl,
                                       pConfig->soft_ttl,
                                       pConfig->max_count,
-                                      pConfig->max_size);
+                                      pConfig->max_size,
+                                      pConfig->admission);
 
     int argc = pConfig->storage_argc;
     char** argv = pConfig->storage_argv;
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#define MXS_MODULE_NAME "cache"
+#include "frequencysketch.hh"
+#include <algorithm>
+
+namespace
+{
+
+// Per row seeds, so that each row behaves as an independent hash function.
+const uint64_t SEEDS[FrequencySketch::DEPTH] =
+{
+    0xc3a5c85c97cb3127ULL,
+    0xb492b66fbe98f273ULL,
+    0x9ae16a3b2f90404fULL,
+    0xcbf29ce484222325ULL
+};
+
+inline uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+
+    return x;
+}
+}
+
+FrequencySketch::FrequencySketch(size_t capacity)
+    : m_width(MIN_WIDTH)
+    , m_additions(0)
+    , m_resets(0)
+{
+    while ((m_width < capacity) && (m_width < MAX_WIDTH))
+    {
+        m_width <<= 1;
+    }
+
+    m_counters.resize(DEPTH * m_width);
+    m_sample_size = SAMPLE_RATE * m_width;
+}
+
+void FrequencySketch::increment(const CACHE_KEY& key)
+{
+    size_t indexes[DEPTH];
+    uint8_t min = MAX_COUNT;
+
+    for (size_t row = 0; row < DEPTH; ++row)
+    {
+        indexes[row] = index_of(key, row);
+        min = std::min(min, m_counters[indexes[row]]);
+    }
+
+    if (min < MAX_COUNT)
+    {
+        // Conservative update; only the smallest counters are incremented,
+        // which reduces the overestimation caused by collisions.
+        for (size_t row = 0; row < DEPTH; ++row)
+        {
+            uint8_t& counter = m_counters[indexes[row]];
+
+            if (counter == min)
+            {
+                ++counter;
+            }
+        }
+    }
+
+    if (++m_additions >= m_sample_size)
+    {
+        reset();
+    }
+}
+
+uint32_t FrequencySketch::frequency(const CACHE_KEY& key) const
+{
+    uint8_t min = MAX_COUNT;
+
+    for (size_t row = 0; row < DEPTH; ++row)
+    {
+        min = std::min(min, m_counters[index_of(key, row)]);
+    }
+
+    return min;
+}
+
+size_t FrequencySketch::index_of(const CACHE_KEY& key, size_t row) const
+{
+    return row * m_width + (mix(key.data + SEEDS[row]) & (m_width - 1));
+}
+
+void FrequencySketch::reset()
+{
+    for (auto& counter : m_counters)
+    {
+        counter >>= 1;
+    }
+
+    m_additions /= 2;
+    ++m_resets;
+}
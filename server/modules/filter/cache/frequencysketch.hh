@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+#pragma once
+
+#include <maxscale/ccdefs.hh>
+#include <vector>
+#include "cache_storage_api.h"
+
+/**
+ * FrequencySketch is a count-min sketch that estimates how many times a key
+ * has recently been accessed. The counters are small and saturate, and once
+ * a number of increments proportional to the width of the sketch has been
+ * made, all counters are halved so that old popularity fades away.
+ *
+ * The sketch is not thread safe, the owner must provide the locking.
+ */
+class FrequencySketch
+{
+public:
+    enum
+    {
+        DEPTH       = 4,    /*< The number of rows, i.e. hash functions. */
+        MAX_COUNT   = 15,   /*< The value at which a counter saturates. */
+        MIN_WIDTH   = 1024,
+        MAX_WIDTH   = 1 << 20,
+        SAMPLE_RATE = 10,   /*< Counters are halved after width * SAMPLE_RATE increments. */
+    };
+
+    /**
+     * Constructor
+     *
+     * @param capacity  The number of items expected to be tracked. The width
+     *                  of the sketch will be the next power of 2, clamped to
+     *                  [MIN_WIDTH, MAX_WIDTH].
+     */
+    FrequencySketch(size_t capacity);
+
+    /**
+     * Record an access of a key.
+     *
+     * @param key  The key that was accessed.
+     */
+    void increment(const CACHE_KEY& key);
+
+    /**
+     * Estimate how many times a key has recently been accessed.
+     *
+     * @param key  The key.
+     *
+     * @return The estimated frequency, at most MAX_COUNT.
+     */
+    uint32_t frequency(const CACHE_KEY& key) const;
+
+    /**
+     * @return How many times the counters have been halved.
+     */
+    uint64_t resets() const
+    {
+        return m_resets;
+    }
+
+private:
+    FrequencySketch(const FrequencySketch&);
+    FrequencySketch& operator=(const FrequencySketch&);
+
+    size_t index_of(const CACHE_KEY& key, size_t row) const;
+    void   reset();
+
+    size_t               m_width;       /*< The number of counters in a row; a power of 2. */
+    std::vector<uint8_t> m_counters;    /*< DEPTH rows of m_width counters. */
+    uint64_t             m_additions;   /*< Increments since the last reset. */
+    uint64_t             m_sample_size; /*< When m_additions reaches this, the counters are halved. */
+    uint64_t             m_resets;      /*< How many times the counters have been halved. */
+};
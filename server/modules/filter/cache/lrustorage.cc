@@ -14,6 +14,30 @@
 #define MXS_MODULE_NAME "cache"
 #include "lrustorage.hh"
 
+namespace
+{
+
+// If only the size of the cache is limited, the number of items, and thus the
+// width of the frequency sketch, is estimated assuming values of this size.
+const size_t SKETCH_ESTIMATED_VALUE_SIZE = 1024;
+
+size_t sketch_capacity(const CACHE_STORAGE_CONFIG& config)
+{
+    size_t capacity = 0;
+
+    if (config.max_count != 0)
+    {
+        capacity = config.max_count;
+    }
+    else if (config.max_size != 0)
+    {
+        capacity = config.max_size / SKETCH_ESTIMATED_VALUE_SIZE;
+    }
+
+    return capacity;
+}
+}
+
 LRUStorage::LRUStorage(const CACHE_STORAGE_CONFIG& config, Storage* pStorage)
     : m_config(config)
     , m_pStorage(pStorage)
@@ -22,6 +46,10 @@ LRUStorage::LRUStorage(const CACHE_STORAGE_CONFIG& config, Storage* pStorage)
     , m_pHead(NULL)
     , m_pTail(NULL)
 {
+    if (config.admission == CACHE_ADMISSION_FREQUENCY)
+    {
+        m_sSketch.reset(new FrequencySketch(sketch_capacity(config)));
+    }
 }
 
 LRUStorage::~LRUStorage()
@@ -82,10 +110,39 @@ cache_result_t LRUStorage::do_get_value(const CACHE_KEY& key,
 }
 
 cache_result_t LRUStorage::do_put_value(const CACHE_KEY& key, const GWBUF* pvalue)
+{
+    return store_value(key, pvalue, NULL);
+}
+
+cache_result_t LRUStorage::do_restore_value(const CACHE_KEY& key, const GWBUF* pvalue, uint32_t time)
+{
+    // A value that already is in the storage is more recent than a restored one.
+    bool exists = (m_nodes_by_key.find(key) != m_nodes_by_key.end());
+
+    return exists ? (CACHE_RESULT_OK | CACHE_RESULT_DISCARDED) : store_value(key, pvalue, &time);
+}
+
+cache_result_t LRUStorage::do_visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    // The actual storage contains exactly the items in the LRU list.
+    return m_pStorage->visit_values(visitor, pContext);
+}
+
+/**
+ * Put a value to the actual storage and update the LRU information.
+ *
+ * @param key     The key.
+ * @param pvalue  The value.
+ * @param pTime   If non-NULL, the value is restored as if it had been
+ *                put at that time.
+ *
+ * @return As for Storage::put_value.
+ */
+cache_result_t LRUStorage::store_value(const CACHE_KEY& key, const GWBUF* pvalue, const uint32_t* pTime)
 {
     cache_result_t result = CACHE_RESULT_ERROR;
 
-    size_t value_size = GWBUF_LENGTH(pvalue);
+    size_t value_size = gwbuf_length(pvalue);
 
     Node* pNode = NULL;
 
@@ -96,16 +153,28 @@ cache_result_t LRUStorage::do_put_value(const CACHE_KEY& key, const GWBUF* pvalu
     {
         result = get_existing_node(i, pvalue, &pNode);
     }
-    else
+    else if (admit(key, value_size))
     {
         result = get_new_node(key, pvalue, &i, &pNode);
     }
+    else
+    {
+        ++m_stats.admission_rejects;
+        result = CACHE_RESULT_OK | CACHE_RESULT_DISCARDED;
+    }
 
-    if (CACHE_RESULT_IS_OK(result))
+    if (CACHE_RESULT_IS_OK(result) && !CACHE_RESULT_IS_DISCARDED(result))
     {
         mxb_assert(pNode);
 
-        result = m_pStorage->put_value(key, pvalue);
+        if (pTime)
+        {
+            result = m_pStorage->restore_value(key, pvalue, *pTime);
+        }
+        else
+        {
+            result = m_pStorage->put_value(key, pvalue);
+        }
 
         if (CACHE_RESULT_IS_OK(result))
         {
@@ -228,6 +297,13 @@ cache_result_t LRUStorage::access_value(access_approach_t approach,
 {
     cache_result_t result = CACHE_RESULT_NOT_FOUND;
 
+    if (m_sSketch && (approach == APPROACH_GET))
+    {
+        // Misses are counted as well, as it is the frequency of a key that
+        // is not in the cache that decides whether it will be admitted.
+        m_sSketch->increment(key);
+    }
+
     NodesByKey::iterator i = m_nodes_by_key.find(key);
     bool existed = (i != m_nodes_by_key.end());
 
@@ -263,6 +339,35 @@ cache_result_t LRUStorage::access_value(access_approach_t approach,
     return result;
 }
 
+/**
+ * Decide whether a new item should be admitted to the cache. If there is room
+ * for the item, or if no admission policy is used, it always is. Otherwise it
+ * is admitted only if it has been requested more frequently than the least
+ * recently used item, that would be evicted to make room for it.
+ *
+ * @param key         The key of the new item.
+ * @param value_size  The size of the new item.
+ *
+ * @return True, if the item should be stored.
+ */
+bool LRUStorage::admit(const CACHE_KEY& key, size_t value_size)
+{
+    bool admitted = true;
+
+    if (m_sSketch && m_pTail)
+    {
+        bool must_evict = (m_stats.size + value_size > m_max_size) || (m_stats.items == m_max_count);
+
+        if (must_evict)
+        {
+            mxb_assert(m_pTail->key());
+            admitted = m_sSketch->frequency(key) > m_sSketch->frequency(*m_pTail->key());
+        }
+    }
+
+    return admitted;
+}
+
 /**
  * Free the data associated with the least recently used node,
  * but not the node itself.
@@ -468,7 +573,7 @@ cache_result_t LRUStorage::get_existing_node(NodesByKey::iterator& i, const GWBU
 {
     cache_result_t result = CACHE_RESULT_OK;
 
-    size_t value_size = GWBUF_LENGTH(pValue);
+    size_t value_size = gwbuf_length(pValue);
 
     if (value_size > m_max_size)
     {
@@ -534,7 +639,7 @@ cache_result_t LRUStorage::get_new_node(const CACHE_KEY& key,
 {
     cache_result_t result = CACHE_RESULT_OK;
 
-    size_t value_size = GWBUF_LENGTH(pValue);
+    size_t value_size = gwbuf_length(pValue);
     size_t new_size = m_stats.size + value_size;
 
     Node* pNode = NULL;
@@ -607,4 +712,5 @@ void LRUStorage::Stats::fill(json_t* pObject) const
     set_integer(pObject, "updates", updates);
     set_integer(pObject, "deletes", deletes);
     set_integer(pObject, "evictions", evictions);
+    set_integer(pObject, "admission_rejects", admission_rejects);
 }
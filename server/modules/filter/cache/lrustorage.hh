@@ -13,9 +13,11 @@
 #pragma once
 
 #include <maxscale/ccdefs.hh>
+#include <memory>
 #include <unordered_map>
 #include "cachefilter.h"
 #include "cache_storage_api.hh"
+#include "frequencysketch.hh"
 #include "storage.hh"
 
 class LRUStorage : public Storage
@@ -78,6 +80,18 @@ protected:
      */
     cache_result_t do_get_items(uint64_t* pItems) const;
 
+    /**
+     * @see Storage::visit_values
+     */
+    cache_result_t do_visit_values(cache_storage_visitor_t visitor, void* pContext) const;
+
+    /**
+     * @see Storage::restore_value
+     */
+    cache_result_t do_restore_value(const CACHE_KEY& key,
+                                    const GWBUF* pValue,
+                                    uint32_t time);
+
 private:
     LRUStorage(const LRUStorage&);
     LRUStorage& operator=(const LRUStorage&);
@@ -211,6 +225,9 @@ private:
 
     typedef std::unordered_map<CACHE_KEY, Node*> NodesByKey;
 
+    cache_result_t store_value(const CACHE_KEY& key, const GWBUF* pValue, const uint32_t* pTime);
+
+    bool  admit(const CACHE_KEY& key, size_t value_size);
     Node* vacate_lru();
     Node* vacate_lru(size_t space);
     bool  free_node_data(Node* pNode);
@@ -236,6 +253,7 @@ private:
             , updates(0)
             , deletes(0)
             , evictions(0)
+            , admission_rejects(0)
         {
         }
 
@@ -248,6 +266,7 @@ private:
         uint64_t updates;   /*< How many times an existing key in the cache was updated. */
         uint64_t deletes;   /*< How many times an existing key in the cache was deleted. */
         uint64_t evictions; /*< How many times an item has been evicted from the cache. */
+        uint64_t admission_rejects; /*< How many times a new item was not admitted to the cache. */
     };
 
     const CACHE_STORAGE_CONFIG m_config;        /*< The configuration. */
@@ -258,4 +277,5 @@ private:
     mutable NodesByKey         m_nodes_by_key;  /*< Mapping from cache keys to corresponding Node. */
     mutable Node*              m_pHead;         /*< The node at the LRU list. */
     mutable Node*              m_pTail;         /*< The node at bottom of the LRU list.*/
+    std::unique_ptr<FrequencySketch> m_sSketch; /*< Access frequencies, if admission is used. */
 };
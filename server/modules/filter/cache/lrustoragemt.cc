@@ -93,3 +93,17 @@ cache_result_t LRUStorageMT::get_items(uint64_t* pItems) const
 
     return LRUStorage::do_get_items(pItems);
 }
+
+cache_result_t LRUStorageMT::visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_visit_values(visitor, pContext);
+}
+
+cache_result_t LRUStorageMT::restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_restore_value(key, pValue, time);
+}
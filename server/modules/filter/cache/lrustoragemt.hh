@@ -49,6 +49,12 @@ public:
 
     cache_result_t get_items(uint64_t* pItems) const;
 
+    cache_result_t visit_values(cache_storage_visitor_t visitor, void* pContext) const;
+
+    cache_result_t restore_value(const CACHE_KEY& key,
+                                 const GWBUF* pValue,
+                                 uint32_t time);
+
 private:
     LRUStorageMT(const CACHE_STORAGE_CONFIG& config, Storage* pStorage);
 
@@ -77,3 +77,13 @@ cache_result_t LRUStorageST::get_items(uint64_t* pItems) const
 {
     return LRUStorage::do_get_items(pItems);
 }
+
+cache_result_t LRUStorageST::visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    return LRUStorage::do_visit_values(visitor, pContext);
+}
+
+cache_result_t LRUStorageST::restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time)
+{
+    return LRUStorage::do_restore_value(key, pValue, time);
+}
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#define MXS_MODULE_NAME "cache"
+#include "shardedstorage.hh"
+#include "cache_storage_api.hh"
+
+ShardedStorage::ShardedStorage(const CACHE_STORAGE_CONFIG& config, Shards& shards)
+    : m_config(config)
+    , m_last(0)
+{
+    m_shards.swap(shards);
+
+    MXS_NOTICE("Created sharded storage with %lu shards.", m_shards.size());
+}
+
+ShardedStorage::~ShardedStorage()
+{
+}
+
+// static
+ShardedStorage* ShardedStorage::create(const CACHE_STORAGE_CONFIG& config, Storages& storages)
+{
+    mxb_assert(!storages.empty());
+
+    ShardedStorage* pStorage = NULL;
+
+    try
+    {
+        Shards shards;
+
+        for (auto& sStorage : storages)
+        {
+            shards.emplace_back(new Shard(sStorage.get()));
+            sStorage.release();
+        }
+
+        storages.clear();
+
+        pStorage = new ShardedStorage(config, shards);
+    }
+    catch (const std::exception& x)
+    {
+        MXS_ERROR("Could not create sharded storage: %s", x.what());
+    }
+
+    return pStorage;
+}
+
+void ShardedStorage::get_config(CACHE_STORAGE_CONFIG* pConfig)
+{
+    *pConfig = m_config;
+}
+
+cache_result_t ShardedStorage::get_info(uint32_t what, json_t** ppInfo) const
+{
+    *ppInfo = json_object();
+
+    if (*ppInfo)
+    {
+        json_t* pShards = json_array();
+
+        if (pShards)
+        {
+            for (const auto& sShard : m_shards)
+            {
+                json_t* pShard_info;
+                cache_result_t result;
+
+                {
+                    std::lock_guard<std::mutex> guard(sShard->lock);
+                    result = sShard->sStorage->get_info(what, &pShard_info);
+                }
+
+                if (CACHE_RESULT_IS_OK(result))
+                {
+                    json_array_append_new(pShards, pShard_info);
+                }
+            }
+
+            json_object_set_new(*ppInfo, "shards", pShards);
+        }
+    }
+
+    return *ppInfo ? CACHE_RESULT_OK : CACHE_RESULT_OUT_OF_RESOURCES;
+}
+
+cache_result_t ShardedStorage::get_value(const CACHE_KEY& key,
+                                         uint32_t flags,
+                                         uint32_t soft_ttl,
+                                         uint32_t hard_ttl,
+                                         GWBUF**  ppValue) const
+{
+    size_t i = shard_index(key);
+    const Shard& shard = *m_shards[i];
+
+    cache_result_t result;
+
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        result = shard.sStorage->get_value(key, flags, soft_ttl, hard_ttl, ppValue);
+    }
+
+    if (CACHE_RESULT_IS_OK(result))
+    {
+        m_last.store(i, std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+cache_result_t ShardedStorage::put_value(const CACHE_KEY& key, const GWBUF* pValue)
+{
+    size_t i = shard_index(key);
+    Shard& shard = *m_shards[i];
+
+    cache_result_t result;
+
+    {
+        std::lock_guard<std::mutex> guard(shard.lock);
+        result = shard.sStorage->put_value(key, pValue);
+    }
+
+    if (CACHE_RESULT_IS_OK(result))
+    {
+        m_last.store(i, std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+cache_result_t ShardedStorage::del_value(const CACHE_KEY& key)
+{
+    Shard& shard = *m_shards[shard_index(key)];
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    return shard.sStorage->del_value(key);
+}
+
+cache_result_t ShardedStorage::get_head(CACHE_KEY* pKey, GWBUF** ppValue) const
+{
+    const Shard& shard = *m_shards[m_last.load(std::memory_order_relaxed)];
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    return shard.sStorage->get_head(pKey, ppValue);
+}
+
+cache_result_t ShardedStorage::get_tail(CACHE_KEY* pKey, GWBUF** ppValue) const
+{
+    cache_result_t result = CACHE_RESULT_NOT_FOUND;
+
+    size_t n = m_shards.size();
+    size_t last = m_last.load(std::memory_order_relaxed);
+
+    for (size_t i = 1; (i <= n) && CACHE_RESULT_IS_NOT_FOUND(result); ++i)
+    {
+        const Shard& shard = *m_shards[(last + i) % n];
+
+        std::lock_guard<std::mutex> guard(shard.lock);
+        result = shard.sStorage->get_tail(pKey, ppValue);
+    }
+
+    return result;
+}
+
+cache_result_t ShardedStorage::get_size(uint64_t* pSize) const
+{
+    cache_result_t result = CACHE_RESULT_OK;
+
+    *pSize = 0;
+
+    for (auto it = m_shards.begin(); (it != m_shards.end()) && CACHE_RESULT_IS_OK(result); ++it)
+    {
+        uint64_t size = 0;
+
+        std::lock_guard<std::mutex> guard((*it)->lock);
+        result = (*it)->sStorage->get_size(&size);
+
+        *pSize += size;
+    }
+
+    return result;
+}
+
+cache_result_t ShardedStorage::get_items(uint64_t* pItems) const
+{
+    cache_result_t result = CACHE_RESULT_OK;
+
+    *pItems = 0;
+
+    for (auto it = m_shards.begin(); (it != m_shards.end()) && CACHE_RESULT_IS_OK(result); ++it)
+    {
+        uint64_t items = 0;
+
+        std::lock_guard<std::mutex> guard((*it)->lock);
+        result = (*it)->sStorage->get_items(&items);
+
+        *pItems += items;
+    }
+
+    return result;
+}
+
+namespace
+{
+
+struct VisitContext
+{
+    cache_storage_visitor_t visitor;
+    void*                   pContext;
+    bool                    stopped;
+};
+
+bool visit_shard_value(void* pContext,
+                       const CACHE_KEY* pKey,
+                       const uint8_t* pData,
+                       size_t len,
+                       uint32_t time)
+{
+    VisitContext* pVisit = static_cast<VisitContext*>(pContext);
+
+    pVisit->stopped = !pVisit->visitor(pVisit->pContext, pKey, pData, len, time);
+
+    return !pVisit->stopped;
+}
+}
+
+cache_result_t ShardedStorage::visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    cache_result_t result = CACHE_RESULT_OK;
+
+    // The visitor's return value must be known, so that the visiting is not
+    // continued in the next shard if the visitor stopped it.
+    VisitContext visit = {visitor, pContext, false};
+
+    for (auto it = m_shards.begin();
+         (it != m_shards.end()) && CACHE_RESULT_IS_OK(result) && !visit.stopped;
+         ++it)
+    {
+        std::lock_guard<std::mutex> guard((*it)->lock);
+        result = (*it)->sStorage->visit_values(visit_shard_value, &visit);
+    }
+
+    return result;
+}
+
+cache_result_t ShardedStorage::restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time)
+{
+    Shard& shard = *m_shards[shard_index(key)];
+
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    return shard.sStorage->restore_value(key, pValue, time);
+}
+
+size_t ShardedStorage::shard_index(const CACHE_KEY& key) const
+{
+    // The key is already a hash, but the low bits are mixed with the high ones
+    // in case the key hash function were to return the key as such.
+    size_t hash = std::hash<CACHE_KEY>()(key);
+
+    return (hash ^ (hash >> 32)) % m_shards.size();
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+#pragma once
+
+#include <maxscale/ccdefs.hh>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "storage.hh"
+
+/**
+ * ShardedStorage is a thread-safe storage that distributes the items over a
+ * number of single threaded storages, each protected by a lock of its own.
+ * The shard of an item is selected using the hash of its key, so threads
+ * accessing different items seldom contend for the same lock.
+ */
+class ShardedStorage : public Storage
+{
+public:
+    typedef std::vector<std::unique_ptr<Storage>> Storages;
+
+    ~ShardedStorage();
+
+    /**
+     * Create a sharded storage.
+     *
+     * @param config   The configuration of the storage as a whole.
+     * @param storages The single threaded storages to be used as shards. If the
+     *                 items are to be capped, the limits of the shards must add
+     *                 up to at most those of @c config. On successful return
+     *                 the storages are owned by the sharded storage.
+     *
+     * @return A new instance or NULL if memory allocation fails.
+     */
+    static ShardedStorage* create(const CACHE_STORAGE_CONFIG& config, Storages& storages);
+
+    void get_config(CACHE_STORAGE_CONFIG* pConfig);
+
+    cache_result_t get_info(uint32_t what, json_t** ppInfo) const;
+
+    cache_result_t get_value(const CACHE_KEY& key,
+                             uint32_t flags,
+                             uint32_t soft_ttl,
+                             uint32_t hard_ttl,
+                             GWBUF**  ppValue) const;
+
+    cache_result_t put_value(const CACHE_KEY& key, const GWBUF* pValue);
+
+    cache_result_t del_value(const CACHE_KEY& key);
+
+    /**
+     * @see Storage::get_head
+     *
+     * Returns the head of the shard that was accessed last.
+     */
+    cache_result_t get_head(CACHE_KEY* pKey, GWBUF** ppValue) const;
+
+    /**
+     * @see Storage::get_tail
+     *
+     * As the relative age of the tails of different shards is not known, this
+     * returns the tail of the first non-empty shard after the one accessed last.
+     */
+    cache_result_t get_tail(CACHE_KEY* pKey, GWBUF** ppValue) const;
+
+    cache_result_t get_size(uint64_t* pSize) const;
+
+    cache_result_t get_items(uint64_t* pItems) const;
+
+    /**
+     * @see Storage::visit_values
+     *
+     * The shards are visited one at a time, so only one shard is locked
+     * at any given moment.
+     */
+    cache_result_t visit_values(cache_storage_visitor_t visitor, void* pContext) const;
+
+    /**
+     * @see Storage::restore_value
+     */
+    cache_result_t restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time);
+
+private:
+    struct Shard
+    {
+        Shard(Storage* pStorage)
+            : sStorage(pStorage)
+        {
+        }
+
+        mutable std::mutex       lock;      /*< Protects the storage. */
+        std::unique_ptr<Storage> sStorage;  /*< The storage of the shard. */
+    };
+
+    typedef std::vector<std::unique_ptr<Shard>> Shards;
+
+    ShardedStorage(const CACHE_STORAGE_CONFIG& config, Shards& shards);
+
+    ShardedStorage(const ShardedStorage&);
+    ShardedStorage& operator=(const ShardedStorage&);
+
+    size_t shard_index(const CACHE_KEY& key) const;
+
+private:
+    const CACHE_STORAGE_CONFIG  m_config;   /*< The configuration. */
+    Shards                      m_shards;   /*< The shards. */
+    mutable std::atomic<size_t> m_last;     /*< The index of the shard accessed last. */
+};
@@ -82,7 +82,7 @@ public:
      *
      * @param key     A key generated with get_key.
      * @param pValue  Pointer to GWBUF containing the value to be stored.
-     *                Must be one contiguous buffer.
+     *                May be a chain of buffers.
      * @return CACHE_RESULT_OK if item was successfully put,
      *         CACHE_RESULT_OUT_OF_RESOURCES if item could not be put, due to
      *         some resource having become exhausted, or some other error code.
@@ -170,6 +170,34 @@ public:
      */
     virtual cache_result_t get_items(uint64_t* pItems) const = 0;
 
+    /**
+     * Visit all items in the storage.
+     *
+     * @param visitor   The function to call for each item.
+     * @param pContext  Provided as such to the visitor.
+     *
+     * @return CACHE_RESULT_OK if the items were visited,
+     *         CACHE_RESULT_OUT_OF_RESOURCES if the storage is incapable of
+     *         visiting the items, and
+     *         CACHE_RESULT_ERROR otherwise.
+     */
+    virtual cache_result_t visit_values(cache_storage_visitor_t visitor, void* pContext) const = 0;
+
+    /**
+     * Put a value to the storage, as if it had been put at a particular time.
+     * An existing value for the key is not replaced.
+     *
+     * @param key     A key generated with get_key.
+     * @param pValue  Pointer to GWBUF containing the value to be stored.
+     *                May be a chain of buffers.
+     * @param time    When the value was originally stored, in seconds since
+     *                the Epoch.
+     *
+     * @return As for @c put_value, and CACHE_RESULT_OK | CACHE_RESULT_DISCARDED
+     *         if there already was a value for the key.
+     */
+    virtual cache_result_t restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time) = 0;
+
 protected:
     Storage();
 
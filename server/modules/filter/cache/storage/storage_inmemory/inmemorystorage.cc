@@ -211,9 +211,20 @@ cache_result_t InMemoryStorage::do_get_value(const CACHE_KEY& key,
 
 cache_result_t InMemoryStorage::do_put_value(const CACHE_KEY& key, const GWBUF& value)
 {
-    mxb_assert(GWBUF_IS_CONTIGUOUS(&value));
+    return store_value(key, value, time(NULL));
+}
 
-    size_t size = GWBUF_LENGTH(&value);
+cache_result_t InMemoryStorage::do_restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time)
+{
+    // A value that already is in the storage is more recent than a restored one.
+    bool exists = (m_entries.find(key) != m_entries.end());
+
+    return exists ? (CACHE_RESULT_OK | CACHE_RESULT_DISCARDED) : store_value(key, value, time);
+}
+
+cache_result_t InMemoryStorage::store_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time)
+{
+    size_t size = gwbuf_length(&value);
 
     Entries::iterator i = m_entries.find(key);
     Entry* pEntry;
@@ -248,10 +259,29 @@ cache_result_t InMemoryStorage::do_put_value(const CACHE_KEY& key, const GWBUF&
 
     m_stats.size += size;
 
-    const uint8_t* pData = GWBUF_DATA(&value);
+    gwbuf_copy_data(&value, 0, size, pEntry->value.data());
+    pEntry->time = time;
+
+    return CACHE_RESULT_OK;
+}
+
+cache_result_t InMemoryStorage::do_visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    uint32_t now = time(NULL);
+    uint32_t hard_ttl = m_config.hard_ttl;
 
-    copy(pData, pData + size, pEntry->value.begin());
-    pEntry->time = time(NULL);
+    for (auto i = m_entries.begin(); i != m_entries.end(); ++i)
+    {
+        const Entry& entry = i->second;
+
+        if ((hard_ttl == 0) || (now - entry.time <= hard_ttl))
+        {
+            if (!visitor(pContext, &i->first, entry.value.data(), entry.value.size(), entry.time))
+            {
+                break;
+            }
+        }
+    }
 
     return CACHE_RESULT_OK;
 }
@@ -40,6 +40,8 @@ public:
                                      GWBUF**  ppResult) = 0;
     virtual cache_result_t put_value(const CACHE_KEY& key, const GWBUF& value) = 0;
     virtual cache_result_t del_value(const CACHE_KEY& key) = 0;
+    virtual cache_result_t visit_values(cache_storage_visitor_t visitor, void* pContext) const = 0;
+    virtual cache_result_t restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time) = 0;
 
     cache_result_t get_head(CACHE_KEY* pKey, GWBUF** ppHead) const;
     cache_result_t get_tail(CACHE_KEY* pKey, GWBUF** ppHead) const;
@@ -58,11 +60,15 @@ protected:
                                 GWBUF**  ppResult);
     cache_result_t do_put_value(const CACHE_KEY& key, const GWBUF& value);
     cache_result_t do_del_value(const CACHE_KEY& key);
+    cache_result_t do_visit_values(cache_storage_visitor_t visitor, void* pContext) const;
+    cache_result_t do_restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time);
 
 private:
     InMemoryStorage(const InMemoryStorage&);
     InMemoryStorage& operator=(const InMemoryStorage&);
 
+    cache_result_t store_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time);
+
 private:
     typedef std::vector<uint8_t> Value;
 
@@ -65,3 +65,17 @@ cache_result_t InMemoryStorageMT::del_value(const CACHE_KEY& key)
 
     return do_del_value(key);
 }
+
+cache_result_t InMemoryStorageMT::visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_visit_values(visitor, pContext);
+}
+
+cache_result_t InMemoryStorageMT::restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_restore_value(key, value, time);
+}
@@ -57,3 +57,13 @@ cache_result_t InMemoryStorageST::del_value(const CACHE_KEY& key)
 {
     return do_del_value(key);
 }
+
+cache_result_t InMemoryStorageST::visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    return do_visit_values(visitor, pContext);
+}
+
+cache_result_t InMemoryStorageST::restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time)
+{
+    return do_restore_value(key, value, time);
+}
@@ -35,6 +35,8 @@ public:
                              GWBUF**  ppResult);
     cache_result_t put_value(const CACHE_KEY& key, const GWBUF& pValue);
     cache_result_t del_value(const CACHE_KEY& key);
+    cache_result_t visit_values(cache_storage_visitor_t visitor, void* pContext) const;
+    cache_result_t restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time);
 
 private:
     InMemoryStorageST(const std::string& name, const CACHE_STORAGE_CONFIG& config);
@@ -0,0 +1,789 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#define MXS_MODULE_NAME "storage_mmap"
+#include "mmapstorage.hh"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <maxscale/alloc.h>
+#include <maxscale/config.h>
+#include <maxscale/paths.h>
+#include <maxscale/utils.h>
+#include "mmapstoragest.hh"
+#include "mmapstoragemt.hh"
+
+using std::auto_ptr;
+using std::string;
+
+namespace
+{
+
+const char   STORAGE_MMAP_SUBDIR[] = "storage_mmap";
+const size_t DEFAULT_SEGMENT_SIZE = 64 * 1024 * 1024;
+}
+
+/**
+ * A segment is a file of fixed size that is mapped into memory. Values are
+ * only appended to a segment and the segment keeps track of how much of
+ * its content is still in use. The file is unlinked as soon as it has been
+ * mapped, so the disk space is released when the mapping is, which happens
+ * when the storage and all buffers referring to the segment are gone.
+ */
+class MmapStorage::Segment
+{
+public:
+    ~Segment()
+    {
+        munmap(m_pData, m_size);
+    }
+
+    static SSegment create(const string& directory, size_t size);
+
+    const uint8_t* data() const
+    {
+        return m_pData;
+    }
+
+    size_t used() const
+    {
+        return m_used;
+    }
+
+    size_t live() const
+    {
+        return m_live;
+    }
+
+    size_t available() const
+    {
+        return m_size - m_used;
+    }
+
+    size_t append(const uint8_t* pData, size_t length)
+    {
+        mxb_assert(length <= available());
+
+        size_t offset = m_used;
+        memcpy(m_pData + offset, pData, length);
+
+        m_used += length;
+        m_live += length;
+
+        return offset;
+    }
+
+    size_t append(const GWBUF& value, size_t length)
+    {
+        mxb_assert(length <= available());
+
+        size_t offset = m_used;
+        gwbuf_copy_data(&value, 0, length, m_pData + offset);
+
+        m_used += length;
+        m_live += length;
+
+        return offset;
+    }
+
+    void release(size_t length)
+    {
+        mxb_assert(m_live >= length);
+        m_live -= length;
+    }
+
+private:
+    Segment(uint8_t* pData, size_t size)
+        : m_pData(pData)
+        , m_size(size)
+        , m_used(0)
+        , m_live(0)
+    {
+    }
+
+    Segment(const Segment&);
+    Segment& operator=(const Segment&);
+
+    uint8_t* m_pData;
+    size_t   m_size;
+    size_t   m_used;
+    size_t   m_live;
+};
+
+// static
+MmapStorage::SSegment MmapStorage::Segment::create(const string& directory, size_t size)
+{
+    SSegment sSegment;
+
+    string path = directory + "/segment-XXXXXX";
+    std::vector<char> zPath(path.begin(), path.end());
+    zPath.push_back(0);
+
+    int fd = mkstemp(zPath.data());
+
+    if (fd != -1)
+    {
+        unlink(zPath.data());
+
+        // Allocate the blocks up front, so that running out of disk space is
+        // reported here and not as a SIGBUS when the mapping is written to.
+        int rv = posix_fallocate(fd, 0, size);
+
+        if (rv == 0)
+        {
+            void* pData = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+            if (pData != MAP_FAILED)
+            {
+                sSegment.reset(new Segment(static_cast<uint8_t*>(pData), size));
+            }
+            else
+            {
+                MXS_ERROR("Could not map segment file '%s': %s", zPath.data(), mxs_strerror(errno));
+            }
+        }
+        else
+        {
+            MXS_ERROR("Could not allocate %lu bytes for segment file '%s': %s",
+                      size, zPath.data(), mxs_strerror(rv));
+        }
+
+        close(fd);
+    }
+    else
+    {
+        MXS_ERROR("Could not create segment file '%s': %s", zPath.data(), mxs_strerror(errno));
+    }
+
+    return sSegment;
+}
+
+// static
+void MmapStorage::release_segment(void* pData)
+{
+    delete static_cast<SSegment*>(pData);
+}
+
+MmapStorage::MmapStorage(const string& name,
+                         const CACHE_STORAGE_CONFIG& config,
+                         const Options& options)
+    : m_name(name)
+    , m_config(config)
+    , m_options(options)
+    , m_max_segments(0)
+{
+    uint64_t max_disk_size = m_options.max_disk_size;
+
+    if ((max_disk_size == 0) && (m_config.max_size != 0))
+    {
+        // Leave room for as much stale data as there is live data.
+        max_disk_size = 2 * m_config.max_size;
+    }
+
+    if (max_disk_size != 0)
+    {
+        m_max_segments = std::max(max_disk_size / m_options.segment_size, (uint64_t)2);
+    }
+}
+
+MmapStorage::~MmapStorage()
+{
+}
+
+bool MmapStorage::Initialize(uint32_t* pCapabilities)
+{
+    *pCapabilities = (CACHE_STORAGE_CAP_ST
+                      | CACHE_STORAGE_CAP_MT
+                      | CACHE_STORAGE_CAP_LRU
+                      | CACHE_STORAGE_CAP_MAX_COUNT
+                      | CACHE_STORAGE_CAP_MAX_SIZE);
+
+    return true;
+}
+
+MmapStorage* MmapStorage::Create_instance(const char* zName,
+                                          const CACHE_STORAGE_CONFIG& config,
+                                          int argc,
+                                          char* argv[])
+{
+    mxb_assert(zName);
+
+    bool error = false;
+
+    string cache_directory = get_cachedir();
+    Options options;
+    options.segment_size = DEFAULT_SEGMENT_SIZE;
+
+    for (int i = 0; i < argc; ++i)
+    {
+        const char* zArg = argv[i];
+        const char* zValue = strchr(zArg, '=');
+
+        if (!zValue)
+        {
+            MXS_ERROR("Storage option '%s' has no value.", zArg);
+            error = true;
+            continue;
+        }
+
+        string key(zArg, zValue - zArg);
+        ++zValue;
+
+        if (key == "cache_directory")
+        {
+            cache_directory = zValue;
+        }
+        else if (key == "segment_size")
+        {
+            if (!get_suffixed_size(zValue, &options.segment_size) || (options.segment_size == 0))
+            {
+                MXS_ERROR("Invalid value '%s' for storage option '%s'.", zValue, key.c_str());
+                error = true;
+            }
+        }
+        else if (key == "max_disk_size")
+        {
+            if (!get_suffixed_size(zValue, &options.max_disk_size))
+            {
+                MXS_ERROR("Invalid value '%s' for storage option '%s'.", zValue, key.c_str());
+                error = true;
+            }
+        }
+        else
+        {
+            MXS_WARNING("Unknown storage option '%s', ignored.", key.c_str());
+        }
+    }
+
+    if (error)
+    {
+        return NULL;
+    }
+
+    options.directory = cache_directory + "/" + STORAGE_MMAP_SUBDIR;
+
+    if (!mxs_mkdir_all(options.directory.c_str(), S_IRWXU | S_IRWXG))
+    {
+        MXS_ERROR("Could not create directory '%s' for segment files.", options.directory.c_str());
+        return NULL;
+    }
+
+    if ((options.max_disk_size != 0) && (options.max_disk_size < 2 * options.segment_size))
+    {
+        MXS_WARNING("The maximum disk size %lu is smaller than two segments; "
+                    "two segments of %lu bytes will be used.",
+                    options.max_disk_size,
+                    options.segment_size);
+    }
+
+    auto_ptr<MmapStorage> sStorage;
+
+    switch (config.thread_model)
+    {
+    case CACHE_THREAD_MODEL_ST:
+        sStorage = MmapStorageST::Create(zName, config, options);
+        break;
+
+    default:
+        mxb_assert(!true);
+        MXS_ERROR("Unknown thread model %d, creating multi-thread aware storage.",
+                  (int)config.thread_model);
+
+    case CACHE_THREAD_MODEL_MT:
+        sStorage = MmapStorageMT::Create(zName, config, options);
+        break;
+    }
+
+    MXS_NOTICE("Storage module created, segment files of %lu bytes in '%s'.",
+               options.segment_size,
+               options.directory.c_str());
+
+    return sStorage.release();
+}
+
+void MmapStorage::get_config(CACHE_STORAGE_CONFIG* pConfig)
+{
+    *pConfig = m_config;
+}
+
+cache_result_t MmapStorage::do_get_info(uint32_t what, json_t** ppInfo) const
+{
+    *ppInfo = json_object();
+
+    if (*ppInfo)
+    {
+        Stats stats = m_stats;
+        stats.segments = m_segments.size() + (m_sCurrent ? 1 : 0);
+
+        stats.fill(*ppInfo);
+    }
+
+    return *ppInfo ? CACHE_RESULT_OK : CACHE_RESULT_OUT_OF_RESOURCES;
+}
+
+cache_result_t MmapStorage::do_get_value(const CACHE_KEY& key,
+                                         uint32_t flags,
+                                         uint32_t soft_ttl,
+                                         uint32_t hard_ttl,
+                                         GWBUF**  ppResult)
+{
+    cache_result_t result = CACHE_RESULT_NOT_FOUND;
+
+    Entries::iterator i = m_entries.find(key);
+
+    if (i != m_entries.end())
+    {
+        m_stats.hits += 1;
+
+        if (soft_ttl == CACHE_USE_CONFIG_TTL)
+        {
+            soft_ttl = m_config.soft_ttl;
+        }
+
+        if (hard_ttl == CACHE_USE_CONFIG_TTL)
+        {
+            hard_ttl = m_config.hard_ttl;
+        }
+
+        if (soft_ttl > hard_ttl)
+        {
+            soft_ttl = hard_ttl;
+        }
+
+        Entry& entry = i->second;
+
+        uint32_t now = time(NULL);
+
+        bool is_hard_stale = hard_ttl == 0 ? false : (now - entry.time > hard_ttl);
+        bool is_soft_stale = soft_ttl == 0 ? false : (now - entry.time > soft_ttl);
+        bool include_stale = ((flags & CACHE_FLAGS_INCLUDE_STALE) != 0);
+
+        if (is_hard_stale)
+        {
+            erase(i);
+            result |= CACHE_RESULT_DISCARDED;
+        }
+        else if (!is_soft_stale || include_stale)
+        {
+            *ppResult = create_buffer(entry);
+
+            if (*ppResult)
+            {
+                m_lru.splice(m_lru.begin(), m_lru, entry.lru);
+
+                result = CACHE_RESULT_OK;
+
+                if (is_soft_stale)
+                {
+                    result |= CACHE_RESULT_STALE;
+                }
+            }
+            else
+            {
+                result = CACHE_RESULT_OUT_OF_RESOURCES;
+            }
+        }
+        else
+        {
+            mxb_assert(is_soft_stale);
+            result |= CACHE_RESULT_STALE;
+        }
+    }
+    else
+    {
+        m_stats.misses += 1;
+    }
+
+    return result;
+}
+
+cache_result_t MmapStorage::do_put_value(const CACHE_KEY& key, const GWBUF& value)
+{
+    return store_value(key, value, time(NULL));
+}
+
+cache_result_t MmapStorage::do_restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time)
+{
+    // A value that already is in the storage is more recent than a restored one.
+    bool exists = (m_entries.find(key) != m_entries.end());
+
+    return exists ? (CACHE_RESULT_OK | CACHE_RESULT_DISCARDED) : store_value(key, value, time);
+}
+
+cache_result_t MmapStorage::store_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time)
+{
+    size_t size = gwbuf_length(&value);
+
+    if ((size > m_options.segment_size) || ((m_config.max_size != 0) && (size > m_config.max_size)))
+    {
+        MXS_WARNING("A value of %lu bytes does not fit in a segment of %lu bytes "
+                    "or in a cache of %lu bytes.",
+                    size,
+                    m_options.segment_size,
+                    m_config.max_size);
+        return CACHE_RESULT_OUT_OF_RESOURCES;
+    }
+
+    Entries::iterator i = m_entries.find(key);
+
+    if (i != m_entries.end())
+    {
+        m_stats.updates += 1;
+        erase(i);
+    }
+
+    while (!m_lru.empty()
+           && (((m_config.max_count != 0) && (m_stats.items + 1 > m_config.max_count))
+               || ((m_config.max_size != 0) && (m_stats.size + size > m_config.max_size))))
+    {
+        erase(m_entries.find(m_lru.back()));
+        m_stats.evictions += 1;
+    }
+
+    if (!make_room(size))
+    {
+        return CACHE_RESULT_OUT_OF_RESOURCES;
+    }
+
+    m_lru.push_front(key);
+
+    Entry& entry = m_entries[key];
+    entry.sSegment = m_sCurrent;
+    entry.offset = m_sCurrent->append(value, size);
+    entry.length = size;
+    entry.time = time;
+    entry.lru = m_lru.begin();
+
+    m_stats.size += size;
+    m_stats.items += 1;
+
+    return CACHE_RESULT_OK;
+}
+
+cache_result_t MmapStorage::do_visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    uint32_t now = time(NULL);
+    uint32_t hard_ttl = m_config.hard_ttl;
+
+    // From the least recently used to the most recently used, so that restoring
+    // the values in the order they are visited recreates the LRU order.
+    for (auto i = m_lru.rbegin(); i != m_lru.rend(); ++i)
+    {
+        const Entry& entry = m_entries.find(*i)->second;
+
+        if ((hard_ttl == 0) || (now - entry.time <= hard_ttl))
+        {
+            const uint8_t* pData = entry.sSegment->data() + entry.offset;
+
+            if (!visitor(pContext, &*i, pData, entry.length, entry.time))
+            {
+                break;
+            }
+        }
+    }
+
+    return CACHE_RESULT_OK;
+}
+
+cache_result_t MmapStorage::do_del_value(const CACHE_KEY& key)
+{
+    Entries::iterator i = m_entries.find(key);
+    bool found = (i != m_entries.end());
+
+    if (found)
+    {
+        m_stats.deletes += 1;
+        erase(i);
+    }
+
+    return found ? CACHE_RESULT_OK : CACHE_RESULT_NOT_FOUND;
+}
+
+cache_result_t MmapStorage::do_get_head(CACHE_KEY* pKey, GWBUF** ppHead) const
+{
+    cache_result_t result = CACHE_RESULT_NOT_FOUND;
+
+    if (!m_lru.empty())
+    {
+        Entries::const_iterator i = m_entries.find(m_lru.front());
+        mxb_assert(i != m_entries.end());
+
+        *ppHead = create_buffer(i->second);
+
+        if (*ppHead)
+        {
+            *pKey = i->first;
+            result = CACHE_RESULT_OK;
+        }
+        else
+        {
+            result = CACHE_RESULT_OUT_OF_RESOURCES;
+        }
+    }
+
+    return result;
+}
+
+cache_result_t MmapStorage::do_get_tail(CACHE_KEY* pKey, GWBUF** ppTail) const
+{
+    cache_result_t result = CACHE_RESULT_NOT_FOUND;
+
+    if (!m_lru.empty())
+    {
+        Entries::const_iterator i = m_entries.find(m_lru.back());
+        mxb_assert(i != m_entries.end());
+
+        *ppTail = create_buffer(i->second);
+
+        if (*ppTail)
+        {
+            *pKey = i->first;
+            result = CACHE_RESULT_OK;
+        }
+        else
+        {
+            result = CACHE_RESULT_OUT_OF_RESOURCES;
+        }
+    }
+
+    return result;
+}
+
+cache_result_t MmapStorage::do_get_size(uint64_t* pSize) const
+{
+    *pSize = m_stats.size;
+    return CACHE_RESULT_OK;
+}
+
+cache_result_t MmapStorage::do_get_items(uint64_t* pItems) const
+{
+    *pItems = m_stats.items;
+    return CACHE_RESULT_OK;
+}
+
+/**
+ * Create a buffer referring directly to the mapped value. The buffer keeps
+ * the segment alive for as long as it exists.
+ *
+ * @param entry  The entry whose value should be returned.
+ *
+ * @return A buffer, or NULL if memory could not be allocated.
+ */
+GWBUF* MmapStorage::create_buffer(const Entry& entry) const
+{
+    GWBUF* pBuffer = gwbuf_alloc(0);
+
+    if (pBuffer)
+    {
+        SSegment* psSegment = new(std::nothrow) SSegment(entry.sSegment);
+
+        if (psSegment)
+        {
+            uint8_t* pData = const_cast<uint8_t*>(entry.sSegment->data()) + entry.offset;
+
+            pBuffer->start = pData;
+            pBuffer->end = pData + entry.length;
+
+            gwbuf_add_buffer_object(pBuffer, GWBUF_MAPPED_DATA, psSegment, release_segment);
+        }
+        else
+        {
+            gwbuf_free(pBuffer);
+            pBuffer = NULL;
+        }
+    }
+
+    return pBuffer;
+}
+
+/**
+ * Remove an entry. A full segment that no longer contains any values
+ * is dropped.
+ *
+ * @param i  The entry to remove.
+ */
+void MmapStorage::erase(Entries::iterator i)
+{
+    mxb_assert(i != m_entries.end());
+
+    Entry& entry = i->second;
+
+    mxb_assert(m_stats.size >= entry.length);
+    mxb_assert(m_stats.items > 0);
+
+    m_stats.size -= entry.length;
+    m_stats.items -= 1;
+
+    entry.sSegment->release(entry.length);
+
+    if ((entry.sSegment->live() == 0) && (entry.sSegment != m_sCurrent))
+    {
+        auto j = std::find(m_segments.begin(), m_segments.end(), entry.sSegment);
+        mxb_assert(j != m_segments.end());
+        m_segments.erase(j);
+    }
+
+    m_lru.erase(entry.lru);
+    m_entries.erase(i);
+}
+
+/**
+ * Ensure that there is room for a value in the current segment.
+ *
+ * @param size  The size of the value.
+ *
+ * @return True, if the value can be appended to the current segment.
+ */
+bool MmapStorage::make_room(size_t size)
+{
+    if (m_sCurrent && (m_sCurrent->available() >= size))
+    {
+        return true;
+    }
+
+    if (m_sCurrent && (m_sCurrent->live() != 0))
+    {
+        m_segments.push_back(m_sCurrent);
+    }
+
+    m_sCurrent.reset();
+
+    if (!add_segment())
+    {
+        return false;
+    }
+
+    // Segments containing mostly stale data are compacted, as long as their
+    // live values fit in the new segment.
+    Segments segments(m_segments);
+
+    for (const SSegment& sSegment : segments)
+    {
+        if ((sSegment->live() < sSegment->used() / 4)
+            && (sSegment->live() + size <= m_sCurrent->available()))
+        {
+            compact(sSegment);
+        }
+    }
+
+    // If there still are too many segments, the segment with the least live data
+    // is compacted, or if its values do not fit, its values are evicted.
+    while ((m_max_segments != 0) && (m_segments.size() + 1 > m_max_segments))
+    {
+        auto i = std::min_element(m_segments.begin(), m_segments.end(),
+                                  [](const SSegment& lhs, const SSegment& rhs) {
+                                      return lhs->live() < rhs->live();
+                                  });
+
+        SSegment sSegment = *i;
+
+        if (sSegment->live() + size <= m_sCurrent->available())
+        {
+            compact(sSegment);
+        }
+        else
+        {
+            Entries::iterator j = m_entries.begin();
+
+            while (j != m_entries.end())
+            {
+                Entries::iterator k = j++;
+
+                if (k->second.sSegment == sSegment)
+                {
+                    erase(k);
+                    m_stats.evictions += 1;
+                }
+            }
+        }
+
+        mxb_assert(std::find(m_segments.begin(), m_segments.end(), sSegment) == m_segments.end());
+    }
+
+    return true;
+}
+
+/**
+ * Create a new current segment.
+ *
+ * @return True, if a segment could be created.
+ */
+bool MmapStorage::add_segment()
+{
+    mxb_assert(!m_sCurrent);
+
+    m_sCurrent = Segment::create(m_options.directory, m_options.segment_size);
+
+    return m_sCurrent.get() != NULL;
+}
+
+/**
+ * Move all values of a segment to the current segment. Once done, the
+ * segment is dropped.
+ *
+ * @param sSegment  The segment to compact.
+ */
+void MmapStorage::compact(const SSegment& sSegment)
+{
+    mxb_assert(sSegment != m_sCurrent);
+    mxb_assert(sSegment->live() <= m_sCurrent->available());
+
+    SSegment sKeep(sSegment);   // The argument may refer to an item in m_segments.
+
+    for (auto& kv : m_entries)
+    {
+        Entry& entry = kv.second;
+
+        if (entry.sSegment == sKeep)
+        {
+            entry.offset = m_sCurrent->append(sKeep->data() + entry.offset, entry.length);
+            entry.sSegment = m_sCurrent;
+            sKeep->release(entry.length);
+        }
+    }
+
+    mxb_assert(sKeep->live() == 0);
+
+    auto i = std::find(m_segments.begin(), m_segments.end(), sKeep);
+    mxb_assert(i != m_segments.end());
+    m_segments.erase(i);
+
+    m_stats.compactions += 1;
+}
+
+static void set_integer(json_t* pObject, const char* zName, size_t value)
+{
+    json_t* pValue = json_integer(value);
+
+    if (pValue)
+    {
+        json_object_set(pObject, zName, pValue);
+        json_decref(pValue);
+    }
+}
+
+void MmapStorage::Stats::fill(json_t* pObject) const
+{
+    set_integer(pObject, "size", size);
+    set_integer(pObject, "items", items);
+    set_integer(pObject, "hits", hits);
+    set_integer(pObject, "misses", misses);
+    set_integer(pObject, "updates", updates);
+    set_integer(pObject, "deletes", deletes);
+    set_integer(pObject, "evictions", evictions);
+    set_integer(pObject, "segments", segments);
+    set_integer(pObject, "compactions", compactions);
+}
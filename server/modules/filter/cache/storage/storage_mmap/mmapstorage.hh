@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+#pragma once
+
+#include <maxscale/ccdefs.hh>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "../../cache_storage_api.hh"
+
+/**
+ * MmapStorage stores the values in memory mapped segment files and keeps
+ * only the index in memory. Values are appended to the current segment and
+ * returned without copying, in buffers referring directly to the mapped
+ * memory. When a new segment is needed, segments containing mostly stale
+ * data are compacted by moving their live values to the new segment.
+ */
+class MmapStorage
+{
+public:
+    struct Options
+    {
+        Options()
+            : segment_size(0)
+            , max_disk_size(0)
+        {
+        }
+
+        std::string directory;      /*< Where the segment files are created. */
+        uint64_t    segment_size;   /*< The size of a segment file. */
+        uint64_t    max_disk_size;  /*< The maximum size of all segment files, 0 means no limit. */
+    };
+
+    virtual ~MmapStorage();
+
+    static bool Initialize(uint32_t* pCapabilities);
+
+    static MmapStorage* Create_instance(const char* zName,
+                                        const CACHE_STORAGE_CONFIG& config,
+                                        int argc,
+                                        char* argv[]);
+
+    void                   get_config(CACHE_STORAGE_CONFIG* pConfig);
+    virtual cache_result_t get_info(uint32_t what, json_t** ppInfo) const = 0;
+    virtual cache_result_t get_value(const CACHE_KEY& key,
+                                     uint32_t flags,
+                                     uint32_t soft_ttl,
+                                     uint32_t hard_ttl,
+                                     GWBUF**  ppResult) = 0;
+    virtual cache_result_t put_value(const CACHE_KEY& key, const GWBUF& value) = 0;
+    virtual cache_result_t del_value(const CACHE_KEY& key) = 0;
+    virtual cache_result_t visit_values(cache_storage_visitor_t visitor, void* pContext) const = 0;
+    virtual cache_result_t restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time) = 0;
+    virtual cache_result_t get_head(CACHE_KEY* pKey, GWBUF** ppHead) const = 0;
+    virtual cache_result_t get_tail(CACHE_KEY* pKey, GWBUF** ppTail) const = 0;
+    virtual cache_result_t get_size(uint64_t* pSize) const = 0;
+    virtual cache_result_t get_items(uint64_t* pItems) const = 0;
+
+protected:
+    MmapStorage(const std::string& name,
+                const CACHE_STORAGE_CONFIG& config,
+                const Options& options);
+
+    cache_result_t do_get_info(uint32_t what, json_t** ppInfo) const;
+    cache_result_t do_get_value(const CACHE_KEY& key,
+                                uint32_t flags,
+                                uint32_t soft_ttl,
+                                uint32_t hard_ttl,
+                                GWBUF**  ppResult);
+    cache_result_t do_put_value(const CACHE_KEY& key, const GWBUF& value);
+    cache_result_t do_del_value(const CACHE_KEY& key);
+    cache_result_t do_visit_values(cache_storage_visitor_t visitor, void* pContext) const;
+    cache_result_t do_restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time);
+    cache_result_t do_get_head(CACHE_KEY* pKey, GWBUF** ppHead) const;
+    cache_result_t do_get_tail(CACHE_KEY* pKey, GWBUF** ppTail) const;
+    cache_result_t do_get_size(uint64_t* pSize) const;
+    cache_result_t do_get_items(uint64_t* pItems) const;
+
+private:
+    MmapStorage(const MmapStorage&);
+    MmapStorage& operator=(const MmapStorage&);
+
+    cache_result_t store_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time);
+
+private:
+    class Segment;
+    typedef std::shared_ptr<Segment> SSegment;
+    typedef std::vector<SSegment>    Segments;
+    typedef std::list<CACHE_KEY>     Lru;  // Most recently used first.
+
+    struct Entry
+    {
+        SSegment      sSegment;     /*< The segment where the value is. */
+        size_t        offset;       /*< The offset of the value in the segment. */
+        size_t        length;       /*< The length of the value. */
+        uint32_t      time;         /*< When the value was stored. */
+        Lru::iterator lru;          /*< The position of the key in the LRU list. */
+    };
+
+    struct Stats
+    {
+        Stats()
+            : size(0)
+            , items(0)
+            , hits(0)
+            , misses(0)
+            , updates(0)
+            , deletes(0)
+            , evictions(0)
+            , segments(0)
+            , compactions(0)
+        {
+        }
+
+        void fill(json_t* pObject) const;
+
+        uint64_t size;          /*< The total size of the stored values. */
+        uint64_t items;         /*< The number of stored items. */
+        uint64_t hits;          /*< How many times a key was found in the cache. */
+        uint64_t misses;        /*< How many times a key was not found in the cache. */
+        uint64_t updates;       /*< How many times an existing key in the cache was updated. */
+        uint64_t deletes;       /*< How many times an existing key in the cache was deleted. */
+        uint64_t evictions;     /*< How many times an item has been evicted from the cache. */
+        uint64_t segments;      /*< The number of segments in use. */
+        uint64_t compactions;   /*< How many times a segment has been compacted. */
+    };
+
+    typedef std::unordered_map<CACHE_KEY, Entry> Entries;
+
+    static void release_segment(void* pData);
+
+    GWBUF* create_buffer(const Entry& entry) const;
+    void   erase(Entries::iterator i);
+    bool   make_room(size_t size);
+    bool   add_segment();
+    void   compact(const SSegment& sSegment);
+
+    std::string                m_name;
+    const CACHE_STORAGE_CONFIG m_config;
+    const Options              m_options;
+    size_t                     m_max_segments;
+    Entries                    m_entries;
+    Lru                        m_lru;
+    SSegment                   m_sCurrent;  /*< The segment values are appended to. */
+    Segments                   m_segments;  /*< The full segments still containing values. */
+    Stats                      m_stats;
+};
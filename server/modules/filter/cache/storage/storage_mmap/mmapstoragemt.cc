@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#define MXS_MODULE_NAME "storage_mmap"
+#include "mmapstoragemt.hh"
+
+using std::auto_ptr;
+
+MmapStorageMT::MmapStorageMT(const std::string& name,
+                             const CACHE_STORAGE_CONFIG& config,
+                             const Options& options)
+    : MmapStorage(name, config, options)
+{
+}
+
+MmapStorageMT::~MmapStorageMT()
+{
+}
+
+auto_ptr<MmapStorageMT> MmapStorageMT::Create(const std::string& name,
+                                              const CACHE_STORAGE_CONFIG& config,
+                                              const Options& options)
+{
+    return auto_ptr<MmapStorageMT>(new MmapStorageMT(name, config, options));
+}
+
+cache_result_t MmapStorageMT::get_info(uint32_t what, json_t** ppInfo) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_get_info(what, ppInfo);
+}
+
+cache_result_t MmapStorageMT::get_value(const CACHE_KEY& key,
+                                        uint32_t flags,
+                                        uint32_t soft_ttl,
+                                        uint32_t hard_ttl,
+                                        GWBUF**  ppResult)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_get_value(key, flags, soft_ttl, hard_ttl, ppResult);
+}
+
+cache_result_t MmapStorageMT::put_value(const CACHE_KEY& key, const GWBUF& value)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_put_value(key, value);
+}
+
+cache_result_t MmapStorageMT::del_value(const CACHE_KEY& key)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_del_value(key);
+}
+
+cache_result_t MmapStorageMT::visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_visit_values(visitor, pContext);
+}
+
+cache_result_t MmapStorageMT::restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time)
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_restore_value(key, value, time);
+}
+
+cache_result_t MmapStorageMT::get_head(CACHE_KEY* pKey, GWBUF** ppHead) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_get_head(pKey, ppHead);
+}
+
+cache_result_t MmapStorageMT::get_tail(CACHE_KEY* pKey, GWBUF** ppTail) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_get_tail(pKey, ppTail);
+}
+
+cache_result_t MmapStorageMT::get_size(uint64_t* pSize) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_get_size(pSize);
+}
+
+cache_result_t MmapStorageMT::get_items(uint64_t* pItems) const
+{
+    std::lock_guard<std::mutex> guard(m_lock);
+
+    return do_get_items(pItems);
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+#pragma once
+
+#include <maxscale/ccdefs.hh>
+#include "mmapstorage.hh"
+
+class MmapStorageST : public MmapStorage
+{
+public:
+    ~MmapStorageST();
+
+    typedef std::auto_ptr<MmapStorageST> SMmapStorageST;
+
+    static SMmapStorageST Create(const std::string& name,
+                                 const CACHE_STORAGE_CONFIG& config,
+                                 const Options& options);
+
+    cache_result_t get_info(uint32_t what, json_t** ppInfo) const;
+    cache_result_t get_value(const CACHE_KEY& key,
+                             uint32_t flags,
+                             uint32_t soft_ttl,
+                             uint32_t hard_ttl,
+                             GWBUF**  ppResult);
+    cache_result_t put_value(const CACHE_KEY& key, const GWBUF& value);
+    cache_result_t del_value(const CACHE_KEY& key);
+    cache_result_t visit_values(cache_storage_visitor_t visitor, void* pContext) const;
+    cache_result_t restore_value(const CACHE_KEY& key, const GWBUF& value, uint32_t time);
+    cache_result_t get_head(CACHE_KEY* pKey, GWBUF** ppHead) const;
+    cache_result_t get_tail(CACHE_KEY* pKey, GWBUF** ppTail) const;
+    cache_result_t get_size(uint64_t* pSize) const;
+    cache_result_t get_items(uint64_t* pItems) const;
+
+private:
+    MmapStorageST(const std::string& name, const CACHE_STORAGE_CONFIG& config, const Options& options);
+
+private:
+    MmapStorageST(const MmapStorageST&);
+    MmapStorageST& operator=(const MmapStorageST&);
+};
@@ -176,6 +176,40 @@ public:
         return result;
     }
 
+    static cache_result_t visitValues(CACHE_STORAGE* pCache_storage,
+                                      cache_storage_visitor_t visitor,
+                                      void* pContext)
+    {
+        mxb_assert(pCache_storage);
+        mxb_assert(visitor);
+
+        cache_result_t result = CACHE_RESULT_ERROR;
+
+        StorageType* pStorage = reinterpret_cast<StorageType*>(pCache_storage);
+
+        MXS_EXCEPTION_GUARD(result = pStorage->visit_values(visitor, pContext));
+
+        return result;
+    }
+
+    static cache_result_t restoreValue(CACHE_STORAGE* pCache_storage,
+                                       const CACHE_KEY* pKey,
+                                       const GWBUF* pValue,
+                                       uint32_t time)
+    {
+        mxb_assert(pCache_storage);
+        mxb_assert(pKey);
+        mxb_assert(pValue);
+
+        cache_result_t result = CACHE_RESULT_ERROR;
+
+        StorageType* pStorage = reinterpret_cast<StorageType*>(pCache_storage);
+
+        MXS_EXCEPTION_GUARD(result = pStorage->restore_value(*pKey, *pValue, time));
+
+        return result;
+    }
+
     static CACHE_STORAGE_API s_api;
 };
 
@@ -193,5 +227,7 @@ CACHE_STORAGE_API StorageModule<StorageType>::s_api =
     &StorageModule<StorageType>::getHead,
     &StorageModule<StorageType>::getTail,
     &StorageModule<StorageType>::getSize,
-    &StorageModule<StorageType>::getItems
+    &StorageModule<StorageType>::getItems,
+    &StorageModule<StorageType>::visitValues,
+    &StorageModule<StorageType>::restoreValue
 };
@@ -22,6 +22,7 @@
 #include "cachefilter.h"
 #include "lrustoragest.hh"
 #include "lrustoragemt.hh"
+#include "shardedstorage.hh"
 #include "storagereal.hh"
 
 
@@ -206,6 +207,74 @@ Storage* StorageFactory::createStorage(const char* zName,
     return pStorage;
 }
 
+Storage* StorageFactory::createShardedStorage(const char* zName,
+                                              const CACHE_STORAGE_CONFIG& config,
+                                              size_t n_shards,
+                                              int argc,
+                                              char* argv[])
+{
+    mxb_assert(m_handle);
+    mxb_assert(m_pApi);
+
+    uint32_t mask = CACHE_STORAGE_CAP_MAX_COUNT | CACHE_STORAGE_CAP_MAX_SIZE;
+
+    if ((n_shards <= 1)
+        || (config.thread_model != CACHE_THREAD_MODEL_MT)
+        || cache_storage_has_cap(m_storage_caps, mask))
+    {
+        return createStorage(zName, config, argc, argv);
+    }
+
+    // Each shard is only accessed while its lock is held, so both the LRU
+    // storage and the real storage can be single threaded.
+    CacheStorageConfig raw_config(config);
+    raw_config.thread_model = CACHE_THREAD_MODEL_ST;
+    raw_config.max_count = 0;
+    raw_config.max_size = 0;
+
+    CacheStorageConfig shard_config(config);
+    shard_config.thread_model = CACHE_THREAD_MODEL_ST;
+    shard_config.max_count = config.max_count / n_shards;
+    shard_config.max_size = config.max_size / n_shards;
+
+    ShardedStorage::Storages storages;
+    bool error = false;
+
+    MXS_EXCEPTION_GUARD(storages.reserve(n_shards));
+
+    for (size_t i = 0; !error && (i < n_shards); ++i)
+    {
+        Storage* pStorage = createRawStorage(zName, raw_config, argc, argv);
+
+        if (pStorage)
+        {
+            LRUStorage* pLruStorage = LRUStorageST::create(shard_config, pStorage);
+
+            if (pLruStorage && (storages.size() < storages.capacity()))
+            {
+                // Does not throw, as the space has been reserved.
+                storages.emplace_back(pLruStorage);
+            }
+            else if (pLruStorage)
+            {
+                delete pLruStorage;
+                error = true;
+            }
+            else
+            {
+                delete pStorage;
+                error = true;
+            }
+        }
+        else
+        {
+            error = true;
+        }
+    }
+
+    return error ? NULL : ShardedStorage::create(config, storages);
+}
+
 
 Storage* StorageFactory::createRawStorage(const char* zName,
                                           const CACHE_STORAGE_CONFIG& config,
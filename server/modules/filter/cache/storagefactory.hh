@@ -67,6 +67,29 @@ public:
                            int argc = 0,
                            char* argv[] = NULL);
 
+    /**
+     * Create a storage instance that is split into shards.
+     *
+     * Behaves like @c createStorage, except that if the storage is to be
+     * used by multiple threads and LRU eviction must be provided on top
+     * of the underlying storage, the items are distributed over @c n_shards
+     * independently locked LRU storages. The limits in @c config are then
+     * divided evenly between the shards.
+     *
+     * @param zName      The name of the storage.
+     * @param config     The storage configuration.
+     * @param n_shards   The number of shards.
+     * @argc             Number of items in argv.
+     * @argv             Storage specific arguments.
+     *
+     * @return A storage instance or NULL in case of errors.
+     */
+    Storage* createShardedStorage(const char* zName,
+                                  const CACHE_STORAGE_CONFIG& config,
+                                  size_t n_shards,
+                                  int argc = 0,
+                                  char* argv[] = NULL);
+
     /**
      * Create raw storage instance.
      *
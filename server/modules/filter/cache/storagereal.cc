@@ -76,3 +76,13 @@ cache_result_t StorageReal::get_items(uint64_t* pItems) const
 {
     return m_pApi->getItems(m_pStorage, pItems);
 }
+
+cache_result_t StorageReal::visit_values(cache_storage_visitor_t visitor, void* pContext) const
+{
+    return m_pApi->visitValues(m_pStorage, visitor, pContext);
+}
+
+cache_result_t StorageReal::restore_value(const CACHE_KEY& key, const GWBUF* pValue, uint32_t time)
+{
+    return m_pApi->restoreValue(m_pStorage, &key, pValue, time);
+}
@@ -0,0 +1,578 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <maxbase/maxbase.hh>
+#include <maxbase/stopwatch.hh>
+#include <maxbase/worker.hh>
+#include <maxscale/alloc.h>
+#include <maxscale/filtermodule.hh>
+#include <maxscale/mock/backend.hh>
+#include <maxscale/mock/client.hh>
+#include <maxscale/mock/routersession.hh>
+#include <maxscale/mock/session.hh>
+#include "../cachefilter.h"
+
+using namespace std;
+using maxscale::FilterModule;
+namespace mock = maxscale::mock;
+
+namespace
+{
+
+// With a soft TTL of one second, an entry is stale once the time, in seconds,
+// has advanced by two.
+const char    SOFT_TTL[] = "1";
+const int32_t STALE_DELAY = 2100;
+
+const int32_t CHECK_INTERVAL = 50;
+const int     CHECK_TIMEOUT = 5;
+
+bool write_packet(int fd, uint8_t seq, const vector<uint8_t>& payload)
+{
+    vector<uint8_t> packet(MYSQL_HEADER_LEN);
+    gw_mysql_set_byte3(packet.data(), payload.size());
+    packet[3] = seq;
+    packet.insert(packet.end(), payload.begin(), payload.end());
+
+    return write(fd, packet.data(), packet.size()) == (ssize_t)packet.size();
+}
+
+bool read_packet(int fd, vector<uint8_t>* pPayload)
+{
+    uint8_t header[MYSQL_HEADER_LEN];
+    bool rv = recv(fd, header, sizeof(header), MSG_WAITALL) == sizeof(header);
+
+    if (rv)
+    {
+        pPayload->resize(gw_mysql_get_byte3(header));
+        rv = pPayload->empty()
+            || (recv(fd, pPayload->data(), pPayload->size(), MSG_WAITALL) == (ssize_t)pPayload->size());
+    }
+
+    return rv;
+}
+
+vector<uint8_t> create_handshake()
+{
+    vector<uint8_t> payload;
+    payload.push_back(GW_MYSQL_PROTOCOL_VERSION);
+
+    const char VERSION[] = "10.3.0-fake";
+    payload.insert(payload.end(), VERSION, VERSION + sizeof(VERSION));  // Including the NUL.
+    payload.insert(payload.end(), {1, 0, 0, 0});                        // Thread id
+    payload.insert(payload.end(), 8, 'a');                              // Scramble, part 1
+    payload.push_back(0);                                               // Filler
+    payload.insert(payload.end(), {0xff, 0xf7});                        // Capabilities, part 1
+    payload.push_back(8);                                               // Character set
+    payload.insert(payload.end(), {2, 0});                              // Status
+    payload.insert(payload.end(), {0xff, 0x81});                        // Capabilities, part 2
+    payload.push_back(GW_MYSQL_SCRAMBLE_SIZE + 1);                      // Scramble length
+    payload.insert(payload.end(), 10, 0);                               // Reserved
+    payload.insert(payload.end(), 12, 'b');                             // Scramble, part 2
+    payload.push_back(0);
+
+    const char PLUGIN[] = "mysql_native_password";
+    payload.insert(payload.end(), PLUGIN, PLUGIN + sizeof(PLUGIN));
+
+    return payload;
+}
+
+/**
+ * Stands in for the listener of the service. Accepts any credentials, records
+ * the statements and responds to each one with an OK packet.
+ */
+class Listener
+{
+public:
+    Listener()
+        : m_fd(socket(AF_INET, SOCK_STREAM, 0))
+        , m_port(0)
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+
+        if (m_fd != -1
+            && bind(m_fd, (sockaddr*)&addr, sizeof(addr)) == 0
+            && listen(m_fd, 8) == 0
+            && getsockname(m_fd, (sockaddr*)&addr, &len) == 0)
+        {
+            m_port = ntohs(addr.sin_port);
+            m_thread = std::thread(&Listener::accept_connections, this);
+        }
+    }
+
+    ~Listener()
+    {
+        if (m_thread.joinable())
+        {
+            shutdown(m_fd, SHUT_RDWR);
+            m_thread.join();
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+
+            for (int fd : m_connections)
+            {
+                shutdown(fd, SHUT_RDWR);
+            }
+        }
+
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+
+        for (int fd : m_connections)
+        {
+            close(fd);
+        }
+
+        if (m_fd != -1)
+        {
+            close(m_fd);
+        }
+    }
+
+    uint16_t port() const
+    {
+        return m_port;
+    }
+
+    bool received(const string& statement) const
+    {
+        std::lock_guard<std::mutex> guard(m_lock);
+
+        return std::find(m_statements.begin(), m_statements.end(), statement) != m_statements.end();
+    }
+
+private:
+    void accept_connections()
+    {
+        int fd;
+
+        while ((fd = accept(m_fd, NULL, NULL)) != -1)
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_connections.push_back(fd);
+            m_threads.push_back(std::thread(&Listener::serve, this, fd));
+        }
+    }
+
+    void serve(int fd)
+    {
+        vector<uint8_t> payload;
+        const vector<uint8_t> ok {0, 0, 0, 2, 0, 0, 0};
+
+        if (write_packet(fd, 0, create_handshake())
+            && read_packet(fd, &payload)
+            && write_packet(fd, 2, ok))
+        {
+            while (read_packet(fd, &payload) && !payload.empty() && payload[0] == MXS_COM_QUERY)
+            {
+                {
+                    std::lock_guard<std::mutex> guard(m_lock);
+                    m_statements.push_back(string(payload.begin() + 1, payload.end()));
+                }
+
+                write_packet(fd, 1, ok);
+            }
+        }
+    }
+
+    int                 m_fd;
+    uint16_t            m_port;
+    std::thread         m_thread;
+    mutable std::mutex  m_lock;
+    vector<int>         m_connections;
+    vector<std::thread> m_threads;
+    vector<string>      m_statements;
+};
+
+struct Connection
+{
+    Connection(FilterModule::Instance& filter_instance)
+        : router_session(&backend)
+        , client("bob", "127.0.0.1")
+        , session(&client)
+    {
+        memset(&service, 0, sizeof(service));
+        service.name = "test";
+
+        memset(&listener, 0, sizeof(listener));
+
+        memset(&protocol, 0, sizeof(protocol));
+        protocol.charset = 8;
+
+        // The background connection is made to the service of the session,
+        // using the protocol of the client connection.
+        session.service = &service;
+        session.client_dcb->protocol = &protocol;
+
+        sFilter_session = filter_instance.newSession(&session);
+
+        if (sFilter_session.get())
+        {
+            router_session.set_as_downstream_on(sFilter_session.get());
+            client.set_as_upstream_on(*sFilter_session.get());
+        }
+    }
+
+    void listen_on(uint16_t port)
+    {
+        listener.port = port;
+        service.ports = &listener;
+    }
+
+    bool set_variable(const char* zName, const char* zValue)
+    {
+        char* zMessage = session_set_variable_value(&session,
+                                                    zName, zName + strlen(zName),
+                                                    zValue, zValue + strlen(zValue));
+        MXS_FREE(zMessage);
+
+        return zMessage == NULL;
+    }
+
+    void route(const char* zSelect)
+    {
+        session.route_query(mock::create_com_query(zSelect));
+    }
+
+    SERVICE                         service;
+    SERV_LISTENER                   listener;
+    MySQLProtocol                   protocol;
+    mock::ResultSetBackend          backend;
+    mock::RouterSession             router_session;
+    mock::Client                    client;
+    mock::Session                   session;
+    auto_ptr<FilterModule::Session> sFilter_session;
+};
+
+/**
+ * A session hitting a stale entry returns it and sends the SELECT over a
+ * background connection. The session lets other sessions refresh the entry
+ * once it has been stored, which is simulated by a session doing what the
+ * cache filter of the background connection does. A session failing to
+ * create the background connection refreshes synchronously and retries
+ * after a delay.
+ */
+class BackgroundRefreshTest
+{
+    typedef void (BackgroundRefreshTest::* Step)();
+
+public:
+    BackgroundRefreshTest(mxb::Worker& worker, FilterModule::Instance& filter_instance, Listener& listener)
+        : m_worker(worker)
+        , m_listener(listener)
+        , m_a(filter_instance)
+        , m_d(filter_instance)
+        , m_e(filter_instance)
+        , m_r(filter_instance)
+        , m_rv(0)
+        , m_zWaited(NULL)
+        , m_pNext(NULL)
+    {
+        m_a.listen_on(listener.port());
+    }
+
+    bool ok() const
+    {
+        return m_a.sFilter_session.get() && m_d.sFilter_session.get()
+               && m_e.sFilter_session.get() && m_r.sFilter_session.get();
+    }
+
+    int rv() const
+    {
+        return m_rv;
+    }
+
+    void start()
+    {
+        m_a.route("SELECT a FROM x");
+        m_a.router_session.respond();
+
+        m_d.route("SELECT a FROM y1");
+        m_d.router_session.respond();
+        m_d.route("SELECT a FROM y2");
+        m_d.router_session.respond();
+
+        expect(m_a.client.n_responses() == 1 && m_d.client.n_responses() == 2,
+               "The entries should have been populated.");
+
+        m_worker.delayed_call(STALE_DELAY, &BackgroundRefreshTest::stale, this);
+    }
+
+private:
+    bool stale(mxb::Worker::Call::action_t action)
+    {
+        if (action == mxb::Worker::Call::EXECUTE)
+        {
+            cout << "Stale entry is returned and refreshed in the background." << endl;
+
+            m_a.route("SELECT a FROM x");
+            expect(m_a.router_session.idle() && m_a.client.n_responses() == 2,
+                   "The stale entry should have been returned.");
+
+            cout << "Stale entry is refreshed synchronously, if there is no connection." << endl;
+
+            m_d.route("SELECT a FROM y1");
+            expect(!m_d.router_session.idle(), "Without a listener, the session should refresh itself.");
+            m_d.router_session.respond();
+
+            m_d.listen_on(m_listener.port());
+
+            m_d.route("SELECT a FROM y2");
+            expect(!m_d.router_session.idle(), "The connection should not be retried at once.");
+            m_d.router_session.respond();
+
+            wait_for("SELECT a FROM x", &BackgroundRefreshTest::sent_x);
+        }
+
+        return false;
+    }
+
+    void sent_x()
+    {
+        cout << "Session is notified when the refreshed entry is stored." << endl;
+
+        // What the session of the background connection does.
+        expect(m_r.set_variable("@maxscale.cache.populate", "true")
+               && m_r.set_variable("@maxscale.cache.use", "false"),
+               "The cache variables should be set.");
+
+        m_r.route("SELECT a FROM x");
+        expect(!m_r.router_session.idle(), "The refreshing session should reach the backend.");
+        m_r.router_session.respond();
+
+        m_worker.delayed_call(STALE_DELAY, &BackgroundRefreshTest::stale_again, this);
+    }
+
+    bool stale_again(mxb::Worker::Call::action_t action)
+    {
+        if (action == mxb::Worker::Call::EXECUTE)
+        {
+            // Had the first session not been notified, the entry would still be pending
+            // and the stale entry would be returned.
+            m_e.route("SELECT a FROM x");
+            expect(!m_e.router_session.idle(),
+                   "Once stored, the entry should no longer be pending.");
+            m_e.router_session.respond();
+
+            cout << "Connection is retried after a delay." << endl;
+
+            m_d.route("SELECT a FROM y1");
+            expect(m_d.router_session.idle(), "The stale entry should now be refreshed in the background.");
+
+            wait_for("SELECT a FROM y1", &BackgroundRefreshTest::end);
+        }
+
+        return false;
+    }
+
+    void end()
+    {
+        m_worker.shutdown();
+    }
+
+    void wait_for(const char* zStatement, Step pStep)
+    {
+        m_zWaited = zStatement;
+        m_pNext = pStep;
+        m_watch.restart();
+        m_worker.delayed_call(CHECK_INTERVAL, &BackgroundRefreshTest::check, this);
+    }
+
+    bool check(mxb::Worker::Call::action_t action)
+    {
+        bool again = false;
+
+        if (action == mxb::Worker::Call::EXECUTE)
+        {
+            if (m_listener.received(m_zWaited))
+            {
+                (this->*m_pNext)();
+            }
+            else if (m_watch.split() < std::chrono::seconds(CHECK_TIMEOUT))
+            {
+                again = true;
+            }
+            else
+            {
+                cout << "ERROR: '" << m_zWaited << "' was not sent in the background." << endl;
+                ++m_rv;
+                end();
+            }
+        }
+
+        return again;
+    }
+
+    void expect(bool condition, const char* zMessage)
+    {
+        if (!condition)
+        {
+            cout << "ERROR: " << zMessage << endl;
+            ++m_rv;
+        }
+    }
+
+    mxb::Worker&   m_worker;
+    Listener&      m_listener;
+    Connection     m_a;         // Refreshes in the background.
+    Connection     m_d;         // Cannot at first create the background connection.
+    Connection     m_e;         // Has no background connection.
+    Connection     m_r;         // Does what the background connection does.
+    int            m_rv;
+    const char*    m_zWaited;   // The statement the listener should receive.
+    Step           m_pNext;     // Called once it has been received.
+    mxb::StopWatch m_watch;
+};
+
+int test(FilterModule& filter_module)
+{
+    int rv = 1;
+
+    auto_ptr<FilterModule::ConfigParameters> sParameters = filter_module.create_default_parameters();
+    sParameters->set_value("debug", "31");
+    sParameters->set_value("cached_data", "shared");
+    sParameters->set_value("soft_ttl", SOFT_TTL);
+    sParameters->set_value("hard_ttl", "60");
+    sParameters->set_value("background_refresh", "true");
+
+    auto_ptr<FilterModule::Instance> sInstance = filter_module.createInstance("test", sParameters);
+
+    if (sInstance.get())
+    {
+        Listener listener;
+
+        if (listener.port() != 0)
+        {
+            mxb::Worker worker;
+            BackgroundRefreshTest test(worker, *sInstance, listener);
+
+            if (test.ok())
+            {
+                worker.execute([&test]() {
+                                   test.start();
+                               }, mxb::Worker::EXECUTE_QUEUED);
+                worker.run();
+
+                rv = test.rv();
+            }
+        }
+        else
+        {
+            cerr << "error: Could not create listening socket." << endl;
+        }
+    }
+
+    return rv;
+}
+
+int run()
+{
+    int rv = 1;
+
+    auto_ptr<FilterModule> sModule = FilterModule::load("cache");
+
+    if (sModule.get())
+    {
+        if (maxscale::Module::process_init())
+        {
+            if (maxscale::Module::thread_init())
+            {
+                rv = test(*sModule.get());
+
+                maxscale::Module::thread_finish();
+            }
+            else
+            {
+                cerr << "error: Could not perform thread initialization." << endl;
+            }
+
+            maxscale::Module::process_finish();
+        }
+        else
+        {
+            cerr << "error: Could not perform process initialization." << endl;
+        }
+    }
+    else
+    {
+        cerr << "error: Could not load filter module." << endl;
+    }
+
+    return rv;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int rv = 1;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        if (maxbase::init())
+        {
+            // The listener may close connections the sessions still write to.
+            signal(SIGPIPE, SIG_IGN);
+
+            if (qc_setup(NULL, QC_SQL_MODE_DEFAULT, "qc_sqlite", NULL))
+            {
+                if (qc_process_init(QC_INIT_SELF))
+                {
+                    rv = run();
+
+                    cout << rv << " failures." << endl;
+
+                    qc_process_end(QC_INIT_SELF);
+                }
+                else
+                {
+                    cerr << "error: Could not initialize query classifier." << endl;
+                }
+            }
+            else
+            {
+                cerr << "error: Could not setup query classifier." << endl;
+            }
+
+            maxbase::finish();
+        }
+        else
+        {
+            cerr << "error: Could not initialize maxbase." << endl;
+        }
+
+        mxs_log_finish();
+    }
+
+    return rv;
+}
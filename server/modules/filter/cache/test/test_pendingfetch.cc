@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <iostream>
+#include <memory>
+#include <maxbase/maxbase.hh>
+#include <maxbase/worker.hh>
+#include <maxscale/filtermodule.hh>
+#include <maxscale/mock/backend.hh>
+#include <maxscale/mock/client.hh>
+#include <maxscale/mock/routersession.hh>
+#include <maxscale/mock/session.hh>
+#include "../cachefilter.h"
+
+using namespace std;
+using maxscale::FilterModule;
+namespace mock = maxscale::mock;
+
+namespace
+{
+
+// How long, in milliseconds, a session waits for data fetched by another session.
+const char COALESCE_TIMEOUT[] = "100";
+const int32_t TIMEOUT_CHECK_DELAY = 300;
+
+struct Connection
+{
+    Connection(FilterModule::Instance& filter_instance)
+        : router_session(&backend)
+        , client("bob", "127.0.0.1")
+        , session(&client)
+        , sFilter_session(filter_instance.newSession(&session))
+    {
+        if (sFilter_session.get())
+        {
+            router_session.set_as_downstream_on(sFilter_session.get());
+            client.set_as_upstream_on(*sFilter_session.get());
+        }
+    }
+
+    void route(const char* zSelect)
+    {
+        session.route_query(mock::create_com_query(zSelect));
+    }
+
+    mock::ResultSetBackend           backend;
+    mock::RouterSession              router_session;
+    mock::Client                     client;
+    mock::Session                    session;
+    auto_ptr<FilterModule::Session> sFilter_session;
+};
+
+/**
+ * Sessions missing the same key wait for the session fetching the data. As
+ * the notification of the fetch having ended is delivered via the worker,
+ * each step posts the next one, which is executed only after everything
+ * posted during the step.
+ */
+class PendingFetchTest
+{
+public:
+    PendingFetchTest(mxb::Worker& worker, FilterModule::Instance& filter_instance)
+        : m_worker(worker)
+        , m_a(filter_instance)
+        , m_b(filter_instance)
+        , m_c(filter_instance)
+        , m_rv(0)
+    {
+    }
+
+    bool ok() const
+    {
+        return m_a.sFilter_session.get() && m_b.sFilter_session.get() && m_c.sFilter_session.get();
+    }
+
+    int rv() const
+    {
+        return m_rv;
+    }
+
+    void start()
+    {
+        cout << "Waiting session gets the data fetched by another session." << endl;
+
+        m_a.route("SELECT a FROM fetched");
+        expect(!m_a.router_session.idle(), "The first session should reach the backend.");
+
+        m_b.route("SELECT a FROM fetched");
+        expect(m_b.router_session.idle(), "The second session should wait.");
+        expect(m_b.client.n_responses() == 0, "The second session should not have a response.");
+
+        m_a.router_session.respond();
+        expect(m_a.client.n_responses() == 1, "The first session should have a response.");
+
+        next(&PendingFetchTest::fetched);
+    }
+
+private:
+    void fetched()
+    {
+        expect(m_b.client.n_responses() == 1,
+               "The second session should have been woken up with the data.");
+        expect(m_b.router_session.idle(), "The second session should not reach the backend.");
+
+        cout << "Waiting session times out and fetches the data itself." << endl;
+
+        m_a.route("SELECT a FROM timeout");
+        expect(!m_a.router_session.idle(), "The first session should reach the backend.");
+
+        m_b.route("SELECT a FROM timeout");
+        expect(m_b.router_session.idle(), "The second session should wait.");
+
+        m_worker.delayed_call(TIMEOUT_CHECK_DELAY, &PendingFetchTest::timed_out, this);
+    }
+
+    bool timed_out(mxb::Worker::Call::action_t action)
+    {
+        if (action == mxb::Worker::Call::EXECUTE)
+        {
+            expect(!m_b.router_session.idle(), "The second session should reach the backend.");
+            m_b.router_session.respond();
+            m_a.router_session.respond();
+            expect(m_a.client.n_responses() == 2 && m_b.client.n_responses() == 2,
+                   "Both sessions should have a response.");
+
+            cout << "Statement sent by a waiting session does not discard the waiting response." << endl;
+
+            m_a.route("SELECT a FROM pipelined");
+            m_b.route("SELECT a FROM pipelined");
+            expect(m_b.router_session.idle(), "The second session should wait.");
+
+            m_b.route("SELECT b FROM other");
+            m_b.router_session.respond();
+            m_b.router_session.respond();
+            expect(m_b.client.n_responses() == 4, "The second session should have both responses.");
+
+            m_c.route("SELECT a FROM pipelined");
+            expect(m_c.router_session.idle() && m_c.client.n_responses() == 1,
+                   "The response to the waiting statement should have been cached.");
+
+            m_a.router_session.respond();
+
+            next(&PendingFetchTest::end);
+        }
+
+        return false;
+    }
+
+    void end()
+    {
+        m_worker.shutdown();
+    }
+
+    void next(void (PendingFetchTest::* pStep)())
+    {
+        m_worker.execute([this, pStep]() {
+                             (this->*pStep)();
+                         }, mxb::Worker::EXECUTE_QUEUED);
+    }
+
+    void expect(bool condition, const char* zMessage)
+    {
+        if (!condition)
+        {
+            cout << "ERROR: " << zMessage << endl;
+            ++m_rv;
+        }
+    }
+
+    mxb::Worker& m_worker;
+    Connection   m_a;
+    Connection   m_b;
+    Connection   m_c;
+    int          m_rv;
+};
+
+int test(FilterModule& filter_module)
+{
+    int rv = 1;
+
+    auto_ptr<FilterModule::ConfigParameters> sParameters = filter_module.create_default_parameters();
+    sParameters->set_value("debug", "31");
+    sParameters->set_value("cached_data", "shared");
+    sParameters->set_value("coalesce_timeout", COALESCE_TIMEOUT);
+
+    auto_ptr<FilterModule::Instance> sInstance = filter_module.createInstance("test", sParameters);
+
+    if (sInstance.get())
+    {
+        mxb::Worker worker;
+        PendingFetchTest test(worker, *sInstance);
+
+        if (test.ok())
+        {
+            worker.execute([&test]() {
+                               test.start();
+                           }, mxb::Worker::EXECUTE_QUEUED);
+            worker.run();
+
+            rv = test.rv();
+        }
+    }
+
+    return rv;
+}
+
+int run()
+{
+    int rv = 1;
+
+    auto_ptr<FilterModule> sModule = FilterModule::load("cache");
+
+    if (sModule.get())
+    {
+        if (maxscale::Module::process_init())
+        {
+            if (maxscale::Module::thread_init())
+            {
+                rv = test(*sModule.get());
+
+                maxscale::Module::thread_finish();
+            }
+            else
+            {
+                cerr << "error: Could not perform thread initialization." << endl;
+            }
+
+            maxscale::Module::process_finish();
+        }
+        else
+        {
+            cerr << "error: Could not perform process initialization." << endl;
+        }
+    }
+    else
+    {
+        cerr << "error: Could not load filter module." << endl;
+    }
+
+    return rv;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int rv = 1;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        if (maxbase::init())
+        {
+            if (qc_setup(NULL, QC_SQL_MODE_DEFAULT, "qc_sqlite", NULL))
+            {
+                if (qc_process_init(QC_INIT_SELF))
+                {
+                    rv = run();
+
+                    cout << rv << " failures." << endl;
+
+                    qc_process_end(QC_INIT_SELF);
+                }
+                else
+                {
+                    cerr << "error: Could not initialize query classifier." << endl;
+                }
+            }
+            else
+            {
+                cerr << "error: Could not setup query classifier." << endl;
+            }
+
+            maxbase::finish();
+        }
+        else
+        {
+            cerr << "error: Could not initialize maxbase." << endl;
+        }
+
+        mxs_log_finish();
+    }
+
+    return rv;
+}
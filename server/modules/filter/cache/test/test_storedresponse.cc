@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <maxscale/filtermodule.hh>
+#include <maxscale/mock/backend.hh>
+#include <maxscale/mock/client.hh>
+#include <maxscale/mock/routersession.hh>
+#include <maxscale/mock/session.hh>
+#include "../cachefilter.h"
+
+using namespace std;
+using maxscale::FilterModule;
+namespace mock = maxscale::mock;
+
+namespace
+{
+
+/**
+ * Records the responses and then overwrites the data, like a filter or
+ * protocol upstream modifying the buffer it was given could do.
+ */
+class ScribblingHandler : public mock::Client::Handler
+{
+public:
+    int32_t backend_reply(GWBUF* pResponse)
+    {
+        return handle(pResponse);
+    }
+
+    int32_t maxscale_reply(GWBUF* pResponse)
+    {
+        return handle(pResponse);
+    }
+
+    const vector<uint8_t>& last_response() const
+    {
+        return m_last_response;
+    }
+
+private:
+    int32_t handle(GWBUF* pResponse)
+    {
+        m_last_response.resize(gwbuf_length(pResponse));
+        gwbuf_copy_data(pResponse, 0, m_last_response.size(), m_last_response.data());
+
+        for (GWBUF* pBuf = pResponse; pBuf; pBuf = pBuf->next)
+        {
+            memset(GWBUF_DATA(pBuf), 'x', GWBUF_LENGTH(pBuf));
+        }
+
+        gwbuf_free(pResponse);
+        return 1;
+    }
+
+    vector<uint8_t> m_last_response;
+};
+
+int test(FilterModule::Instance& filter_instance)
+{
+    int rv = 0;
+
+    mock::ResultSetBackend backend;
+    mock::RouterSession router_session(&backend);
+
+    ScribblingHandler handler;
+    mock::Client client("bob", "127.0.0.1", &handler);
+    mock::Session session(&client);
+
+    auto_ptr<FilterModule::Session> sFilter_session = filter_instance.newSession(&session);
+
+    if (sFilter_session.get())
+    {
+        router_session.set_as_downstream_on(sFilter_session.get());
+        client.set_as_upstream_on(*sFilter_session.get());
+
+        const char SELECT[] = "SELECT a FROM tbl";
+
+        cout << "Performing select: \"" << SELECT << "\"" << endl;
+        session.route_query(mock::create_com_query(SELECT));
+
+        if (!router_session.idle())
+        {
+            router_session.respond();
+            vector<uint8_t> response = handler.last_response();
+
+            cout << "Performing same select: \"" << SELECT << "\"" << flush;
+            session.route_query(mock::create_com_query(SELECT));
+
+            if (router_session.idle())
+            {
+                cout << ", cache was used." << endl;
+
+                if (handler.last_response() != response)
+                {
+                    cout << "ERROR: The stored response was modified via the forwarded buffer." << endl;
+                    ++rv;
+                }
+            }
+            else
+            {
+                cout << "\nERROR: cache was not used." << endl;
+                router_session.respond();
+                ++rv;
+            }
+        }
+        else
+        {
+            cout << "ERROR: Did not reach backend." << endl;
+            ++rv;
+        }
+    }
+    else
+    {
+        ++rv;
+    }
+
+    return rv;
+}
+
+int test(FilterModule& filter_module)
+{
+    int rv = 1;
+
+    auto_ptr<FilterModule::ConfigParameters> sParameters = filter_module.create_default_parameters();
+    sParameters->set_value("debug", "31");
+    sParameters->set_value("cached_data", "shared");
+
+    auto_ptr<FilterModule::Instance> sInstance = filter_module.createInstance("test", sParameters);
+
+    if (sInstance.get())
+    {
+        rv = test(*sInstance);
+    }
+
+    return rv;
+}
+
+int run()
+{
+    int rv = 1;
+
+    auto_ptr<FilterModule> sModule = FilterModule::load("cache");
+
+    if (sModule.get())
+    {
+        if (maxscale::Module::process_init())
+        {
+            if (maxscale::Module::thread_init())
+            {
+                rv = test(*sModule.get());
+
+                maxscale::Module::thread_finish();
+            }
+            else
+            {
+                cerr << "error: Could not perform thread initialization." << endl;
+            }
+
+            maxscale::Module::process_finish();
+        }
+        else
+        {
+            cerr << "error: Could not perform process initialization." << endl;
+        }
+    }
+    else
+    {
+        cerr << "error: Could not load filter module." << endl;
+    }
+
+    return rv;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int rv = 1;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        if (qc_setup(NULL, QC_SQL_MODE_DEFAULT, "qc_sqlite", NULL))
+        {
+            if (qc_process_init(QC_INIT_SELF))
+            {
+                rv = run();
+
+                cout << rv << " failures." << endl;
+
+                qc_process_end(QC_INIT_SELF);
+            }
+            else
+            {
+                cerr << "error: Could not initialize query classifier." << endl;
+            }
+        }
+        else
+        {
+            cerr << "error: Could not setup query classifier." << endl;
+        }
+
+        mxs_log_finish();
+    }
+
+    return rv;
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/ccdefs.hh>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <maxscale/alloc.h>
+#include <maxscale/log.h>
+#include <maxscale/paths.h>
+#include "cachest.hh"
+#include "storagefactory.hh"
+
+using namespace std;
+
+namespace
+{
+
+const size_t THRESHOLD = 1024;
+
+#define EXPECT(condition, message) \
+    do { if (!(condition)) { cerr << "error: " << message << endl; ++rv; } } while (false)
+
+CACHE_KEY create_key(uint64_t data)
+{
+    CACHE_KEY key;
+    key.data = data;
+    return key;
+}
+
+string create_incompressible(size_t size)
+{
+    string content(size, 0);
+    uint32_t x = 4711;
+
+    for (size_t i = 0; i < size; ++i)
+    {
+        x = x * 1103515245 + 12345;
+        content[i] = x >> 24;
+    }
+
+    return content;
+}
+
+/**
+ * The length and the first byte of a value, as stored.
+ */
+struct Stored
+{
+    size_t  len = 0;
+    uint8_t codec = 0xff;
+};
+
+Stored get_stored(Cache& cache, uint64_t key)
+{
+    Stored stored;
+
+    cache.visit_values([key, &stored](const CACHE_KEY& k, const uint8_t* pData, size_t len, uint32_t) {
+                           if (k.data == key)
+                           {
+                               stored.len = len;
+                               stored.codec = len != 0 ? pData[0] : 0xff;
+                           }
+                           return true;
+                       });
+
+    return stored;
+}
+
+bool round_trip(Cache& cache, uint64_t key, const string& content)
+{
+    GWBUF* pValue = gwbuf_alloc_and_load(content.length(), content.data());
+    cache_result_t result = cache.put_value(create_key(key), pValue);
+
+    bool rv = CACHE_RESULT_IS_OK(result)
+        && string(reinterpret_cast<const char*>(GWBUF_DATA(pValue)), GWBUF_LENGTH(pValue)) == content;
+    gwbuf_free(pValue);
+
+    if (rv)
+    {
+        pValue = NULL;
+        result = cache.get_value(create_key(key), 0, 0, 0, &pValue);
+
+        rv = CACHE_RESULT_IS_OK(result) && pValue && (gwbuf_length(pValue) == content.length());
+
+        if (rv)
+        {
+            string s(content.length(), 0);
+            gwbuf_copy_data(pValue, 0, s.length(), reinterpret_cast<uint8_t*>(&s[0]));
+            rv = (s == content);
+        }
+
+        gwbuf_free(pValue);
+    }
+
+    return rv;
+}
+
+uint64_t get_stat(Cache& cache, const char* zName)
+{
+    json_t* pInfo = cache.get_info(Cache::INFO_COMPRESSION);
+    json_t* pCompression = json_object_get(pInfo, "compression");
+    uint64_t value = json_integer_value(json_object_get(pCompression, zName));
+    json_decref(pInfo);
+
+    return value;
+}
+
+int test_round_trip(Cache& cache)
+{
+    int rv = 0;
+
+    string small(THRESHOLD - 1, 'a');
+    EXPECT(round_trip(cache, 1, small), "A value below the threshold should be restored as such.");
+
+    Stored stored = get_stored(cache, 1);
+    EXPECT(stored.len == small.length() + 1 && stored.codec == 0,
+           "A value below the threshold should be stored unchanged after a flag, not with "
+           << stored.len << " bytes.");
+
+    string compressible(10 * THRESHOLD, 'b');
+    EXPECT(round_trip(cache, 2, compressible), "A compressed value should be restored as such.");
+
+    stored = get_stored(cache, 2);
+    EXPECT(stored.len < compressible.length() / 10 && stored.codec == 1,
+           "A compressible value should be stored compressed, not with " << stored.len << " bytes.");
+
+    string incompressible = create_incompressible(THRESHOLD);
+    EXPECT(round_trip(cache, 3, incompressible), "An incompressible value should be restored as such.");
+
+    stored = get_stored(cache, 3);
+    EXPECT(stored.len == incompressible.length() + 1 && stored.codec == 0,
+           "A value that does not compress should be stored unchanged after a flag.");
+
+    EXPECT(get_stat(cache, "compressed") == 1, "One value should have been compressed.");
+    EXPECT(get_stat(cache, "uncompressed") == 2, "Two values should have been stored uncompressed.");
+
+    return rv;
+}
+
+int test_broken(Cache& cache)
+{
+    int rv = 0;
+
+    // A compressed value claiming to be longer than what the data decompresses to.
+    uint8_t broken[] = {1, 0xff, 0, 0, 0, 'x', 'y', 'z'};
+    GWBUF* pValue = gwbuf_alloc_and_load(sizeof(broken), broken);
+    cache.restore_value(create_key(10), pValue, time(NULL));
+    gwbuf_free(pValue);
+
+    pValue = NULL;
+    cache_result_t result = cache.get_value(create_key(10), 0, 0, 0, &pValue);
+    EXPECT(CACHE_RESULT_IS_NOT_FOUND(result) && !pValue, "A broken compressed value should be ignored.");
+
+    // Nothing but the flag.
+    uint8_t empty[] = {0};
+    pValue = gwbuf_alloc_and_load(sizeof(empty), empty);
+    cache.restore_value(create_key(11), pValue, time(NULL));
+    gwbuf_free(pValue);
+
+    pValue = NULL;
+    result = cache.get_value(create_key(11), 0, 0, 0, &pValue);
+    EXPECT(CACHE_RESULT_IS_NOT_FOUND(result) && !pValue, "A value with only a flag should be ignored.");
+
+    return rv;
+}
+
+int test(StorageFactory* pFactory)
+{
+    int rv = 1;
+
+    CACHE_CONFIG config;
+    memset(&config, 0, sizeof(config));
+    config.thread_model = CACHE_THREAD_MODEL_ST;
+    config.selects = CACHE_SELECTS_ASSUME_CACHEABLE;
+    config.compression = CACHE_COMPRESSION_ZLIB;
+    config.compression_threshold = THRESHOLD;
+
+    unique_ptr<Cache> sCache(CacheST::Create("test", std::vector<Cache::SCacheRules>(),
+                                             Cache::SStorageFactory(pFactory), &config));
+
+    if (sCache)
+    {
+        rv = test_round_trip(*sCache);
+        rv += test_broken(*sCache);
+    }
+    else
+    {
+        cerr << "error: Could not create cache." << endl;
+    }
+
+    return rv;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int rv = EXIT_FAILURE;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        char* libdir = MXS_STRDUP("../storage/storage_inmemory/");
+        set_libdir(libdir);
+
+        StorageFactory* pFactory = StorageFactory::Open("storage_inmemory");
+
+        if (pFactory)
+        {
+            rv = test(pFactory) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else
+        {
+            cerr << "error: Could not initialize factory." << endl;
+        }
+
+        mxs_log_finish();
+    }
+    else
+    {
+        cerr << "error: Could not initialize log." << endl;
+    }
+
+    return rv;
+}
@@ -41,8 +41,12 @@ int TesterLRUStorage::execute(size_t n_threads, size_t n_seconds, const CacheIte
     int rv4 = test_max_size(n_threads, n_seconds, cache_items, size);
     out() << endl;
     int rv5 = test_max_count_and_size(n_threads, n_seconds, cache_items, size);
+    out() << endl;
+    int rv6 = test_sharded(n_threads, n_seconds, cache_items, size);
+    out() << endl;
+    int rv7 = test_admission(cache_items);
 
-    return combine_rvs(rv1, rv2, rv3, rv4, rv5);
+    return combine_rvs(rv1, rv2, combine_rvs(rv3, rv4, rv5, rv6, rv7));
 }
 
 Storage* TesterLRUStorage::get_storage(const CACHE_STORAGE_CONFIG& config) const
@@ -275,3 +279,170 @@ int TesterLRUStorage::test_max_count_and_size(size_t n_threads,
 
     return rv;
 }
+
+int TesterLRUStorage::test_sharded(size_t n_threads,
+                                   size_t n_seconds,
+                                   const CacheItems& cache_items,
+                                   uint64_t size)
+{
+    int rv = EXIT_FAILURE;
+
+    Storage* pStorage;
+
+    size_t n_shards = 4;
+    size_t max_count = cache_items.size() / 4;
+    size_t max_size = size / 10;
+
+    out() << "Sharded LRU shards   : " << n_shards << "\n" << endl;
+    out() << "Sharded LRU max-count: " << max_count << "\n" << endl;
+    out() << "Sharded LRU max-size : " << max_size << "\n" << endl;
+
+    CacheStorageConfig config(CACHE_THREAD_MODEL_MT);
+    config.max_count = max_count;
+    config.max_size = max_size;
+
+    pStorage = m_factory.createShardedStorage("unspecified", config, n_shards);
+
+    if (pStorage)
+    {
+        rv = execute_tasks(n_threads, n_seconds, cache_items, *pStorage);
+
+        MXB_AT_DEBUG(cache_result_t result);
+        uint64_t items;
+        MXB_AT_DEBUG(result = ) pStorage->get_items(&items);
+        mxb_assert(result == CACHE_RESULT_OK);
+
+        out() << "Max count: " << max_count << ", count: " << items << "." << endl;
+
+        if (items > max_count)
+        {
+            rv = EXIT_FAILURE;
+        }
+
+        uint64_t size;
+        MXB_AT_DEBUG(result = ) pStorage->get_size(&size);
+        mxb_assert(result == CACHE_RESULT_OK);
+
+        out() << "Max size: " << max_size << ", size: " << size << "." << endl;
+
+        if (size > max_size)
+        {
+            rv = EXIT_FAILURE;
+        }
+
+        delete pStorage;
+    }
+
+    return rv;
+}
+
+int TesterLRUStorage::test_admission(const CacheItems& cache_items)
+{
+    int rv = EXIT_FAILURE;
+
+    size_t max_count = cache_items.size() > 10 ? 10 : cache_items.size() - 2;
+
+    out() << "LRU admission max-count: " << max_count << "\n" << endl;
+
+    CacheStorageConfig config(CACHE_THREAD_MODEL_MT);
+    config.max_count = max_count;
+    config.admission = CACHE_ADMISSION_FREQUENCY;
+
+    Storage* pStorage = get_storage(config);
+
+    if (pStorage)
+    {
+        rv = EXIT_SUCCESS;
+
+        cache_result_t result;
+        GWBUF* pValue;
+
+        // Fill the cache and make each item somewhat popular.
+        for (size_t i = 0; i < max_count; ++i)
+        {
+            const CacheItems::value_type& cache_item = cache_items[i];
+
+            result = pStorage->put_value(cache_item.first, cache_item.second);
+
+            if (result != CACHE_RESULT_OK)
+            {
+                out() << "Could not put a value to a cache that is not full." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            for (size_t j = 0; j < 3; ++j)
+            {
+                result = pStorage->get_value(cache_item.first, 0, &pValue);
+
+                if (CACHE_RESULT_IS_OK(result))
+                {
+                    gwbuf_free(pValue);
+                }
+                else
+                {
+                    out() << "Could not get a value that was put." << endl;
+                    rv = EXIT_FAILURE;
+                }
+            }
+        }
+
+        // An item that has not been asked for should not evict a popular one.
+        const CacheItems::value_type& one_off = cache_items[max_count];
+
+        result = pStorage->put_value(one_off.first, one_off.second);
+
+        if (result != (CACHE_RESULT_OK | CACHE_RESULT_DISCARDED))
+        {
+            out() << "An infrequent item was admitted to a full cache." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        result = pStorage->get_value(cache_items[0].first, 0, &pValue);
+
+        if (CACHE_RESULT_IS_OK(result))
+        {
+            gwbuf_free(pValue);
+        }
+        else
+        {
+            out() << "A popular item was evicted by an infrequent one." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        // An item that has been asked for more often than the tail should be admitted.
+        const CacheItems::value_type& popular = cache_items[max_count + 1];
+
+        for (size_t j = 0; j < 10; ++j)
+        {
+            result = pStorage->get_value(popular.first, 0, &pValue);
+
+            if (CACHE_RESULT_IS_OK(result))
+            {
+                gwbuf_free(pValue);
+            }
+        }
+
+        result = pStorage->put_value(popular.first, popular.second);
+
+        if (result != CACHE_RESULT_OK)
+        {
+            out() << "A frequent item was not admitted to a full cache." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        uint64_t items;
+        MXB_AT_DEBUG(result = ) pStorage->get_items(&items);
+        mxb_assert(result == CACHE_RESULT_OK);
+
+        out() << "Max count: " << max_count << ", count: " << items << "." << endl;
+
+        if (items > max_count)
+        {
+            rv = EXIT_FAILURE;
+        }
+
+        delete pStorage;
+    }
+
+    return rv;
+}
@@ -52,6 +52,11 @@ private:
                                 size_t n_seconds,
                                 const CacheItems& cache_items,
                                 uint64_t size);
+    int test_sharded(size_t n_threads,
+                     size_t n_seconds,
+                     const CacheItems& cache_items,
+                     uint64_t size);
+    int test_admission(const CacheItems& cache_items);
 
 private:
     TesterLRUStorage(const TesterLRUStorage&);
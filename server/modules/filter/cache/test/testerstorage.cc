@@ -266,7 +266,10 @@ TesterStorage::storage_action_t TesterStorage::get_random_action()
 // static
 int TesterStorage::test_smoke(const CacheItems& cache_items)
 {
-    return test_ttl(cache_items);
+    int rv1 = test_ttl(cache_items);
+    int rv2 = test_restore(cache_items);
+
+    return combine_rvs(rv1, rv2);
 }
 
 int TesterStorage::test_ttl(const CacheItems& cache_items)
@@ -419,3 +422,118 @@ int TesterStorage::test_ttl(const CacheItems& cache_items, Storage& storage)
 
     return rv;
 }
+
+namespace
+{
+
+struct VisitedValue
+{
+    CACHE_KEY       key;
+    vector<uint8_t> data;
+    uint32_t        time;
+};
+
+bool collect_value(void* pContext, const CACHE_KEY* pKey, const uint8_t* pData, size_t len, uint32_t time)
+{
+    vector<VisitedValue>* pValues = static_cast<vector<VisitedValue>*>(pContext);
+
+    pValues->push_back(VisitedValue {*pKey, vector<uint8_t>(pData, pData + len), time});
+
+    return true;
+}
+}
+
+int TesterStorage::test_restore(const CacheItems& cache_items)
+{
+    int rv = EXIT_FAILURE;
+
+    out() << "Testing visit and restore." << endl;
+
+    CacheStorageConfig config(CACHE_THREAD_MODEL_ST);
+    config.hard_ttl = 60;
+
+    Storage* pFrom = get_storage(config);
+    Storage* pTo = get_storage(config);
+
+    if (pFrom && pTo)
+    {
+        rv = EXIT_SUCCESS;
+
+        for (const auto& item : cache_items)
+        {
+            pFrom->put_value(item.first, item.second);
+        }
+
+        vector<VisitedValue> values;
+        pFrom->visit_values(collect_value, &values);
+
+        if (values.size() != cache_items.size())
+        {
+            out() << "Expected " << cache_items.size() << " values to be visited, "
+                  << "but " << values.size() << " were." << endl;
+            rv = EXIT_FAILURE;
+        }
+
+        uint32_t now = time(NULL);
+
+        for (const auto& value : values)
+        {
+            // Every other value is restored as if it had been stored before the
+            // hard TTL, so it should not be found.
+            bool expired = ((value.key.data % 2) == 0);
+            uint32_t stored = expired ? now - config.hard_ttl - 1 : value.time;
+
+            GWBUF* pValue = gwbuf_alloc_and_load(value.data.size(), value.data.data());
+            pTo->restore_value(value.key, pValue, stored);
+            gwbuf_free(pValue);
+
+            pValue = NULL;
+            cache_result_t result = pTo->get_value(value.key, 0, &pValue);
+
+            if (expired && CACHE_RESULT_IS_OK(result))
+            {
+                out() << "Expected a value restored after its hard TTL not to be found." << endl;
+                rv = EXIT_FAILURE;
+            }
+            else if (!expired
+                     && (!CACHE_RESULT_IS_OK(result)
+                         || (gwbuf_length(pValue) != value.data.size())
+                         || !equal(value.data.begin(), value.data.end(), GWBUF_DATA(pValue))))
+            {
+                out() << "Expected a restored value to be found as it was." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            gwbuf_free(pValue);
+        }
+
+        if (!cache_items.empty())
+        {
+            // An existing value must not be replaced by a restored one.
+            const CacheItems::value_type& first = cache_items.front();
+            const CacheItems::value_type& last = cache_items.back();
+
+            pTo->put_value(first.first, first.second);
+
+            cache_result_t result = pTo->restore_value(first.first, last.second, now);
+
+            GWBUF* pValue = NULL;
+            pTo->get_value(first.first, 0, &pValue);
+
+            if (!CACHE_RESULT_IS_DISCARDED(result)
+                || !pValue
+                || (gwbuf_compare(pValue, first.second) != 0))
+            {
+                out() << "Expected an existing value not to be replaced when restoring." << endl;
+                rv = EXIT_FAILURE;
+            }
+
+            gwbuf_free(pValue);
+        }
+    }
+
+    delete pTo;
+    delete pFrom;
+
+    return rv;
+}
@@ -169,6 +169,8 @@ public:
     int test_ttl(const CacheItems& cache_items);
     int test_ttl(const CacheItems& cache_items, Storage& storage);
 
+    int test_restore(const CacheItems& cache_items);
+
 protected:
     /**
      * Constructor
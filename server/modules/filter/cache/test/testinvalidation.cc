@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/ccdefs.hh>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <maxscale/alloc.h>
+#include <maxscale/log.h>
+#include <maxscale/paths.h>
+#include "cachest.hh"
+#include "storagefactory.hh"
+
+using namespace std;
+
+namespace
+{
+
+const string VALUE("the value");
+
+GWBUF* create_value()
+{
+    return gwbuf_alloc_and_load(VALUE.length(), VALUE.data());
+}
+
+/**
+ * Wraps a value and checks whether it is still valid when unwrapped.
+ */
+bool is_valid(Cache& cache, const Cache::Tables& tables, uint64_t epoch)
+{
+    GWBUF* pValue = create_value();
+    GWBUF* pWrapped = Cache::wrap_value(pValue, tables, epoch);
+    gwbuf_free(pValue);
+    mxb_assert(pWrapped);
+
+    bool valid = cache.unwrap_value(&pWrapped);
+
+    if (valid)
+    {
+        string s(reinterpret_cast<const char*>(GWBUF_DATA(pWrapped)), GWBUF_LENGTH(pWrapped));
+
+        if (s != VALUE)
+        {
+            cerr << "error: Unwrapped value '" << s << "' differs from the original one." << endl;
+            valid = false;
+        }
+
+        gwbuf_free(pWrapped);
+    }
+
+    return valid;
+}
+
+size_t n_tables(Cache& cache)
+{
+    json_t* pInfo = cache.get_info(Cache::INFO_INVALIDATION);
+    json_t* pInvalidation = json_object_get(pInfo, "invalidation");
+    size_t n = json_integer_value(json_object_get(pInvalidation, "tables"));
+    json_decref(pInfo);
+
+    return n;
+}
+
+#define EXPECT(condition, message) \
+    do { if (!(condition)) { cerr << "error: " << message << endl; ++rv; } } while (false)
+
+int test_wrapping(Cache& cache)
+{
+    int rv = 0;
+
+    // Longer than what fits in one byte.
+    string long_name = "db." + string(300, 'x');
+    Cache::Tables tables {"db.t1", long_name};
+
+    uint64_t epoch = cache.epoch();
+    EXPECT(is_valid(cache, tables, epoch), "A value with no invalidated tables should be valid.");
+    EXPECT(is_valid(cache, Cache::Tables(), epoch), "A value with no tables should be valid.");
+
+    cache.invalidate({"db.t2"});
+    EXPECT(is_valid(cache, tables, epoch), "An unrelated invalidation should not affect the value.");
+
+    cache.invalidate({long_name});
+    EXPECT(!is_valid(cache, tables, epoch), "Invalidating a long table name should invalidate the value.");
+    EXPECT(is_valid(cache, tables, cache.epoch()), "A value requested after the invalidation is valid.");
+
+    epoch = cache.epoch();
+    cache.invalidate({"db.t1"});
+    EXPECT(!is_valid(cache, tables, epoch), "Invalidating a table should invalidate the value.");
+    EXPECT(is_valid(cache, {"db.t3"}, epoch), "A value of another table should be valid.");
+
+    cache.invalidate(Cache::Tables());
+    epoch = cache.epoch();
+    EXPECT(is_valid(cache, tables, epoch), "A value requested after invalidating everything is valid.");
+    cache.invalidate({"db.t1"});
+    EXPECT(!is_valid(cache, tables, epoch),
+           "Invalidating a table after everything should invalidate the value.");
+
+    cache.raise_epoch(epoch);
+    EXPECT(cache.epoch() > epoch, "Raising the epoch to an older one should not lower it.");
+    cache.raise_epoch(epoch + 100);
+    EXPECT(cache.epoch() == epoch + 100, "Raising the epoch should set it.");
+    cache.invalidate({"db.t1"});
+    EXPECT(!is_valid(cache, tables, epoch + 100),
+           "An invalidation after raising the epoch should invalidate a value of that epoch.");
+
+    GWBUF* pValue = create_value();
+    Cache::Tables too_long {string(UINT16_MAX + 1, 'x')};
+    EXPECT(!Cache::wrap_value(pValue, too_long, epoch), "Too long names should not be wrapped.");
+    gwbuf_free(pValue);
+
+    return rv;
+}
+
+int test_pruning(Cache& cache)
+{
+    int rv = 0;
+
+    cache.invalidate(Cache::Tables());
+    EXPECT(n_tables(cache) == 0, "Invalidating everything should forget the tables.");
+
+    uint64_t old_epoch = cache.epoch();
+
+    for (size_t i = 0; i <= Cache::MAX_TABLE_EPOCHS; ++i)
+    {
+        cache.invalidate({"db.t" + to_string(i)});
+    }
+
+    size_t n = n_tables(cache);
+    EXPECT(n > 0 && n <= Cache::MAX_TABLE_EPOCHS,
+           "The number of tracked tables, " << n << ", should not exceed the maximum.");
+
+    string newest = "db.t" + to_string(Cache::MAX_TABLE_EPOCHS);
+    EXPECT(!is_valid(cache, {"db.other"}, old_epoch),
+           "A value older than the pruned tables should be considered invalid.");
+    EXPECT(!is_valid(cache, {newest}, cache.epoch() - 1),
+           "A value older than a tracked invalidation should be invalid.");
+    EXPECT(is_valid(cache, {"db.t0"}, cache.epoch()),
+           "A value newer than the pruned tables should be valid.");
+    EXPECT(is_valid(cache, {newest}, cache.epoch()),
+           "A value newer than the last invalidation should be valid.");
+
+    return rv;
+}
+
+int test(StorageFactory* pFactory)
+{
+    int rv = 1;
+
+    CACHE_CONFIG config;
+    memset(&config, 0, sizeof(config));
+    config.thread_model = CACHE_THREAD_MODEL_ST;
+    config.selects = CACHE_SELECTS_ASSUME_CACHEABLE;
+    config.invalidate = CACHE_INVALIDATE_CURRENT;
+
+    unique_ptr<Cache> sCache(CacheST::Create("test", std::vector<Cache::SCacheRules>(),
+                                             Cache::SStorageFactory(pFactory), &config));
+
+    if (sCache)
+    {
+        rv = test_wrapping(*sCache);
+        rv += test_pruning(*sCache);
+    }
+    else
+    {
+        cerr << "error: Could not create cache." << endl;
+    }
+
+    return rv;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int rv = EXIT_FAILURE;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        char* libdir = MXS_STRDUP("../storage/storage_inmemory/");
+        set_libdir(libdir);
+
+        StorageFactory* pFactory = StorageFactory::Open("storage_inmemory");
+
+        if (pFactory)
+        {
+            rv = test(pFactory) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+        else
+        {
+            cerr << "error: Could not initialize factory." << endl;
+        }
+
+        mxs_log_finish();
+    }
+    else
+    {
+        cerr << "error: Could not initialize log." << endl;
+    }
+
+    return rv;
+}
@@ -82,6 +82,27 @@ int test(StorageFactory& factory, istream& in)
                         ++n_keys;
                         keys.insert(make_pair(key, statement));
                     }
+
+                    // The same statement executed as a prepared statement must result
+                    // in a different key, and so must different parameters.
+                    const uint8_t params1[] = {1};
+                    const uint8_t params2[] = {2};
+                    CACHE_KEY key1;
+                    CACHE_KEY key2;
+
+                    if ((Cache::get_default_key(NULL, pQuery, params1, sizeof(params1), &key1)
+                         != CACHE_RESULT_OK)
+                        || (Cache::get_default_key(NULL, pQuery, params2, sizeof(params2), &key2)
+                            != CACHE_RESULT_OK))
+                    {
+                        cerr << "error: Could not generate a parameter key for '" << statement << "'." << endl;
+                        rv = EXIT_FAILURE;
+                    }
+                    else if ((key1 == key) || (key2 == key) || (key1 == key2))
+                    {
+                        cerr << "error: Parameters do not affect the key of '" << statement << "'." << endl;
+                        rv = EXIT_FAILURE;
+                    }
                 }
                 else
                 {
@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/ccdefs.hh>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <maxscale/alloc.h>
+#include <maxscale/log.h>
+#include <maxscale/paths.h>
+#include "cache_storage_api.hh"
+#include "storage.hh"
+#include "storagefactory.hh"
+
+using namespace std;
+
+namespace
+{
+
+// Five values fit in a segment.
+const size_t SEGMENT_SIZE = 4096;
+const size_t VALUE_SIZE = 800;
+
+#define EXPECT(condition, message) \
+    do { if (!(condition)) { cerr << "error: " << message << endl; ++rv; } } while (false)
+
+CACHE_KEY create_key(uint64_t data)
+{
+    CACHE_KEY key;
+    key.data = data;
+    return key;
+}
+
+/**
+ * The content of a value depends upon the key and the version, so that
+ * an old or misplaced value is detected.
+ */
+string create_content(uint64_t key, int version, size_t size = VALUE_SIZE)
+{
+    string content = to_string(key) + ":" + to_string(version) + ":";
+    content.resize(size, 'a' + (key + version) % 26);
+    return content;
+}
+
+cache_result_t put(Storage& storage, uint64_t key, int version, size_t size = VALUE_SIZE)
+{
+    string content = create_content(key, version, size);
+    GWBUF* pValue = gwbuf_alloc_and_load(content.length(), content.data());
+    cache_result_t result = storage.put_value(create_key(key), pValue);
+    gwbuf_free(pValue);
+
+    return result;
+}
+
+string get_content(const GWBUF* pValue)
+{
+    return string(reinterpret_cast<const char*>(GWBUF_DATA(pValue)), GWBUF_LENGTH(pValue));
+}
+
+bool has(Storage& storage, uint64_t key, int version)
+{
+    bool rv = false;
+    GWBUF* pValue = NULL;
+
+    if (CACHE_RESULT_IS_OK(storage.get_value(create_key(key), 0, 0, 0, &pValue)))
+    {
+        rv = (get_content(pValue) == create_content(key, version));
+        gwbuf_free(pValue);
+    }
+
+    return rv;
+}
+
+bool lacks(Storage& storage, uint64_t key)
+{
+    GWBUF* pValue = NULL;
+    cache_result_t result = storage.get_value(create_key(key), 0, 0, 0, &pValue);
+    gwbuf_free(pValue);
+
+    return CACHE_RESULT_IS_NOT_FOUND(result);
+}
+
+uint64_t get_stat(Storage& storage, const char* zName)
+{
+    json_t* pInfo = NULL;
+    storage.get_info(0, &pInfo);
+    uint64_t value = json_integer_value(json_object_get(pInfo, zName));
+    json_decref(pInfo);
+
+    return value;
+}
+
+unique_ptr<Storage> create_storage(StorageFactory& factory,
+                                   const CacheStorageConfig& config,
+                                   const char* zMax_disk_size = NULL)
+{
+    string segment_size = "segment_size=" + std::to_string(SEGMENT_SIZE);
+    string max_disk_size = zMax_disk_size ? string("max_disk_size=") + zMax_disk_size : string();
+
+    vector<char*> argv;
+    argv.push_back(&segment_size[0]);
+
+    if (zMax_disk_size)
+    {
+        argv.push_back(&max_disk_size[0]);
+    }
+
+    return unique_ptr<Storage>(factory.createStorage("test", config, argv.size(), argv.data()));
+}
+
+int test_round_trip(StorageFactory& factory)
+{
+    int rv = 0;
+    unique_ptr<Storage> sStorage = create_storage(factory, CacheStorageConfig(CACHE_THREAD_MODEL_ST));
+    Storage& storage = *sStorage;
+
+    for (uint64_t key = 1; key <= 3; ++key)
+    {
+        EXPECT(put(storage, key, 0) == CACHE_RESULT_OK, "Could not store value " << key << ".");
+    }
+
+    for (uint64_t key = 1; key <= 3; ++key)
+    {
+        EXPECT(has(storage, key, 0), "Value " << key << " should be found as stored.");
+    }
+
+    EXPECT(put(storage, 2, 1) == CACHE_RESULT_OK, "Could not update a value.");
+    EXPECT(has(storage, 2, 1), "The updated value should be found.");
+
+    EXPECT(storage.del_value(create_key(1)) == CACHE_RESULT_OK, "Could not delete a value.");
+    EXPECT(lacks(storage, 1), "A deleted value should not be found.");
+
+    uint64_t items;
+    storage.get_items(&items);
+    EXPECT(items == 2, "There should be 2 items, not " << items << ".");
+
+    uint64_t size;
+    storage.get_size(&size);
+    EXPECT(size == 2 * VALUE_SIZE, "The size should be " << 2 * VALUE_SIZE << ", not " << size << ".");
+
+    EXPECT(put(storage, 4, 0, SEGMENT_SIZE + 1) == CACHE_RESULT_OUT_OF_RESOURCES,
+           "A value larger than a segment should not be stored.");
+
+    return rv;
+}
+
+int test_segments(StorageFactory& factory)
+{
+    int rv = 0;
+    unique_ptr<Storage> sStorage = create_storage(factory, CacheStorageConfig(CACHE_THREAD_MODEL_MT));
+    Storage& storage = *sStorage;
+
+    const uint64_t N_KEYS = 20;
+
+    for (uint64_t key = 0; key < N_KEYS; ++key)
+    {
+        put(storage, key, 0);
+    }
+
+    EXPECT(get_stat(storage, "segments") >= N_KEYS * VALUE_SIZE / SEGMENT_SIZE,
+           "The values should have been spread over several segments.");
+
+    // Keep the oldest value around; the buffer must remain valid although
+    // the segment it refers to is compacted and dropped.
+    GWBUF* pOld = NULL;
+    storage.get_value(create_key(0), 0, 0, 0, &pOld);
+
+    // Only one value remains in the first segment, which is compacted when
+    // a new segment is needed.
+    for (uint64_t key = 0; key < 4; ++key)
+    {
+        put(storage, key, 1);
+    }
+
+    for (int version = 2; version < 10; ++version)
+    {
+        put(storage, 0, version);
+    }
+
+    EXPECT(get_stat(storage, "compactions") != 0, "Segments with stale data should have been compacted.");
+
+    for (uint64_t key = 0; key < N_KEYS; ++key)
+    {
+        int version = key == 0 ? 9 : (key < 4 ? 1 : 0);
+        EXPECT(has(storage, key, version), "Value " << key << " should be intact after the compaction.");
+    }
+
+    EXPECT(pOld && get_content(pOld) == create_content(0, 0),
+           "A returned buffer should remain valid after its segment has been dropped.");
+    gwbuf_free(pOld);
+
+    return rv;
+}
+
+int test_limits(StorageFactory& factory)
+{
+    int rv = 0;
+    unique_ptr<Storage> sStorage = create_storage(factory, CacheStorageConfig(CACHE_THREAD_MODEL_ST, 0, 0, 2));
+    Storage& storage = *sStorage;
+
+    put(storage, 1, 0);
+    put(storage, 2, 0);
+    EXPECT(has(storage, 1, 0), "Value 1 should be found.");
+    put(storage, 3, 0);
+
+    EXPECT(lacks(storage, 2), "The least recently used value should have been evicted.");
+
+    CACHE_KEY key;
+    GWBUF* pValue = NULL;
+    EXPECT(storage.get_head(&key, &pValue) == CACHE_RESULT_OK && key.data == 3,
+           "The most recently stored value should be the head.");
+    gwbuf_free(pValue);
+
+    pValue = NULL;
+    EXPECT(storage.get_tail(&key, &pValue) == CACHE_RESULT_OK && key.data == 1,
+           "The least recently used value should be the tail.");
+    gwbuf_free(pValue);
+
+    // Room for two segments.
+    string max_disk_size = std::to_string(2 * SEGMENT_SIZE);
+    sStorage = create_storage(factory, CacheStorageConfig(CACHE_THREAD_MODEL_ST), max_disk_size.c_str());
+    Storage& bounded = *sStorage;
+
+    for (uint64_t key = 0; key < 20; ++key)
+    {
+        EXPECT(put(bounded, key, 0) == CACHE_RESULT_OK, "Could not store value " << key << ".");
+        EXPECT(get_stat(bounded, "segments") <= 2, "The disk size limit should not be exceeded.");
+    }
+
+    EXPECT(has(bounded, 19, 0), "The most recent value should be found.");
+    EXPECT(lacks(bounded, 0), "The oldest value should have been evicted.");
+
+    return rv;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int rv = EXIT_FAILURE;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        set_libdir(MXS_STRDUP("../storage/storage_mmap/"));
+        set_cachedir(MXS_STRDUP("."));
+
+        StorageFactory* pFactory = StorageFactory::Open("storage_mmap");
+
+        if (pFactory)
+        {
+            int failures = test_round_trip(*pFactory);
+            failures += test_segments(*pFactory);
+            failures += test_limits(*pFactory);
+
+            rv = failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+
+            delete pFactory;
+        }
+        else
+        {
+            cerr << "error: Could not initialize factory." << endl;
+        }
+
+        mxs_log_finish();
+    }
+    else
+    {
+        cerr << "error: Could not initialize log." << endl;
+    }
+
+    return rv;
+}
@@ -50,6 +50,8 @@ int main(int argc, char* argv[])
 {
     char* libdir = MXS_STRDUP("../../../../../query_classifier/qc_sqlite/");
     set_libdir(libdir);
+    // Storage modules that use the disk create their files beneath the cache directory.
+    set_cachedir(MXS_STRDUP("."));
 
     TestRawStorage test(&cout);
     int rv = test.run(argc, argv);
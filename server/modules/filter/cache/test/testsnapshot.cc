@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/ccdefs.hh>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <maxscale/alloc.h>
+#include <maxscale/log.h>
+#include <maxscale/paths.h>
+#include "cachesnapshot.hh"
+#include "cachest.hh"
+#include "storagefactory.hh"
+
+using namespace std;
+
+namespace
+{
+
+const uint32_t HARD_TTL = 100;
+
+#define EXPECT(condition, message) \
+    do { if (!(condition)) { cerr << "error: " << message << endl; ++rv; } } while (false)
+
+Cache::SStorageFactory sFactory;
+string snapshot;
+
+CACHE_KEY create_key(uint64_t data)
+{
+    CACHE_KEY key;
+    key.data = data;
+    return key;
+}
+
+string create_content(uint64_t key)
+{
+    return "value " + to_string(key) + string(key * 100, 'x');
+}
+
+CACHE_CONFIG create_config()
+{
+    CACHE_CONFIG config;
+    memset(&config, 0, sizeof(config));
+    config.thread_model = CACHE_THREAD_MODEL_ST;
+    config.selects = CACHE_SELECTS_ASSUME_CACHEABLE;
+
+    return config;
+}
+
+Cache* create_cache(const CACHE_CONFIG* pConfig)
+{
+    return CacheST::Create("test", std::vector<Cache::SCacheRules>(), sFactory, pConfig);
+}
+
+void put_value(Cache& cache, uint64_t key, uint32_t time)
+{
+    string content = create_content(key);
+    GWBUF* pValue = gwbuf_alloc_and_load(content.length(), content.data());
+    cache.restore_value(create_key(key), pValue, time);
+    gwbuf_free(pValue);
+}
+
+bool has_value(Cache& cache, uint64_t key)
+{
+    GWBUF* pValue = NULL;
+    cache_result_t result = cache.get_value(create_key(key), 0, 0, 0, &pValue);
+
+    bool rv = CACHE_RESULT_IS_OK(result) && pValue;
+
+    if (rv)
+    {
+        string content = create_content(key);
+        string s(gwbuf_length(pValue), 0);
+        gwbuf_copy_data(pValue, 0, s.length(), reinterpret_cast<uint8_t*>(&s[0]));
+        rv = (s == content);
+    }
+
+    gwbuf_free(pValue);
+
+    return rv;
+}
+
+int test_round_trip()
+{
+    int rv = 0;
+
+    CACHE_CONFIG config = create_config();
+    unique_ptr<Cache> sSaved(create_cache(&config));
+    uint32_t now = time(NULL);
+
+    put_value(*sSaved, 1, now);
+    put_value(*sSaved, 2, now);
+    put_value(*sSaved, 3, now - 10 * HARD_TTL);
+
+    EXPECT(CacheSnapshot::save(*sSaved, snapshot), "The snapshot should be saved.");
+    EXPECT(access((snapshot + ".tmp").c_str(), F_OK) != 0, "The temporary file should have been renamed.");
+
+    config.hard_ttl = HARD_TTL;
+    unique_ptr<Cache> sRestored(create_cache(&config));
+    unique_ptr<CacheSnapshot> sSnapshot = CacheSnapshot::open(*sRestored, snapshot);
+    EXPECT(sSnapshot, "The snapshot should be opened.");
+
+    if (sSnapshot)
+    {
+        std::atomic<bool> stop(false);
+        EXPECT(sSnapshot->restore(stop), "The snapshot should be restored in its entirety.");
+
+        EXPECT(has_value(*sRestored, 1) && has_value(*sRestored, 2), "The values should be restored.");
+        EXPECT(!has_value(*sRestored, 3), "A value whose hard TTL has passed should be skipped.");
+    }
+
+    unique_ptr<Cache> sStopped(create_cache(&config));
+    sSnapshot = CacheSnapshot::open(*sStopped, snapshot);
+
+    if (sSnapshot)
+    {
+        std::atomic<bool> stop(true);
+        EXPECT(!sSnapshot->restore(stop), "A stopped restore should not be complete.");
+        EXPECT(!has_value(*sStopped, 1), "Nothing should be restored once stopped.");
+    }
+
+    return rv;
+}
+
+int test_incompatible()
+{
+    int rv = 0;
+
+    CACHE_CONFIG config = create_config();
+    unique_ptr<Cache> sSaved(create_cache(&config));
+    put_value(*sSaved, 1, time(NULL));
+    CacheSnapshot::save(*sSaved, snapshot);
+
+    config.compression = CACHE_COMPRESSION_ZLIB;
+    unique_ptr<Cache> sCompressing(create_cache(&config));
+    EXPECT(!CacheSnapshot::open(*sCompressing, snapshot),
+           "A snapshot with a different compression should be rejected.");
+
+    config = create_config();
+    config.invalidate = CACHE_INVALIDATE_CURRENT;
+    unique_ptr<Cache> sInvalidating(create_cache(&config));
+    EXPECT(!CacheSnapshot::open(*sInvalidating, snapshot),
+           "A snapshot with a different invalidation should be rejected.");
+
+    EXPECT(!CacheSnapshot::open(*sInvalidating, snapshot + ".missing"),
+           "A missing snapshot should not be opened.");
+
+    return rv;
+}
+
+int test_truncated()
+{
+    int rv = 0;
+
+    CACHE_CONFIG config = create_config();
+    unique_ptr<Cache> sSaved(create_cache(&config));
+    put_value(*sSaved, 1, time(NULL));
+    put_value(*sSaved, 2, time(NULL));
+    CacheSnapshot::save(*sSaved, snapshot);
+
+    FILE* pFile = fopen(snapshot.c_str(), "r");
+    fseek(pFile, 0, SEEK_END);
+    long size = ftell(pFile);
+    fclose(pFile);
+
+    // In the middle of the last value.
+    EXPECT(truncate(snapshot.c_str(), size - 10) == 0, "The snapshot should be truncated.");
+
+    unique_ptr<Cache> sRestored(create_cache(&config));
+    unique_ptr<CacheSnapshot> sSnapshot = CacheSnapshot::open(*sRestored, snapshot);
+    EXPECT(sSnapshot, "A truncated snapshot should be opened.");
+
+    if (sSnapshot)
+    {
+        std::atomic<bool> stop(false);
+        EXPECT(!sSnapshot->restore(stop), "A truncated snapshot should not be restored in its entirety.");
+    }
+
+    // Not even a complete header.
+    EXPECT(truncate(snapshot.c_str(), 10) == 0, "The snapshot should be truncated.");
+    EXPECT(!CacheSnapshot::open(*sRestored, snapshot), "A snapshot without a header should be rejected.");
+
+    return rv;
+}
+
+int test_epoch()
+{
+    int rv = 0;
+
+    CACHE_CONFIG config = create_config();
+    config.invalidate = CACHE_INVALIDATE_CURRENT;
+
+    unique_ptr<Cache> sSaved(create_cache(&config));
+
+    for (int i = 0; i < 10; ++i)
+    {
+        sSaved->invalidate({"db.t" + to_string(i)});
+    }
+
+    uint64_t epoch = sSaved->epoch();
+    CacheSnapshot::save(*sSaved, snapshot);
+
+    unique_ptr<Cache> sRestored(create_cache(&config));
+    EXPECT(sRestored->epoch() < epoch, "A new cache should start from an earlier epoch.");
+
+    unique_ptr<CacheSnapshot> sSnapshot = CacheSnapshot::open(*sRestored, snapshot);
+    EXPECT(sSnapshot, "The snapshot should be opened.");
+    EXPECT(sRestored->epoch() >= epoch, "Opening a snapshot should raise the epoch to that of the snapshot.");
+
+    return rv;
+}
+
+int test()
+{
+    char dir[] = "/tmp/testsnapshot_XXXXXX";
+
+    if (!mkdtemp(dir))
+    {
+        cerr << "error: Could not create directory." << endl;
+        return 1;
+    }
+
+    snapshot = string(dir) + "/snapshot";
+
+    int rv = test_round_trip();
+    rv += test_incompatible();
+    rv += test_truncated();
+    rv += test_epoch();
+
+    unlink(snapshot.c_str());
+    rmdir(dir);
+
+    return rv;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int rv = EXIT_FAILURE;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        char* libdir = MXS_STRDUP("../storage/storage_inmemory/");
+        set_libdir(libdir);
+
+        StorageFactory* pFactory = StorageFactory::Open("storage_inmemory");
+
+        if (pFactory)
+        {
+            sFactory.reset(pFactory);
+            rv = test() == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+            sFactory.reset();
+        }
+        else
+        {
+            cerr << "error: Could not initialize factory." << endl;
+        }
+
+        mxs_log_finish();
+    }
+    else
+    {
+        cerr << "error: Could not initialize log." << endl;
+    }
+
+    return rv;
+}
@@ -25,6 +25,7 @@
 #include <maxscale/mysql_utils.h>
 #include <maxscale/routingworker.h>
 #include <maxscale/secrets.h>
+#include <maxscale/server.hh>
 #include <maxscale/utils.hh>
 
 using std::string;
@@ -46,6 +47,8 @@ static const char CN_SWITCHOVER_TIMEOUT[] = "switchover_timeout";
 static const char CN_DETECT_STANDALONE_MASTER[] = "detect_standalone_master";
 static const char CN_MAINTENANCE_ON_LOW_DISK_SPACE[] = "maintenance_on_low_disk_space";
 static const char CN_ASSUME_UNIQUE_HOSTNAMES[] = "assume_unique_hostnames";
+static const char CN_GTID_REFRESH_INTERVAL[] = "gtid_refresh_interval";
+static const char CN_SAMPLE_LOAD[] = "sample_load";
 // Parameters for master failure verification and timeout
 static const char CN_VERIFY_MASTER_FAILURE[] = "verify_master_failure";
 static const char CN_MASTER_FAILURE_TIMEOUT[] = "master_failure_timeout";
@@ -76,7 +79,7 @@ void MariaDBMonitor::reset_server_info()
     for (auto mon_server = m_monitor->monitored_servers; mon_server; mon_server = mon_server->next)
     {
         m_servers.push_back(new MariaDBServer(mon_server, m_servers.size(),
-                            m_assume_unique_hostnames, m_handle_event_scheduler));
+                            m_assume_unique_hostnames, m_handle_event_scheduler, m_sample_load));
     }
 }
 
@@ -211,6 +214,8 @@ bool MariaDBMonitor::configure(const MXS_CONFIG_PARAMETER* params)
     m_detect_standalone_master = config_get_bool(params, CN_DETECT_STANDALONE_MASTER);
     m_assume_unique_hostnames = config_get_bool(params, CN_ASSUME_UNIQUE_HOSTNAMES);
     m_failcount = config_get_integer(params, CN_FAILCOUNT);
+    m_gtid_refresh_interval = config_get_integer(params, CN_GTID_REFRESH_INTERVAL);
+    m_sample_load = config_get_bool(params, CN_SAMPLE_LOAD);
     m_failover_timeout = config_get_integer(params, CN_FAILOVER_TIMEOUT);
     m_switchover_timeout = config_get_integer(params, CN_SWITCHOVER_TIMEOUT);
     m_auto_failover = config_get_bool(params, CN_AUTO_FAILOVER);
@@ -382,6 +387,7 @@ void MariaDBMonitor::update_server(MariaDBServer* server)
         /* The current server is not running. Clear all but the stale master bit as it is used to detect
          * masters that went down but came up. */
         server->clear_status(~SERVER_WAS_MASTER);
+        server->clear_load_signals();
         auto conn_errno = mysql_errno(conn);
         if (conn_errno == ER_ACCESS_DENIED_ERROR || conn_errno == ER_ACCESS_DENIED_NO_PASSWORD_ERROR)
         {
@@ -493,8 +499,12 @@ void MariaDBMonitor::tick()
         SERVER* srv = server->m_server_base->server;
         srv->rlag = server->m_replication_lag;
         srv->status = server->m_server_base->pending_status;
+        server_set_load(srv, &server->m_load);
+        publish_gtid_pos(server);
     }
 
+    m_gtid_refreshed = get_time_ms();
+
     log_master_changes();
 
     // Before exiting, we need to store the current master into the m_master
@@ -503,6 +513,39 @@ void MariaDBMonitor::tick()
     MonitorInstance::m_master = m_master ? m_master->m_server_base : NULL;
 }
 
+/**
+ * Refresh the gtid positions of the servers if the monitor interval is longer than the gtid refresh
+ * interval. Only the gtids are queried, the server roles are updated during the normal monitor tick.
+ */
+void MariaDBMonitor::between_ticks()
+{
+    if (m_gtid_refresh_interval > 0 && get_time_ms() - m_gtid_refreshed >= m_gtid_refresh_interval)
+    {
+        for (MariaDBServer* server : m_servers)
+        {
+            if (server->is_running() && server->m_capabilities.gtid && server->m_server_base->con
+                && server->update_gtids())
+            {
+                publish_gtid_pos(server);
+            }
+        }
+
+        m_gtid_refreshed = get_time_ms();
+    }
+}
+
+/**
+ * Share the gtid position of a server with the routers.
+ *
+ * @param server The server whose gtid position is shared
+ */
+void MariaDBMonitor::publish_gtid_pos(MariaDBServer* server)
+{
+    bool known = server->is_running() && server->m_capabilities.gtid;
+    mxs::server_set_gtid_pos(server->m_server_base->server,
+                             known ? server->m_gtid_current_pos.to_string() : "");
+}
+
 void MariaDBMonitor::process_state_changes()
 {
     MonitorInstance::process_state_changes();
@@ -1086,6 +1129,12 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
             {
                 CN_ASSUME_UNIQUE_HOSTNAMES,         MXS_MODULE_PARAM_BOOL,    "true"
             },
+            {
+                CN_GTID_REFRESH_INTERVAL,           MXS_MODULE_PARAM_COUNT,   "0"
+            },
+            {
+                CN_SAMPLE_LOAD,                     MXS_MODULE_PARAM_BOOL,    "false"
+            },
             {MXS_END_MODULE_PARAMS}
         }
     };
@@ -204,6 +204,10 @@ private:
     bool m_assume_unique_hostnames = true;  /* Are server hostnames consistent between MaxScale and servers */
     int m_failcount = 1;                    /* Number of ticks master must be down before it's considered
                                              * totally down, allowing failover or master change. */
+    int64_t m_gtid_refresh_interval = 0;    /* How often gtids are refreshed between monitor ticks, in
+                                             * milliseconds. 0 disables. */
+    int64_t m_gtid_refreshed = 0;           /* When the gtids were last refreshed */
+    bool    m_sample_load = false;          /* Read load signals from the server status variables */
 
     // Cluster operations activation settings
     bool m_auto_failover = false;                   /* Automatic master failover enabled? */
@@ -249,6 +253,7 @@ private:
     void reset_node_index_info();
     bool execute_manual_command(std::function<void ()> command, json_t** error_out);
     bool immediate_tick_required() const;
+    void between_ticks();
 
     std::string diagnostics_to_string() const;
     json_t*     to_json() const;
@@ -260,6 +265,7 @@ private:
 
     // Cluster discovery and status assignment methods, top levels
     void update_server(MariaDBServer* server);
+    void publish_gtid_pos(MariaDBServer* server);
     void update_topology();
     void build_replication_graph();
     void assign_new_master(MariaDBServer* new_master);
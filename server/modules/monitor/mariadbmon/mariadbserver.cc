@@ -28,13 +28,15 @@ using maxbase::StopWatch;
 using Guard = std::lock_guard<std::mutex>;
 
 MariaDBServer::MariaDBServer(MXS_MONITORED_SERVER* monitored_server, int config_index,
-                             bool assume_unique_hostnames, bool query_events)
+                             bool assume_unique_hostnames, bool query_events, bool sample_load)
     : m_server_base(monitored_server)
     , m_config_index(config_index)
     , m_assume_unique_hostnames(assume_unique_hostnames)
     , m_query_events(query_events)
+    , m_sample_load(sample_load)
 {
     mxb_assert(monitored_server);
+    clear_load_signals();
 }
 
 NodeData::NodeData()
@@ -446,6 +448,72 @@ bool MariaDBServer::update_gtids(string* errmsg_out)
     return rval;
 }
 
+bool MariaDBServer::update_load_signals(string* errmsg_out)
+{
+    static const string query = "SHOW GLOBAL STATUS WHERE Variable_name IN "
+                                "('Threads_running', 'Innodb_row_lock_current_waits', "
+                                "'Innodb_buffer_pool_reads', 'Innodb_buffer_pool_read_requests');";
+    const int i_name = 0;
+    const int i_value = 1;
+
+    bool rval = false;
+    auto result = execute_query(query, errmsg_out);
+    if (result.get() != NULL)
+    {
+        rval = true;
+        SERVER_LOAD load = {-1, 0, 0};
+        int64_t bp_reads = -1;
+        int64_t bp_read_requests = -1;
+
+        while (result->next_row())
+        {
+            string name = result->get_string(i_name);
+            int64_t value = result->get_uint(i_value);
+
+            if (strcasecmp(name.c_str(), "Threads_running") == 0)
+            {
+                load.threads_running = value;
+            }
+            else if (strcasecmp(name.c_str(), "Innodb_row_lock_current_waits") == 0)
+            {
+                load.row_lock_waits = std::max(value, (int64_t)0);
+            }
+            else if (strcasecmp(name.c_str(), "Innodb_buffer_pool_reads") == 0)
+            {
+                bp_reads = value;
+            }
+            else if (strcasecmp(name.c_str(), "Innodb_buffer_pool_read_requests") == 0)
+            {
+                bp_read_requests = value;
+            }
+        }
+
+        if (bp_reads >= 0 && bp_read_requests >= 0)
+        {
+            // Use the change since the previous sample if there is one, otherwise the total ratio.
+            bool have_prev = m_bp_reads >= 0 && bp_reads >= m_bp_reads
+                && bp_read_requests >= m_bp_read_requests;
+            int64_t reads = have_prev ? bp_reads - m_bp_reads : bp_reads;
+            int64_t requests = have_prev ? bp_read_requests - m_bp_read_requests : bp_read_requests;
+            load.bp_miss_rate = requests > 0 ? std::min((double)reads / requests, 1.0) : 0;
+        }
+
+        m_bp_reads = bp_reads;
+        m_bp_read_requests = bp_read_requests;
+        m_load = load;
+    }
+    return rval;
+}
+
+void MariaDBServer::clear_load_signals()
+{
+    m_load.threads_running = -1;
+    m_load.row_lock_waits = -1;
+    m_load.bp_miss_rate = -1;
+    m_bp_reads = -1;
+    m_bp_read_requests = -1;
+}
+
 bool MariaDBServer::update_replication_settings(std::string* errmsg_out)
 {
     const string query = "SELECT @@gtid_strict_mode, @@log_bin, @@log_slave_updates;";
@@ -862,6 +930,10 @@ void MariaDBServer::monitor_server()
         {
             query_ok = update_enabled_events();
         }
+        if (query_ok && m_sample_load)
+        {
+            query_ok = update_load_signals(&errmsg);
+        }
     }
     else
     {
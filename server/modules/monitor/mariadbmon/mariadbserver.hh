@@ -74,7 +74,7 @@ class MariaDBServer
 {
 public:
     MariaDBServer(MXS_MONITORED_SERVER* monitored_server, int config_index,
-                  bool assume_unique_hostnames, bool query_events);
+                  bool assume_unique_hostnames, bool query_events, bool sample_load = false);
 
     class EventInfo
     {
@@ -149,6 +149,10 @@ public:
     ReplicationSettings m_rpl_settings;
 
     bool         m_query_events; /* Copy of monitor->m_handle_event_scheduler. TODO: move elsewhere */
+    bool         m_sample_load;  /* Copy of monitor->m_sample_load. */
+    SERVER_LOAD  m_load;         /* Load signals from the status variables, negative if not sampled */
+    int64_t      m_bp_reads = -1;           /* Previous value of Innodb_buffer_pool_reads */
+    int64_t      m_bp_read_requests = -1;   /* Previous value of Innodb_buffer_pool_read_requests */
     EventNameSet m_enabled_events; /* Enabled scheduled events */
 
     bool m_print_update_errormsg = true;    /* Should an update error be printed? */
@@ -247,6 +251,20 @@ public:
      */
     bool read_server_variables(std::string* errmsg_out = NULL);
 
+    /**
+     * Query and save load signals from the global status variables. The buffer pool miss rate is
+     * calculated from the change in the counters since the previous call.
+     *
+     * @param errmsg_out Where to store an error message if query fails. Can be null.
+     * @return True on success.
+     */
+    bool update_load_signals(std::string* errmsg_out = NULL);
+
+    /**
+     * Mark the load signals as unknown.
+     */
+    void clear_load_signals();
+
     /**
      * Print warnings if gtid_strict_mode or log_slave_updates is off. Does not query the server,
      * so 'update_replication_settings' should have been called recently to update the values.
@@ -63,10 +63,18 @@ bool LocalClient::queue_query(GWBUF* buffer)
 
 void LocalClient::self_destruct()
 {
-    GWBUF* buffer = mysql_create_com_quit(NULL, 0);
-    queue_query(buffer);
-    gwbuf_free(buffer);
-    m_self_destruct = true;
+    if (m_state == VC_ERROR)
+    {
+        // The connection is already closed, so no more events will arrive.
+        delete this;
+    }
+    else
+    {
+        GWBUF* buffer = mysql_create_com_quit(NULL, 0);
+        queue_query(buffer);
+        gwbuf_free(buffer);
+        m_self_destruct = true;
+    }
 }
 
 void LocalClient::close()
@@ -89,7 +97,19 @@ void LocalClient::error()
 void LocalClient::process(uint32_t events)
 {
 
-    if (events & EPOLLIN)
+    if ((events & EPOLLIN) && (m_state == VC_OK))
+    {
+        // The responses are ignored, but as the socket is edge triggered, all
+        // available data must be read. Otherwise the rest of a large response
+        // would remain unread.
+        GWBUF* buf;
+
+        while (m_state == VC_OK && (buf = read_complete_packet()))
+        {
+            gwbuf_free(buf);
+        }
+    }
+    else if (events & EPOLLIN)
     {
         GWBUF* buf = read_complete_packet();
 
@@ -162,6 +182,12 @@ GWBUF* LocalClient::read_complete_packet()
             }
             break;
         }
+        else if (rc == 0)
+        {
+            // The server closed the connection.
+            error();
+            break;
+        }
 
         mxs::Buffer chunk(buffer, rc);
         m_partial.append(chunk);
@@ -123,9 +123,33 @@ bool RWBackend::write(GWBUF* buffer, response_type type)
     return mxs::Backend::write(buffer, type);
 }
 
+bool RWBackend::write_pipelined(GWBUF* buffer)
+{
+    uint8_t cmd = mxs_mysql_get_command(buffer);
+    mxb_assert(m_reply_state != REPLY_STATE_DONE && m_command == MXS_COM_QUERY && cmd == MXS_COM_QUERY);
+    bool rval = mxs::Backend::write(buffer, EXPECT_RESPONSE);
+
+    if (rval)
+    {
+        m_pipeline.push_back(cmd);
+    }
+
+    return rval;
+}
+
+void RWBackend::start_next_pipelined_reply()
+{
+    mxb_assert(m_reply_state == REPLY_STATE_DONE && !m_pipeline.empty());
+    m_command = m_pipeline.front();
+    m_pipeline.pop_front();
+    set_reply_state(REPLY_STATE_START);
+    ++m_completed_pipelined;
+}
+
 void RWBackend::close(close_type type)
 {
     m_reply_state = REPLY_STATE_DONE;
+    m_pipeline.clear();
     mxs::Backend::close(type);
 }
 
@@ -355,6 +379,12 @@ void RWBackend::process_packets(GWBUF* result)
             break;
         }
 
+        if (m_reply_state == REPLY_STATE_DONE && !m_pipeline.empty())
+        {
+            // The rest of the packets belong to the reply of the next pipelined command
+            start_next_pipelined_reply();
+        }
+
         it = end;
     }
 
@@ -368,6 +398,8 @@ void RWBackend::process_packets(GWBUF* result)
  */
 void RWBackend::process_reply(GWBUF* buffer)
 {
+    m_completed_pipelined = 0;
+
     if (current_command() == MXS_COM_STMT_FETCH)
     {
         // If the server responded with an error, n_eof > 0
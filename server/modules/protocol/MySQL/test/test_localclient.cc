@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include <maxscale/ccdefs.hh>
+#include <arpa/inet.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <maxbase/maxbase.hh>
+#include <maxbase/stopwatch.hh>
+#include <maxbase/worker.hh>
+#include <maxscale/log.h>
+#include <maxscale/modutil.h>
+#include <maxscale/protocol/mariadb_client.hh>
+
+using namespace std;
+
+namespace
+{
+
+// The response is much larger than what fits in the socket buffers, so it can
+// be written only if the client keeps on reading.
+const size_t RESPONSE_PACKETS = 1000;
+const size_t RESPONSE_PACKET_SIZE = 4000;
+
+const int32_t CHECK_INTERVAL = 50;
+const int     TEST_TIMEOUT = 10;
+
+bool write_all(int fd, const uint8_t* pData, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = write(fd, pData, len);
+
+        if (n <= 0)
+        {
+            return false;
+        }
+
+        pData += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+bool write_packet(int fd, uint8_t seq, const vector<uint8_t>& payload)
+{
+    uint8_t header[MYSQL_HEADER_LEN];
+    gw_mysql_set_byte3(header, payload.size());
+    header[3] = seq;
+
+    return write_all(fd, header, sizeof(header)) && write_all(fd, payload.data(), payload.size());
+}
+
+bool read_packet(int fd, vector<uint8_t>* pPayload)
+{
+    uint8_t header[MYSQL_HEADER_LEN];
+    bool rv = recv(fd, header, sizeof(header), MSG_WAITALL) == sizeof(header);
+
+    if (rv)
+    {
+        pPayload->resize(gw_mysql_get_byte3(header));
+        rv = pPayload->empty()
+            || (recv(fd, pPayload->data(), pPayload->size(), MSG_WAITALL) == (ssize_t)pPayload->size());
+    }
+
+    return rv;
+}
+
+vector<uint8_t> create_handshake()
+{
+    vector<uint8_t> payload;
+    payload.push_back(GW_MYSQL_PROTOCOL_VERSION);
+
+    const char VERSION[] = "10.3.0-fake";
+    payload.insert(payload.end(), VERSION, VERSION + sizeof(VERSION));  // Including the NUL.
+    payload.insert(payload.end(), {1, 0, 0, 0});                        // Thread id
+    payload.insert(payload.end(), 8, 'a');                              // Scramble, part 1
+    payload.push_back(0);                                               // Filler
+    payload.insert(payload.end(), {0xff, 0xf7});                        // Capabilities, part 1
+    payload.push_back(8);                                               // Character set
+    payload.insert(payload.end(), {2, 0});                              // Status
+    payload.insert(payload.end(), {0xff, 0x81});                        // Capabilities, part 2
+    payload.push_back(GW_MYSQL_SCRAMBLE_SIZE + 1);                      // Scramble length
+    payload.insert(payload.end(), 10, 0);                               // Reserved
+    payload.insert(payload.end(), 12, 'b');                             // Scramble, part 2
+    payload.push_back(0);
+
+    const char PLUGIN[] = "mysql_native_password";
+    payload.insert(payload.end(), PLUGIN, PLUGIN + sizeof(PLUGIN));
+
+    return payload;
+}
+
+/**
+ * A server accepting one connection, which after the authentication responds
+ * to the first statement with a large response and then closes the connection.
+ */
+class Server
+{
+public:
+    Server()
+        : m_fd(socket(AF_INET, SOCK_STREAM, 0))
+        , m_port(0)
+        , m_done(false)
+        , m_response_written(false)
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+
+        if (m_fd != -1
+            && bind(m_fd, (sockaddr*)&addr, sizeof(addr)) == 0
+            && listen(m_fd, 1) == 0
+            && getsockname(m_fd, (sockaddr*)&addr, &len) == 0)
+        {
+            m_port = ntohs(addr.sin_port);
+            m_thread = std::thread(&Server::run, this);
+        }
+    }
+
+    ~Server()
+    {
+        if (m_thread.joinable())
+        {
+            // Wakes up the thread, if no connection was ever made.
+            shutdown(m_fd, SHUT_RDWR);
+            m_thread.join();
+        }
+
+        if (m_fd != -1)
+        {
+            close(m_fd);
+        }
+    }
+
+    uint16_t port() const
+    {
+        return m_port;
+    }
+
+    bool done() const
+    {
+        return m_done;
+    }
+
+    bool response_written() const
+    {
+        return m_response_written;
+    }
+
+private:
+    void run()
+    {
+        int fd = accept(m_fd, NULL, NULL);
+
+        if (fd != -1)
+        {
+            // If the client stops reading, the writing times out.
+            timeval tv {TEST_TIMEOUT / 2, 0};
+            setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+            vector<uint8_t> payload;
+            const vector<uint8_t> ok {0, 0, 0, 2, 0, 0, 0};
+
+            if (write_packet(fd, 0, create_handshake())
+                && read_packet(fd, &payload)
+                && write_packet(fd, 2, ok)
+                && read_packet(fd, &payload)
+                && payload[0] == MXS_COM_QUERY)
+            {
+                bool written = true;
+                vector<uint8_t> row(RESPONSE_PACKET_SIZE, 'x');
+
+                for (size_t i = 0; written && i < RESPONSE_PACKETS; ++i)
+                {
+                    written = write_packet(fd, i + 1, row);
+                }
+
+                m_response_written = written;
+            }
+
+            close(fd);
+        }
+
+        m_done = true;
+    }
+
+    int               m_fd;
+    uint16_t          m_port;
+    std::thread       m_thread;
+    std::atomic<bool> m_done;
+    std::atomic<bool> m_response_written;
+};
+
+class LocalClientTest
+{
+public:
+    LocalClientTest(mxb::Worker& worker, Server& server)
+        : m_worker(worker)
+        , m_server(server)
+        , m_pClient(NULL)
+        , m_rv(0)
+    {
+        memset(&m_session, 0, sizeof(m_session));
+        strcpy(m_session.user, "bob");
+
+        memset(&m_protocol, 0, sizeof(m_protocol));
+        m_protocol.charset = 8;
+
+        memset(&m_backend, 0, sizeof(m_backend));
+        strcpy(m_backend.address, "127.0.0.1");
+        m_backend.port = server.port();
+    }
+
+    int rv() const
+    {
+        return m_rv;
+    }
+
+    void start()
+    {
+        cout << "A large response is read completely and EOF is treated as an error." << endl;
+
+        m_pClient = LocalClient::create(&m_session, &m_protocol, &m_backend);
+
+        GWBUF* pQuery = modutil_create_query("SELECT 1");
+        bool queued = m_pClient && m_pClient->queue_query(pQuery);
+        gwbuf_free(pQuery);
+
+        expect(queued, "A query should be queued before the connection has been authenticated.");
+
+        if (queued)
+        {
+            m_worker.delayed_call(CHECK_INTERVAL, &LocalClientTest::check, this);
+        }
+        else
+        {
+            end();
+        }
+    }
+
+private:
+    bool check(mxb::Worker::Call::action_t action)
+    {
+        bool again = false;
+
+        if (action == mxb::Worker::Call::EXECUTE)
+        {
+            if (!m_server.done() && m_watch.split() < std::chrono::seconds(TEST_TIMEOUT))
+            {
+                again = true;
+            }
+            else if (!m_server.done())
+            {
+                expect(false, "The server should have completed.");
+                end();
+            }
+            else
+            {
+                expect(m_server.response_written(), "All of the response should have been read.");
+
+                GWBUF* pQuery = modutil_create_query("SELECT 2");
+                bool queued = m_pClient->queue_query(pQuery);
+                gwbuf_free(pQuery);
+
+                if (queued && m_watch.split() < std::chrono::seconds(TEST_TIMEOUT))
+                {
+                    // The closing of the connection has not yet been noticed.
+                    again = true;
+                }
+                else
+                {
+                    expect(!queued, "A query should not be queued once the server has closed the "
+                                    "connection.");
+                    end();
+                }
+            }
+        }
+
+        return again;
+    }
+
+    void end()
+    {
+        if (m_pClient)
+        {
+            // After an error, the client deletes itself immediately.
+            m_pClient->self_destruct();
+            m_pClient = NULL;
+        }
+
+        m_worker.shutdown();
+    }
+
+    void expect(bool condition, const char* zMessage)
+    {
+        if (!condition)
+        {
+            cout << "ERROR: " << zMessage << endl;
+            ++m_rv;
+        }
+    }
+
+    mxb::Worker&   m_worker;
+    Server&        m_server;
+    MYSQL_session  m_session;
+    MySQLProtocol  m_protocol;
+    SERVER         m_backend;
+    LocalClient*   m_pClient;
+    mxb::StopWatch m_watch;
+    int            m_rv;
+};
+}
+
+int main(int argc, char* argv[])
+{
+    int rv = 1;
+
+    if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+    {
+        if (maxbase::init())
+        {
+            // Writing to the connection the server closed must not terminate the test.
+            signal(SIGPIPE, SIG_IGN);
+
+            Server server;
+
+            if (server.port() != 0)
+            {
+                mxb::Worker worker;
+                LocalClientTest test(worker, server);
+
+                worker.execute([&test]() {
+                                   test.start();
+                               }, mxb::Worker::EXECUTE_QUEUED);
+                worker.run();
+
+                rv = test.rv();
+            }
+            else
+            {
+                cerr << "error: Could not create listening socket." << endl;
+            }
+
+            cout << rv << " failures." << endl;
+
+            maxbase::finish();
+        }
+        else
+        {
+            cerr << "error: Could not initialize maxbase." << endl;
+        }
+
+        mxs_log_finish();
+    }
+
+    return rv;
+}
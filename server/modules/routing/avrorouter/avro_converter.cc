@@ -14,6 +14,8 @@
 #include "avro_converter.hh"
 
 #include <limits.h>
+#include <string.h>
+#include <algorithm>
 
 #include <maxbase/assert.h>
 #include <maxscale/alloc.h>
@@ -34,6 +36,7 @@ AvroTable* avro_table_alloc(const char* filepath,
     avro_file_writer_t avro_file;
     avro_value_iface_t* avro_writer_iface;
     avro_schema_t avro_schema;
+    avro_value_t avro_record;
 
     if (avro_schema_from_json_length(json_schema,
                                      strlen(json_schema),
@@ -74,10 +77,20 @@ AvroTable* avro_table_alloc(const char* filepath,
         return NULL;
     }
 
-    AvroTable* table = new(std::nothrow) AvroTable(avro_file, avro_writer_iface, avro_schema);
+    if (avro_generic_value_new(avro_writer_iface, &avro_record))
+    {
+        MXS_ERROR("Avro error: %s", avro_strerror());
+        avro_value_iface_decref(avro_writer_iface);
+        avro_schema_decref(avro_schema);
+        avro_file_writer_close(avro_file);
+        return NULL;
+    }
+
+    AvroTable* table = new(std::nothrow) AvroTable(avro_file, avro_writer_iface, avro_schema, avro_record);
 
     if (!table)
     {
+        avro_value_decref(&avro_record);
         avro_file_writer_close(avro_file);
         avro_value_iface_decref(avro_writer_iface);
         avro_schema_decref(avro_schema);
@@ -360,8 +373,8 @@ bool AvroConverter::prepare_table(const STableMapEvent& map, const STableCreateE
 
     if (it != m_open_tables.end())
     {
-        m_writer_iface = it->second->avro_writer_iface;
         m_avro_file = &it->second->avro_file;
+        m_record = &it->second->avro_record;
         m_map = map;
         m_create = create;
         rval = true;
@@ -380,85 +393,113 @@ void AvroConverter::flush_tables()
 
 void AvroConverter::prepare_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type)
 {
-    avro_generic_value_new(m_writer_iface, &m_record);
-    avro_value_get_by_name(&m_record, avro_domain, &m_field, NULL);
+    // The record is reused, resetting it keeps the memory of its values
+    avro_value_reset(m_record);
+
+    avro_value_get_by_name(m_record, avro_domain, &m_field, NULL);
     avro_value_set_int(&m_field, gtid.domain);
 
-    avro_value_get_by_name(&m_record, avro_server_id, &m_field, NULL);
+    avro_value_get_by_name(m_record, avro_server_id, &m_field, NULL);
     avro_value_set_int(&m_field, gtid.server_id);
 
-    avro_value_get_by_name(&m_record, avro_sequence, &m_field, NULL);
+    avro_value_get_by_name(m_record, avro_sequence, &m_field, NULL);
     avro_value_set_int(&m_field, gtid.seq);
 
-    avro_value_get_by_name(&m_record, avro_event_number, &m_field, NULL);
+    avro_value_get_by_name(m_record, avro_event_number, &m_field, NULL);
     avro_value_set_int(&m_field, gtid.event_num);
 
-    avro_value_get_by_name(&m_record, avro_timestamp, &m_field, NULL);
+    avro_value_get_by_name(m_record, avro_timestamp, &m_field, NULL);
     avro_value_set_int(&m_field, hdr.timestamp);
 
-    avro_value_get_by_name(&m_record, avro_event_type, &m_field, NULL);
+    avro_value_get_by_name(m_record, avro_event_type, &m_field, NULL);
     avro_value_set_enum(&m_field, event_type);
 }
 
-bool AvroConverter::commit(const gtid_pos_t& gtid)
+bool AvroConverter::process_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type, const Row& row)
 {
     bool rval = true;
 
-    if (avro_file_writer_append_value(*m_avro_file, &m_record))
+    /**
+     * The record is reused and resetting it does not unset its columns, so a
+     * column without a value would be written as a zero or empty value. Such
+     * rows, e.g. from a partial row image, are not written, as was the case
+     * when each row had a record of its own. The values are in the order of
+     * the columns, so the row is complete if it has as many values as the
+     * record has columns and the last one is for the last column.
+     */
+    size_t n_columns = std::min<size_t>(m_map->columns(), m_create->columns.size());
+
+    if (row.size() != n_columns || (n_columns > 0 && (size_t)row[n_columns - 1].column() != n_columns - 1))
     {
-        MXS_ERROR("Failed to write value: %s", avro_strerror());
+        MXS_ERROR("Failed to write value: the row of table %s.%s has values for %lu of its %lu columns.",
+                  m_map->database.c_str(),
+                  m_map->table.c_str(),
+                  row.size(),
+                  n_columns);
         rval = false;
     }
+    else
+    {
+        prepare_row(gtid, hdr, event_type);
 
-    return rval;
-}
-
-void AvroConverter::column(int i, int32_t value)
-{
-    set_active(i);
-    avro_value_set_int(&m_field, value);
-}
-
-void AvroConverter::column(int i, int64_t value)
-{
-    set_active(i);
-    avro_value_set_long(&m_field, value);
-}
-
-void AvroConverter::column(int i, float value)
-{
-    set_active(i);
-    avro_value_set_float(&m_field, value);
-}
+        for (const ColumnValue& value : row)
+        {
+            set_value(value);
+        }
 
-void AvroConverter::column(int i, double value)
-{
-    set_active(i);
-    avro_value_set_double(&m_field, value);
-}
+        if (avro_file_writer_append_value(*m_avro_file, m_record))
+        {
+            MXS_ERROR("Failed to write value: %s", avro_strerror());
+            rval = false;
+        }
+    }
 
-void AvroConverter::column(int i, std::string value)
-{
-    set_active(i);
-    avro_value_set_string(&m_field, value.c_str());
+    return rval;
 }
 
-void AvroConverter::column(int i, uint8_t* value, int len)
+void AvroConverter::set_value(const ColumnValue& value)
 {
-    set_active(i);
-    avro_value_set_bytes(&m_field, value, len);
-}
+    set_active(value.column());
 
-void AvroConverter::column(int i)
-{
-    set_active(i);
-    avro_value_set_branch(&m_union_value, 0, &m_field);
-    avro_value_set_null(&m_field);
+    switch (value.type())
+    {
+    case ColumnValue::NUL:
+        avro_value_set_branch(&m_union_value, 0, &m_field);
+        avro_value_set_null(&m_field);
+        break;
+
+    case ColumnValue::INT32:
+        avro_value_set_int(&m_field, value.get_int32());
+        break;
+
+    case ColumnValue::INT64:
+        avro_value_set_long(&m_field, value.get_int64());
+        break;
+
+    case ColumnValue::FLOAT:
+        avro_value_set_float(&m_field, value.get_float());
+        break;
+
+    case ColumnValue::DOUBLE:
+        avro_value_set_double(&m_field, value.get_double());
+        break;
+
+    case ColumnValue::STRING:
+        // Avro needs a NUL terminated string and the values have always been
+        // stored only up to the first NUL byte
+        m_string.assign(value.data(), strnlen(value.data(), value.length()));
+        avro_value_set_string_len(&m_field, m_string.c_str(), m_string.size() + 1);
+        break;
+
+    case ColumnValue::BYTES:
+        avro_value_set_bytes(&m_field, (void*)value.data(), value.length());
+        break;
+    }
 }
 
 void AvroConverter::set_active(int i)
 {
-    MXB_AT_DEBUG(int rc = ) avro_value_get_by_name(&m_record,
+    MXB_AT_DEBUG(int rc = ) avro_value_get_by_name(m_record,
                                                    m_create->columns[i].name.c_str(),
                                                    &m_union_value,
                                                    NULL);
@@ -19,15 +19,17 @@
 
 struct AvroTable
 {
-    AvroTable(avro_file_writer_t file, avro_value_iface_t* iface, avro_schema_t schema)
+    AvroTable(avro_file_writer_t file, avro_value_iface_t* iface, avro_schema_t schema, avro_value_t record)
         : avro_file(file)
         , avro_writer_iface(iface)
         , avro_schema(schema)
+        , avro_record(record)
     {
     }
 
     ~AvroTable()
     {
+        avro_value_decref(&avro_record);
         avro_file_writer_flush(avro_file);
         avro_file_writer_close(avro_file);
         avro_value_iface_decref(avro_writer_iface);
@@ -37,6 +39,7 @@ struct AvroTable
     avro_file_writer_t  avro_file;          /*< Current Avro data file */
     avro_value_iface_t* avro_writer_iface;  /*< Avro C API writer interface */
     avro_schema_t       avro_schema;        /*< Native Avro schema of the table */
+    avro_value_t        avro_record;        /*< Record reused for every row of the table */
 };
 
 typedef std::shared_ptr<AvroTable>                  SAvroTable;
@@ -51,20 +54,11 @@ public:
     bool open_table(const STableMapEvent& map, const STableCreateEvent& create);
     bool prepare_table(const STableMapEvent& map, const STableCreateEvent& create);
     void flush_tables();
-    void prepare_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type);
-    bool commit(const gtid_pos_t& gtid);
-    void column(int i, int32_t value);
-    void column(int i, int64_t value);
-    void column(int i, float value);
-    void column(int i, double value);
-    void column(int i, std::string value);
-    void column(int i, uint8_t* value, int len);
-    void column(int i);
+    bool process_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type, const Row& row);
 
 private:
-    avro_value_iface_t* m_writer_iface;
     avro_file_writer_t* m_avro_file;
-    avro_value_t        m_record;
+    avro_value_t*       m_record;
     avro_value_t        m_union_value;
     avro_value_t        m_field;
     std::string         m_avrodir;
@@ -73,6 +67,9 @@ private:
     mxs_avro_codec_type m_codec;
     STableMapEvent      m_map;
     STableCreateEvent   m_create;
+    std::string         m_string;   // NUL terminated copy of the current string value
 
+    void prepare_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type);
+    void set_value(const ColumnValue& value);
     void set_active(int i);
 };
@@ -41,6 +41,7 @@
 #include <binlog_common.h>
 
 #include "avro_converter.hh"
+#include "avro_parallel.hh"
 
 using namespace maxbase;
 
@@ -66,7 +67,20 @@ MXS_ROUTER* createInstance(SERVICE* service, MXS_CONFIG_PARAMETER* params)
                                                                                  "codec",
                                                                                  codec_values));
     std::string avrodir = config_get_string(service->svc_config_param, "avrodir");
-    SRowEventHandler handler(new AvroConverter(avrodir, block_size, codec));
+    int threads = config_get_integer(service->svc_config_param, "conversion_threads");
+    SRowEventHandler handler;
+
+    if (threads > 0)
+    {
+        handler.reset(new ParallelConverter(threads,
+                                            [avrodir, block_size, codec]() {
+                                                return new AvroConverter(avrodir, block_size, codec);
+                                            }));
+    }
+    else
+    {
+        handler.reset(new AvroConverter(avrodir, block_size, codec));
+    }
 
     Avro* router = Avro::create(service, handler);
 
@@ -542,6 +556,8 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
             {"codec",                             MXS_MODULE_PARAM_ENUM,  "null",
              MXS_MODULE_OPT_ENUM_UNIQUE,
              codec_values},
+            {"conversion_threads",                MXS_MODULE_PARAM_COUNT,
+             "0"},
             {"match",
              MXS_MODULE_PARAM_REGEX},
             {"exclude",
@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "avrorouter.hh"
+#include "avro_parallel.hh"
+
+#include <maxbase/assert.h>
+#include <maxscale/log.h>
+
+namespace
+{
+
+// A batch is handed over to the worker once it holds this many rows or bytes
+const size_t BATCH_MAX_ROWS = 1000;
+const size_t BATCH_MAX_BYTES = 1024 * 1024;
+
+// How many batches may wait for a worker before the conversion task waits
+const size_t MAX_QUEUED_BATCHES = 16;
+
+/** A column value of a stored row */
+struct Value
+{
+    ColumnValue value;
+    size_t      offset;     /*< Offset of a STRING or BYTES value in Batch::data */
+};
+
+/** An operation for the handler of a worker */
+struct Op
+{
+    enum Type
+    {
+        CREATE,
+        OPEN,
+        PREPARE,
+        ROW,
+        FLUSH
+    };
+
+    Type              type;
+    STableMapEvent    map;          /*< OPEN and PREPARE */
+    STableCreateEvent create;       /*< CREATE, OPEN and PREPARE */
+    bool*             result;       /*< Result of OPEN */
+    gtid_pos_t        gtid;         /*< ROW */
+    REP_HEADER        hdr;          /*< ROW */
+    int               event_type;   /*< ROW */
+    size_t            first_value;  /*< ROW, index of its first value in Batch::values */
+    size_t            n_values;     /*< ROW */
+};
+
+/** A batch of operations for one worker */
+struct Batch
+{
+    std::vector<Op>      ops;
+    std::vector<Value>   values;
+    std::vector<uint8_t> data;
+    size_t               n_rows = 0;
+};
+}
+
+/**
+ * A worker thread that converts the rows of the tables assigned to it
+ */
+class ConversionWorker
+{
+public:
+    ConversionWorker(const ConversionWorker&) = delete;
+    ConversionWorker& operator=(const ConversionWorker&) = delete;
+
+    ConversionWorker(RowEventHandler* handler)
+        : m_handler(handler)
+        , m_batch(new Batch)
+        , m_posted(0)
+        , m_processed(0)
+        , m_stop(false)
+        , m_thread(&ConversionWorker::run, this)
+    {
+    }
+
+    ~ConversionWorker()
+    {
+        post();
+
+        {
+            std::lock_guard<std::mutex> guard(m_lock);
+            m_stop = true;
+        }
+
+        m_work_cond.notify_one();
+        m_thread.join();
+    }
+
+    // The batch being filled by the conversion task
+    Batch& batch()
+    {
+        return *m_batch;
+    }
+
+    /**
+     * Hand the current batch over to the worker
+     *
+     * @return The sequence number of the batch
+     */
+    uint64_t post()
+    {
+        std::unique_lock<std::mutex> guard(m_lock);
+
+        if (!m_batch->ops.empty())
+        {
+            m_done_cond.wait(guard, [this]() {
+                                 return m_queue.size() < MAX_QUEUED_BATCHES;
+                             });
+
+            m_queue.push_back(std::move(m_batch));
+            m_batch.reset(new Batch);
+            m_posted++;
+            m_work_cond.notify_one();
+        }
+
+        return m_posted;
+    }
+
+    // Wait until the worker has processed the batch with the given sequence number
+    void wait(uint64_t seqno)
+    {
+        std::unique_lock<std::mutex> guard(m_lock);
+        m_done_cond.wait(guard, [this, seqno]() {
+                             return m_processed >= seqno;
+                         });
+    }
+
+private:
+    std::unique_ptr<RowEventHandler>    m_handler;
+    std::unique_ptr<Batch>              m_batch;        // Only used by the conversion task
+    std::deque<std::unique_ptr<Batch>>  m_queue;
+    uint64_t                            m_posted;       // Batches posted, only used by the conversion task
+    uint64_t                            m_processed;    // Batches processed
+    bool                                m_stop;
+    std::mutex                          m_lock;
+    std::condition_variable             m_work_cond;    // Signaled when a batch is posted
+    std::condition_variable             m_done_cond;    // Signaled when a batch is processed
+    Row                                 m_row;          // Only used by the worker
+    std::thread                         m_thread;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> guard(m_lock);
+
+        while (true)
+        {
+            m_work_cond.wait(guard, [this]() {
+                                 return m_stop || !m_queue.empty();
+                             });
+
+            if (m_queue.empty())
+            {
+                break;
+            }
+
+            std::unique_ptr<Batch> batch = std::move(m_queue.front());
+            m_queue.pop_front();
+            guard.unlock();
+
+            process(*batch);
+            batch.reset();
+
+            guard.lock();
+            m_processed++;
+            m_done_cond.notify_all();
+        }
+    }
+
+    void process(Batch& batch)
+    {
+        bool prepared = false;
+
+        for (const Op& op : batch.ops)
+        {
+            switch (op.type)
+            {
+            case Op::CREATE:
+                m_handler->create_table(op.create);
+                break;
+
+            case Op::OPEN:
+                *op.result = m_handler->open_table(op.map, op.create);
+                break;
+
+            case Op::PREPARE:
+                prepared = m_handler->prepare_table(op.map, op.create);
+
+                if (!prepared)
+                {
+                    MXS_ERROR("Avro file handle was not found for table %s.%s.",
+                              op.map->database.c_str(),
+                              op.map->table.c_str());
+                }
+                break;
+
+            case Op::ROW:
+                if (prepared)
+                {
+                    process_row(batch, op);
+                }
+                break;
+
+            case Op::FLUSH:
+                m_handler->flush_tables();
+                break;
+            }
+        }
+    }
+
+    void process_row(Batch& batch, const Op& op)
+    {
+        m_row.clear();
+
+        for (size_t i = op.first_value; i < op.first_value + op.n_values; i++)
+        {
+            const ColumnValue& value = batch.values[i].value;
+
+            if (value.type() == ColumnValue::STRING || value.type() == ColumnValue::BYTES)
+            {
+                // The data was copied into the batch, point the value to the copy
+                m_row.add(ColumnValue(value.column(),
+                                      value.type(),
+                                      (char*)&batch.data[batch.values[i].offset],
+                                      value.length()));
+            }
+            else
+            {
+                m_row.add(value);
+            }
+        }
+
+        m_handler->process_row(op.gtid, op.hdr, op.event_type, m_row);
+    }
+};
+
+ParallelConverter::ParallelConverter(int n_workers, RowEventHandlerFactory factory)
+    : m_current(nullptr)
+{
+    mxb_assert(n_workers > 0);
+
+    for (int i = 0; i < n_workers; i++)
+    {
+        m_workers.emplace_back(new ConversionWorker(factory()));
+    }
+}
+
+ParallelConverter::~ParallelConverter()
+{
+}
+
+ConversionWorker* ParallelConverter::worker_for(const std::string& database, const std::string& table)
+{
+    size_t hash = std::hash<std::string>()(database + '.' + table);
+    return m_workers[hash % m_workers.size()].get();
+}
+
+STableCreateEvent ParallelConverter::snapshot(const STableCreateEvent& create, bool refresh)
+{
+    Snapshot& snapshot = m_snapshots[create->id()];
+
+    if (refresh || snapshot.original != create)
+    {
+        snapshot.original = create;
+        snapshot.copy = std::make_shared<TableCreateEvent>(*create);
+    }
+
+    return snapshot.copy;
+}
+
+bool ParallelConverter::create_table(const STableCreateEvent& create)
+{
+    Op op = {};
+    op.type = Op::CREATE;
+    op.create = snapshot(create, true);
+    worker_for(create->database, create->table)->batch().ops.push_back(std::move(op));
+    return true;
+}
+
+bool ParallelConverter::open_table(const STableMapEvent& map, const STableCreateEvent& create)
+{
+    ConversionWorker* worker = worker_for(map->database, map->table);
+    bool rval = false;
+
+    Op op = {};
+    op.type = Op::OPEN;
+    op.map = map;
+    op.create = snapshot(create, true);
+    op.result = &rval;
+    worker->batch().ops.push_back(std::move(op));
+
+    // The result is needed right away, the Avro file is opened by the worker
+    worker->wait(worker->post());
+
+    if (rval)
+    {
+        m_open_tables.insert(map->database + '.' + map->table);
+    }
+
+    return rval;
+}
+
+bool ParallelConverter::prepare_table(const STableMapEvent& map, const STableCreateEvent& create)
+{
+    bool rval = false;
+
+    if (m_open_tables.count(map->database + '.' + map->table))
+    {
+        m_current = worker_for(map->database, map->table);
+
+        Op op = {};
+        op.type = Op::PREPARE;
+        op.map = map;
+        op.create = snapshot(create, false);
+        m_current->batch().ops.push_back(std::move(op));
+        rval = true;
+    }
+
+    return rval;
+}
+
+void ParallelConverter::flush_tables()
+{
+    std::vector<uint64_t> seqnos;
+
+    for (auto& worker : m_workers)
+    {
+        Op op = {};
+        op.type = Op::FLUSH;
+        worker->batch().ops.push_back(std::move(op));
+        seqnos.push_back(worker->post());
+    }
+
+    for (size_t i = 0; i < m_workers.size(); i++)
+    {
+        m_workers[i]->wait(seqnos[i]);
+    }
+}
+
+bool ParallelConverter::process_row(const gtid_pos_t& gtid,
+                                    const REP_HEADER& hdr,
+                                    int event_type,
+                                    const Row& row)
+{
+    mxb_assert(m_current);
+    Batch& batch = m_current->batch();
+
+    Op op = {};
+    op.type = Op::ROW;
+    op.gtid = gtid;
+    op.hdr = hdr;
+    op.event_type = event_type;
+    op.first_value = batch.values.size();
+    op.n_values = row.size();
+    batch.ops.push_back(std::move(op));
+
+    for (const ColumnValue& value : row)
+    {
+        Value v = {value, batch.data.size()};
+
+        if (value.type() == ColumnValue::STRING || value.type() == ColumnValue::BYTES)
+        {
+            // The row is only valid during this call
+            batch.data.insert(batch.data.end(), value.data(), value.data() + value.length());
+        }
+
+        batch.values.push_back(v);
+    }
+
+    if (++batch.n_rows >= BATCH_MAX_ROWS || batch.data.size() >= BATCH_MAX_BYTES)
+    {
+        m_current->post();
+    }
+
+    return true;
+}
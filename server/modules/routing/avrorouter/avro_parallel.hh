@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+#pragma once
+
+#include "rpl.hh"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Creates the handler that a conversion worker passes the rows to
+typedef std::function<RowEventHandler* ()> RowEventHandlerFactory;
+
+class ConversionWorker;
+
+/**
+ * Distributes the conversion of the rows over a pool of worker threads
+ *
+ * The binlog events are still decoded by Rpl in the conversion task but the
+ * decoded rows are stored and handed over in batches to the worker threads.
+ * Each worker has its own handler, e.g. an AvroConverter, that converts the
+ * rows and writes them to disk. A table is always handled by the same worker,
+ * so the rows of a table are converted in the order they were replicated.
+ *
+ * Tables are opened and flushed synchronously: when flush_tables() returns,
+ * all rows given before it have been written by the workers and the
+ * conversion state can be saved.
+ *
+ * The table definitions are modified in place by ALTER TABLE statements, so
+ * the workers are given copies of them that are only replaced when the table
+ * is created or opened again.
+ */
+class ParallelConverter : public RowEventHandler
+{
+public:
+    ParallelConverter(const ParallelConverter&) = delete;
+    ParallelConverter& operator=(const ParallelConverter&) = delete;
+
+    /**
+     * Create a new converter
+     *
+     * @param n_workers Number of worker threads
+     * @param factory   Creates the handler of each worker
+     */
+    ParallelConverter(int n_workers, RowEventHandlerFactory factory);
+    ~ParallelConverter();
+
+    bool create_table(const STableCreateEvent& create);
+    bool open_table(const STableMapEvent& map, const STableCreateEvent& create);
+    bool prepare_table(const STableMapEvent& map, const STableCreateEvent& create);
+    void flush_tables();
+    bool process_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type, const Row& row);
+
+private:
+    struct Snapshot
+    {
+        STableCreateEvent original;
+        STableCreateEvent copy;
+    };
+
+    std::vector<std::unique_ptr<ConversionWorker>> m_workers;
+    std::unordered_set<std::string>                m_open_tables;   // Tables the workers have opened
+    std::unordered_map<std::string, Snapshot>      m_snapshots;     // Table definitions given to workers
+    ConversionWorker*                              m_current;       // Worker of the table being processed
+
+    ConversionWorker* worker_for(const std::string& database, const std::string& table);
+    STableCreateEvent snapshot(const STableCreateEvent& create, bool refresh);
+};
@@ -66,13 +66,13 @@ static int get_event_type(uint8_t event)
  *
  * Convert the raw binary data into actual numeric types.
  *
- * @param conv     Event converter to use
+ * @param row      Row where the value is added
  * @param idx      Position of this column in the row
  * @param type     Event type
  * @param metadata Field metadata
  * @param value    Pointer to the start of the in-memory representation of the data
  */
-void set_numeric_field_value(SRowEventHandler& conv,
+void set_numeric_field_value(Row& row,
                              int idx,
                              uint8_t type,
                              uint8_t* metadata,
@@ -83,14 +83,14 @@ void set_numeric_field_value(SRowEventHandler& conv,
     case TABLE_COL_TYPE_TINY:
         {
             char c = *value;
-            conv->column(idx, c);
+            row.add(ColumnValue(idx, c));
             break;
         }
 
     case TABLE_COL_TYPE_SHORT:
         {
             short s = gw_mysql_get_byte2(value);
-            conv->column(idx, s);
+            row.add(ColumnValue(idx, s));
             break;
         }
 
@@ -103,21 +103,21 @@ void set_numeric_field_value(SRowEventHandler& conv,
                 x = -((0xffffff & (~x)) + 1);
             }
 
-            conv->column(idx, x);
+            row.add(ColumnValue(idx, x));
             break;
         }
 
     case TABLE_COL_TYPE_LONG:
         {
             int x = gw_mysql_get_byte4(value);
-            conv->column(idx, x);
+            row.add(ColumnValue(idx, x));
             break;
         }
 
     case TABLE_COL_TYPE_LONGLONG:
         {
             long l = gw_mysql_get_byte8(value);
-            conv->column(idx, l);
+            row.add(ColumnValue(idx, l));
             break;
         }
 
@@ -125,7 +125,7 @@ void set_numeric_field_value(SRowEventHandler& conv,
         {
             float f = 0;
             memcpy(&f, value, 4);
-            conv->column(idx, f);
+            row.add(ColumnValue(idx, f));
             break;
         }
 
@@ -133,7 +133,7 @@ void set_numeric_field_value(SRowEventHandler& conv,
         {
             double d = 0;
             memcpy(&d, value, 8);
-            conv->column(idx, d);
+            row.add(ColumnValue(idx, d));
             break;
         }
 
@@ -230,7 +230,7 @@ static bool all_fields_null(uint8_t* null_bitmap, int ncolumns)
  *
  * @param map Table map event associated with this row
  * @param create Table creation associated with this row
- * @param record Avro record used for storing this row
+ * @param row Row where the decoded values are stored
  * @param ptr Pointer to the start of the row data, should be after the row event header
  * @param columns_present The bitfield holding the columns that are present for
  * this row event. Currently this should be a bitfield which has all bits set.
@@ -238,7 +238,7 @@ static bool all_fields_null(uint8_t* null_bitmap, int ncolumns)
  */
 uint8_t* process_row_event_data(STableMapEvent map,
                                 STableCreateEvent create,
-                                SRowEventHandler& conv,
+                                Row& row,
                                 uint8_t* ptr,
                                 uint8_t* columns_present,
                                 uint8_t* end)
@@ -260,6 +260,7 @@ uint8_t* process_row_event_data(STableMapEvent map,
 
     char trace[ncolumns][768];
     memset(trace, 0, sizeof(trace));
+    row.clear();
 
     for (long i = 0; i < ncolumns && npresent < ncolumns; i++)
     {
@@ -270,7 +271,7 @@ uint8_t* process_row_event_data(STableMapEvent map,
             if (bit_is_set(null_bitmap, ncolumns, i))
             {
                 sprintf(trace[i], "[%ld] NULL", i);
-                conv->column(i);
+                row.add(ColumnValue(i));
             }
             else if (column_is_fixed_string(map->column_types[i]))
             {
@@ -282,7 +283,7 @@ uint8_t* process_row_event_data(STableMapEvent map,
                     uint64_t bytes = unpack_enum(ptr, &metadata[metadata_offset], val);
                     char strval[bytes * 2 + 1];
                     gw_bin2hex(strval, val, bytes);
-                    conv->column(i, strval);
+                    row.add_copy(i, strval, bytes * 2);
                     sprintf(trace[i], "[%ld] ENUM: %lu bytes", i, bytes);
                     ptr += bytes;
                     check_overflow(ptr <= end);
@@ -316,10 +317,7 @@ uint8_t* process_row_event_data(STableMapEvent map,
                     }
 
                     sprintf(trace[i], "[%ld] CHAR: field: %d bytes, data: %d bytes", i, field_length, bytes);
-                    char str[bytes + 1];
-                    memcpy(str, ptr, bytes);
-                    str[bytes] = '\0';
-                    conv->column(i, str);
+                    row.add(ColumnValue(i, ColumnValue::STRING, (char*)ptr, bytes));
                     ptr += bytes;
                     check_overflow(ptr <= end);
                 }
@@ -336,7 +334,7 @@ uint8_t* process_row_event_data(STableMapEvent map,
                     warn_bit = true;
                     MXS_WARNING("BIT is not currently supported, values are stored as 0.");
                 }
-                conv->column(i, 0);
+                row.add(ColumnValue(i, 0));
                 sprintf(trace[i], "[%ld] BIT", i);
                 ptr += bytes;
                 check_overflow(ptr <= end);
@@ -345,7 +343,7 @@ uint8_t* process_row_event_data(STableMapEvent map,
             {
                 double f_value = 0.0;
                 ptr += unpack_decimal_field(ptr, metadata + metadata_offset, &f_value);
-                conv->column(i, f_value);
+                row.add(ColumnValue(i, f_value));
                 sprintf(trace[i], "[%ld] DECIMAL", i);
                 check_overflow(ptr <= end);
             }
@@ -365,11 +363,8 @@ uint8_t* process_row_event_data(STableMapEvent map,
                 }
 
                 sprintf(trace[i], "[%ld] VARCHAR: field: %d bytes, data: %lu bytes", i, bytes, sz);
-                char buf[sz + 1];
-                memcpy(buf, ptr, sz);
-                buf[sz] = '\0';
+                row.add(ColumnValue(i, ColumnValue::STRING, (char*)ptr, sz));
                 ptr += sz;
-                conv->column(i, buf);
                 check_overflow(ptr <= end);
             }
             else if (column_is_blob(map->column_types[i]))
@@ -381,13 +376,13 @@ uint8_t* process_row_event_data(STableMapEvent map,
                 sprintf(trace[i], "[%ld] BLOB: field: %d bytes, data: %lu bytes", i, bytes, len);
                 if (len)
                 {
-                    conv->column(i, ptr, len);
+                    row.add(ColumnValue(i, ColumnValue::BYTES, (char*)ptr, len));
                     ptr += len;
                 }
                 else
                 {
-                    uint8_t nullvalue = 0;
-                    conv->column(i, &nullvalue, 1);
+                    static const char nullvalue = 0;
+                    row.add(ColumnValue(i, ColumnValue::BYTES, &nullvalue, 1));
                 }
                 check_overflow(ptr <= end);
             }
@@ -401,7 +396,7 @@ uint8_t* process_row_event_data(STableMapEvent map,
                                              create->columns[i].length,
                                              &tm);
                 format_temporal_value(buf, sizeof(buf), map->column_types[i], &tm);
-                conv->column(i, buf);
+                row.add_copy(i, buf, strlen(buf));
                 sprintf(trace[i], "[%ld] %s: %s", i, column_type_to_string(map->column_types[i]), buf);
                 check_overflow(ptr <= end);
             }
@@ -414,7 +409,7 @@ uint8_t* process_row_event_data(STableMapEvent map,
                                             map->column_types[i],
                                             &metadata[metadata_offset],
                                             lval);
-                set_numeric_field_value(conv, i, map->column_types[i], &metadata[metadata_offset], lval);
+                set_numeric_field_value(row, i, map->column_types[i], &metadata[metadata_offset], lval);
                 sprintf(trace[i], "[%ld] %s", i, column_type_to_string(map->column_types[i]));
                 check_overflow(ptr <= end);
             }
@@ -650,9 +645,8 @@ bool Rpl::handle_row_event(REP_HEADER* hdr, uint8_t* ptr)
                 // Increment the event count for this transaction
                 m_gtid.event_num++;
 
-                m_handler->prepare_row(m_gtid, *hdr, event_type);
-                ptr = process_row_event_data(map, create->second, m_handler, ptr, col_present, end);
-                m_handler->commit(m_gtid);
+                ptr = process_row_event_data(map, create->second, m_row, ptr, col_present, end);
+                m_handler->process_row(m_gtid, *hdr, event_type, m_row);
 
                 /** Update rows events have the before and after images of the
                  * affected rows so we'll process them as another record with
@@ -660,9 +654,8 @@ bool Rpl::handle_row_event(REP_HEADER* hdr, uint8_t* ptr)
                 if (event_type == UPDATE_EVENT)
                 {
                     m_gtid.event_num++;
-                    m_handler->prepare_row(m_gtid, *hdr, UPDATE_EVENT_AFTER);
-                    ptr = process_row_event_data(map, create->second, m_handler, ptr, col_present, end);
-                    m_handler->commit(m_gtid);
+                    ptr = process_row_event_data(map, create->second, m_row, ptr, col_present, end);
+                    m_handler->process_row(m_gtid, *hdr, UPDATE_EVENT_AFTER, m_row);
                 }
 
                 rows++;
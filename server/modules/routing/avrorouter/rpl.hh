@@ -14,11 +14,13 @@
 
 #include <vector>
 #include <cstdint>
+#include <deque>
 #include <string>
 #include <sstream>
 #include <memory>
 #include <unordered_map>
 
+#include <maxbase/assert.h>
 #include <maxscale/pcre2.h>
 #include <maxscale/service.h>
 #include <binlog_common.h>
@@ -163,6 +165,202 @@ typedef std::unordered_map<std::string, STableCreateEvent> CreatedTables;
 typedef std::unordered_map<std::string, STableMapEvent>    MappedTables;
 typedef std::unordered_map<uint64_t, STableMapEvent>       ActiveMaps;
 
+// A column value of a decoded row
+class ColumnValue
+{
+public:
+    enum Type
+    {
+        NUL,
+        INT32,
+        INT64,
+        FLOAT,
+        DOUBLE,
+        STRING,
+        BYTES
+    };
+
+    // Empty (NULL) value, explicit so that an int is never taken for one
+    explicit ColumnValue(int column = 0)
+        : m_column(column)
+        , m_type(NUL)
+        , m_len(0)
+    {
+        m_data = nullptr;
+    }
+
+    ColumnValue(int column, int32_t value)
+        : m_column(column)
+        , m_type(INT32)
+        , m_len(0)
+    {
+        m_int32 = value;
+    }
+
+    ColumnValue(int column, int64_t value)
+        : m_column(column)
+        , m_type(INT64)
+        , m_len(0)
+    {
+        m_int64 = value;
+    }
+
+    ColumnValue(int column, float value)
+        : m_column(column)
+        , m_type(FLOAT)
+        , m_len(0)
+    {
+        m_float = value;
+    }
+
+    ColumnValue(int column, double value)
+        : m_column(column)
+        , m_type(DOUBLE)
+        , m_len(0)
+    {
+        m_double = value;
+    }
+
+    // STRING or BYTES value, the data is not copied
+    ColumnValue(int column, Type type, const char* data, size_t len)
+        : m_column(column)
+        , m_type(type)
+        , m_len(len)
+    {
+        mxb_assert(type == STRING || type == BYTES);
+        m_data = data;
+    }
+
+    // Index of the column in the table
+    int column() const
+    {
+        return m_column;
+    }
+
+    Type type() const
+    {
+        return m_type;
+    }
+
+    int32_t get_int32() const
+    {
+        mxb_assert(m_type == INT32);
+        return m_int32;
+    }
+
+    int64_t get_int64() const
+    {
+        mxb_assert(m_type == INT64);
+        return m_int64;
+    }
+
+    float get_float() const
+    {
+        mxb_assert(m_type == FLOAT);
+        return m_float;
+    }
+
+    double get_double() const
+    {
+        mxb_assert(m_type == DOUBLE);
+        return m_double;
+    }
+
+    // The data of a STRING or BYTES value, it is not NUL terminated
+    const char* data() const
+    {
+        mxb_assert(m_type == STRING || m_type == BYTES);
+        return m_data;
+    }
+
+    // The length of a STRING or BYTES value
+    size_t length() const
+    {
+        return m_len;
+    }
+
+private:
+    int  m_column;
+    Type m_type;
+
+    union
+    {
+        int32_t     m_int32;
+        int64_t     m_int64;
+        float       m_float;
+        double      m_double;
+        const char* m_data;
+    };
+
+    size_t m_len;
+};
+
+/**
+ * A decoded row
+ *
+ * The STRING and BYTES values point into the replicated event or into the
+ * buffers of the row and are only valid until the next row is decoded. The
+ * same object is used for all rows, so decoding a row does not allocate memory
+ * once the containers have grown large enough.
+ */
+class Row
+{
+public:
+    typedef std::vector<ColumnValue>::const_iterator const_iterator;
+
+    const_iterator begin() const
+    {
+        return m_values.begin();
+    }
+
+    const_iterator end() const
+    {
+        return m_values.end();
+    }
+
+    size_t size() const
+    {
+        return m_values.size();
+    }
+
+    const ColumnValue& operator[](size_t i) const
+    {
+        return m_values[i];
+    }
+
+    // Remove all values, the buffers are kept for the next row
+    void clear()
+    {
+        m_values.clear();
+        m_used = 0;
+    }
+
+    // Add a value, the values are added in the order of the columns
+    void add(const ColumnValue& value)
+    {
+        m_values.push_back(value);
+    }
+
+    // Add a STRING value that is copied into a buffer of the row
+    void add_copy(int column, const char* str, size_t len)
+    {
+        if (m_used == m_buffers.size())
+        {
+            // A deque never moves its elements when it grows
+            m_buffers.emplace_back();
+        }
+
+        std::string& buffer = m_buffers[m_used++];
+        buffer.assign(str, len);
+        m_values.emplace_back(column, ColumnValue::STRING, buffer.data(), buffer.size());
+    }
+
+private:
+    std::vector<ColumnValue> m_values;
+    std::deque<std::string>  m_buffers;
+    size_t                   m_used = 0;    // Buffers used by the current row
+};
+
 // Handler class for row based replication events
 class RowEventHandler
 {
@@ -194,32 +392,8 @@ public:
     {
     }
 
-    // Prepare a new row for processing
-    virtual void prepare_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type) = 0;
-
-    // Called once all columns are processed
-    virtual bool commit(const gtid_pos_t& gtid) = 0;
-
-    // 32-bit integer handler
-    virtual void column(int i, int32_t value) = 0;
-
-    // 64-bit integer handler
-    virtual void column(int i, int64_t value) = 0;
-
-    // Float handler
-    virtual void column(int i, float value) = 0;
-
-    // Double handler
-    virtual void column(int i, double value) = 0;
-
-    // String handler
-    virtual void column(int i, std::string value) = 0;
-
-    // Bytes handler
-    virtual void column(int i, uint8_t* value, int len) = 0;
-
-    // Empty (NULL) value type handler
-    virtual void column(int i) = 0;
+    // Process a decoded row of the prepared table, the row is only valid during the call
+    virtual bool process_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type, const Row& row) = 0;
 };
 
 typedef std::auto_ptr<RowEventHandler> SRowEventHandler;
@@ -282,6 +456,7 @@ private:
     pcre2_code*       m_exclude;
     pcre2_match_data* m_md_match;
     pcre2_match_data* m_md_exclude;
+    Row               m_row;
 
     void              handle_query_event(REP_HEADER* hdr, uint8_t* ptr);
     bool              handle_table_map_event(REP_HEADER* hdr, uint8_t* ptr);
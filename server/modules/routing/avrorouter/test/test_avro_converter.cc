@@ -0,0 +1,290 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../avro_converter.hh"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <maxscale/log.h>
+
+namespace
+{
+
+static_assert(!std::is_convertible<int, ColumnValue>::value,
+              "An int must not be implicitly converted into a NULL value");
+
+int test_column_value()
+{
+    int rval = 0;
+    const char str[] = "abc";
+
+    ColumnValue null(3);
+    ColumnValue int32(1, (int32_t)-5);
+    ColumnValue int64(2, (int64_t)1 << 40);
+    ColumnValue flt(4, 1.5f);
+    ColumnValue dbl(5, 2.25);
+    ColumnValue string(6, ColumnValue::STRING, str, 2);
+
+    if (null.type() != ColumnValue::NUL || null.column() != 3
+        || int32.type() != ColumnValue::INT32 || int32.get_int32() != -5
+        || int64.type() != ColumnValue::INT64 || int64.get_int64() != (int64_t)1 << 40
+        || flt.type() != ColumnValue::FLOAT || flt.get_float() != 1.5f
+        || dbl.type() != ColumnValue::DOUBLE || dbl.get_double() != 2.25
+        || string.type() != ColumnValue::STRING || string.column() != 6)
+    {
+        printf("A column value does not have the type, column or value it was created with\n");
+        rval++;
+    }
+
+    if (string.data() != str || string.length() != 2)
+    {
+        printf("A STRING value should refer to the data it was created with\n");
+        rval++;
+    }
+
+    return rval;
+}
+
+int test_row()
+{
+    int rval = 0;
+    Row row;
+    std::vector<std::string> expected;
+
+    // More copies than the deque of buffers has in one block
+    for (int i = 0; i < 100; i++)
+    {
+        expected.push_back("value " + std::to_string(i) + std::string(40, 'x'));
+        row.add_copy(i, expected[i].c_str(), expected[i].length());
+    }
+
+    for (int i = 0; i < 100; i++)
+    {
+        if (row[i].column() != i || std::string(row[i].data(), row[i].length()) != expected[i])
+        {
+            printf("Copied value %d is no longer intact\n", i);
+            rval++;
+            break;
+        }
+    }
+
+    const char* buffer = row[0].data();
+    row.clear();
+
+    if (row.size() != 0)
+    {
+        printf("A cleared row should be empty\n");
+        rval++;
+    }
+
+    row.add(ColumnValue(0));
+    row.add_copy(1, expected[1].c_str(), expected[1].length());
+
+    if (row.size() != 2 || row[0].type() != ColumnValue::NUL
+        || std::string(row[1].data(), row[1].length()) != expected[1])
+    {
+        printf("A cleared row should hold the values added to it\n");
+        rval++;
+    }
+    else if (row[1].data() != buffer)
+    {
+        printf("A cleared row should reuse its buffers\n");
+        rval++;
+    }
+
+    return rval;
+}
+
+// The value of a column of a record, as a string
+std::string get_column(avro_value_t* record, const char* name)
+{
+    std::string rval = "?";
+    avro_value_t union_value;
+    avro_value_t branch;
+    int discriminant;
+    int32_t i;
+    const char* str;
+    size_t size;
+
+    if (avro_value_get_by_name(record, name, &union_value, NULL) == 0
+        && avro_value_get_discriminant(&union_value, &discriminant) == 0
+        && avro_value_get_current_branch(&union_value, &branch) == 0)
+    {
+        if (discriminant == 0)
+        {
+            rval = "NULL";
+        }
+        else if (avro_value_get_int(&branch, &i) == 0)
+        {
+            rval = std::to_string(i);
+        }
+        else if (avro_value_get_string(&branch, &str, &size) == 0)
+        {
+            rval = std::string(str, size - 1);
+        }
+    }
+
+    return rval;
+}
+
+// Read the sequence numbers and the columns of the rows in an Avro file
+std::vector<std::string> read_rows(const std::string& path)
+{
+    std::vector<std::string> rows;
+    avro_file_reader_t reader;
+
+    if (avro_file_reader(path.c_str(), &reader) == 0)
+    {
+        avro_value_iface_t* iface = avro_generic_class_from_schema(avro_file_reader_get_writer_schema(reader));
+        avro_value_t record;
+        avro_generic_value_new(iface, &record);
+
+        while (avro_file_reader_read_value(reader, &record) == 0)
+        {
+            avro_value_t field;
+            int32_t seq = -1;
+            avro_value_get_by_name(&record, avro_sequence, &field, NULL);
+            avro_value_get_int(&field, &seq);
+
+            rows.push_back(std::to_string(seq) + ": "
+                           + get_column(&record, "id") + ", " + get_column(&record, "name"));
+        }
+
+        avro_value_decref(&record);
+        avro_value_iface_decref(iface);
+        avro_file_reader_close(reader);
+    }
+    else
+    {
+        printf("Could not open %s: %s\n", path.c_str(), avro_strerror());
+    }
+
+    return rows;
+}
+
+/**
+ * Writes rows with a reused record: the values of the previous rows must not
+ * leak into the next ones and incomplete rows are not written
+ */
+int test_record_reuse()
+{
+    int rval = 0;
+    char dir[] = "/tmp/test_avro_converter_XXXXXX";
+
+    if (!mkdtemp(dir))
+    {
+        printf("Could not create directory: %d\n", errno);
+        return 1;
+    }
+
+    std::vector<Column> columns {Column("id", "int"), Column("name", "varchar")};
+    STableCreateEvent create(new TableCreateEvent("test", "t1", 1, std::move(columns)));
+    Bytes types {TABLE_COL_TYPE_LONG, TABLE_COL_TYPE_VARCHAR};
+    STableMapEvent map(new TableMapEvent("test", "t1", 1, 1, std::move(types), Bytes(1), Bytes(4)));
+    std::string path = std::string(dir) + "/test.t1.000001.avro";
+
+    {
+        AvroConverter converter(dir, 1024, MXS_AVRO_CODEC_NULL);
+
+        if (converter.open_table(map, create) && converter.prepare_table(map, create))
+        {
+            const char* names[] = {"first", "second", NULL, NULL, "fifth"};
+            const bool written[] = {true, true, true, false, true};
+            gtid_pos_t gtid;
+            REP_HEADER hdr = {};
+            Row row;
+
+            for (int i = 0; i < 5; i++)
+            {
+                row.clear();
+                row.add(i == 1 ? ColumnValue(0) : ColumnValue(0, (int32_t)i));
+
+                // The fourth row misses its last column, as in a partial row image
+                if (names[i])
+                {
+                    row.add(ColumnValue(1, ColumnValue::STRING, names[i], strlen(names[i])));
+                }
+                else if (i == 2)
+                {
+                    row.add(ColumnValue(1));
+                }
+
+                gtid.seq = i;
+
+                // An insert, the first of the EVENT_TYPES symbols
+                if (converter.process_row(gtid, hdr, 0, row) != written[i])
+                {
+                    printf("Row %d should %sbe written\n", i, written[i] ? "" : "not ");
+                    rval++;
+                }
+            }
+
+            converter.flush_tables();
+        }
+        else
+        {
+            printf("Could not open the Avro file\n");
+            rval++;
+        }
+    }
+
+    std::vector<std::string> expected {"0: 0, first", "1: NULL, second", "2: 2, NULL", "4: 4, fifth"};
+    std::vector<std::string> rows = read_rows(path);
+
+    if (rows != expected)
+    {
+        printf("Expected the rows:\n");
+
+        for (const auto& r : expected)
+        {
+            printf("  %s\n", r.c_str());
+        }
+
+        printf("got:\n");
+
+        for (const auto& r : rows)
+        {
+            printf("  %s\n", r.c_str());
+        }
+
+        rval++;
+    }
+
+    unlink(path.c_str());
+    unlink((std::string(dir) + "/test.t1.000001.avsc").c_str());
+    rmdir(dir);
+
+    return rval;
+}
+}
+
+int main(int argc, char** argv)
+{
+    int rval = 0;
+
+    mxs_log_init(NULL, NULL, MXS_LOG_TARGET_DEFAULT);
+
+    rval += test_column_value();
+    rval += test_row();
+    rval += test_record_reuse();
+
+    mxs_log_finish();
+
+    return rval;
+}
@@ -0,0 +1,309 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../avrorouter.hh"
+#include "../avro_parallel.hh"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <maxscale/log.h>
+
+namespace
+{
+
+// More rows than fit in one batch
+const int N_ROWS = 5000;
+const int N_TABLES = 4;
+const int N_WORKERS = 3;
+
+/** A row as a handler received it */
+struct Received
+{
+    int64_t     id;
+    std::string str;
+    size_t      n_columns;  /*< Number of columns of the prepared table */
+};
+
+/** What the handlers of all the workers received */
+struct Recording
+{
+    std::mutex                                   lock;
+    std::map<std::string, std::vector<Received>> rows;      // Per table
+    int                                          creates = 0;
+    int                                          flushes = 0;
+
+    size_t n_rows()
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t n = 0;
+
+        for (const auto& table : rows)
+        {
+            n += table.second.size();
+        }
+
+        return n;
+    }
+};
+
+/**
+ * Records the rows of the prepared table, slowly enough that the conversion
+ * task is ahead of the workers
+ */
+class RecordingHandler : public RowEventHandler
+{
+public:
+    RecordingHandler(Recording* recording)
+        : m_recording(recording)
+    {
+    }
+
+    bool create_table(const STableCreateEvent& create)
+    {
+        std::lock_guard<std::mutex> guard(m_recording->lock);
+        m_recording->creates++;
+        return true;
+    }
+
+    bool prepare_table(const STableMapEvent& map, const STableCreateEvent& create)
+    {
+        m_table = create->id();
+        m_n_columns = create->columns.size();
+        return true;
+    }
+
+    void flush_tables()
+    {
+        std::lock_guard<std::mutex> guard(m_recording->lock);
+        m_recording->flushes++;
+    }
+
+    bool process_row(const gtid_pos_t& gtid, const REP_HEADER& hdr, int event_type, const Row& row)
+    {
+        Received received = {row[0].get_int64(), std::string(row[1].data(), row[1].length()), m_n_columns};
+
+        if (received.id % 100 == 0)
+        {
+            usleep(100);
+        }
+
+        std::lock_guard<std::mutex> guard(m_recording->lock);
+        m_recording->rows[m_table].push_back(received);
+        return true;
+    }
+
+private:
+    Recording*  m_recording;
+    std::string m_table;
+    size_t      m_n_columns = 0;
+};
+
+RowEventHandlerFactory create_factory(Recording* recording)
+{
+    return [recording]() {
+               return new RecordingHandler(recording);
+           };
+}
+
+STableCreateEvent create_table_event(const std::string& table)
+{
+    std::vector<Column> columns {Column("id", "bigint"), Column("str", "varchar")};
+    return STableCreateEvent(new TableCreateEvent("test", table, 1, std::move(columns)));
+}
+
+STableMapEvent create_map_event(const std::string& table, uint64_t id)
+{
+    return STableMapEvent(new TableMapEvent("test", table, id, 1, Bytes(2), Bytes(1), Bytes()));
+}
+
+/**
+ * Give a row to the converter from a buffer that is overwritten afterwards,
+ * as the rows are only valid during the call
+ */
+void process_row(ParallelConverter& converter, int64_t id)
+{
+    std::string str = "row " + std::to_string(id);
+    char buffer[32];
+    strcpy(buffer, str.c_str());
+
+    Row row;
+    row.add(ColumnValue(0, id));
+    row.add(ColumnValue(1, ColumnValue::STRING, buffer, str.length()));
+
+    gtid_pos_t gtid;
+    REP_HEADER hdr = {};
+    converter.process_row(gtid, hdr, WRITE_ROWS_EVENTv2, row);
+
+    memset(buffer, 'x', sizeof(buffer));
+}
+
+int test_order()
+{
+    int rval = 0;
+    Recording recording;
+
+    {
+        ParallelConverter converter(N_WORKERS, create_factory(&recording));
+        std::vector<STableMapEvent> maps;
+        std::vector<STableCreateEvent> creates;
+
+        for (int i = 0; i < N_TABLES; i++)
+        {
+            std::string table = "t" + std::to_string(i);
+            maps.push_back(create_map_event(table, i));
+            creates.push_back(create_table_event(table));
+
+            if (!converter.open_table(maps[i], creates[i]))
+            {
+                printf("Opening table %s failed\n", table.c_str());
+                rval++;
+            }
+        }
+
+        for (int64_t id = 0; id < N_ROWS; id++)
+        {
+            int t = id % N_TABLES;
+            converter.prepare_table(maps[t], creates[t]);
+            process_row(converter, id);
+        }
+
+        converter.flush_tables();
+
+        // Nothing may be left to the workers once flush_tables() has returned
+        size_t n_rows = recording.n_rows();
+
+        if (n_rows != N_ROWS)
+        {
+            printf("Expected %d rows when flush_tables() returned, got %lu\n", N_ROWS, n_rows);
+            rval++;
+        }
+
+        if (recording.flushes != N_WORKERS)
+        {
+            printf("Expected %d flushes, got %d\n", N_WORKERS, recording.flushes);
+            rval++;
+        }
+    }
+
+    for (int t = 0; t < N_TABLES; t++)
+    {
+        const std::vector<Received>& rows = recording.rows["test.t" + std::to_string(t)];
+        int64_t expected = t;
+        bool ok = true;
+
+        for (const Received& row : rows)
+        {
+            if (row.id != expected || row.str != "row " + std::to_string(expected))
+            {
+                printf("Expected row %ld of table t%d, got %ld ('%s')\n",
+                       expected, t, row.id, row.str.c_str());
+                ok = false;
+                break;
+            }
+
+            expected += N_TABLES;
+        }
+
+        if (!ok)
+        {
+            rval++;
+        }
+        else if (expected < N_ROWS)
+        {
+            printf("Table t%d is missing rows from %ld on\n", t, expected);
+            rval++;
+        }
+    }
+
+    return rval;
+}
+
+int test_alter()
+{
+    int rval = 0;
+    Recording recording;
+
+    {
+        ParallelConverter converter(N_WORKERS, create_factory(&recording));
+        STableMapEvent map = create_map_event("t1", 1);
+        STableCreateEvent create = create_table_event("t1");
+
+        converter.create_table(create);
+        converter.open_table(map, create);
+        converter.prepare_table(map, create);
+        process_row(converter, 0);
+
+        // An ALTER TABLE modifies the table definition in place ...
+        create->columns.push_back(Column("added", "int"));
+        create->version++;
+
+        converter.prepare_table(map, create);
+        process_row(converter, 1);
+
+        // ... and then passes it on as a new table
+        converter.create_table(create);
+        converter.prepare_table(map, create);
+        process_row(converter, 2);
+
+        converter.flush_tables();
+    }
+
+    const std::vector<Received>& rows = recording.rows["test.t1"];
+    const size_t expected[] = {2, 2, 3};
+
+    if (rows.size() != 3)
+    {
+        printf("Expected 3 rows after ALTER TABLE, got %lu\n", rows.size());
+        rval++;
+    }
+    else
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (rows[i].n_columns != expected[i])
+            {
+                printf("Expected row %d to be converted with %lu columns, got %lu\n",
+                       i, expected[i], rows[i].n_columns);
+                rval++;
+            }
+        }
+    }
+
+    if (recording.creates != 2)
+    {
+        printf("Expected the table to be created 2 times, got %d\n", recording.creates);
+        rval++;
+    }
+
+    return rval;
+}
+}
+
+int main(int argc, char** argv)
+{
+    int rval = 0;
+
+    mxs_log_init(NULL, NULL, MXS_LOG_TARGET_DEFAULT);
+
+    rval += test_order();
+    rval += test_alter();
+
+    mxs_log_finish();
+
+    return rval;
+}
@@ -118,6 +118,43 @@ static const MXS_ENUM_VALUE binlog_storage_values[] =
     {NULL}
 };
 
+static const MXS_ENUM_VALUE write_batching_values[] =
+{
+    {"off",         BLR_WRITE_BATCH_OFF        },
+    {"transaction", BLR_WRITE_BATCH_TRANSACTION},
+    {"window",      BLR_WRITE_BATCH_WINDOW     },
+    {NULL}
+};
+
+static const MXS_ENUM_VALUE sync_policy_values[] =
+{
+    {"response",    BLR_SYNC_RESPONSE   },
+    {"none",        BLR_SYNC_NONE       },
+    {"transaction", BLR_SYNC_TRANSACTION},
+    {"interval",    BLR_SYNC_INTERVAL   },
+    {NULL}
+};
+
+/**
+ * Return the name of an enumeration value
+ *
+ * @param values    The enumeration values
+ * @param value     The value to look for
+ * @return          The name of the value
+ */
+static const char* blr_enum_name(const MXS_ENUM_VALUE* values, uint64_t value)
+{
+    for (const MXS_ENUM_VALUE* v = values; v->name; v++)
+    {
+        if (v->enum_value == value)
+        {
+            return v->name;
+        }
+    }
+
+    return "unknown";
+}
+
 /**
  * The module entry point routine. It is this routine that
  * must populate the structure that is referred to as the
@@ -211,6 +248,28 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
              DEF_LONG_BURST},
             {"burstsize",                                MXS_MODULE_PARAM_SIZE,
              DEF_BURST_SIZE},
+            {"event_ring",                               MXS_MODULE_PARAM_COUNT,
+             DEF_EVENT_RING},
+            {"event_ring_size",                          MXS_MODULE_PARAM_SIZE,
+             DEF_EVENT_RING_SIZE},
+            {
+                "write_batching",                        MXS_MODULE_PARAM_ENUM,
+                "off",
+                MXS_MODULE_OPT_NONE,                     write_batching_values
+            },
+            {"write_batch_window",                       MXS_MODULE_PARAM_COUNT,
+             DEF_WRITE_BATCH_WINDOW},
+            {
+                "sync_policy",                           MXS_MODULE_PARAM_ENUM,
+                "response",
+                MXS_MODULE_OPT_NONE,                     sync_policy_values
+            },
+            {"sync_interval",                            MXS_MODULE_PARAM_COUNT,
+             DEF_SYNC_INTERVAL},
+            {"binlog_compression",                       MXS_MODULE_PARAM_BOOL,
+             "false"},
+            {"binlog_compression_keep",                  MXS_MODULE_PARAM_COUNT,
+             DEF_BINLOG_COMPRESSION_KEEP},
             {"heartbeat",                                MXS_MODULE_PARAM_COUNT,
              BLR_HEARTBEAT_DEFAULT_INTERVAL},
             {"connect_retry",                            MXS_MODULE_PARAM_COUNT,
@@ -344,6 +403,16 @@ static MXS_ROUTER* createInstance(SERVICE* service, MXS_CONFIG_PARAMETER* params
     inst->short_burst = config_get_integer(params, "shortburst");
     inst->long_burst = config_get_integer(params, "longburst");
     inst->burst_size = config_get_size(params, "burstsize");
+    inst->event_ring.max_events = config_get_integer(params, "event_ring");
+    inst->event_ring.max_size = config_get_size(params, "event_ring_size");
+    inst->write_batch.mode = static_cast<blr_write_batching>(
+        config_get_enum(params, "write_batching", write_batching_values));
+    inst->write_batch.window = config_get_integer(params, "write_batch_window");
+    inst->write_batch.sync = static_cast<blr_sync_policy>(
+        config_get_enum(params, "sync_policy", sync_policy_values));
+    inst->write_batch.sync_interval = config_get_integer(params, "sync_interval");
+    inst->compression.enabled = config_get_bool(params, "binlog_compression");
+    inst->compression.keep = config_get_integer(params, "binlog_compression_keep");
     inst->binlogdir = config_copy_string(params, "binlogdir");
     inst->heartbeat = config_get_integer(params, "heartbeat");
     inst->retry_interval = config_get_integer(params, "connect_retry");
@@ -706,6 +775,12 @@ static MXS_ROUTER* createInstance(SERVICE* service, MXS_CONFIG_PARAMETER* params
         return NULL;
     }
 
+    if (!blr_event_ring_init(inst))
+    {
+        free_instance(inst);
+        return NULL;
+    }
+
     /* Check BinlogDir option */
     if ((inst->binlogdir == NULL)
         || (inst->binlogdir != NULL
@@ -795,6 +870,17 @@ static MXS_ROUTER* createInstance(SERVICE* service, MXS_CONFIG_PARAMETER* params
             free_instance(inst);
             return NULL;
         }
+
+        /* Open the GTID index, copying the GTIDs of an older GTID maps DB */
+        if ((inst->gtid_index = blr_gtid_index_open(inst)) == NULL)
+        {
+            MXS_ERROR("%s: Failed to open the GTID index in '%s'.",
+                      inst->service->name,
+                      inst->binlogdir);
+            sqlite3_close_v2(inst->gtid_maps);
+            free_instance(inst);
+            return NULL;
+        }
     }
 
     /* Dynamically allocate master_host server struct, not written in any cnf file */
@@ -990,6 +1076,12 @@ static MXS_ROUTER* createInstance(SERVICE* service, MXS_CONFIG_PARAMETER* params
     snprintf(task_name, BLRM_TASK_NAME_LEN, "%s stats", service->name);
     hktask_add(task_name, stats_func, inst, BLR_STATS_FREQ);
 
+    /* Compress the older binlog files in the background */
+    if (inst->compression.enabled)
+    {
+        blr_compression_start(inst);
+    }
+
     /* Log whether the transaction safety option value is on */
     if (inst->trx_safe)
     {
@@ -1150,6 +1242,17 @@ static void free_instance(ROUTER_INSTANCE* instance)
     MXS_FREE(instance->ssl_key);
     MXS_FREE(instance->ssl_version);
 
+    blr_event_ring_free(instance);
+    blr_gtid_index_close(instance->gtid_index);
+    MXS_FREE(instance->write_batch.data);
+
+    while (instance->workers)
+    {
+        BLR_WORKER* w = instance->workers;
+        instance->workers = w->next;
+        MXS_FREE(w);
+    }
+
     MXS_FREE(instance);
 }
 
@@ -1202,7 +1305,6 @@ static MXS_ROUTER_SESSION* newSession(MXS_ROUTER* instance, MXS_SESSION* session
     slave->lastEventReceived = 0;
     slave->encryption_ctx = NULL;
     slave->mariadb_gtid = NULL;
-    slave->gtid_maps = NULL;
     memset(&slave->f_info, 0, sizeof(MARIADB_GTID_INFO));
     slave->annotate_rows = false;
     slave->warning_msg = NULL;
@@ -1239,6 +1341,9 @@ static void freeSession(MXS_ROUTER* router_instance,
     MXB_AT_DEBUG(int prev_val = ) atomic_add(&router->stats.n_slaves, -1);
     mxb_assert(prev_val > 0);
 
+    /* Normally already done when the session was closed */
+    blr_slave_worker_remove(slave);
+
     /*
      * Remove the slave session form the list of slaves that are using the
      * router currently.
@@ -1364,6 +1469,7 @@ static void closeSession(MXS_ROUTER* instance, MXS_ROUTER_SESSION* router_sessio
          * of any more binlog records to this slave.
          */
         slave->state = BLRS_UNREGISTERED;
+        blr_slave_worker_remove(slave);
 
 #ifdef BLFILE_IN_SLAVE
         // TODO: Is it really certain the file can be closed here? If other
@@ -1640,6 +1746,52 @@ static void diagnostics(MXS_ROUTER* router, DCB* dcb)
     dcb_printf(dcb,
                "\tNumber of heartbeat events:                  %u\n",
                router_inst->stats.n_heartbeats);
+    dcb_printf(dcb,
+               "\tNumber of events read from the event ring:   %lu\n",
+               router_inst->stats.n_ringhits);
+    dcb_printf(dcb,
+               "\tNumber of events read from the binlog file:  %lu\n",
+               router_inst->stats.n_ringmisses);
+    dcb_printf(dcb,
+               "\tWrite batching:                              %s\n",
+               blr_enum_name(write_batching_values, router_inst->write_batch.mode));
+    dcb_printf(dcb,
+               "\tSync policy:                                 %s\n",
+               blr_enum_name(sync_policy_values, router_inst->write_batch.sync));
+    dcb_printf(dcb,
+               "\tNumber of binlog file writes:                %lu\n",
+               router_inst->stats.n_writes);
+    dcb_printf(dcb,
+               "\tNumber of binlog events written:             %lu\n",
+               router_inst->stats.n_written_events);
+    dcb_printf(dcb,
+               "\tNumber of binlog file syncs:                 %lu\n",
+               router_inst->stats.n_syncs);
+    dcb_printf(dcb, "\tBinlog file write latency:\n");
+    for (int i = 0; i < BLR_LATENCY_BUCKETS; i++)
+    {
+        dcb_printf(dcb,
+                   "\t\t%-20s%lu\n",
+                   blr_latency_bucket_name(i),
+                   router_inst->stats.write_latency[i]);
+    }
+    dcb_printf(dcb, "\tBinlog file sync latency:\n");
+    for (int i = 0; i < BLR_LATENCY_BUCKETS; i++)
+    {
+        dcb_printf(dcb,
+                   "\t\t%-20s%lu\n",
+                   blr_latency_bucket_name(i),
+                   router_inst->stats.sync_latency[i]);
+    }
+    dcb_printf(dcb,
+               "\tBinlog compression:                          %s\n",
+               router_inst->compression.enabled ? "on" : "off");
+    dcb_printf(dcb,
+               "\tNumber of binlog files compressed:           %lu\n",
+               router_inst->compression.n_files);
+    dcb_printf(dcb,
+               "\tBytes saved by compressing binlog files:     %lu\n",
+               router_inst->compression.n_saved);
     dcb_printf(dcb,
                "\tNumber of packets received:                  %u\n",
                router_inst->stats.n_reads);
@@ -2100,6 +2252,36 @@ static json_t* diagnostics_json(const MXS_ROUTER* router)
     json_object_set_new(rval, "binlog_rotates", json_integer(router_inst->stats.n_rotates));
     json_object_set_new(rval, "heartbeat_events", json_integer(router_inst->stats.n_heartbeats));
     json_object_set_new(rval, "events_read", json_integer(router_inst->stats.n_reads));
+    json_object_set_new(rval, "event_ring_hits", json_integer(router_inst->stats.n_ringhits));
+    json_object_set_new(rval, "event_ring_misses", json_integer(router_inst->stats.n_ringmisses));
+    json_object_set_new(rval,
+                        "write_batching",
+                        json_string(blr_enum_name(write_batching_values, router_inst->write_batch.mode)));
+    json_object_set_new(rval,
+                        "sync_policy",
+                        json_string(blr_enum_name(sync_policy_values, router_inst->write_batch.sync)));
+    json_object_set_new(rval, "binlog_writes", json_integer(router_inst->stats.n_writes));
+    json_object_set_new(rval, "binlog_events_written", json_integer(router_inst->stats.n_written_events));
+    json_object_set_new(rval, "binlog_syncs", json_integer(router_inst->stats.n_syncs));
+
+    json_t* write_latency = json_object();
+    json_t* sync_latency = json_object();
+
+    for (int i = 0; i < BLR_LATENCY_BUCKETS; i++)
+    {
+        json_object_set_new(write_latency,
+                            blr_latency_bucket_name(i),
+                            json_integer(router_inst->stats.write_latency[i]));
+        json_object_set_new(sync_latency,
+                            blr_latency_bucket_name(i),
+                            json_integer(router_inst->stats.sync_latency[i]));
+    }
+
+    json_object_set_new(rval, "write_latency", write_latency);
+    json_object_set_new(rval, "sync_latency", sync_latency);
+    json_object_set_new(rval, "binlog_compression", json_boolean(router_inst->compression.enabled));
+    json_object_set_new(rval, "binlog_files_compressed", json_integer(router_inst->compression.n_files));
+    json_object_set_new(rval, "binlog_compression_saved", json_integer(router_inst->compression.n_saved));
     json_object_set_new(rval, "residual_packets", json_integer(router_inst->stats.n_residuals));
 
     double average_packets = router_inst->stats.n_reads != 0 ?
@@ -3022,8 +3204,18 @@ static void destroyInstance(MXS_ROUTER* instance)
                     inst->binlog_position);
     }
 
-    /* Close GTID maps database */
+    /* Stop compressing the binlog files */
+    blr_compression_stop(inst);
+
+    /* Close GTID maps database and GTID index */
     sqlite3_close_v2(inst->gtid_maps);
+    blr_gtid_index_close(inst->gtid_index);
+    inst->gtid_index = NULL;
+
+    /* Release the events kept in memory */
+    pthread_mutex_lock(&inst->binlog_lock);
+    blr_event_ring_free(inst);
+    pthread_mutex_unlock(&inst->binlog_lock);
 }
 
 /**
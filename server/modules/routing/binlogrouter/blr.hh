@@ -40,6 +40,11 @@
 #include <maxscale/sqlite3.h>
 #include <maxscale/mysql_binlog.h>
 
+namespace maxscale
+{
+class RoutingWorker;
+}
+
 #define BINLOG_FNAMELEN   255
 #define BLR_PROTOCOL      "MySQLBackend"
 #define BINLOG_MAGIC      {0xfe, 0x62, 0x69, 0x6e}
@@ -219,6 +224,25 @@ typedef enum
 #define DEF_LONG_BURST  "500"
 #define DEF_BURST_SIZE  "1024000"           /* 1 Mb */
 
+/**
+ * Default limits of the ring of recently written events
+ */
+#define DEF_EVENT_RING      "1000"
+#define DEF_EVENT_RING_SIZE "16M"
+
+/**
+ * Default write batching window and sync interval, in milliseconds
+ */
+#define DEF_WRITE_BATCH_WINDOW "10"
+#define DEF_SYNC_INTERVAL      "1000"
+
+/**
+ * Default number of the most recent binlog files of each binlog directory
+ * that are not compressed, and the suffix of the compressed binlog files
+ */
+#define DEF_BINLOG_COMPRESSION_KEEP "2"
+#define BLR_COMPRESSED_SUFFIX       ".blz"
+
 /**
  * master reconnect backoff constants
  * BLR_MASTER_BACKOFF_TIME      The increments of the back off time (seconds)
@@ -505,6 +529,119 @@ typedef struct
     mutable pthread_mutex_t lock;   /*< The spinlock for the cache */
 } BLCACHE;
 
+/**
+ * An event written to the current binlog file, kept in memory so that slaves
+ * close to the end of the binlog can be served without reading the file.
+ *
+ * The event is shared by the ring and the readers copying it, so it is freed
+ * only when the last reference is released.
+ */
+typedef struct blr_ring_event
+{
+    int        refcount;    /*< Number of references, updated atomically */
+    uint64_t   pos;         /*< Position of the event in the binlog file */
+    REP_HEADER hdr;         /*< Replication header of the event */
+    bool       encrypted;   /*< Whether the event is encrypted in the file */
+    uint8_t*   data;        /*< The unencrypted event, hdr.event_size bytes */
+} BLR_RING_EVENT;
+
+/**
+ * A bounded ring of the most recently written events of the current binlog
+ * file, ordered by position. It is protected by the binlog_lock of the router.
+ *
+ * The generation and the positions are also stored atomically, so that
+ * readers can skip the lock when the event they want cannot be in the ring.
+ */
+typedef struct blr_event_ring
+{
+    BLR_RING_EVENT** events;        /*< The slots of the ring */
+    unsigned int     max_events;    /*< The number of slots, 0 if disabled */
+    uint64_t         max_size;      /*< Maximum total size of the events */
+    unsigned int     first;         /*< The slot of the oldest event */
+    unsigned int     count;         /*< The number of events in the ring */
+    uint64_t         size;          /*< The total size of the events */
+    char             binlog_name[BINLOG_FNAMELEN + 1];
+    /*< Name of the binlog file of the events */
+    uint64_t generation;            /*< The binlog_generation of the events plus one,
+                                     * 0 if the ring is empty */
+    uint64_t first_pos;             /*< Position of the oldest event */
+    uint64_t end_pos;               /*< End position of the newest event */
+} BLR_EVENT_RING;
+
+/** How the events received from the master are written to the binlog file */
+enum blr_write_batching
+{
+    BLR_WRITE_BATCH_OFF,            /*< Each event is written when received */
+    BLR_WRITE_BATCH_TRANSACTION,    /*< The events of a transaction are written at commit */
+    BLR_WRITE_BATCH_WINDOW          /*< The transactions of a time window are written together */
+};
+
+/** When the binlog file is synced to disk */
+enum blr_sync_policy
+{
+    BLR_SYNC_RESPONSE,      /*< After the events of each read from the master */
+    BLR_SYNC_NONE,          /*< Left to the operating system */
+    BLR_SYNC_TRANSACTION,   /*< Before the slaves may read a transaction */
+    BLR_SYNC_INTERVAL       /*< At most every sync_interval milliseconds */
+};
+
+/**
+ * The events received from the master that have not yet been written
+ * to the current binlog file. Only used by the thread handling the master.
+ */
+typedef struct blr_write_batch
+{
+    enum blr_write_batching mode;
+    uint64_t                window;     /*< The batching window in milliseconds */
+    uint8_t*                data;       /*< The events to write */
+    uint64_t                size;       /*< The size of the events to write */
+    uint64_t                capacity;   /*< The allocated size of data */
+    uint64_t                offset;     /*< The file offset of the events */
+    unsigned int            n_events;   /*< The number of events to write */
+    uint64_t                started;    /*< When the first event was added, in microseconds */
+    uint64_t                commit_pos; /*< The end of the last transaction the slaves
+                                         * may read once the events have been written */
+    enum blr_sync_policy    sync;
+    uint64_t                sync_interval;  /*< The sync interval in milliseconds */
+    uint64_t                last_sync;      /*< When the file was last synced, in microseconds */
+    bool                    unsynced;       /*< Whether something has been written since */
+    uint32_t                sync_call_id;   /*< The delayed call syncing the file once
+                                             * the interval has passed, 0 if none */
+} BLR_WRITE_BATCH;
+
+/**
+ * The compression of the binlog files that are no longer written to,
+ * done by a thread of its own.
+ */
+typedef struct blr_compression
+{
+    bool      enabled;
+    int       keep;         /*< The number of most recent files not compressed */
+    int       shutdown;     /*< Set when the thread should stop */
+    bool      started;      /*< Whether the thread has been started */
+    pthread_t thread;
+    uint64_t  n_files;      /*< The number of files compressed */
+    uint64_t  n_saved;      /*< The number of bytes saved by compressing them */
+} BLR_COMPRESSION;
+
+/** The result of blr_file_commit() */
+typedef enum
+{
+    BLR_COMMIT_ERROR,       /*< The events could not be written */
+    BLR_COMMIT_DONE,        /*< The events have been written */
+    BLR_COMMIT_DEFERRED     /*< The events are written with the following ones */
+} blr_commit_result_t;
+
+/** The number of buckets of the binlog write and sync latency histograms:
+ * under 10us, 100us, 1ms, 10ms, 100ms, 1s, and the rest */
+#define BLR_LATENCY_BUCKETS 7
+
+/** The index of the MariaDB 10 GTIDs in the binlog files, see blr_gtid_index.cc */
+typedef struct blr_gtid_index BLR_GTID_INDEX;
+
+/** The chunk index and chunk cache of a compressed binlog file, see blr_compress.cc */
+typedef struct blr_compressed BLR_COMPRESSED;
+
 typedef struct blfile
 {
     char binlog_name[BINLOG_FNAMELEN + 1];
@@ -512,8 +649,9 @@ typedef struct blfile
     int                     fd;         /*< Actual file descriptor */
     int                     refcnt;     /*< Reference count for file */
     BLCACHE*                cache;      /*< Record cache for this file */
-    mutable pthread_mutex_t lock;       /*< The file lock */
     MARIADB_GTID_ELEMS      gtid_elms;  /*< Elements for file prefix */
+    uint64_t                state;      /*< Whether the file is complete, see blr_file_is_complete() */
+    BLR_COMPRESSED*         compressed; /*< Set if fd refers to a compressed file */
     struct blfile*          next;       /*< Next file in list */
 } BLFILE;
 
@@ -627,11 +765,27 @@ typedef struct router_slave
     bool gtid_strict_mode;
     /*< MariaDB 10 Slave sets gtid_strict_mode */
     char*             mariadb_gtid;     /*< MariaDB 10 Slave connects with GTID */
-    sqlite3*          gtid_maps;        /*< GTID storage client handle, read only*/
     MARIADB_GTID_INFO f_info;           /*< GTID info for file name prefix */
     bool              annotate_rows;    /*< MariaDB 10 Slave requests ANNOTATE_ROWS */
+    struct blr_worker*   worker;        /*< The worker the slave is dumping on */
+    struct router_slave* worker_next;   /*< Next dumping slave of the worker */
 } ROUTER_SLAVE;
 
+/**
+ * The dumping slaves of a router on one routing worker. The slaves are
+ * notified of new events by the worker itself, so that the master never
+ * touches the slaves of the workers. Apart from notify_pending and n_slaves,
+ * the fields are only accessed by the worker.
+ */
+typedef struct blr_worker
+{
+    mxs::RoutingWorker* worker;         /*< The routing worker */
+    int                 notify_pending; /*< A notification has been posted */
+    int                 n_slaves;       /*< Number of dumping slaves */
+    ROUTER_SLAVE*       slaves;         /*< The dumping slaves */
+    struct blr_worker*  next;           /*< Next worker, the list is only appended to */
+} BLR_WORKER;
+
 
 /**
  * The statistics for this router instance
@@ -646,6 +800,13 @@ typedef struct
     uint64_t n_rotates;         /*< Number of binlog rotate events */
     uint64_t n_cachehits;       /*< Number of hits on the binlog cache */
     uint64_t n_cachemisses;     /*< Number of misses on the binlog cache */
+    uint64_t n_ringhits;        /*< Number of events read from the event ring */
+    uint64_t n_ringmisses;      /*< Number of events read from the current file */
+    uint64_t n_writes;          /*< Number of writes to the binlog files */
+    uint64_t n_written_events;  /*< Number of events written by those writes */
+    uint64_t n_syncs;           /*< Number of syncs of the binlog files */
+    uint64_t write_latency[BLR_LATENCY_BUCKETS];    /*< Write latency histogram */
+    uint64_t sync_latency[BLR_LATENCY_BUCKETS];     /*< Sync latency histogram */
     int      n_registered;      /*< Number of registered slaves */
     int      n_masterstarts;    /*< Number of times connection restarted */
     int      n_delayedreconnects;
@@ -746,6 +907,8 @@ struct ROUTER_INSTANCE : public MXS_ROUTER
 {
     SERVICE*                service;        /*< Pointer to the service using this router */
     ROUTER_SLAVE*           slaves;         /*< Link list of all the slave connections  */
+    BLR_WORKER*             workers;        /*< The workers with dumping slaves */
+    uint64_t                binlog_generation;  /*< Incremented when the current binlog file changes */
     mutable pthread_mutex_t lock;           /*< Spinlock for the instance data */
     char*                   uuid;           /*< UUID for the router to use w/master */
     int                     orig_masterid;  /*< Server ID of the master, internally used */
@@ -799,6 +962,9 @@ struct ROUTER_INSTANCE : public MXS_ROUTER
     unsigned int            long_burst; /*< Long burst for slave catchup */
     unsigned long           burst_size; /*< Maximum size of burst to send */
     unsigned long           heartbeat;  /*< Configured heartbeat value */
+    BLR_EVENT_RING          event_ring; /*< Recently written events, protected by binlog_lock */
+    BLR_WRITE_BATCH         write_batch;/*< Events not yet written to the binlog file */
+    BLR_COMPRESSION         compression;/*< Compression of the older binlog files */
     ROUTER_STATS            stats;      /*< Statistics for this router */
     int                     active_logs;
     int                     reconnect_pending;
@@ -838,6 +1004,7 @@ struct ROUTER_INSTANCE : public MXS_ROUTER
                                                              */
     uint32_t                        mariadb10_gtid_domain;  /*< MariaDB 10 GTID Domain ID */
     sqlite3*                        gtid_maps;              /*< MariaDB 10 GTID storage */
+    BLR_GTID_INDEX*                 gtid_index;             /*< MariaDB 10 GTID index */
     enum binlog_storage_type        storage_type;           /*< Enables hierachical binlog file storage */
     char*                           set_slave_hostname;     /*< Send custom Hostname to Master */
     ROUTER_INSTANCE*                next;
@@ -1058,6 +1225,9 @@ extern void blr_slave_rotate(ROUTER_INSTANCE*,
 extern int blr_slave_catchup(ROUTER_INSTANCE* router,
                              ROUTER_SLAVE* slave,
                              bool large);
+extern bool blr_slave_worker_add(ROUTER_INSTANCE* router,
+                                 ROUTER_SLAVE* slave);
+extern void blr_slave_worker_remove(ROUTER_SLAVE* slave);
 extern void blr_init_cache(ROUTER_INSTANCE*);
 
 extern int blr_file_init(ROUTER_INSTANCE*);
@@ -1071,6 +1241,11 @@ extern int blr_file_rotate(ROUTER_INSTANCE*,
 extern int     blr_file_read_master_config(ROUTER_INSTANCE* router);
 extern int     blr_file_write_master_config(ROUTER_INSTANCE* router, char* error);
 extern void    blr_file_flush(ROUTER_INSTANCE*);
+extern bool    blr_file_write_batch(ROUTER_INSTANCE*);
+extern void    blr_file_sync_pending(ROUTER_INSTANCE*);
+extern bool    blr_file_commit_deferred(ROUTER_INSTANCE*);
+extern blr_commit_result_t blr_file_commit(ROUTER_INSTANCE*);
+extern const char*         blr_latency_bucket_name(int);
 extern BLFILE* blr_open_binlog(ROUTER_INSTANCE*,
                                const char*,
                                const MARIADB_GTID_INFO*);
@@ -1080,7 +1255,41 @@ extern GWBUF* blr_read_binlog(ROUTER_INSTANCE*,
                               REP_HEADER*,
                               char*,
                               const SLAVE_ENCRYPTION_CTX*);
+extern GWBUF* blr_read_binlog_range(ROUTER_INSTANCE*,
+                                    BLFILE*,
+                                    unsigned long,
+                                    unsigned long);
+extern unsigned long blr_slave_bulk_events(const ROUTER_INSTANCE*,
+                                           const ROUTER_SLAVE*,
+                                           const uint8_t*,
+                                           unsigned long,
+                                           int,
+                                           int*,
+                                           unsigned long*,
+                                           unsigned long*);
+extern bool blr_crypt_event(ROUTER_INSTANCE*,
+                            const uint8_t*,
+                            uint8_t*,
+                            uint32_t,
+                            uint32_t,
+                            const uint8_t*,
+                            int);
+extern unsigned long blr_decrypt_events(ROUTER_INSTANCE*,
+                                        uint8_t*,
+                                        unsigned long,
+                                        unsigned long,
+                                        const uint8_t*);
 extern void          blr_close_binlog(ROUTER_INSTANCE*, BLFILE*);
+extern bool          blr_event_ring_init(ROUTER_INSTANCE*);
+extern void          blr_event_ring_reset(ROUTER_INSTANCE*);
+extern void          blr_event_ring_free(ROUTER_INSTANCE*);
+extern BLR_RING_EVENT* blr_ring_event_alloc(uint64_t, bool, uint32_t, uint8_t*);
+extern void            blr_event_ring_add(ROUTER_INSTANCE*, BLR_RING_EVENT*);
+extern GWBUF*          blr_event_ring_read(ROUTER_INSTANCE*,
+                                           const BLFILE*,
+                                           unsigned long,
+                                           REP_HEADER*,
+                                           const SLAVE_ENCRYPTION_CTX*);
 extern unsigned long blr_file_size(BLFILE*);
 extern int           blr_statistics(ROUTER_INSTANCE*, ROUTER_SLAVE*, GWBUF*);
 extern int           blr_ping(ROUTER_INSTANCE*, ROUTER_SLAVE*, GWBUF*);
@@ -1103,6 +1312,11 @@ void        blr_cache_response(ROUTER_INSTANCE* router, char* response, GWBUF* b
 const char* blr_last_event_description(ROUTER_INSTANCE* router);
 void        blr_free_ssl_data(ROUTER_INSTANCE* inst);
 
+extern bool blr_events_not_sent(blr_thread_role_t role,
+                                const char* binlog_name,
+                                uint32_t binlog_pos,
+                                uint32_t end_pos,
+                                ROUTER_SLAVE* slave);
 extern bool blr_send_event(blr_thread_role_t role,
                            const char* binlog_name,
                            uint32_t binlog_pos,
@@ -1119,6 +1333,33 @@ extern const char* blr_skip_leading_sql_comments(const char*);
 extern bool        blr_fetch_mariadb_gtid(ROUTER_SLAVE*,
                                           const char*,
                                           MARIADB_GTID_INFO*);
+extern BLR_GTID_INDEX* blr_gtid_index_open(ROUTER_INSTANCE*);
+extern void            blr_gtid_index_close(BLR_GTID_INDEX*);
+extern bool            blr_gtid_index_add(BLR_GTID_INDEX*,
+                                          const MARIADB_GTID_INFO*,
+                                          uint32_t,
+                                          uint32_t,
+                                          bool*);
+extern bool blr_gtid_index_find(BLR_GTID_INDEX*,
+                                const MARIADB_GTID_ELEMS*,
+                                MARIADB_GTID_INFO*);
+extern bool blr_gtid_index_last(BLR_GTID_INDEX*,
+                                MARIADB_GTID_INFO*);
+extern void blr_gtid_index_purge(BLR_GTID_INDEX*,
+                                 const char*,
+                                 uint32_t,
+                                 uint32_t);
+extern bool            blr_compression_start(ROUTER_INSTANCE*);
+extern void            blr_compression_stop(ROUTER_INSTANCE*);
+extern BLR_COMPRESSED* blr_compressed_open(int fd);
+extern void            blr_compressed_close(BLR_COMPRESSED*);
+extern ssize_t         blr_compressed_pread(BLR_COMPRESSED*,
+                                            void*,
+                                            size_t,
+                                            uint64_t);
+extern uint64_t blr_compressed_size(const BLR_COMPRESSED*);
+extern bool     blr_compressed_file_size(const char* path,
+                                         uint64_t* size);
 extern bool blr_start_master_in_main(ROUTER_INSTANCE* data, int32_t delay = 0);
 extern bool blr_binlog_file_exists(ROUTER_INSTANCE* router,
                                    const MARIADB_GTID_INFO* info_file);
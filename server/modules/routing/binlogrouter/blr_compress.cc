@@ -0,0 +1,679 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file blr_compress.cc - Compression of the older binlog files
+ *
+ * A thread of the router periodically compresses the binlog files that are no
+ * longer written to, leaving the most recent ones of each binlog directory as
+ * they are. A binlog file is replaced by a file with the same name and the
+ * suffix BLR_COMPRESSED_SUFFIX, in which the contents of the binlog file are
+ * compressed in chunks of COMPRESSED_CHUNK_SIZE bytes, followed by an index of
+ * the offsets of the chunks.
+ *
+ * A compressed file is read by decompressing the chunks that contain the
+ * requested range. The most recently used chunks are cached, so that reading
+ * the events of a chunk one at a time decompresses the chunk only once.
+ */
+
+#include "blr.hh"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <maxbase/atomic.h>
+#include <maxscale/log.h>
+#include <maxscale/utils.h>
+
+extern bool blr_compare_binlogs(const ROUTER_INSTANCE* router,
+                                const MARIADB_GTID_ELEMS* info,
+                                const char* r_file,
+                                const char* s_file);
+
+namespace
+{
+
+const char     COMPRESSED_MAGIC[8] = {'M', 'X', 'S', 'B', 'L', 'O', 'G', 'Z'};
+const uint32_t COMPRESSED_VERSION = 1;
+
+/** The size of the uncompressed chunks */
+const uint32_t COMPRESSED_CHUNK_SIZE = 128 * 1024;
+
+/** The number of decompressed chunks cached for each open file */
+const int COMPRESSED_CACHE_CHUNKS = 4;
+
+/** The number of seconds between the scans of the binlog directory */
+const int COMPRESSION_INTERVAL = 60;
+
+/**
+ * A compressed file begins with a header, which is followed by the compressed
+ * chunks and the offsets of the chunks. The offsets are followed by the
+ * offset where the index begins, so that the length of each chunk is the
+ * difference between two consecutive offsets.
+ */
+struct CompressedHeader
+{
+    char     magic[8];      /*< COMPRESSED_MAGIC */
+    uint32_t version;       /*< COMPRESSED_VERSION */
+    uint32_t chunk_size;    /*< The size of the uncompressed chunks */
+    uint64_t size;          /*< The size of the uncompressed binlog file */
+    uint64_t n_chunks;      /*< The number of chunks */
+    uint64_t index_offset;  /*< Where the n_chunks + 1 offsets begin */
+};
+
+static_assert(sizeof(CompressedHeader) == 40, "CompressedHeader must not contain padding.");
+
+struct CachedChunk
+{
+    uint64_t             chunk; /*< The number of the chunk, UINT64_MAX if unused */
+    uint64_t             used;  /*< When the chunk was last used */
+    std::vector<uint8_t> data;  /*< The decompressed chunk */
+};
+
+/** The binlog files of one directory, by file root and number */
+typedef std::map<std::string, std::map<int, std::string>> BinlogFiles;
+}
+
+/**
+ * An open compressed binlog file. The functions are thread safe.
+ */
+struct blr_compressed
+{
+    pthread_mutex_t       lock;
+    int                   fd;       /*< Owned by the BLFILE */
+    CompressedHeader      header;
+    std::vector<uint64_t> index;    /*< The offsets of the chunks */
+    std::vector<uint8_t>  buffer;   /*< For reading a compressed chunk */
+    uint64_t              clock;
+    CachedChunk           cache[COMPRESSED_CACHE_CHUNKS];
+};
+
+/**
+ * Open a compressed binlog file for reading
+ *
+ * @param fd    The compressed file, which must remain open until the
+ *              returned object has been closed
+ * @return      The compressed file, or NULL if the file is not valid
+ */
+BLR_COMPRESSED* blr_compressed_open(int fd)
+{
+    CompressedHeader header;
+    struct stat statb;
+
+    if (fstat(fd, &statb) == -1
+        || pread(fd, &header, sizeof(header), 0) != sizeof(header)
+        || memcmp(header.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) != 0
+        || header.version != COMPRESSED_VERSION
+        || header.chunk_size == 0
+        || header.n_chunks != (header.size + header.chunk_size - 1) / header.chunk_size)
+    {
+        return NULL;
+    }
+
+    uint64_t file_size = statb.st_size;
+
+    /* The offsets must fit between the chunks and the end of the file */
+    if (header.index_offset < sizeof(header)
+        || header.index_offset > file_size
+        || header.n_chunks >= (file_size - header.index_offset) / sizeof(uint64_t))
+    {
+        return NULL;
+    }
+
+    BLR_COMPRESSED* file = new BLR_COMPRESSED;
+    file->fd = fd;
+    file->header = header;
+    file->index.resize(header.n_chunks + 1);
+    file->clock = 0;
+
+    size_t len = file->index.size() * sizeof(uint64_t);
+
+    if (pread(fd, &file->index[0], len, header.index_offset) != static_cast<ssize_t>(len))
+    {
+        delete file;
+        return NULL;
+    }
+
+    /* The chunks must follow each other, from the header to the offsets */
+    bool valid = file->index[0] == sizeof(header) && file->index[header.n_chunks] == header.index_offset;
+
+    for (uint64_t i = 0; valid && i < header.n_chunks; i++)
+    {
+        valid = file->index[i] <= file->index[i + 1];
+    }
+
+    if (!valid)
+    {
+        delete file;
+        return NULL;
+    }
+
+    for (int i = 0; i < COMPRESSED_CACHE_CHUNKS; i++)
+    {
+        file->cache[i].chunk = UINT64_MAX;
+        file->cache[i].used = 0;
+    }
+
+    pthread_mutex_init(&file->lock, NULL);
+
+    return file;
+}
+
+/**
+ * Close a compressed binlog file
+ *
+ * @param file  The file to close, the file descriptor is not closed
+ */
+void blr_compressed_close(BLR_COMPRESSED* file)
+{
+    if (file)
+    {
+        pthread_mutex_destroy(&file->lock);
+        delete file;
+    }
+}
+
+/**
+ * Return the size of the uncompressed binlog file
+ */
+uint64_t blr_compressed_size(const BLR_COMPRESSED* file)
+{
+    return file->header.size;
+}
+
+/**
+ * Return a decompressed chunk, reading it unless it is cached
+ *
+ * The caller must hold the lock of the file.
+ *
+ * @param file   The compressed file
+ * @param chunk  The number of the chunk
+ * @return       The cached chunk, or NULL on error
+ */
+static CachedChunk* compressed_get_chunk(BLR_COMPRESSED* file, uint64_t chunk)
+{
+    CachedChunk* oldest = &file->cache[0];
+
+    for (int i = 0; i < COMPRESSED_CACHE_CHUNKS; i++)
+    {
+        CachedChunk* cached = &file->cache[i];
+
+        if (cached->chunk == chunk)
+        {
+            cached->used = ++file->clock;
+            return cached;
+        }
+        else if (cached->used < oldest->used)
+        {
+            oldest = cached;
+        }
+    }
+
+    uint64_t offset = file->index[chunk];
+    size_t len = file->index[chunk + 1] - offset;
+    uLongf expected = std::min<uint64_t>(file->header.chunk_size,
+                                         file->header.size - chunk * file->header.chunk_size);
+    uLongf n = expected;
+
+    file->buffer.resize(len);
+    oldest->data.resize(expected);
+    oldest->chunk = UINT64_MAX;
+
+    if (pread(file->fd, file->buffer.data(), len, offset) != static_cast<ssize_t>(len)
+        || uncompress(oldest->data.data(), &n, file->buffer.data(), len) != Z_OK
+        || n != expected)
+    {
+        return NULL;
+    }
+
+    oldest->chunk = chunk;
+    oldest->used = ++file->clock;
+
+    return oldest;
+}
+
+/**
+ * Read from a compressed binlog file as if it was not compressed
+ *
+ * @param file  The compressed file
+ * @param buf   The buffer to read to
+ * @param len   The number of bytes to read
+ * @param pos   The position in the uncompressed binlog file
+ * @return      The number of bytes read, 0 at the end of the file and
+ *              -1 if the file could not be read, with errno set
+ */
+ssize_t blr_compressed_pread(BLR_COMPRESSED* file, void* buf, size_t len, uint64_t pos)
+{
+    if (pos >= file->header.size)
+    {
+        return 0;
+    }
+
+    len = std::min<uint64_t>(len, file->header.size - pos);
+
+    uint8_t* ptr = static_cast<uint8_t*>(buf);
+    size_t done = 0;
+    ssize_t rval = 0;
+
+    pthread_mutex_lock(&file->lock);
+
+    while (done < len)
+    {
+        uint64_t chunk = (pos + done) / file->header.chunk_size;
+        CachedChunk* cached = compressed_get_chunk(file, chunk);
+
+        if (!cached)
+        {
+            break;
+        }
+
+        size_t offset = pos + done - chunk * file->header.chunk_size;
+        size_t n = std::min(len - done, cached->data.size() - offset);
+
+        memcpy(ptr + done, cached->data.data() + offset, n);
+        done += n;
+    }
+
+    pthread_mutex_unlock(&file->lock);
+
+    if (done < len)
+    {
+        MXS_ERROR("Failed to decompress the binlog data at %" PRIu64 " in file descriptor %d.",
+                  pos + done,
+                  file->fd);
+        errno = EIO;
+        rval = -1;
+    }
+    else
+    {
+        rval = done;
+    }
+
+    return rval;
+}
+
+/**
+ * Return the size of a binlog file that has been compressed
+ *
+ * @param path  The path of the binlog file, without the suffix
+ * @param size  The size of the uncompressed file
+ * @return      True if the path refers to a compressed binlog file
+ */
+bool blr_compressed_file_size(const char* path, uint64_t* size)
+{
+    std::string compressed = std::string(path) + BLR_COMPRESSED_SUFFIX;
+    CompressedHeader header;
+    bool rval = false;
+    int fd = open(compressed.c_str(), O_RDONLY);
+
+    if (fd != -1)
+    {
+        if (pread(fd, &header, sizeof(header), 0) == sizeof(header)
+            && memcmp(header.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC)) == 0)
+        {
+            *size = header.size;
+            rval = true;
+        }
+
+        close(fd);
+    }
+
+    return rval;
+}
+
+/**
+ * Compress a binlog file
+ *
+ * The compressed file is written to a temporary file, which is renamed once
+ * it is complete. Only then is the binlog file removed, so at any point in
+ * time either one of them exists.
+ *
+ * @param router    The router instance
+ * @param path      The path of the binlog file
+ * @param saved     The number of bytes saved
+ * @return          True if the file was compressed, false if the compression
+ *                  failed, was interrupted or would not have saved space
+ */
+static bool compress_binlog(ROUTER_INSTANCE* router, const std::string& path, uint64_t* saved)
+{
+    std::string compressed = path + BLR_COMPRESSED_SUFFIX;
+    std::string tmp = compressed + ".tmp";
+    struct stat statb;
+    int in = open(path.c_str(), O_RDONLY);
+
+    if (in == -1 || fstat(in, &statb) == -1)
+    {
+        if (in != -1)
+        {
+            close(in);
+        }
+
+        return false;
+    }
+
+    int out = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0660);
+
+    if (out == -1)
+    {
+        MXS_ERROR("%s: Failed to create '%s': %d, %s",
+                  router->service->name,
+                  tmp.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+        close(in);
+        return false;
+    }
+
+    CompressedHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+    header.version = COMPRESSED_VERSION;
+    header.chunk_size = COMPRESSED_CHUNK_SIZE;
+    header.size = statb.st_size;
+    header.n_chunks = (header.size + header.chunk_size - 1) / header.chunk_size;
+
+    std::vector<uint8_t> chunk(header.chunk_size);
+    std::vector<uint8_t> buffer(compressBound(header.chunk_size));
+    std::vector<uint64_t> index;
+    uint64_t offset = sizeof(header);
+    bool ok = true;
+
+    for (uint64_t pos = 0; ok && pos < header.size; pos += header.chunk_size)
+    {
+        size_t len = std::min<uint64_t>(header.chunk_size, header.size - pos);
+        uLongf n = buffer.size();
+
+        ok = !atomic_load_int(&router->compression.shutdown)
+            && pread(in, chunk.data(), len, pos) == static_cast<ssize_t>(len)
+            && compress(buffer.data(), &n, chunk.data(), len) == Z_OK
+            && pwrite(out, buffer.data(), n, offset) == static_cast<ssize_t>(n);
+
+        index.push_back(offset);
+        offset += n;
+    }
+
+    index.push_back(offset);
+    header.index_offset = offset;
+
+    size_t index_len = index.size() * sizeof(uint64_t);
+
+    ok = ok
+        && offset + index_len < header.size
+        && pwrite(out, index.data(), index_len, offset) == static_cast<ssize_t>(index_len)
+        && pwrite(out, &header, sizeof(header), 0) == sizeof(header)
+        && fsync(out) == 0;
+
+    /* The file must not have been appended to while it was being compressed */
+    ok = ok && fstat(in, &statb) == 0 && static_cast<uint64_t>(statb.st_size) == header.size;
+
+    close(in);
+
+    if (close(out) != 0)
+    {
+        ok = false;
+    }
+
+    if (ok && rename(tmp.c_str(), compressed.c_str()) == 0)
+    {
+        if (unlink(path.c_str()) == -1)
+        {
+            // Purged while being compressed
+            unlink(compressed.c_str());
+            ok = false;
+        }
+        else
+        {
+            *saved = header.size - offset - index_len;
+        }
+    }
+    else
+    {
+        unlink(tmp.c_str());
+        ok = false;
+    }
+
+    return ok;
+}
+
+/**
+ * Interface for testing the compression of a binlog file
+ *
+ * @param router    The router instance
+ * @param path      The path of the binlog file
+ * @param saved     The number of bytes saved
+ * @return          True if the file was compressed
+ */
+bool blr_test_compress_binlog(ROUTER_INSTANCE* router, const char* path, uint64_t* saved)
+{
+    return compress_binlog(router, path, saved);
+}
+
+/**
+ * Find the binlog files of a directory
+ *
+ * A binlog file name consists of a file root and a number, separated by
+ * a dot.
+ *
+ * @param dir   The directory
+ * @param files The binlog files that are not compressed
+ */
+static void compression_find_files(const std::string& dir, BinlogFiles* files)
+{
+    DIR* dirp = opendir(dir.c_str());
+
+    if (dirp)
+    {
+        struct dirent* dp;
+
+        while ((dp = readdir(dirp)) != NULL)
+        {
+            const char* dot = strrchr(dp->d_name, '.');
+
+            if (dot && dot != dp->d_name && dot[1]
+                && strspn(dot + 1, "0123456789") == strlen(dot + 1))
+            {
+                std::string root(dp->d_name, dot - dp->d_name);
+                (*files)[root][atoi(dot + 1)] = dp->d_name;
+            }
+        }
+
+        closedir(dirp);
+    }
+}
+
+/**
+ * Compress the older binlog files of a directory
+ *
+ * @param router    The router instance
+ * @param dir       The binlog directory
+ * @param elems     The domain and server of the directory, tree storage
+ * @param skipped   The files that could not be compressed
+ */
+static void compression_scan_dir(ROUTER_INSTANCE* router,
+                                 const std::string& dir,
+                                 const MARIADB_GTID_ELEMS* elems,
+                                 std::set<std::string>* skipped)
+{
+    BinlogFiles files;
+    compression_find_files(dir, &files);
+
+    for (const auto& root : files)
+    {
+        int n_old = static_cast<int>(root.second.size()) - router->compression.keep;
+
+        for (auto it = root.second.begin();
+             n_old > 0 && it != root.second.end() && !atomic_load_int(&router->compression.shutdown);
+             ++it, --n_old)
+        {
+            std::string path = dir + "/" + it->second;
+
+            pthread_mutex_lock(&router->binlog_lock);
+            bool current = blr_compare_binlogs(router, elems, router->binlog_name, it->second.c_str());
+            pthread_mutex_unlock(&router->binlog_lock);
+
+            if (current || skipped->count(path))
+            {
+                continue;
+            }
+
+            uint64_t saved = 0;
+
+            if (compress_binlog(router, path, &saved))
+            {
+                atomic_add_uint64(&router->compression.n_files, 1);
+                atomic_add_uint64(&router->compression.n_saved, saved);
+                MXS_INFO("%s: Compressed binlog file '%s', saved %" PRIu64 " bytes.",
+                         router->service->name,
+                         path.c_str(),
+                         saved);
+            }
+            else if (!atomic_load_int(&router->compression.shutdown))
+            {
+                // Not tried again, e.g. an encrypted file does not compress.
+                skipped->insert(path);
+            }
+        }
+    }
+}
+
+/**
+ * Compress the older binlog files of all binlog directories
+ *
+ * @param router    The router instance
+ * @param skipped   The files that could not be compressed
+ */
+static void compression_scan(ROUTER_INSTANCE* router, std::set<std::string>* skipped)
+{
+    std::string binlogdir = router->binlogdir;
+    MARIADB_GTID_ELEMS elems = {};
+
+    if (router->storage_type == BLR_BINLOG_STORAGE_FLAT)
+    {
+        compression_scan_dir(router, binlogdir, &elems, skipped);
+        return;
+    }
+
+    /* The binlog files are stored in "domain_id/server_id" subdirectories */
+    BinlogFiles domains;
+    DIR* dirp = opendir(binlogdir.c_str());
+
+    if (dirp)
+    {
+        struct dirent* dp;
+
+        while ((dp = readdir(dirp)) != NULL)
+        {
+            if (dp->d_name[0] && strspn(dp->d_name, "0123456789") == strlen(dp->d_name))
+            {
+                std::string domain_dir = binlogdir + "/" + dp->d_name;
+                DIR* sub = opendir(domain_dir.c_str());
+
+                if (sub)
+                {
+                    struct dirent* sp;
+
+                    while ((sp = readdir(sub)) != NULL)
+                    {
+                        if (sp->d_name[0] && strspn(sp->d_name, "0123456789") == strlen(sp->d_name))
+                        {
+                            domains[dp->d_name][atoi(sp->d_name)] = domain_dir + "/" + sp->d_name;
+                        }
+                    }
+
+                    closedir(sub);
+                }
+            }
+        }
+
+        closedir(dirp);
+    }
+
+    for (const auto& domain : domains)
+    {
+        for (const auto& server : domain.second)
+        {
+            elems.domain_id = atoi(domain.first.c_str());
+            elems.server_id = server.first;
+            compression_scan_dir(router, server.second, &elems, skipped);
+        }
+    }
+}
+
+static void* compression_thread(void* data)
+{
+    ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(data);
+    std::set<std::string> skipped;
+
+    while (!atomic_load_int(&router->compression.shutdown))
+    {
+        compression_scan(router, &skipped);
+
+        for (int i = 0; i < COMPRESSION_INTERVAL && !atomic_load_int(&router->compression.shutdown); i++)
+        {
+            sleep(1);
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ * Start the thread compressing the older binlog files
+ *
+ * @param router    The router instance
+ * @return          True if the thread was started
+ */
+bool blr_compression_start(ROUTER_INSTANCE* router)
+{
+    router->compression.shutdown = 0;
+
+    if (pthread_create(&router->compression.thread, NULL, compression_thread, router) != 0)
+    {
+        MXS_ERROR("%s: Failed to start the binlog compression thread.",
+                  router->service->name);
+        return false;
+    }
+
+    router->compression.started = true;
+    return true;
+}
+
+/**
+ * Stop the thread compressing the older binlog files, interrupting the
+ * compression of a file
+ *
+ * @param router    The router instance
+ */
+void blr_compression_stop(ROUTER_INSTANCE* router)
+{
+    if (router->compression.started)
+    {
+        atomic_store_int(&router->compression.shutdown, 1);
+        pthread_join(router->compression.thread, NULL);
+        router->compression.started = false;
+    }
+}
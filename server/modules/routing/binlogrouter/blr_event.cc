@@ -28,13 +28,16 @@ bool blr_handle_one_event(MXS_ROUTER* instance, REP_HEADER& hdr, uint8_t* ptr, u
      * Only complete transactions should be sent to sleves
      *
      * If a trasaction is pending router->binlog_position
-     * won't be updated to router->current_pos
+     * won't be updated to router->current_pos.
+     * Neither is it if there are batched events
+     * that have not been written yet.
      */
 
     pthread_mutex_lock(&router->binlog_lock);
-    if (router->trx_safe == 0
-        || (router->trx_safe
-            && router->pending_transaction.state == BLRM_NO_TRANSACTION))
+    if ((router->trx_safe == 0
+         || (router->trx_safe
+             && router->pending_transaction.state == BLRM_NO_TRANSACTION))
+        && router->write_batch.size == 0)
     {
         /* no pending transaction: set current_pos to binlog_position */
         router->binlog_position = router->current_pos;
@@ -322,6 +325,14 @@ bool blr_handle_one_event(MXS_ROUTER* instance, REP_HEADER& hdr, uint8_t* ptr, u
                           router->service->dbref->server->address,
                           router->service->dbref->server->port);
 
+                /* The event must be in the binlog file before it is acknowledged */
+                if (!blr_file_write_batch(router))
+                {
+                    blr_master_close(router);
+                    blr_start_master_in_main(router);
+                    return false;
+                }
+
                 /* Send Semi-Sync ACK packet to master server */
                 blr_send_semisync_ack(router, hdr.next_pos);
 
@@ -332,24 +343,37 @@ bool blr_handle_one_event(MXS_ROUTER* instance, REP_HEADER& hdr, uint8_t* ptr, u
             /**
              * Distributing binlog events to slaves
              * may depend on pending transaction
+             * and on the events having been written
              */
 
-            pthread_mutex_lock(&router->binlog_lock);
+            blr_commit_result_t commit;
 
             if (router->trx_safe == 0
                 || (router->trx_safe
                     && router->pending_transaction.state == BLRM_NO_TRANSACTION))
             {
-                router->binlog_position = router->current_pos;
-                router->current_safe_event = router->last_event_pos;
+                if ((commit = blr_file_commit(router)) == BLR_COMMIT_ERROR)
+                {
+                    blr_master_close(router);
+                    blr_start_master_in_main(router);
+                    return false;
+                }
 
-                pthread_mutex_unlock(&router->binlog_lock);
+                if (commit == BLR_COMMIT_DONE)
+                {
+                    pthread_mutex_lock(&router->binlog_lock);
+                    router->binlog_position = router->current_pos;
+                    router->current_safe_event = router->last_event_pos;
+                    pthread_mutex_unlock(&router->binlog_lock);
 
-                /* Notify clients events can be read */
-                blr_notify_all_slaves(router);
+                    /* Notify clients events can be read */
+                    blr_notify_all_slaves(router);
+                }
             }
             else
             {
+                pthread_mutex_lock(&router->binlog_lock);
+
                 /**
                  * If transaction is closed:
                  *
@@ -386,13 +410,26 @@ bool blr_handle_one_event(MXS_ROUTER* instance, REP_HEADER& hdr, uint8_t* ptr, u
 
                     pthread_mutex_unlock(&router->binlog_lock);
 
-                    /* Notify clients events can be read */
-                    blr_notify_all_slaves(router);
+                    if ((commit = blr_file_commit(router)) == BLR_COMMIT_ERROR)
+                    {
+                        blr_master_close(router);
+                        blr_start_master_in_main(router);
+                        return false;
+                    }
+
+                    if (commit == BLR_COMMIT_DONE)
+                    {
+                        /* Notify clients events can be read */
+                        blr_notify_all_slaves(router);
+                    }
 
                     /* update binlog_position and set pending to NO_TRX */
                     pthread_mutex_lock(&router->binlog_lock);
 
-                    router->binlog_position = router->current_pos;
+                    if (commit == BLR_COMMIT_DONE)
+                    {
+                        router->binlog_position = router->current_pos;
+                    }
 
                     /* Set no pending transaction and no standalone */
                     router->pending_transaction.state = BLRM_NO_TRANSACTION;
@@ -28,6 +28,9 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <ini.h>
 
 #include <maxscale/alloc.h>
@@ -37,6 +40,7 @@
 #include <maxscale/log.h>
 #include <maxscale/paths.h>
 #include <maxscale/router.h>
+#include <maxscale/routingworker.hh>
 #include <maxscale/secrets.h>
 #include <maxscale/server.h>
 #include <maxscale/service.h>
@@ -134,6 +138,48 @@ const EVP_CIPHER* (* ciphers[])(unsigned int) =
     aes_ecb
 };
 
+/**
+ * A cipher context that is reused for all the events a thread encrypts or
+ * decrypts with the same key. Only the IV changes from one event to the next,
+ * so the key schedule is computed only when the cipher, the key or the
+ * direction changes.
+ */
+struct BlrCipher
+{
+    EVP_CIPHER_CTX*   ctx = nullptr;
+    const EVP_CIPHER* cipher = nullptr;
+    int               action = -1;
+    unsigned int      key_len = 0;
+    uint8_t           key[BINLOG_AES_MAX_KEY_LEN];
+
+    ~BlrCipher()
+    {
+        if (ctx)
+        {
+            mxs_evp_cipher_ctx_free(ctx);
+        }
+    }
+};
+
+/**
+ * The cipher contexts and buffers of a thread
+ */
+struct BlrCipherContexts
+{
+    BlrCipher            event;     /*< For encrypting or decrypting one event */
+    BlrCipher            ecb;       /*< For the AES_CBC tails and AES_CTR keystreams */
+    std::vector<uint8_t> buffer;    /*< For the events encrypted before writing */
+    std::vector<uint8_t> keystream; /*< For decrypting AES_CTR events in batches */
+};
+
+static thread_local BlrCipherContexts blr_cipher_contexts;
+
+/**
+ * The AES_CTR events smaller than this are decrypted in batches. The larger
+ * ones are decrypted faster one at a time.
+ */
+#define BLR_CTR_BATCH_EVENT_SIZE 400
+
 #if OPENSSL_VERSION_NUMBER > 0x10000000L
 static const char* blr_encryption_algorithm_names[BINLOG_MAX_CRYPTO_SCHEME] = {"aes_cbc", "aes_ctr"};
 static const char blr_encryption_algorithm_list_names[] = "aes_cbc, aes_ctr";
@@ -176,22 +222,22 @@ int blr_write_special_event(ROUTER_INSTANCE* router,
 static uint8_t* blr_create_start_encryption_event(ROUTER_INSTANCE* router,
                                                   uint32_t event_pos,
                                                   bool do_checksum);
+static ssize_t blr_file_pwrite(ROUTER_INSTANCE* router,
+                               const uint8_t* data,
+                               uint64_t size,
+                               uint64_t offset,
+                               unsigned int n_events);
 static GWBUF* blr_prepare_encrypted_event(ROUTER_INSTANCE* router,
                                           uint8_t* event,
                                           uint32_t event_size,
                                           uint32_t pos,
                                           const uint8_t* nonce,
                                           int action);
-static GWBUF* blr_aes_crypt(ROUTER_INSTANCE* router,
-                            uint8_t* event,
-                            uint32_t event_size,
-                            uint8_t* iv,
-                            int action);
 static int blr_aes_create_tail_for_cbc(uint8_t* output,
                                        uint8_t* input,
                                        uint32_t in_size,
                                        uint8_t* iv,
-                                       uint8_t* key,
+                                       const uint8_t* key,
                                        unsigned int key_len);
 static int blr_binlog_event_check(ROUTER_INSTANCE* router,
                                   unsigned long pos,
@@ -525,8 +571,11 @@ static int blr_file_create(ROUTER_INSTANCE* router, char* orig_file)
     {
         if (blr_file_add_magic(fd))
         {
+            blr_file_write_batch(router);
+            blr_file_sync_pending(router);
             close(router->binlog_fd);
             pthread_mutex_lock(&router->binlog_lock);
+            atomic_add_uint64(&router->binlog_generation, 1);
 
             /// Use an intermediate buffer in case the source and destination overlap
             char new_binlog[strlen(file) + 1];
@@ -534,6 +583,8 @@ static int blr_file_create(ROUTER_INSTANCE* router, char* orig_file)
             strcpy(router->binlog_name, new_binlog);
 
             router->binlog_fd = fd;
+            blr_event_ring_reset(router);
+            router->write_batch.commit_pos = 0;
             /* Initial position after the magic number */
             router->current_pos = BINLOG_MAGIC_SIZE;
             router->binlog_position = BINLOG_MAGIC_SIZE;
@@ -575,95 +626,846 @@ static int blr_file_create(ROUTER_INSTANCE* router, char* orig_file)
     }
     else
     {
-        MXS_ERROR("%s: Failed to create binlog file %s, %s.",
+        MXS_ERROR("%s: Failed to create binlog file %s, %s.",
+                  router->service->name,
+                  path,
+                  mxs_strerror(errno));
+    }
+
+    return created;
+}
+
+/**
+ * Prepare an existing binlog file to be appended to.
+ *
+ * @param router    The router instance
+ * @param file      The binlog file name
+ */
+void blr_file_append(ROUTER_INSTANCE* router, char* file)
+{
+    char path[PATH_MAX + 1] = "";
+    int fd;
+    int flags = O_RDWR;
+
+    /* If Master GTID registration is not set, then use append */
+    if (!router->mariadb10_master_gtid)
+    {
+        flags |= O_APPEND;
+    }
+
+    strcpy(path, router->binlogdir);
+    strcat(path, "/");
+
+    // Add file prefix
+    if (router->mariadb10_compat
+        && router->mariadb10_master_gtid
+        && router->storage_type == BLR_BINLOG_STORAGE_TREE)
+    {
+        char prefix[BINLOG_FILE_EXTRA_INFO];
+        sprintf(prefix,
+                "%" PRIu32 "/%" PRIu32 "/",
+                router->mariadb10_gtid_domain,
+                router->orig_masterid);
+        strcat(path, prefix);
+    }
+
+    // Add filename
+    strcat(path, file);
+
+    if ((fd = open(path, flags, 0660)) == -1)
+    {
+        MXS_ERROR("Failed to open binlog file %s for append.",
+                  path);
+        return;
+    }
+    fsync(fd);
+    blr_file_write_batch(router);
+    blr_file_sync_pending(router);
+    close(router->binlog_fd);
+    pthread_mutex_lock(&router->binlog_lock);
+    atomic_add_uint64(&router->binlog_generation, 1);
+    memmove(router->binlog_name, file, BINLOG_FNAMELEN);
+    blr_event_ring_reset(router);
+    router->write_batch.commit_pos = 0;
+    router->current_pos = lseek(fd, 0L, SEEK_END);
+    if (router->current_pos < 4)
+    {
+        if (router->current_pos == 0)
+        {
+            if (blr_file_add_magic(fd))
+            {
+                router->current_pos = BINLOG_MAGIC_SIZE;
+                router->binlog_position = BINLOG_MAGIC_SIZE;
+                router->current_safe_event = BINLOG_MAGIC_SIZE;
+                router->last_written = BINLOG_MAGIC_SIZE;
+            }
+            else
+            {
+                MXS_ERROR("%s: Could not write magic to binlog file.",
+                          router->service->name);
+            }
+        }
+        else
+        {
+            /* If for any reason the file's length is between 1 and 3 bytes
+             * then report an error. */
+            MXS_ERROR("%s: binlog file %s has an invalid length %lu.",
+                      router->service->name,
+                      path,
+                      router->current_pos);
+            close(fd);
+            pthread_mutex_unlock(&router->binlog_lock);
+            return;
+        }
+    }
+    router->binlog_fd = fd;
+    pthread_mutex_unlock(&router->binlog_lock);
+}
+
+/**
+ * Allocate an event for the ring of recently written events
+ *
+ * @param pos        Position of the event in the binlog file
+ * @param encrypted  Whether the event is encrypted in the file
+ * @param size       The size of the event
+ * @param buf        The unencrypted event
+ * @return           The event with one reference, or NULL
+ */
+BLR_RING_EVENT* blr_ring_event_alloc(uint64_t pos,
+                                     bool encrypted,
+                                     uint32_t size,
+                                     uint8_t* buf)
+{
+    BLR_RING_EVENT* event = (BLR_RING_EVENT*)MXS_MALLOC(sizeof(BLR_RING_EVENT) + size);
+
+    if (event)
+    {
+        event->refcount = 1;
+        event->pos = pos;
+        event->encrypted = encrypted;
+        event->data = (uint8_t*)(event + 1);
+        memcpy(event->data, buf, size);
+
+        /* Fill replication header struct as blr_read_binlog() would */
+        memset(&event->hdr, 0, sizeof(REP_HEADER));
+        event->hdr.timestamp = EXTRACT32(buf);
+        event->hdr.event_type = buf[4];
+        event->hdr.serverid = EXTRACT32(&buf[5]);
+        event->hdr.event_size = size;
+        event->hdr.next_pos = EXTRACT32(&buf[13]);
+        event->hdr.flags = EXTRACT16(&buf[17]);
+    }
+
+    return event;
+}
+
+/**
+ * Release a reference to an event of the ring, the last one frees it
+ *
+ * @param event The event to release
+ */
+static void blr_ring_event_release(BLR_RING_EVENT* event)
+{
+    if (atomic_add(&event->refcount, -1) == 1)
+    {
+        MXS_FREE(event);
+    }
+}
+
+/**
+ * Allocate the slots of the ring of recently written events.
+ *
+ * The limits of the ring must have been set.
+ *
+ * @param router    The router instance
+ * @return          True on success, false if memory allocation failed
+ */
+bool blr_event_ring_init(ROUTER_INSTANCE* router)
+{
+    BLR_EVENT_RING* ring = &router->event_ring;
+
+    ring->events = NULL;
+    ring->first = 0;
+    ring->count = 0;
+    ring->size = 0;
+    ring->binlog_name[0] = '\0';
+    ring->generation = 0;
+    ring->first_pos = 0;
+    ring->end_pos = 0;
+
+    if (ring->max_events)
+    {
+        ring->events = (BLR_RING_EVENT**)MXS_CALLOC(ring->max_events,
+                                                     sizeof(BLR_RING_EVENT*));
+    }
+
+    return ring->max_events == 0 || ring->events != NULL;
+}
+
+/**
+ * Publish the generation and the positions of the events of the ring,
+ * for the readers checking them without the binlog_lock.
+ *
+ * Must be called with the binlog_lock held.
+ *
+ * @param ring          The ring
+ * @param generation    The binlog_generation of the events plus one, 0 if empty
+ */
+static void blr_event_ring_publish(BLR_EVENT_RING* ring, uint64_t generation)
+{
+    uint64_t first_pos = 0;
+    uint64_t end_pos = 0;
+
+    if (ring->count > 0)
+    {
+        BLR_RING_EVENT* first = ring->events[ring->first];
+        BLR_RING_EVENT* last = ring->events[(ring->first + ring->count - 1) % ring->max_events];
+
+        first_pos = first->pos;
+        end_pos = last->pos + last->hdr.event_size;
+    }
+
+    generation = ring->count > 0 ? generation : 0;
+
+    /**
+     * Within a generation the positions only grow. Otherwise readers check
+     * the generation first, so it is cleared first and set last.
+     */
+    if (ring->generation != generation)
+    {
+        atomic_store_uint64(&ring->generation, 0);
+    }
+
+    atomic_store_uint64(&ring->first_pos, first_pos);
+    atomic_store_uint64(&ring->end_pos, end_pos);
+    atomic_store_uint64(&ring->generation, generation);
+}
+
+/**
+ * Remove all events from the ring of recently written events.
+ *
+ * Must be called, with the binlog_lock held, whenever the router starts
+ * writing a binlog file at a position other than the end of the last event.
+ *
+ * @param router    The router instance
+ */
+void blr_event_ring_reset(ROUTER_INSTANCE* router)
+{
+    BLR_EVENT_RING* ring = &router->event_ring;
+
+    for (unsigned int i = 0; i < ring->count; i++)
+    {
+        blr_ring_event_release(ring->events[(ring->first + i) % ring->max_events]);
+    }
+
+    ring->first = 0;
+    ring->count = 0;
+    ring->size = 0;
+    ring->binlog_name[0] = '\0';
+    blr_event_ring_publish(ring, 0);
+}
+
+/**
+ * Free the ring of recently written events
+ *
+ * @param router    The router instance
+ */
+void blr_event_ring_free(ROUTER_INSTANCE* router)
+{
+    if (router->event_ring.events)
+    {
+        blr_event_ring_reset(router);
+        MXS_FREE(router->event_ring.events);
+        router->event_ring.events = NULL;
+    }
+
+    router->event_ring.max_events = 0;
+}
+
+/**
+ * Add an event just written to the current binlog file to the ring,
+ * evicting the oldest events if the limits of the ring would be exceeded.
+ *
+ * Must be called with the binlog_lock held.
+ *
+ * @param router    The router instance
+ * @param event     The event, whose reference is taken over by the ring
+ */
+void blr_event_ring_add(ROUTER_INSTANCE* router, BLR_RING_EVENT* event)
+{
+    BLR_EVENT_RING* ring = &router->event_ring;
+    uint64_t generation = router->binlog_generation + 1;
+
+    if (ring->max_events == 0)
+    {
+        /* The ring has been freed */
+        blr_ring_event_release(event);
+        return;
+    }
+
+    if (ring->count > 0)
+    {
+        BLR_RING_EVENT* last = ring->events[(ring->first + ring->count - 1) % ring->max_events];
+
+        /* The events must be of one file and ordered by position */
+        if (strcmp(ring->binlog_name, router->binlog_name) != 0
+            || ring->generation != generation
+            || event->pos < last->pos + last->hdr.event_size)
+        {
+            blr_event_ring_reset(router);
+        }
+    }
+
+    if (ring->count == 0)
+    {
+        strcpy(ring->binlog_name, router->binlog_name);
+    }
+
+    while (ring->count == ring->max_events
+           || (ring->count > 0 && ring->size + event->hdr.event_size > ring->max_size))
+    {
+        BLR_RING_EVENT* oldest = ring->events[ring->first];
+
+        ring->first = (ring->first + 1) % ring->max_events;
+        ring->count--;
+        ring->size -= oldest->hdr.event_size;
+        blr_ring_event_release(oldest);
+    }
+
+    ring->events[(ring->first + ring->count) % ring->max_events] = event;
+    ring->count++;
+    ring->size += event->hdr.event_size;
+
+    blr_event_ring_publish(ring, generation);
+}
+
+/**
+ * Read an event from the ring of recently written events.
+ *
+ * Only events before the latest safe position of the current binlog file
+ * are returned, i.e. the ones blr_read_binlog() could read from the file.
+ * The binlog_lock is taken only if the ring may contain the event, and the
+ * event is copied outside it, so that the master thread writing the events
+ * is not held up by the slaves reading them.
+ *
+ * @param router    The router instance
+ * @param file      File record
+ * @param pos       Position of binlog record to read
+ * @param hdr       Binlog header to populate
+ * @param enc_ctx   Encryption context for binlog file being read
+ * @return          A copy of the event, or NULL if it is not in the ring
+ */
+GWBUF* blr_event_ring_read(ROUTER_INSTANCE* router,
+                           const BLFILE* file,
+                           unsigned long pos,
+                           REP_HEADER* hdr,
+                           const SLAVE_ENCRYPTION_CTX* enc_ctx)
+{
+    BLR_EVENT_RING* ring = &router->event_ring;
+    BLR_RING_EVENT* event = NULL;
+    GWBUF* result = NULL;
+    /* The event can be served only if the reader would decrypt it as well */
+    bool encrypted = enc_ctx && pos >= enc_ctx->first_enc_event_pos;
+
+    uint64_t generation = atomic_load_uint64(&ring->generation);
+
+    /* The events are of an earlier binlog file or not yet written */
+    if (generation != atomic_load_uint64(&router->binlog_generation) + 1
+        || pos >= atomic_load_uint64(&ring->end_pos))
+    {
+        return NULL;
+    }
+
+    /* The event has already been evicted */
+    if (pos < atomic_load_uint64(&ring->first_pos))
+    {
+        atomic_add_uint64(&router->stats.n_ringmisses, 1);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&router->binlog_lock);
+
+    if (blr_compare_binlogs(router,
+                            &file->gtid_elms,
+                            router->binlog_name,
+                            file->binlog_name)
+        && strcmp(ring->binlog_name, file->binlog_name) == 0
+        && pos < router->binlog_position)
+    {
+        unsigned int low = 0;
+        unsigned int high = ring->count;
+
+        while (low < high)
+        {
+            unsigned int mid = low + (high - low) / 2;
+            BLR_RING_EVENT* candidate = ring->events[(ring->first + mid) % ring->max_events];
+
+            if (candidate->pos < pos)
+            {
+                low = mid + 1;
+            }
+            else if (candidate->pos > pos)
+            {
+                high = mid;
+            }
+            else
+            {
+                if (candidate->encrypted == encrypted)
+                {
+                    event = candidate;
+                    atomic_add(&event->refcount, 1);
+                }
+                break;
+            }
+        }
+
+        if (event)
+        {
+            atomic_add_uint64(&router->stats.n_ringhits, 1);
+        }
+        else
+        {
+            atomic_add_uint64(&router->stats.n_ringmisses, 1);
+        }
+    }
+
+    pthread_mutex_unlock(&router->binlog_lock);
+
+    if (event)
+    {
+        if ((result = gwbuf_alloc_and_load(event->hdr.event_size, event->data)) != NULL)
+        {
+            *hdr = event->hdr;
+            hdr->ok = SLAVE_POS_READ_OK;
+        }
+
+        blr_ring_event_release(event);
+    }
+
+    return result;
+}
+
+/**
+ * The size at which the batched events are written even if the slaves
+ * may not read them yet, so that large transactions are not kept in memory
+ */
+#define BLR_WRITE_BATCH_MAX_SIZE (4 * 1024 * 1024)
+
+/**
+ * The current time in microseconds, for measuring latencies and intervals
+ */
+static uint64_t blr_now_usec()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Add a latency to a histogram of BLR_LATENCY_BUCKETS buckets,
+ * each of which is ten times larger than the previous one.
+ */
+static void blr_latency_add(uint64_t* histogram, uint64_t usec)
+{
+    int bucket = 0;
+
+    for (uint64_t limit = 10; bucket < BLR_LATENCY_BUCKETS - 1 && usec >= limit; limit *= 10)
+    {
+        bucket++;
+    }
+
+    histogram[bucket]++;
+}
+
+/**
+ * Return the name of a latency histogram bucket
+ *
+ * @param bucket    The bucket, from 0 to BLR_LATENCY_BUCKETS - 1
+ * @return          The name of the bucket
+ */
+const char* blr_latency_bucket_name(int bucket)
+{
+    static const char* names[BLR_LATENCY_BUCKETS] =
+    {
+        "under_10us",
+        "under_100us",
+        "under_1ms",
+        "under_10ms",
+        "under_100ms",
+        "under_1s",
+        "over_1s"
+    };
+
+    mxb_assert(bucket >= 0 && bucket < BLR_LATENCY_BUCKETS);
+    return names[bucket];
+}
+
+/**
+ * Write to the current binlog file, updating the write statistics
+ *
+ * @param router    The router instance
+ * @param data      The data to write
+ * @param size      The size of the data
+ * @param offset    The file offset
+ * @param n_events  The number of events in the data
+ * @return          The result of pwrite()
+ */
+static ssize_t blr_file_pwrite(ROUTER_INSTANCE* router,
+                               const uint8_t* data,
+                               uint64_t size,
+                               uint64_t offset,
+                               unsigned int n_events)
+{
+    uint64_t start = blr_now_usec();
+    ssize_t n = pwrite(router->binlog_fd, data, size, offset);
+
+    blr_latency_add(router->stats.write_latency, blr_now_usec() - start);
+    router->stats.n_writes++;
+
+    if (n == static_cast<ssize_t>(size))
+    {
+        router->stats.n_written_events += n_events;
+    }
+
+    router->write_batch.unsynced = true;
+
+    return n;
+}
+
+/**
+ * Sync the current binlog file to disk
+ *
+ * @param router    The router instance
+ * @param start     When the sync was started, in microseconds
+ */
+static void blr_file_do_sync(ROUTER_INSTANCE* router, uint64_t start)
+{
+    BLR_WRITE_BATCH* batch = &router->write_batch;
+
+    /* Syncing each read from the master uses fsync() as the router always did,
+     * the other policies only need the data and the size of the file. */
+    if (batch->sync == BLR_SYNC_RESPONSE)
+    {
+        fsync(router->binlog_fd);
+    }
+    else
+    {
+        fdatasync(router->binlog_fd);
+    }
+
+    uint64_t now = blr_now_usec();
+    blr_latency_add(router->stats.sync_latency, now - start);
+    router->stats.n_syncs++;
+    batch->last_sync = now;
+    batch->unsynced = false;
+}
+
+/**
+ * Sync what has been written to the current binlog file but not yet synced,
+ * unless syncing is left to the operating system. Called before the file
+ * is closed and once the sync interval has passed after the last write.
+ *
+ * @param router    The router instance
+ */
+void blr_file_sync_pending(ROUTER_INSTANCE* router)
+{
+    BLR_WRITE_BATCH* batch = &router->write_batch;
+
+    if (batch->sync != BLR_SYNC_NONE && batch->unsynced && router->binlog_fd != -1)
+    {
+        blr_file_do_sync(router, blr_now_usec());
+    }
+}
+
+/**
+ * The delayed call syncing the tail of the binlog file when nothing has
+ * been written during the sync interval.
+ */
+static bool blr_file_sync_cb(mxb::Worker::Call::action_t action, ROUTER_INSTANCE* router)
+{
+    router->write_batch.sync_call_id = 0;
+
+    if (action == mxb::Worker::Call::EXECUTE)
+    {
+        blr_file_sync_pending(router);
+    }
+
+    return false;
+}
+
+/**
+ * Sync the current binlog file to disk, if the sync policy requires it
+ *
+ * With the interval policy, a sync that is not yet due is done by a delayed
+ * call of the worker handling the master, so that the last events are synced
+ * even if no further events arrive.
+ *
+ * @param router    The router instance
+ * @param commit    Whether the slaves are about to be allowed to read
+ *                  the written events
+ */
+static void blr_file_sync(ROUTER_INSTANCE* router, bool commit)
+{
+    BLR_WRITE_BATCH* batch = &router->write_batch;
+    uint64_t start = blr_now_usec();
+    uint64_t interval = batch->sync_interval * 1000;
+    bool sync;
+
+    switch (batch->sync)
+    {
+    case BLR_SYNC_RESPONSE:
+        sync = !commit;
+        break;
+
+    case BLR_SYNC_TRANSACTION:
+        sync = commit;
+        break;
+
+    case BLR_SYNC_INTERVAL:
+        sync = start - batch->last_sync >= interval;
+        break;
+
+    default:
+        sync = false;
+        break;
+    }
+
+    if (sync && batch->unsynced)
+    {
+        blr_file_do_sync(router, start);
+    }
+    else if (batch->sync == BLR_SYNC_INTERVAL && batch->unsynced && batch->sync_call_id == 0)
+    {
+        mxs::RoutingWorker* worker = mxs::RoutingWorker::get_current();
+
+        if (worker)
+        {
+            uint64_t remaining = interval - (start - batch->last_sync);
+            batch->sync_call_id = worker->delayed_call(remaining / 1000 + 1, blr_file_sync_cb, router);
+        }
+    }
+}
+
+/**
+ * Add an event to the write batch
+ *
+ * @param router    The router instance
+ * @param data      The event, as it is written to the file
+ * @param size      The size of the event
+ * @return          True on success, false on memory allocation failure
+ */
+static bool blr_write_batch_add(ROUTER_INSTANCE* router,
+                                const uint8_t* data,
+                                uint32_t size)
+{
+    BLR_WRITE_BATCH* batch = &router->write_batch;
+
+    if (batch->size + size > batch->capacity)
+    {
+        uint64_t capacity = std::max(batch->capacity * 2, batch->size + size);
+        uint8_t* new_data = static_cast<uint8_t*>(MXS_REALLOC(batch->data, capacity));
+
+        if (new_data == NULL)
+        {
+            return false;
+        }
+
+        batch->data = new_data;
+        batch->capacity = capacity;
+    }
+
+    if (batch->size == 0)
+    {
+        batch->offset = router->last_written;
+        batch->started = blr_now_usec();
+    }
+
+    memcpy(batch->data + batch->size, data, size);
+    batch->size += size;
+    batch->n_events++;
+
+    return true;
+}
+
+/**
+ * Write the batched events to the current binlog file
+ *
+ * If the write fails, the file is truncated to the last position the slaves
+ * may read and the router positions are reset to it, so that the master
+ * sends the events again after reconnecting.
+ *
+ * @param router    The router instance
+ * @return          True if there were no events or they were written
+ */
+bool blr_file_write_batch(ROUTER_INSTANCE* router)
+{
+    BLR_WRITE_BATCH* batch = &router->write_batch;
+
+    if (batch->size == 0)
+    {
+        return true;
+    }
+
+    ssize_t n = blr_file_pwrite(router, batch->data, batch->size, batch->offset, batch->n_events);
+    bool rval = n == static_cast<ssize_t>(batch->size);
+
+    if (!rval)
+    {
+        MXS_ERROR("%s: Failed to write %u binlog records at %lu of %s, %s. "
+                  "Truncating to previous transaction.",
                   router->service->name,
-                  path,
+                  batch->n_events,
+                  batch->offset,
+                  router->binlog_name,
                   mxs_strerror(errno));
+
+        if (ftruncate(router->binlog_fd, router->binlog_position))
+        {
+            MXS_ERROR("%s: Failed to truncate binlog record at %lu of %s, %s. ",
+                      router->service->name,
+                      router->binlog_position,
+                      router->binlog_name,
+                      mxs_strerror(errno));
+        }
+
+        pthread_mutex_lock(&router->binlog_lock);
+        blr_event_ring_reset(router);
+        router->current_pos = router->binlog_position;
+        router->last_written = router->binlog_position;
+        router->pending_transaction.state = BLRM_NO_TRANSACTION;
+        pthread_mutex_unlock(&router->binlog_lock);
+
+        batch->commit_pos = 0;
     }
 
-    return created;
+    batch->size = 0;
+    batch->n_events = 0;
+
+    return rval;
 }
 
 /**
- * Prepare an existing binlog file to be appended to.
+ * Called when the events up to router->current_pos form complete
+ * transactions the slaves may read.
+ *
+ * The batched events are written to the binlog file and synced as the
+ * sync policy requires, unless write batching uses a window that has not
+ * yet elapsed. In that case the position is remembered and the events are
+ * written by a later commit or by blr_file_commit_deferred().
  *
  * @param router    The router instance
- * @param file      The binlog file name
+ * @return          BLR_COMMIT_DONE if the caller may let the slaves read
+ *                  up to router->current_pos, BLR_COMMIT_DEFERRED if not
+ *                  yet and BLR_COMMIT_ERROR if writing failed
  */
-void blr_file_append(ROUTER_INSTANCE* router, char* file)
+blr_commit_result_t blr_file_commit(ROUTER_INSTANCE* router)
 {
-    char path[PATH_MAX + 1] = "";
-    int fd;
-    int flags = O_RDWR;
+    BLR_WRITE_BATCH* batch = &router->write_batch;
 
-    /* If Master GTID registration is not set, then use append */
-    if (!router->mariadb10_master_gtid)
+    if (batch->mode == BLR_WRITE_BATCH_WINDOW
+        && batch->size > 0
+        && blr_now_usec() - batch->started < batch->window * 1000)
     {
-        flags |= O_APPEND;
+        batch->commit_pos = router->current_pos;
+        return BLR_COMMIT_DEFERRED;
     }
 
-    strcpy(path, router->binlogdir);
-    strcat(path, "/");
-
-    // Add file prefix
-    if (router->mariadb10_compat
-        && router->mariadb10_master_gtid
-        && router->storage_type == BLR_BINLOG_STORAGE_TREE)
+    if (!blr_file_write_batch(router))
     {
-        char prefix[BINLOG_FILE_EXTRA_INFO];
-        sprintf(prefix,
-                "%" PRIu32 "/%" PRIu32 "/",
-                router->mariadb10_gtid_domain,
-                router->orig_masterid);
-        strcat(path, prefix);
+        return BLR_COMMIT_ERROR;
     }
 
-    // Add filename
-    strcat(path, file);
+    batch->commit_pos = 0;
+    blr_file_sync(router, true);
 
-    if ((fd = open(path, flags, 0660)) == -1)
+    return BLR_COMMIT_DONE;
+}
+
+/**
+ * Write the batched events and let the slaves read the transactions
+ * whose commit was deferred. Called once all the events of a read from
+ * the master have been handled and when the master connection is closed.
+ *
+ * @param router    The router instance
+ * @return          True on success, false if writing failed
+ */
+bool blr_file_commit_deferred(ROUTER_INSTANCE* router)
+{
+    BLR_WRITE_BATCH* batch = &router->write_batch;
+    uint64_t commit_pos = batch->commit_pos;
+
+    if (!blr_file_write_batch(router))
     {
-        MXS_ERROR("Failed to open binlog file %s for append.",
-                  path);
-        return;
+        return false;
     }
-    fsync(fd);
-    close(router->binlog_fd);
-    pthread_mutex_lock(&router->binlog_lock);
-    memmove(router->binlog_name, file, BINLOG_FNAMELEN);
-    router->current_pos = lseek(fd, 0L, SEEK_END);
-    if (router->current_pos < 4)
+
+    batch->commit_pos = 0;
+
+    if (commit_pos)
     {
-        if (router->current_pos == 0)
+        blr_file_sync(router, true);
+
+        pthread_mutex_lock(&router->binlog_lock);
+        if (commit_pos > router->binlog_position)
         {
-            if (blr_file_add_magic(fd))
-            {
-                router->current_pos = BINLOG_MAGIC_SIZE;
-                router->binlog_position = BINLOG_MAGIC_SIZE;
-                router->current_safe_event = BINLOG_MAGIC_SIZE;
-                router->last_written = BINLOG_MAGIC_SIZE;
-            }
-            else
-            {
-                MXS_ERROR("%s: Could not write magic to binlog file.",
-                          router->service->name);
-            }
+            router->binlog_position = commit_pos;
+            router->current_safe_event = commit_pos;
         }
-        else
+        pthread_mutex_unlock(&router->binlog_lock);
+
+        /* Notify clients events can be read */
+        blr_notify_all_slaves(router);
+    }
+
+    return true;
+}
+
+/**
+ * Write an event to the current binlog file or add it to the write batch
+ *
+ * Events that are too large to be batched are written directly, after the
+ * events batched so far. A ROTATE_EVENT is written at once together with
+ * the batched events, as the binlog file is closed after it.
+ *
+ * @param router    The router instance
+ * @param hdr       The replication header of the event
+ * @param data      The event, as it is written to the file
+ * @param size      The size of the event
+ * @return          The number of bytes written or batched, -1 on error
+ */
+static ssize_t blr_write_event(ROUTER_INSTANCE* router,
+                               REP_HEADER* hdr,
+                               const uint8_t* data,
+                               uint32_t size)
+{
+    if (router->write_batch.mode == BLR_WRITE_BATCH_OFF)
+    {
+        return blr_file_pwrite(router, data, size, router->last_written, 1);
+    }
+
+    if (size >= BLR_WRITE_BATCH_MAX_SIZE)
+    {
+        if (!blr_file_write_batch(router))
         {
-            /* If for any reason the file's length is between 1 and 3 bytes
-             * then report an error. */
-            MXS_ERROR("%s: binlog file %s has an invalid length %lu.",
-                      router->service->name,
-                      path,
-                      router->current_pos);
-            close(fd);
-            pthread_mutex_unlock(&router->binlog_lock);
-            return;
+            return -1;
         }
+
+        return blr_file_pwrite(router, data, size, router->last_written, 1);
     }
-    router->binlog_fd = fd;
-    pthread_mutex_unlock(&router->binlog_lock);
+
+    if (!blr_write_batch_add(router, data, size))
+    {
+        return -1;
+    }
+
+    if ((hdr->event_type == ROTATE_EVENT
+         || router->write_batch.size >= BLR_WRITE_BATCH_MAX_SIZE)
+        && !blr_file_write_batch(router))
+    {
+        return -1;
+    }
+
+    return size;
 }
 
 /**
@@ -683,6 +1485,8 @@ int blr_write_binlog_record(ROUTER_INSTANCE* router,
     bool write_start_encryption_event = false;
     uint64_t file_offset = router->current_pos;
     uint32_t event_size[4];
+    bool encrypted;
+    BLR_RING_EVENT* ring_event = NULL;
 
     /* Track whether FORMAT_DESCRIPTION_EVENT has been received */
     if (hdr->event_type == FORMAT_DESCRIPTION_EVENT)
@@ -709,37 +1513,31 @@ int blr_write_binlog_record(ROUTER_INSTANCE* router,
         n = hole_size;
     }
 
-    if (router->encryption.enabled && router->encryption_ctx != NULL)
+    encrypted = router->encryption.enabled && router->encryption_ctx != NULL;
+
+    if (encrypted)
     {
-        GWBUF* encrypted;
-        uint8_t* encr_ptr;
-        if ((encrypted = blr_prepare_encrypted_event(router,
-                                                     buf,
-                                                     size,
-                                                     router->current_pos,
-                                                     NULL,
-                                                     BINLOG_FLAG_ENCRYPT)) == NULL)
+        /* The event is encrypted into a buffer reused for all events */
+        std::vector<uint8_t>& encrypted_event = blr_cipher_contexts.buffer;
+        encrypted_event.resize(size);
+
+        if (!blr_crypt_event(router,
+                             buf,
+                             encrypted_event.data(),
+                             size,
+                             router->current_pos,
+                             NULL,
+                             BINLOG_FLAG_ENCRYPT))
         {
             return 0;
         }
 
-        encr_ptr = GWBUF_DATA(encrypted);
-
-        n = pwrite(router->binlog_fd,
-                   encr_ptr,
-                   size,
-                   router->last_written);
-
-        gwbuf_free(encrypted);
-        encrypted = NULL;
+        n = blr_write_event(router, hdr, encrypted_event.data(), size);
     }
     else
     {
         /* Write current received event form master */
-        n = pwrite(router->binlog_fd,
-                   buf,
-                   size,
-                   router->last_written);
+        n = blr_write_event(router, hdr, buf, size);
     }
 
     /* Check write operation result*/
@@ -760,14 +1558,32 @@ int blr_write_binlog_record(ROUTER_INSTANCE* router,
                       router->binlog_name,
                       mxs_strerror(errno));
         }
+
+        pthread_mutex_lock(&router->binlog_lock);
+        blr_event_ring_reset(router);
+        pthread_mutex_unlock(&router->binlog_lock);
         return 0;
     }
 
+    /* Keep the event in memory for the slaves close to the end of the binlog */
+    if (router->event_ring.max_events
+        && size >= BINLOG_EVENT_HDR_LEN
+        && size <= router->event_ring.max_size
+        && extract_field(&buf[9], 32) == size)
+    {
+        ring_event = blr_ring_event_alloc(router->last_written, encrypted, size, buf);
+    }
+
     /* Increment offsets */
     pthread_mutex_lock(&router->binlog_lock);
     router->current_pos = hdr->next_pos;
     router->last_written += size;
     router->last_event_pos = hdr->next_pos - hdr->event_size;
+
+    if (ring_event)
+    {
+        blr_event_ring_add(router, ring_event);
+    }
     pthread_mutex_unlock(&router->binlog_lock);
 
     /* Check whether adding the Start Encryption event into current binlog */
@@ -799,13 +1615,14 @@ int blr_write_binlog_record(ROUTER_INSTANCE* router,
 }
 
 /**
- * Flush the content of the binlog file to disk.
+ * Flush the content of the binlog file to disk, as the sync policy requires.
+ * Called once all the events of a read from the master have been handled.
  *
  * @param   router  The binlog router
  */
 void blr_file_flush(ROUTER_INSTANCE* router)
 {
-    fsync(router->binlog_fd);
+    blr_file_sync(router, false);
 }
 
 /**
@@ -921,7 +1738,6 @@ BLFILE* blr_open_binlog(ROUTER_INSTANCE* router,
                sizeof(MARIADB_GTID_ELEMS));
     }
 
-    pthread_mutex_init(&file->lock, NULL);
 
     strcpy(path, router->binlogdir);
     strcat(path, "/");
@@ -940,7 +1756,21 @@ BLFILE* blr_open_binlog(ROUTER_INSTANCE* router,
     /* Add file name */
     strcat(path, binlog);
 
-    if ((file->fd = open(path, O_RDONLY, 0660)) == -1)
+    if ((file->fd = open(path, O_RDONLY, 0660)) == -1 && errno == ENOENT)
+    {
+        /* An older binlog file may have been compressed */
+        strcat(path, BLR_COMPRESSED_SUFFIX);
+
+        if ((file->fd = open(path, O_RDONLY, 0660)) != -1
+            && (file->compressed = blr_compressed_open(file->fd)) == NULL)
+        {
+            MXS_ERROR("Compressed binlog file %s is not valid", path);
+            close(file->fd);
+            file->fd = -1;
+        }
+    }
+
+    if (file->fd == -1)
     {
         MXS_ERROR("Failed to open binlog file %s", path);
         MXS_FREE(file);
@@ -955,6 +1785,69 @@ BLFILE* blr_open_binlog(ROUTER_INSTANCE* router,
     return file;
 }
 
+/**
+ * Read from a binlog file opened with blr_open_binlog()
+ *
+ * @param file  The binlog file
+ * @param buf   The buffer to read to
+ * @param len   The number of bytes to read
+ * @param pos   The position in the binlog file
+ * @return      As pread(), the file is decompressed if it is compressed
+ */
+static ssize_t blr_file_pread(BLFILE* file, void* buf, size_t len, unsigned long pos)
+{
+    return file->compressed ?
+        blr_compressed_pread(file->compressed, buf, len, pos) :
+        pread(file->fd, buf, len, pos);
+}
+
+/**
+ * Check whether a binlog file is complete, that is, not the current binlog file
+ *
+ * A complete file no longer changes, so it can be read without the binlog lock.
+ * The result is cached in the file for the current generation of the router,
+ * so the binlog lock is taken only once per file after the current binlog
+ * file has changed, instead of once per event.
+ *
+ * @param router    The router instance
+ * @param file      The binlog file
+ * @return          True if the file is complete
+ */
+static bool blr_file_is_complete(ROUTER_INSTANCE* router, BLFILE* file)
+{
+    uint64_t generation = atomic_load_uint64(&router->binlog_generation);
+    uint64_t state = atomic_load_uint64(&file->state);
+
+    /* The generation is stored incremented, so that zero means unknown */
+    if ((state >> 1) != generation + 1)
+    {
+        pthread_mutex_lock(&router->binlog_lock);
+        generation = router->binlog_generation;
+        bool current = blr_compare_binlogs(router,
+                                           &file->gtid_elms,
+                                           router->binlog_name,
+                                           file->binlog_name);
+        pthread_mutex_unlock(&router->binlog_lock);
+
+        state = ((generation + 1) << 1) | (current ? 0 : 1);
+        atomic_store_uint64(&file->state, state);
+    }
+
+    return state & 1;
+}
+
+/**
+ * Interface for testing the completeness check of a binlog file
+ *
+ * @param router    The router instance
+ * @param file      The binlog file
+ * @return          True if the file is complete
+ */
+bool blr_test_file_is_complete(ROUTER_INSTANCE* router, BLFILE* file)
+{
+    return blr_file_is_complete(router, file);
+}
+
 /**
  * Read a replication event into a GWBUF structure.
  *
@@ -994,8 +1887,21 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
         return NULL;
     }
 
-    pthread_mutex_lock(&file->lock);
-    if (fstat(file->fd, &statb) == 0)
+    bool complete = blr_file_is_complete(router, file);
+
+    /* Events close to the end of the current binlog are served from memory */
+    if (!complete
+        && router->event_ring.max_events
+        && (result = blr_event_ring_read(router, file, pos, hdr, enc_ctx)) != NULL)
+    {
+        return result;
+    }
+
+    if (file->compressed)
+    {
+        filelen = blr_compressed_size(file->compressed);
+    }
+    else if (fstat(file->fd, &statb) == 0)
     {
         filelen = statb.st_size;
     }
@@ -1008,16 +1914,13 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
                      BINLOG_ERROR_MSG_LEN,
                      "blr_read_binlog called with invalid file->fd, pos %lu",
                      pos);
-            pthread_mutex_unlock(&file->lock);
             return NULL;
         }
     }
-    pthread_mutex_unlock(&file->lock);
 
     if (pos > filelen)
     {
         pthread_mutex_lock(&router->binlog_lock);
-        pthread_mutex_lock(&file->lock);
 
         /* Check whether is current router file */
         if (!blr_compare_binlogs(router,
@@ -1047,54 +1950,54 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
             hdr->ok = SLAVE_POS_BEYOND_EOF;
         }
 
-        pthread_mutex_unlock(&file->lock);
         pthread_mutex_unlock(&router->binlog_lock);
 
         return NULL;
     }
 
-    pthread_mutex_lock(&router->binlog_lock);
-    pthread_mutex_lock(&file->lock);
-
-    /* Check current router file and router position */
-    if (blr_compare_binlogs(router,
-                            &file->gtid_elms,
-                            router->binlog_name,
-                            file->binlog_name)
-        && pos >= router->binlog_position)
+    /* A complete file can be read up to its end without checking the router position */
+    if (!complete)
     {
-        if (pos > router->binlog_position)
-        {
-            snprintf(errmsg,
-                     BINLOG_ERROR_MSG_LEN,
-                     "Requested binlog position %lu is unsafe. "
-                     "Latest safe position %lu, end of binlog file %lu",
-                     pos,
-                     router->binlog_position,
-                     router->current_pos);
+        pthread_mutex_lock(&router->binlog_lock);
 
-            hdr->ok = SLAVE_POS_READ_UNSAFE;
-        }
-        else
+        /* Check current router file and router position */
+        if (blr_compare_binlogs(router,
+                                &file->gtid_elms,
+                                router->binlog_name,
+                                file->binlog_name)
+            && pos >= router->binlog_position)
         {
-            /* accessing last position is ok */
-            hdr->ok = SLAVE_POS_READ_OK;
+            if (pos > router->binlog_position)
+            {
+                snprintf(errmsg,
+                         BINLOG_ERROR_MSG_LEN,
+                         "Requested binlog position %lu is unsafe. "
+                         "Latest safe position %lu, end of binlog file %lu",
+                         pos,
+                         router->binlog_position,
+                         router->current_pos);
+
+                hdr->ok = SLAVE_POS_READ_UNSAFE;
+            }
+            else
+            {
+                /* accessing last position is ok */
+                hdr->ok = SLAVE_POS_READ_OK;
+            }
+
+            pthread_mutex_unlock(&router->binlog_lock);
+
+            return NULL;
         }
 
-        pthread_mutex_unlock(&file->lock);
         pthread_mutex_unlock(&router->binlog_lock);
-
-        return NULL;
     }
 
-    pthread_mutex_unlock(&file->lock);
-    pthread_mutex_unlock(&router->binlog_lock);
-
     /* Read the header information from the file */
-    if ((n = pread(file->fd,
-                   hdbuf,
-                   BINLOG_EVENT_HDR_LEN,
-                   pos)) != BINLOG_EVENT_HDR_LEN)
+    if ((n = blr_file_pread(file,
+                            hdbuf,
+                            BINLOG_EVENT_HDR_LEN,
+                            pos)) != BINLOG_EVENT_HDR_LEN)
     {
         switch (n)
         {
@@ -1175,10 +2078,10 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
                       router->binlog_position,
                       router->binlog_name);
 
-            if ((n = pread(file->fd,
-                           hdbuf,
-                           BINLOG_EVENT_HDR_LEN,
-                           pos)) != BINLOG_EVENT_HDR_LEN)
+            if ((n = blr_file_pread(file,
+                                    hdbuf,
+                                    BINLOG_EVENT_HDR_LEN,
+                                    pos)) != BINLOG_EVENT_HDR_LEN)
             {
                 switch (n)
                 {
@@ -1279,10 +2182,10 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
 
     memcpy(data, hdbuf, BINLOG_EVENT_HDR_LEN);      // Copy the header in the buffer
 
-    if ((n = pread(file->fd,
-                   &data[BINLOG_EVENT_HDR_LEN],
-                   hdr->event_size - BINLOG_EVENT_HDR_LEN,
-                   pos + BINLOG_EVENT_HDR_LEN))
+    if ((n = blr_file_pread(file,
+                            &data[BINLOG_EVENT_HDR_LEN],
+                            hdr->event_size - BINLOG_EVENT_HDR_LEN,
+                            pos + BINLOG_EVENT_HDR_LEN))
         != static_cast<ssize_t>(hdr->event_size - BINLOG_EVENT_HDR_LEN))    // Read the balance
     {
         if (n == 0)
@@ -1344,15 +2247,14 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
      */
     if (enc_ctx && pos >= enc_ctx->first_enc_event_pos)
     {
-        GWBUF* decrypted_event;
-        uint8_t* decrypt_ptr;
-        /* prepare and decrypt the event */
-        if ((decrypted_event = blr_prepare_encrypted_event(router,
-                                                           data,
-                                                           hdr->event_size,
-                                                           pos,
-                                                           enc_ctx->nonce,
-                                                           BINLOG_FLAG_DECRYPT)) == NULL)
+        /* Decrypt the event in place */
+        if (!blr_crypt_event(router,
+                             data,
+                             data,
+                             hdr->event_size,
+                             pos,
+                             enc_ctx->nonce,
+                             BINLOG_FLAG_DECRYPT))
         {
             snprintf(errmsg,
                      BINLOG_ERROR_MSG_LEN,
@@ -1365,18 +2267,13 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
             return NULL;
         }
 
-        decrypt_ptr = GWBUF_DATA(decrypted_event);
-
         /* Fill replication header struct */
-        hdr->timestamp = EXTRACT32(decrypt_ptr);
-        hdr->event_type = decrypt_ptr[4];
-        hdr->serverid = EXTRACT32(&decrypt_ptr[5]);
-        hdr->event_size = extract_field(&decrypt_ptr[9], 32);
-        hdr->next_pos = EXTRACT32(&decrypt_ptr[13]);
-        hdr->flags = EXTRACT16(&decrypt_ptr[17]);
-
-        /* Free data read from disk */
-        gwbuf_free(result);
+        hdr->timestamp = EXTRACT32(data);
+        hdr->event_type = data[4];
+        hdr->serverid = EXTRACT32(&data[5]);
+        hdr->event_size = extract_field(&data[9], 32);
+        hdr->next_pos = EXTRACT32(&data[13]);
+        hdr->flags = EXTRACT16(&data[17]);
 
         /**
          * Binlog event check based on Rep Header content and pos
@@ -1387,12 +2284,9 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
                                     file->binlog_name,
                                     errmsg))
         {
-            gwbuf_free(decrypted_event);
+            gwbuf_free(result);
             return NULL;
         }
-
-        /* Set the decrypted event as result */
-        result = decrypted_event;
     }
 
     /* set OK indicator */
@@ -1401,6 +2295,78 @@ GWBUF* blr_read_binlog(ROUTER_INSTANCE* router,
     return result;
 }
 
+/**
+ * Read a range of a binlog file as it is stored, for sending the events
+ * in it to a slave in bulk.
+ *
+ * Only data before the latest safe position is read from the current
+ * binlog file, and not the events in the ring of recently written events,
+ * which blr_read_binlog() serves from memory. The binlog_lock is held only
+ * for reading the position, never while the file is read. Errors are not
+ * reported, the caller is expected to fall back to blr_read_binlog() that
+ * reports them.
+ *
+ * @param router    The router instance
+ * @param file      File record
+ * @param pos       Position to start reading from
+ * @param max_len   Maximum number of bytes to read
+ * @return          The data, possibly ending with a partial event, or NULL
+ *                  if not even a binlog event header could be read
+ */
+GWBUF* blr_read_binlog_range(ROUTER_INSTANCE* router,
+                             BLFILE* file,
+                             unsigned long pos,
+                             unsigned long max_len)
+{
+    unsigned long len = max_len;
+    GWBUF* result = NULL;
+
+    /* A complete file can be read up to its end without checking the router position */
+    if (!blr_file_is_complete(router, file))
+    {
+        BLR_EVENT_RING* ring = &router->event_ring;
+
+        if (atomic_load_uint64(&ring->generation) == atomic_load_uint64(&router->binlog_generation) + 1)
+        {
+            uint64_t first_pos = atomic_load_uint64(&ring->first_pos);
+            len = pos < first_pos ? MXS_MIN(len, first_pos - pos) : 0;
+        }
+
+        if (len >= BINLOG_EVENT_HDR_LEN)
+        {
+            pthread_mutex_lock(&router->binlog_lock);
+
+            if (blr_compare_binlogs(router,
+                                    &file->gtid_elms,
+                                    router->binlog_name,
+                                    file->binlog_name))
+            {
+                len = pos < router->binlog_position ?
+                    MXS_MIN(len, router->binlog_position - pos) : 0;
+            }
+
+            pthread_mutex_unlock(&router->binlog_lock);
+        }
+    }
+
+    if (len >= BINLOG_EVENT_HDR_LEN && (result = gwbuf_alloc(len)) != NULL)
+    {
+        ssize_t n = blr_file_pread(file, GWBUF_DATA(result), len, pos);
+
+        if (n < BINLOG_EVENT_HDR_LEN)
+        {
+            gwbuf_free(result);
+            result = NULL;
+        }
+        else if (static_cast<unsigned long>(n) < len)
+        {
+            result = gwbuf_rtrim(result, len - n);
+        }
+    }
+
+    return result;
+}
+
 /**
  * Close a binlog file that has been opened to read binlog records
  *
@@ -1442,6 +2408,7 @@ void blr_close_binlog(ROUTER_INSTANCE* router, BLFILE* file)
 
     if (file)
     {
+        blr_compressed_close(file->compressed);
         close(file->fd);
         file->fd = -1;
         MXS_FREE(file);
@@ -1479,7 +2446,11 @@ unsigned long blr_file_size(BLFILE* file)
 {
     struct stat statb;
 
-    if (fstat(file->fd, &statb) == 0)
+    if (file->compressed)
+    {
+        return blr_compressed_size(file->compressed);
+    }
+    else if (fstat(file->fd, &statb) == 0)
     {
         return statb.st_size;
     }
@@ -1641,11 +2612,14 @@ int blr_file_next_exists(ROUTER_INSTANCE* router,
                               "binlog_file "
                               "FROM gtid_maps "
                               "WHERE id = "
+                              "(SELECT MIN(id) "
+                              "FROM gtid_maps "
+                              "WHERE id > "
                               "(SELECT MAX(id) "
                               "FROM gtid_maps "
                               "WHERE (binlog_file='%s' AND "
                               "rep_domain = %" PRIu32 " AND "
-                                                      "server_id = %" PRIu32 ")) + 1;";
+                                                      "server_id = %" PRIu32 ")));";
 
     MARIADB_GTID_ELEMS gtid_elms = {};
     MARIADB_GTID_INFO result;
@@ -3669,22 +4643,17 @@ int blr_write_special_event(ROUTER_INSTANCE* router,
         {
             return 0;
         }
-        if (router->encryption.enabled && router->encryption_ctx != NULL)
+        if (router->encryption.enabled && router->encryption_ctx != NULL
+            && !blr_crypt_event(router,
+                                new_event,
+                                new_event,
+                                event_size,
+                                router->current_pos,
+                                NULL,
+                                BINLOG_FLAG_ENCRYPT))
         {
-            GWBUF* encrypted;
-            uint8_t* encr_ptr;
-            if ((encrypted = blr_prepare_encrypted_event(router,
-                                                         new_event,
-                                                         event_size,
-                                                         router->current_pos,
-                                                         NULL,
-                                                         BINLOG_FLAG_ENCRYPT)) == NULL)
-            {
-                return 0;
-            }
-
-            memcpy(new_event, GWBUF_DATA(encrypted), event_size);
-            gwbuf_free(encrypted);
+            MXS_FREE(new_event);
+            return 0;
         }
         break;
 
@@ -3719,11 +4688,18 @@ int blr_write_special_event(ROUTER_INSTANCE* router,
         break;
     }
 
-    /* Write the event */
-    if ((n = pwrite(router->binlog_fd,
-                    new_event,
-                    event_size,
-                    router->last_written)) != static_cast<ssize_t>(event_size))
+    /* Write the event after the events received so far */
+    if (!blr_file_write_batch(router))
+    {
+        MXS_FREE(new_event);
+        return 0;
+    }
+
+    if ((n = blr_file_pwrite(router,
+                             new_event,
+                             event_size,
+                             router->last_written,
+                             1)) != static_cast<ssize_t>(event_size))
     {
         MXS_ERROR("%s: Failed to write %s special binlog record at %lu of %s, %s. "
                   "Truncating to previous record.",
@@ -3859,136 +4835,405 @@ uint8_t* blr_create_start_encryption_event(ROUTER_INSTANCE* router,
 }
 
 /**
- * Encrypt/Decrypt an array of bytes
+ * Initialise a reusable cipher context for a new IV
+ *
+ * @param cipher    The cached context
+ * @param type      The cipher
+ * @param key       The encryption key
+ * @param key_len   The length of the key
+ * @param iv        The IV, or NULL
+ * @param action    BINLOG_FLAG_ENCRYPT or BINLOG_FLAG_DECRYPT
+ * @return          The context or NULL on error
+ */
+static EVP_CIPHER_CTX* blr_cipher_init(BlrCipher* cipher,
+                                       const EVP_CIPHER* type,
+                                       const uint8_t* key,
+                                       unsigned int key_len,
+                                       const uint8_t* iv,
+                                       int action)
+{
+    if (!cipher->ctx && (cipher->ctx = mxs_evp_cipher_ctx_alloc()) == NULL)
+    {
+        return NULL;
+    }
+
+    bool same_key = cipher->cipher == type
+        && cipher->action == action
+        && cipher->key_len == key_len
+        && memcmp(cipher->key, key, key_len) == 0;
+
+    if (!EVP_CipherInit_ex(cipher->ctx,
+                           same_key ? NULL : type,
+                           NULL,
+                           same_key ? NULL : key,
+                           iv,
+                           action))
+    {
+        cipher->cipher = NULL;
+        return NULL;
+    }
+
+    if (!same_key)
+    {
+        cipher->cipher = type;
+        cipher->action = action;
+        cipher->key_len = key_len;
+        memcpy(cipher->key, key, key_len);
+
+        /* Set no padding */
+        EVP_CIPHER_CTX_set_padding(cipher->ctx, 0);
+    }
+
+    return cipher->ctx;
+}
+
+/**
+ * Encrypt or decrypt a binlog event
  *
- * Note: The output buffer is 4 bytes larger than input
- * Encrypted bytes start at offset 4
+ * The event size, four bytes at offset BINLOG_EVENT_LEN_OFFSET, is stored in
+ * clear. The other bytes of the event, with the first four bytes taking the
+ * place of the event size, are encrypted and stored from offset 4 onwards;
+ * the encrypted bytes at the place of the event size are then moved to the
+ * beginning of the event.
  *
  * @param router    The router instance
- * @param buffer    The buffer to encrypt/decrypt
- * @param size      The buffer size
- * @param iv        The AES initialisation Vector
- * @action          Crypt action: 1 encrypt, 1 decrypt
- * @return          A new allocated, encrypted, GWBUF buffer
- *
+ * @param event     The binlog event
+ * @param out       Where the result is stored, may be the same as event
+ * @param size      The event size (CRC32 four bytes included)
+ * @param pos       The position of the event in binlog file
+ * @param nonce     The binlog nonce 12 bytes as in MXS_START_ENCRYPTION_EVENT
+ *                  of requested or current binlog file
+ *                  If nonce is NULL the one from current binlog file is used.
+ * @param action    Encryption action: 1 Encrypt, 0 Decrypt
+ * @return          True on success
  */
-static GWBUF* blr_aes_crypt(ROUTER_INSTANCE* router,
-                            uint8_t* buffer,
-                            uint32_t size,
-                            uint8_t* iv,
-                            int action)
+bool blr_crypt_event(ROUTER_INSTANCE* router,
+                     const uint8_t* event,
+                     uint8_t* out,
+                     uint32_t size,
+                     uint32_t pos,
+                     const uint8_t* nonce,
+                     int action)
 {
-    uint8_t* key = router->encryption.key_value;
+    const uint8_t* key = router->encryption.key_value;
     unsigned int key_len = router->encryption.key_len;
-    int outlen;
-    int flen;
-    uint32_t encrypted_size = size + 4;
-    int total_len;
-    GWBUF* outbuf;
-    uint8_t* out_ptr;
+    uint8_t iv[BLRM_IV_LENGTH];
+    uint8_t head[4];
+    uint8_t event_size[4];
+    int len;
+    int outlen = 0;
 
     if (key_len == 0)
     {
         MXS_ERROR("The encrytion key len is 0");
-        return NULL;
+        return false;
     }
 
-    if ((outbuf = gwbuf_alloc(encrypted_size)) == NULL)
+    if (size < BINLOG_EVENT_HDR_LEN)
     {
-        return NULL;
+        return false;
     }
 
-    out_ptr = GWBUF_DATA(outbuf);
+    /* If nonce is NULL use the router current binlog file */
+    if (nonce == NULL)
+    {
+        BINLOG_ENCRYPTION_CTX* encryption_ctx = (BINLOG_ENCRYPTION_CTX*)(router->encryption_ctx);
+        nonce = encryption_ctx->nonce;
+    }
 
-    EVP_CIPHER_CTX* ctx = mxs_evp_cipher_ctx_alloc();
+    /* Encryption IV is 12 bytes nonce + 4 bytes event position */
+    memcpy(iv, nonce, BLRM_NONCE_LENGTH);
+    gw_mysql_set_byte4(iv + BLRM_NONCE_LENGTH, (unsigned long)pos);
 
-    /* Set the encryption algorithm accordingly to key_len and encryption mode */
-    if (!EVP_CipherInit_ex(ctx,
-                           ciphers[router->encryption.encryption_algorithm](router->encryption.key_len),
-                           NULL,
-                           key,
-                           iv,
-                           action))
+    /* Saved, as they are overwritten if the event is processed in place */
+    memcpy(head, event, 4);
+    memcpy(event_size, event + BINLOG_EVENT_LEN_OFFSET, 4);
+
+    EVP_CIPHER_CTX* ctx = blr_cipher_init(&blr_cipher_contexts.event,
+                                          ciphers[router->encryption.encryption_algorithm](key_len),
+                                          key,
+                                          key_len,
+                                          iv,
+                                          action);
+
+    if (!ctx)
     {
         MXS_ERROR("Error in EVP_CipherInit_ex for algo %d",
                   router->encryption.encryption_algorithm);
-        mxs_evp_cipher_ctx_free(ctx);
-        MXS_FREE(outbuf);
-        return NULL;
+        return false;
     }
 
-    /* Set no padding */
-    EVP_CIPHER_CTX_set_padding(ctx, 0);
-
-    /* Encryt/Decrypt the input data */
-    if (!EVP_CipherUpdate(ctx,
-                          out_ptr + 4,
-                          &outlen,
-                          buffer,
-                          size))
+    /**
+     * Encrypt/Decrypt the bytes from offset 4 onwards, taking the first
+     * four bytes instead of the event size. The input is processed in
+     * pieces so that it need not be rearranged first.
+     */
+    if (!EVP_CipherUpdate(ctx, out + 4, &len, event + 4, BINLOG_EVENT_LEN_OFFSET - 4)
+        || (outlen += len, !EVP_CipherUpdate(ctx, out + 4 + outlen, &len, head, 4))
+        || (outlen += len, !EVP_CipherUpdate(ctx,
+                                             out + 4 + outlen,
+                                             &len,
+                                             event + BINLOG_EVENT_LEN_OFFSET + 4,
+                                             size - BINLOG_EVENT_LEN_OFFSET - 4)))
     {
         MXS_ERROR("Error in EVP_CipherUpdate");
-        mxs_evp_cipher_ctx_free(ctx);
-        MXS_FREE(outbuf);
-        return NULL;
+        return false;
     }
 
-    int finale_ret = 1;
+    outlen += len;
 
     /* Enc/dec finish is differently handled for AES_CBC */
     if (router->encryption.encryption_algorithm != BLR_AES_CBC)
     {
+        int flen;
+
         /* Call Final_ex */
-        if (!EVP_CipherFinal_ex(ctx,
-                                (out_ptr + 4 + outlen),
-                                (int*)&flen))
+        if (!EVP_CipherFinal_ex(ctx, out + 4 + outlen, &flen))
         {
             MXS_ERROR("Error in EVP_CipherFinal_ex");
-            finale_ret = 0;
+            return false;
         }
     }
-    else
+    /**
+     * The bytes after the last full block are handled with ECB and XOR.
+     * They are taken from the input, as not all OpenSSL versions keep
+     * them in ctx.buf, and are still intact even if the event is processed
+     * in place, as only the full blocks have been written.
+     */
+    else if (size - 4 - outlen > 0)
     {
-        /**
-         * If some bytes (ctx.buf_len) are still available in ctx.buf
-         * handle them with ECB and XOR
-         */
-        if (size - outlen > 0)
+        uint8_t tail[AES_BLOCK_SIZE];
+
+        for (uint32_t i = outlen; i < size - 4; i++)
+        {
+            bool in_head = i >= BINLOG_EVENT_LEN_OFFSET - 4 && i < BINLOG_EVENT_LEN_OFFSET;
+            tail[i - outlen] = in_head ? head[i - (BINLOG_EVENT_LEN_OFFSET - 4)] : event[4 + i];
+        }
+
+        if (!blr_aes_create_tail_for_cbc(out + 4 + outlen,
+                                         tail,
+                                         size - 4 - outlen,
+                                         iv,
+                                         key,
+                                         key_len))
+        {
+            MXS_ERROR("Error in blr_aes_create_tail_for_cbc");
+            return false;
+        }
+    }
+
+    /* Move the bytes encrypted in place of the event size to the beginning */
+    memcpy(out, out + BINLOG_EVENT_LEN_OFFSET, 4);
+    memcpy(out + BINLOG_EVENT_LEN_OFFSET, event_size, 4);
+
+    return true;
+}
+
+/**
+ * Decrypt AES_CTR encrypted binlog events in place
+ *
+ * The keystream of a binlog event consists of the encrypted counter blocks
+ * starting from its IV, so the keystreams of all the events are computed
+ * with a single ECB encryption of the counter blocks. For small events this
+ * is much faster than decrypting the events one at a time.
+ *
+ * @param router    The router instance
+ * @param data      The complete events
+ * @param len       The length of data
+ * @param pos       The position of the first event in the binlog file
+ * @param nonce     The nonce of the binlog file
+ * @return          True on success
+ */
+static bool blr_ctr_decrypt_events(ROUTER_INSTANCE* router,
+                                   uint8_t* data,
+                                   unsigned long len,
+                                   unsigned long pos,
+                                   const uint8_t* nonce)
+{
+    std::vector<uint8_t>& keystream = blr_cipher_contexts.keystream;
+    size_t n_blocks = 0;
+
+    for (unsigned long offset = 0; offset < len;)
+    {
+        uint32_t event_size = extract_field(data + offset + BINLOG_EVENT_LEN_OFFSET, 32);
+        n_blocks += (event_size - 4 + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE;
+        offset += event_size;
+    }
+
+    /* The counter blocks, incremented as a 128-bit big-endian integer */
+    keystream.resize(n_blocks * AES_BLOCK_SIZE);
+    uint8_t* block = keystream.data();
+
+    for (unsigned long offset = 0; offset < len;)
+    {
+        uint32_t event_size = extract_field(data + offset + BINLOG_EVENT_LEN_OFFSET, 32);
+        uint8_t counter[AES_BLOCK_SIZE];
+
+        memcpy(counter, nonce, BLRM_NONCE_LENGTH);
+        gw_mysql_set_byte4(counter + BLRM_NONCE_LENGTH, (unsigned long)(pos + offset));
+
+        for (uint32_t i = 0; i < (event_size - 4 + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE; i++)
         {
-            if (!blr_aes_create_tail_for_cbc(out_ptr + 4 + outlen,
-                                             mxs_evp_cipher_ctx_buf(ctx),
-                                             size - outlen,
-                                             mxs_evp_cipher_ctx_oiv(ctx),
-                                             router->encryption.key_value,
-                                             router->encryption.key_len))
+            memcpy(block, counter, AES_BLOCK_SIZE);
+            block += AES_BLOCK_SIZE;
+
+            for (int j = AES_BLOCK_SIZE - 1; j >= 0 && ++counter[j] == 0; j--)
             {
-                MXS_ERROR("Error in blr_aes_create_tail_for_cbc");
-                finale_ret = 0;
             }
         }
+
+        offset += event_size;
+    }
+
+    int outlen;
+    EVP_CIPHER_CTX* ctx = blr_cipher_init(&blr_cipher_contexts.ecb,
+                                          ciphers[BLR_AES_ECB](router->encryption.key_len),
+                                          router->encryption.key_value,
+                                          router->encryption.key_len,
+                                          NULL,
+                                          BINLOG_FLAG_ENCRYPT);
+
+    if (!ctx || !EVP_CipherUpdate(ctx,
+                                  keystream.data(),
+                                  &outlen,
+                                  keystream.data(),
+                                  keystream.size()))
+    {
+        MXS_ERROR("Error in EVP_CipherUpdate ECB");
+        return false;
+    }
+
+    /* XOR the events with their keystreams, as blr_crypt_event() does */
+    const uint8_t* ks = keystream.data();
+
+    for (unsigned long offset = 0; offset < len;)
+    {
+        uint8_t* event = data + offset;
+        uint32_t event_size = extract_field(event + BINLOG_EVENT_LEN_OFFSET, 32);
+        uint8_t head[4];
+        uint8_t size_bytes[4];
+
+        memcpy(head, event, 4);
+        memcpy(size_bytes, event + BINLOG_EVENT_LEN_OFFSET, 4);
+
+        for (uint32_t k = 0; k < BINLOG_EVENT_LEN_OFFSET - 4; k++)
+        {
+            event[4 + k] ^= ks[k];
+        }
+
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            event[BINLOG_EVENT_LEN_OFFSET + k] = head[k] ^ ks[BINLOG_EVENT_LEN_OFFSET - 4 + k];
+        }
+
+        /* The rest of the event, a word at a time */
+        uint8_t* ptr = event + BINLOG_EVENT_LEN_OFFSET + 4;
+        const uint8_t* ks_ptr = ks + BINLOG_EVENT_LEN_OFFSET;
+        uint8_t* ptr_end = event + event_size;
+
+        for (; ptr + sizeof(uint64_t) <= ptr_end; ptr += sizeof(uint64_t), ks_ptr += sizeof(uint64_t))
+        {
+            uint64_t word;
+            uint64_t mask;
+            memcpy(&word, ptr, sizeof(word));
+            memcpy(&mask, ks_ptr, sizeof(mask));
+            word ^= mask;
+            memcpy(ptr, &word, sizeof(word));
+        }
+
+        for (; ptr < ptr_end; ptr++, ks_ptr++)
+        {
+            *ptr ^= *ks_ptr;
+        }
+
+        memcpy(event, event + BINLOG_EVENT_LEN_OFFSET, 4);
+        memcpy(event + BINLOG_EVENT_LEN_OFFSET, size_bytes, 4);
+
+        ks += (event_size - 4 + AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE * AES_BLOCK_SIZE;
+        offset += event_size;
     }
 
-    if (!finale_ret)
+    return true;
+}
+
+/**
+ * Decrypt the events of a range of an encrypted binlog file in place
+ *
+ * With AES_CTR, the consecutive events smaller than BLR_CTR_BATCH_EVENT_SIZE
+ * are decrypted together with blr_ctr_decrypt_events().
+ *
+ * @param router    The router instance
+ * @param data      The events read from the binlog file
+ * @param len       The length of data
+ * @param pos       The position of the first event in the binlog file
+ * @param nonce     The nonce of the binlog file
+ * @return          The length of the complete events decrypted, the rest of
+ *                  the data is left as it is
+ */
+unsigned long blr_decrypt_events(ROUTER_INSTANCE* router,
+                                 uint8_t* data,
+                                 unsigned long len,
+                                 unsigned long pos,
+                                 const uint8_t* nonce)
+{
+    bool batch = router->encryption.encryption_algorithm == BLR_AES_CTR;
+    unsigned long batch_start = 0;
+    unsigned long end = 0;
+
+    /* The event sizes are in clear */
+    while (end + BINLOG_EVENT_HDR_LEN <= len)
     {
-        MXS_FREE(outbuf);
-        outbuf = NULL;
+        uint32_t event_size = extract_field(data + end + BINLOG_EVENT_LEN_OFFSET, 32);
+
+        if (event_size < BINLOG_EVENT_HDR_LEN || end + event_size > len)
+        {
+            break;
+        }
+
+        if (!batch || event_size >= BLR_CTR_BATCH_EVENT_SIZE)
+        {
+            if (batch_start < end
+                && !blr_ctr_decrypt_events(router, data + batch_start, end - batch_start,
+                                           pos + batch_start, nonce))
+            {
+                return batch_start;
+            }
+
+            if (!blr_crypt_event(router,
+                                 data + end,
+                                 data + end,
+                                 event_size,
+                                 pos + end,
+                                 nonce,
+                                 BINLOG_FLAG_DECRYPT))
+            {
+                return end;
+            }
+
+            batch_start = end + event_size;
+        }
+
+        end += event_size;
     }
 
-    mxs_evp_cipher_ctx_free(ctx);
+    if (batch_start < end
+        && !blr_ctr_decrypt_events(router, data + batch_start, end - batch_start,
+                                   pos + batch_start, nonce))
+    {
+        return batch_start;
+    }
 
-    return outbuf;
+    return end;
 }
 
 /**
- * The routine prepares a binlg event for encryption and ecrypts it
+ * Encrypt or decrypt a binlog event into a new buffer
  *
  * @param router    The ruter instance
- * @buf             The binlog event
+ * @buf             The binlog event, left as it is
  * @size            The event size (CRC32 four bytes included)
  * @pos             The position of the event in binlog file
- * @nonce           The binlog nonce 12 bytes as in MXS_START_ENCRYPTION_EVENT
- *                  of requested or current binlog file
- *                  If nonce is NULL the one from current binlog file is used.
+ * @nonce           The binlog nonce or NULL, see blr_crypt_event()
  * @action          Encryption action: 1 Encryp, 0 Decryot
  * @return          A GWBUF buffer or NULL omn error
  */
@@ -3999,82 +5244,14 @@ static GWBUF* blr_prepare_encrypted_event(ROUTER_INSTANCE* router,
                                           const uint8_t* nonce,
                                           int action)
 {
-    uint8_t iv[BLRM_IV_LENGTH];
-    uint32_t file_offset = pos;
-    uint8_t event_size[4];
-    const uint8_t* nonce_ptr = nonce;
-    GWBUF* encrypted;
-    uint8_t* enc_ptr;
-
-    /* If nonce is NULL use the router current binlog file */
-    if (nonce_ptr == NULL)
-    {
-        BINLOG_ENCRYPTION_CTX* encryption_ctx = (BINLOG_ENCRYPTION_CTX*)(router->encryption_ctx);
-        nonce_ptr = encryption_ctx->nonce;
-    }
-
-    /* Encryption IV is 12 bytes nonce + 4 bytes event position */
-    memcpy(iv, nonce_ptr, BLRM_NONCE_LENGTH);
-    gw_mysql_set_byte4(iv + BLRM_NONCE_LENGTH, (unsigned long)file_offset);
-
-    /**
-     * Encrypt binlog event, steps:
-     *
-     * 1: Save event size (buf + 9, 4 bytes)
-     * 2: move first 4 bytes of buf to buf + 9
-     * 3: encrypt buf starting from buf + 4 (so it will be event_size - 4)
-     * 4: move encrypted_data + 9 (4 bytes) to  encrypted_data[0]
-     * 5: Copy saved_event_size 4 bytes into encrypted_data + 9
-     */
+    GWBUF* encrypted = gwbuf_alloc(size);
 
-    /* (1): Save event size (buf + 9, 4 bytes) */
-    memcpy(&event_size, buf + BINLOG_EVENT_LEN_OFFSET, 4);
-    /* (2): move first 4 bytes of buf to buf + 9 */
-    memmove(buf + BINLOG_EVENT_LEN_OFFSET, buf, 4);
-
-#ifdef SS_DEBUG
-    char iv_hex[AES_BLOCK_SIZE * 2 + 1] = "";
-    char nonce_hex[BLRM_NONCE_LENGTH * 2 + 1] = "";
-
-    /* Human readable debug */
-    gw_bin2hex(iv_hex, iv, BLRM_IV_LENGTH);
-    gw_bin2hex(nonce_hex, nonce_ptr, BLRM_NONCE_LENGTH);
-
-    MXS_DEBUG("** Encryption/Decryption of Event @ %lu: the IV is %s, "
-              "size is %lu, next pos is %lu",
-              (unsigned long)pos,
-              iv_hex,
-              (unsigned long)size,
-              (unsigned long)(pos + size));
-#endif
-
-    /**
-     * (3): encrypt the event stored in buf starting from (buf + 4):
-     * with len (event_size - 4)
-     *
-     * NOTE: the encrypted_data buffer returned by blr_aes_encrypt() contains:
-     * (size - 4) encrypted bytes + (4) bytes event size in clear
-     *
-     * The encrypted buffer has same size of the original event (size variable)
-     */
-
-    if ((encrypted = blr_aes_crypt(router,
-                                   buf + 4,
-                                   size - 4,
-                                   iv,
-                                   action)) == NULL)
+    if (encrypted && !blr_crypt_event(router, buf, GWBUF_DATA(encrypted), size, pos, nonce, action))
     {
-        return NULL;
+        gwbuf_free(encrypted);
+        encrypted = NULL;
     }
 
-    enc_ptr = GWBUF_DATA(encrypted);
-
-    /* (4): move encrypted_data + 9 (4 bytes) to  encrypted_data[0] */
-    memmove(enc_ptr, enc_ptr + BINLOG_EVENT_LEN_OFFSET, 4);
-
-    /* (5): Copy saved_event_size 4 bytes into encrypted_data + 9 */
-    memcpy(enc_ptr + BINLOG_EVENT_LEN_OFFSET, &event_size, 4);
-
     return encrypted;
 }
 
@@ -4155,30 +5332,26 @@ static int blr_aes_create_tail_for_cbc(uint8_t* output,
                                        uint8_t* input,
                                        uint32_t in_size,
                                        uint8_t* iv,
-                                       uint8_t* key,
+                                       const uint8_t* key,
                                        unsigned int key_len)
 {
     uint8_t mask[AES_BLOCK_SIZE];
     int mlen = 0;
 
-    EVP_CIPHER_CTX* t_ctx = mxs_evp_cipher_ctx_alloc();
-
     /* Initialise with AES_ECB and NULL iv */
-    if (!EVP_CipherInit_ex(t_ctx,
-                           ciphers[BLR_AES_ECB](key_len),
-                           NULL,
-                           key,
-                           NULL,    /* NULL iv */
-                           BINLOG_FLAG_ENCRYPT))
+    EVP_CIPHER_CTX* t_ctx = blr_cipher_init(&blr_cipher_contexts.ecb,
+                                            ciphers[BLR_AES_ECB](key_len),
+                                            key,
+                                            key_len,
+                                            NULL,   /* NULL iv */
+                                            BINLOG_FLAG_ENCRYPT);
+
+    if (!t_ctx)
     {
         MXS_ERROR("Error in EVP_CipherInit_ex CBC for last block (ECB)");
-        mxs_evp_cipher_ctx_free(t_ctx);
         return 0;
     }
 
-    /* Set no padding */
-    EVP_CIPHER_CTX_set_padding(t_ctx, 0);
-
     /* Do the enc/dec of the IV (the one from previous stage) */
     if (!EVP_CipherUpdate(t_ctx,
                           mask,
@@ -4187,7 +5360,6 @@ static int blr_aes_create_tail_for_cbc(uint8_t* output,
                           sizeof(mask)))
     {
         MXS_ERROR("Error in EVP_CipherUpdate ECB");
-        mxs_evp_cipher_ctx_free(t_ctx);
         return 0;
     }
 
@@ -4202,8 +5374,6 @@ static int blr_aes_create_tail_for_cbc(uint8_t* output,
         output[i] = input[i] ^ mask[i];
     }
 
-    mxs_evp_cipher_ctx_free(t_ctx);
-
     return 1;
 }
 
@@ -4302,6 +5472,10 @@ static void blr_report_checksum(REP_HEADER hdr,
 /**
  * Save MariaDB GTID found in complete transaction
  *
+ * Transactions are added to the GTID index. The GTID maps database
+ * only gets the binlog file entries (pos 4) and the first transaction
+ * of each binlog file, as it is used for listing the binlog files.
+ *
  * @param    inst The router instance
  * @return   true on success, false otherwise
  */
@@ -4346,6 +5520,39 @@ bool blr_save_mariadb_gtid(ROUTER_INSTANCE* inst)
            &inst->pending_transaction.gtid_elms,
            sizeof(MARIADB_GTID_ELEMS));
 
+    if (gtid_info.start > 4 && inst->gtid_index)
+    {
+        bool first_in_file = false;
+        gtid_info.gtid_elms = gtid_elms;
+
+        /* The binlog file is in the directory of the master, with tree storage */
+        if (!blr_gtid_index_add(inst->gtid_index,
+                                &gtid_info,
+                                inst->mariadb10_gtid_domain,
+                                inst->orig_masterid,
+                                &first_in_file))
+        {
+            MXS_ERROR("Service %s: failed to add GTID %s for %s:%lu,%lu "
+                      "into the GTID index",
+                      inst->service->name,
+                      gtid_info.gtid,
+                      gtid_info.binlog_name,
+                      gtid_info.start,
+                      gtid_info.end);
+            return false;
+        }
+
+        if (!first_in_file)
+        {
+            MXS_DEBUG("Saved MariaDB GTID '%s', %s:%lu,%lu into the GTID index",
+                      gtid_info.gtid,
+                      inst->binlog_name,
+                      gtid_info.start,
+                      gtid_info.end);
+            return true;
+        }
+    }
+
     /* Prepare INSERT SQL */
     snprintf(sql_stmt,
              GTID_SQL_BUFFER_SIZE,
@@ -4479,7 +5686,7 @@ static int gtid_select_cb(void* data,
 }
 
 /**
- * Get MariaDB GTID from repo
+ * Get MariaDB GTID from the GTID index
  *
  * @param    slave   The current slave instance
  * @param    gtid    The GTID to look for
@@ -4490,33 +5697,7 @@ bool blr_fetch_mariadb_gtid(ROUTER_SLAVE* slave,
                             const char*   gtid,
                             MARIADB_GTID_INFO* result)
 {
-    char* errmsg = NULL;
-    char select_query[GTID_SQL_BUFFER_SIZE];
     MARIADB_GTID_ELEMS gtid_elms = {};
-    /* The fields in the WHERE clause belong to
-     * primary key but binlog_file cannot be part of
-     * WHERE because GTID is made of X-Y-Z, three elements.
-     *
-     * The query has ORDER BY id DESC LIMIT 1 in order
-     * to get the right GTID, even in case of database
-     * with old content.
-     */
-    static const char select_tpl[] = "SELECT "
-                                     "(rep_domain ||"
-                                     " '-' || server_id ||"
-                                     " '-' || sequence) AS gtid, "
-                                     "binlog_file, "
-                                     "start_pos, "
-                                     "end_pos, "
-                                     "rep_domain, "
-                                     "server_id, "
-                                     "sequence "
-                                     "FROM gtid_maps "
-                                     "WHERE (rep_domain = %" PRIu32 " AND "
-                                                                    "server_id = %" PRIu32 " AND "
-                                                                                           "sequence = %"
-        PRIu64 ") "
-               "ORDER BY id DESC LIMIT 1;";
     mxb_assert(gtid != NULL);
 
     /* Parse GTID value into its components */
@@ -4525,38 +5706,23 @@ bool blr_fetch_mariadb_gtid(ROUTER_SLAVE* slave,
         return false;
     }
 
-    snprintf(select_query,
-             GTID_SQL_BUFFER_SIZE,
-             select_tpl,
-             gtid_elms.domain_id,
-             gtid_elms.server_id,
-             gtid_elms.seq_no);
-
-    /* Find the GTID */
-    if (sqlite3_exec(slave->gtid_maps,
-                     select_query,
-                     gtid_select_cb,
-                     result,
-                     &errmsg) != SQLITE_OK)
+    /**
+     * If the GTID is found in several binlog files,
+     * for instance after a master switch, the most
+     * recent one is used.
+     */
+    if (!slave->router->gtid_index
+        || !blr_gtid_index_find(slave->router->gtid_index, &gtid_elms, result))
     {
-        MXS_ERROR("Failed to select GTID %s from GTID maps DB: %s, select [%s]",
-                  gtid,
-                  errmsg,
-                  select_query);
-        sqlite3_free(errmsg);
         return false;
     }
-    else
-    {
-        if (result->gtid[0])
-        {
-            MXS_INFO("Binlog file to read from is %" PRIu32 "/%" PRIu32 "/%s",
-                     result->gtid_elms.domain_id,
-                     result->gtid_elms.server_id,
-                     result->binlog_name);
-        }
-    }
-    return result->gtid[0] ? true : false;
+
+    MXS_INFO("Binlog file to read from is %" PRIu32 "/%" PRIu32 "/%s",
+             result->gtid_elms.domain_id,
+             result->gtid_elms.server_id,
+             result->binlog_name);
+
+    return true;
 }
 
 /**
@@ -4593,10 +5759,16 @@ uint32_t blr_slave_get_file_size(const char* filename)
 {
     struct stat statb;
 
+    uint64_t size;
+
     if (stat(filename, &statb) == 0)
     {
         return statb.st_size;
     }
+    else if (errno == ENOENT && blr_compressed_file_size(filename, &size))
+    {
+        return size;
+    }
     else
     {
         MXS_ERROR("Failed to get %s file size: %d %s",
@@ -4652,51 +5824,28 @@ bool blr_parse_gtid(const char* gtid, MARIADB_GTID_ELEMS* info)
 }
 
 /**
- * Get MariaDB GTID from repo
+ * Get the last MariaDB GTID from the GTID index
  *
  * @param    router  The current router instance
  * @param    result  The (allocated) ouput data to fill
- * @return   False on sqlite errors
- *           True even if the gtid_maps is empty
+ * @return   False if the GTID index is not available
+ *           True even if the GTID index is empty
  *           The caller must check result->gtid value
  */
 
 bool blr_load_last_mariadb_gtid(ROUTER_INSTANCE* router,
                                 MARIADB_GTID_INFO* result)
 {
-    char* errmsg = NULL;
-    MARIADB_GTID_ELEMS gtid_elms = {};
-    static const char last_gtid[] = "SELECT "
-                                    "(rep_domain ||"
-                                    " '-' || server_id ||"
-                                    " '-' || sequence) AS gtid, "
-                                    "binlog_file, "
-                                    "start_pos, "
-                                    "end_pos, "
-                                    "rep_domain, "
-                                    "server_id, "
-                                    "sequence "
-                                    "FROM gtid_maps "
-                                    "WHERE id = "
-                                    "(SELECT MAX(id) "
-                                    "FROM gtid_maps "
-                                    "WHERE start_pos > 4);";
-
-    /* Find the last GTID */
-    if (sqlite3_exec(router->gtid_maps,
-                     last_gtid,
-                     gtid_select_cb,
-                     result,
-                     &errmsg) != SQLITE_OK)
+    if (!router->gtid_index)
     {
-        MXS_ERROR("Failed to select last GTID"
-                  " from GTID maps DB: %s, select [%s]",
-                  errmsg,
-                  last_gtid);
-        sqlite3_free(errmsg);
+        MXS_ERROR("%s: Failed to select last GTID, the GTID index is not available.",
+                  router->service->name);
         return false;
     }
 
+    /* An empty index leaves result->gtid unset */
+    blr_gtid_index_last(router->gtid_index, result);
+
     return true;
 }
 
@@ -4875,7 +6024,10 @@ bool blr_binlog_file_exists(ROUTER_INSTANCE* router,
            info_file->binlog_name);
 
     // Check file
-    if (access(path, F_OK) == -1 && errno == ENOENT)
+    uint64_t size;
+
+    if (access(path, F_OK) == -1 && errno == ENOENT
+        && !blr_compressed_file_size(path, &size))
     {
         // No file found
         MXS_WARNING("%s: %s, missing binlog file '%s'",
@@ -0,0 +1,984 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file blr_gtid_index.cc - The index of MariaDB GTIDs in the binlog files
+ *
+ * The start and end positions of every transaction are appended to an index
+ * file of the binlog file the transaction was written to. The index files are
+ * stored in the GTID_INDEX_DIR subdirectory of the binlog directory and are
+ * numbered in the order they have been created.
+ *
+ * Only a sparse summary of the records is kept in memory: for each index file
+ * and each replication domain and server, the smallest and largest sequence
+ * number and every GTID_INDEX_SAMPLE_RATE:th record. A GTID is looked up by
+ * searching the summary and then reading the records between two samples
+ * from the index file. The files are read without holding the lock.
+ *
+ * With tree storage, an index file is identified by the domain and server
+ * directory the binlog file is in, which is not necessarily the domain and
+ * server of the GTIDs in it.
+ *
+ * The GTID maps database is only used for the list of binlog files, so that
+ * a row for the beginning of each binlog file is enough. If the index does not
+ * exist, the transactions found in the database are copied into it.
+ */
+
+#include "blr.hh"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <maxscale/log.h>
+#include <maxscale/utils.h>
+
+namespace
+{
+
+const char     GTID_INDEX_DIR[] = "gtid_index";
+const char     GTID_INDEX_SUFFIX[] = ".gtidx";
+const char     GTID_INDEX_MAGIC[8] = {'M', 'X', 'S', 'G', 'T', 'I', 'D', 'X'};
+const uint32_t GTID_INDEX_VERSION = 1;
+
+/** Every this many records of a domain and server are kept in memory */
+const uint64_t GTID_INDEX_SAMPLE_RATE = 64;
+
+/** The number of records read at a time */
+const size_t GTID_INDEX_READ_RECORDS = 1024;
+
+/**
+ * An index file begins with a header identifying the binlog file,
+ * which is followed by the records.
+ */
+struct IndexHeader
+{
+    char     magic[8];          /*< GTID_INDEX_MAGIC */
+    uint32_t version;           /*< GTID_INDEX_VERSION */
+    uint32_t domain_id;         /*< Directory of the binlog file, tree storage */
+    uint32_t server_id;         /*< Directory of the binlog file, tree storage */
+    uint32_t reserved;
+    char     binlog_name[BINLOG_FNAMELEN + 1];
+};
+
+struct IndexRecord
+{
+    uint32_t domain_id;         /*< The replication domain */
+    uint32_t server_id;         /*< The server id */
+    uint64_t seq_no;            /*< The sequence number */
+    uint64_t start;             /*< The position of the GTID event */
+    uint64_t end;               /*< The position after the COMMIT event */
+};
+
+static_assert(sizeof(IndexHeader) == 280, "IndexHeader must not contain padding.");
+static_assert(sizeof(IndexRecord) == 32, "IndexRecord must not contain padding.");
+
+struct Sample
+{
+    uint64_t seq_no;            /*< The sequence number of the record */
+    uint64_t record;            /*< The number of the record in the file */
+};
+
+/**
+ * The summary of the records of one domain and server in one index file.
+ */
+struct Stream
+{
+    uint64_t            min_seq;
+    uint64_t            max_seq;
+    uint64_t            n_records;
+    uint64_t            last_record;    /*< The number of the last record */
+    bool                ordered;        /*< Whether the sequence numbers increase */
+    std::vector<Sample> samples;        /*< Every GTID_INDEX_SAMPLE_RATE:th record */
+};
+
+struct IndexFile
+{
+    uint64_t                   number;      /*< The order of creation */
+    std::string                path;
+    IndexHeader                header;
+    int                        fd;
+    uint64_t                   n_records;
+    std::map<uint64_t, Stream> streams;     /*< Keyed by domain and server */
+};
+
+/** An index file is shared with the lookups reading it, so that it can be purged meanwhile */
+typedef std::shared_ptr<IndexFile> SIndexFile;
+
+/**
+ * The records of an index file that may contain a GTID
+ */
+struct IndexRange
+{
+    SIndexFile file;
+    uint64_t   from;    /*< The first record */
+    uint64_t   to;      /*< The record following the last one */
+};
+
+inline uint64_t stream_key(uint32_t domain_id, uint32_t server_id)
+{
+    return (static_cast<uint64_t>(domain_id) << 32) | server_id;
+}
+
+inline off_t record_offset(uint64_t record)
+{
+    return sizeof(IndexHeader) + record * sizeof(IndexRecord);
+}
+}
+
+/**
+ * The GTID index of a router instance. The functions are thread safe.
+ */
+struct blr_gtid_index
+{
+    pthread_mutex_t         lock;
+    std::string             dir;    /*< The directory of the index files */
+    bool                    tree;   /*< Whether the binlog files are stored in a tree */
+    std::vector<SIndexFile> files;  /*< The index files, in the order of creation */
+    IndexFile*              last;   /*< The file with the last record, if any */
+    IndexRecord             last_record;
+};
+
+static void gtid_index_summarize(IndexFile* file, const IndexRecord& record)
+{
+    uint64_t number = file->n_records;
+    Stream& stream = file->streams[stream_key(record.domain_id, record.server_id)];
+
+    if (stream.n_records == 0)
+    {
+        stream.min_seq = record.seq_no;
+        stream.max_seq = record.seq_no;
+        stream.ordered = true;
+    }
+    else
+    {
+        if (record.seq_no <= stream.max_seq)
+        {
+            // The samples cannot be used for searching the records.
+            stream.ordered = false;
+        }
+
+        stream.min_seq = std::min(stream.min_seq, record.seq_no);
+        stream.max_seq = std::max(stream.max_seq, record.seq_no);
+    }
+
+    if (stream.n_records % GTID_INDEX_SAMPLE_RATE == 0)
+    {
+        stream.samples.push_back({record.seq_no, number});
+    }
+
+    stream.last_record = number;
+    stream.n_records++;
+    file->n_records++;
+}
+
+static void gtid_index_free_file(IndexFile* file)
+{
+    if (file->fd != -1)
+    {
+        close(file->fd);
+    }
+
+    delete file;
+}
+
+/**
+ * Load an index file and create its summary
+ *
+ * @param path      The path of the index file
+ * @param number    The number of the index file
+ * @return          The index file, or NULL on error
+ */
+static IndexFile* gtid_index_load_file(const std::string& path, uint64_t number)
+{
+    IndexFile* file = new IndexFile;
+    file->number = number;
+    file->path = path;
+    file->n_records = 0;
+
+    if ((file->fd = open(path.c_str(), O_RDWR)) == -1)
+    {
+        MXS_ERROR("Failed to open GTID index file '%s': %d, %s",
+                  path.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+        gtid_index_free_file(file);
+        return NULL;
+    }
+
+    if (pread(file->fd, &file->header, sizeof(IndexHeader), 0) != sizeof(IndexHeader)
+        || memcmp(file->header.magic, GTID_INDEX_MAGIC, sizeof(GTID_INDEX_MAGIC)) != 0
+        || file->header.version != GTID_INDEX_VERSION)
+    {
+        MXS_ERROR("'%s' is not a GTID index file.", path.c_str());
+        gtid_index_free_file(file);
+        return NULL;
+    }
+
+    file->header.binlog_name[BINLOG_FNAMELEN] = '\0';
+
+    std::vector<IndexRecord> records(GTID_INDEX_READ_RECORDS);
+    ssize_t n;
+
+    while ((n = pread(file->fd,
+                      records.data(),
+                      records.size() * sizeof(IndexRecord),
+                      record_offset(file->n_records))) > 0)
+    {
+        size_t n_records = n / sizeof(IndexRecord);
+
+        for (size_t i = 0; i < n_records; i++)
+        {
+            gtid_index_summarize(file, records[i]);
+        }
+
+        if (n_records * sizeof(IndexRecord) != static_cast<size_t>(n))
+        {
+            break;
+        }
+    }
+
+    if (n == -1)
+    {
+        MXS_ERROR("Failed to read GTID index file '%s': %d, %s",
+                  path.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+        gtid_index_free_file(file);
+        return NULL;
+    }
+
+    /* Remove a partially written record */
+    if (ftruncate(file->fd, record_offset(file->n_records)) == -1)
+    {
+        MXS_ERROR("Failed to truncate GTID index file '%s': %d, %s",
+                  path.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+        gtid_index_free_file(file);
+        return NULL;
+    }
+
+    return file;
+}
+
+/**
+ * Create the index file of a binlog file
+ *
+ * @param index         The GTID index
+ * @param binlog_name   The binlog file
+ * @param domain_id     The domain directory of the binlog file
+ * @param server_id     The server directory of the binlog file
+ * @return              The index file, or NULL on error
+ */
+static IndexFile* gtid_index_create_file(BLR_GTID_INDEX* index,
+                                         const char* binlog_name,
+                                         uint32_t domain_id,
+                                         uint32_t server_id)
+{
+    char path[PATH_MAX + 1];
+    uint64_t number = index->files.empty() ? 1 : index->files.back()->number + 1;
+
+    snprintf(path,
+             sizeof(path),
+             "%s/%012" PRIu64 "%s",
+             index->dir.c_str(),
+             number,
+             GTID_INDEX_SUFFIX);
+
+    IndexFile* file = new IndexFile;
+    file->number = number;
+    file->path = path;
+    file->n_records = 0;
+
+    memset(&file->header, 0, sizeof(IndexHeader));
+    memcpy(file->header.magic, GTID_INDEX_MAGIC, sizeof(GTID_INDEX_MAGIC));
+    file->header.version = GTID_INDEX_VERSION;
+    file->header.domain_id = domain_id;
+    file->header.server_id = server_id;
+    strncpy(file->header.binlog_name, binlog_name, BINLOG_FNAMELEN);
+
+    if ((file->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0660)) == -1
+        || pwrite(file->fd, &file->header, sizeof(IndexHeader), 0) != sizeof(IndexHeader))
+    {
+        MXS_ERROR("Failed to create GTID index file '%s': %d, %s",
+                  path,
+                  errno,
+                  mxs_strerror(errno));
+        gtid_index_free_file(file);
+        return NULL;
+    }
+
+    index->files.push_back(SIndexFile(file, gtid_index_free_file));
+
+    return file;
+}
+
+static bool gtid_index_is_file_of(const BLR_GTID_INDEX* index,
+                                  const IndexFile* file,
+                                  const char* binlog_name,
+                                  uint32_t domain_id,
+                                  uint32_t server_id)
+{
+    return strcmp(file->header.binlog_name, binlog_name) == 0
+           && (!index->tree
+               || (file->header.domain_id == domain_id && file->header.server_id == server_id));
+}
+
+/**
+ * Append a record to the index, creating the index file of the binlog file if
+ * the record is not for the binlog file of the previous record.
+ *
+ * Must be called with the lock held.
+ */
+static bool gtid_index_append(BLR_GTID_INDEX* index,
+                              const char* binlog_name,
+                              uint32_t domain_id,
+                              uint32_t server_id,
+                              const IndexRecord& record,
+                              bool* first_in_file)
+{
+    IndexFile* file = index->files.empty() ? NULL : index->files.back().get();
+
+    if (!file || !gtid_index_is_file_of(index, file, binlog_name, domain_id, server_id))
+    {
+        file = gtid_index_create_file(index, binlog_name, domain_id, server_id);
+    }
+
+    if (!file)
+    {
+        return false;
+    }
+
+    if (pwrite(file->fd,
+               &record,
+               sizeof(IndexRecord),
+               record_offset(file->n_records)) != sizeof(IndexRecord))
+    {
+        MXS_ERROR("Failed to write to GTID index file '%s': %d, %s",
+                  file->path.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+        return false;
+    }
+
+    *first_in_file = file->n_records == 0;
+
+    gtid_index_summarize(file, record);
+    index->last = file;
+    index->last_record = record;
+
+    return true;
+}
+
+/**
+ * Find the records of an index file that may contain a GTID
+ *
+ * Must be called with the lock held.
+ */
+static bool gtid_index_find_range(const SIndexFile& file,
+                                  const MARIADB_GTID_ELEMS* gtid,
+                                  IndexRange* range)
+{
+    auto it = file->streams.find(stream_key(gtid->domain_id, gtid->server_id));
+
+    if (it == file->streams.end()
+        || gtid->seq_no < it->second.min_seq
+        || gtid->seq_no > it->second.max_seq)
+    {
+        return false;
+    }
+
+    const Stream& stream = it->second;
+
+    range->file = file;
+    range->from = 0;
+    range->to = file->n_records;
+
+    if (stream.ordered)
+    {
+        /* The record is between the last sample not after it and the next sample */
+        auto sample = std::upper_bound(stream.samples.begin(),
+                                       stream.samples.end(),
+                                       gtid->seq_no,
+                                       [](uint64_t seq_no, const Sample& s) {
+                                           return seq_no < s.seq_no;
+                                       });
+
+        mxb_assert(sample != stream.samples.begin());
+        range->from = (sample - 1)->record;
+        range->to = (sample == stream.samples.end()) ? stream.last_record + 1 : sample->record;
+    }
+
+    return true;
+}
+
+/**
+ * Find the last record of a GTID in a range of an index file
+ *
+ * The records of the range have been written, so the lock is not needed.
+ */
+static bool gtid_index_read_range(const IndexRange& range,
+                                  const MARIADB_GTID_ELEMS* gtid,
+                                  IndexRecord* result)
+{
+    std::vector<IndexRecord> records(GTID_INDEX_READ_RECORDS);
+    uint64_t from = range.from;
+    bool found = false;
+
+    while (from < range.to)
+    {
+        size_t n_records = std::min(range.to - from, static_cast<uint64_t>(records.size()));
+        ssize_t n = pread(range.file->fd,
+                          records.data(),
+                          n_records * sizeof(IndexRecord),
+                          record_offset(from));
+
+        if (n != static_cast<ssize_t>(n_records * sizeof(IndexRecord)))
+        {
+            MXS_ERROR("Failed to read GTID index file '%s': %d, %s",
+                      range.file->path.c_str(),
+                      errno,
+                      mxs_strerror(errno));
+            return false;
+        }
+
+        for (size_t i = 0; i < n_records; i++)
+        {
+            const IndexRecord& record = records[i];
+
+            if (record.seq_no == gtid->seq_no
+                && record.domain_id == gtid->domain_id
+                && record.server_id == gtid->server_id)
+            {
+                *result = record;
+                found = true;
+            }
+        }
+
+        from += n_records;
+    }
+
+    return found;
+}
+
+/**
+ * Fill the GTID information of a record
+ *
+ * With tree storage, the domain and server are the directory of the binlog file,
+ * as the callers use them for finding the file, not the ones of the GTID.
+ */
+static void gtid_index_fill_info(const BLR_GTID_INDEX* index,
+                                 const IndexFile* file,
+                                 const IndexRecord& record,
+                                 MARIADB_GTID_INFO* info)
+{
+    snprintf(info->gtid,
+             sizeof(info->gtid),
+             "%" PRIu32 "-%" PRIu32 "-%" PRIu64 "",
+             record.domain_id,
+             record.server_id,
+             record.seq_no);
+    strcpy(info->binlog_name, file->header.binlog_name);
+    info->start = record.start;
+    info->end = record.end;
+    info->gtid_elms.domain_id = index->tree ? file->header.domain_id : record.domain_id;
+    info->gtid_elms.server_id = index->tree ? file->header.server_id : record.server_id;
+    info->gtid_elms.seq_no = record.seq_no;
+}
+
+static void gtid_index_free(BLR_GTID_INDEX* index)
+{
+    pthread_mutex_destroy(&index->lock);
+    delete index;
+}
+
+static BLR_GTID_INDEX* gtid_index_alloc(const std::string& dir, bool tree)
+{
+    BLR_GTID_INDEX* index = new BLR_GTID_INDEX;
+    pthread_mutex_init(&index->lock, NULL);
+    index->dir = dir;
+    index->tree = tree;
+    index->last = NULL;
+    memset(&index->last_record, 0, sizeof(IndexRecord));
+
+    return index;
+}
+
+/**
+ * Load the index files of a directory
+ *
+ * @param index     The GTID index
+ * @return          True on success
+ */
+static bool gtid_index_load(BLR_GTID_INDEX* index)
+{
+    DIR* dirp;
+    struct dirent* dp;
+    std::vector<uint64_t> numbers;
+
+    if ((dirp = opendir(index->dir.c_str())) == NULL)
+    {
+        MXS_ERROR("Unable to read the GTID index directory '%s': %d, %s",
+                  index->dir.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+        return false;
+    }
+
+    while ((dp = readdir(dirp)) != NULL)
+    {
+        const char* suffix = strstr(dp->d_name, GTID_INDEX_SUFFIX);
+
+        if (suffix && strcmp(suffix, GTID_INDEX_SUFFIX) == 0)
+        {
+            numbers.push_back(strtoull(dp->d_name, NULL, 10));
+        }
+    }
+
+    closedir(dirp);
+
+    std::sort(numbers.begin(), numbers.end());
+
+    for (uint64_t number : numbers)
+    {
+        char path[PATH_MAX + 1];
+        snprintf(path,
+                 sizeof(path),
+                 "%s/%012" PRIu64 "%s",
+                 index->dir.c_str(),
+                 number,
+                 GTID_INDEX_SUFFIX);
+
+        IndexFile* file = gtid_index_load_file(path, number);
+
+        if (!file)
+        {
+            return false;
+        }
+
+        index->files.push_back(SIndexFile(file, gtid_index_free_file));
+
+        if (file->n_records > 0)
+        {
+            index->last = file;
+        }
+    }
+
+    if (index->last
+        && pread(index->last->fd,
+                 &index->last_record,
+                 sizeof(IndexRecord),
+                 record_offset(index->last->n_records - 1)) != sizeof(IndexRecord))
+    {
+        MXS_ERROR("Failed to read GTID index file '%s': %d, %s",
+                  index->last->path.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Remove the index files in a directory and the directory itself
+ */
+static void gtid_index_remove_dir(const std::string& dir)
+{
+    DIR* dirp;
+    struct dirent* dp;
+
+    if ((dirp = opendir(dir.c_str())) != NULL)
+    {
+        while ((dp = readdir(dirp)) != NULL)
+        {
+            if (dp->d_name[0] != '.')
+            {
+                unlink((dir + "/" + dp->d_name).c_str());
+            }
+        }
+
+        closedir(dirp);
+    }
+
+    rmdir(dir.c_str());
+}
+
+/**
+ * The state of a migration from the GTID maps database
+ */
+struct Migration
+{
+    BLR_GTID_INDEX* index;
+    /** The domain and server directories of the binlog files, by name */
+    std::map<std::string, std::pair<uint32_t, uint32_t>> dirs;
+};
+
+/**
+ * Migration callback: append a transaction found in the GTID maps database
+ *
+ * The values are rep_domain, server_id, sequence, binlog_file, start_pos and end_pos.
+ */
+static int gtid_index_migrate_cb(void* data, int cols, char** values, char** names)
+{
+    Migration* migration = static_cast<Migration*>(data);
+
+    mxb_assert(cols == 6);
+
+    if (values[0] && values[1] && values[2] && values[3] && values[4] && values[5])
+    {
+        IndexRecord record;
+        bool first_in_file;
+
+        record.domain_id = strtoul(values[0], NULL, 10);
+        record.server_id = strtoul(values[1], NULL, 10);
+        record.seq_no = strtoull(values[2], NULL, 10);
+        record.start = strtoull(values[4], NULL, 10);
+        record.end = strtoull(values[5], NULL, 10);
+
+        if (record.start <= 4)
+        {
+            /**
+             * The row added when the binlog file was created is not a transaction,
+             * but it has the domain and server directory of the file.
+             */
+            migration->dirs[values[3]] = std::make_pair(record.domain_id, record.server_id);
+        }
+        else
+        {
+            auto it = migration->dirs.find(values[3]);
+            uint32_t domain_id = record.domain_id;
+            uint32_t server_id = record.server_id;
+
+            /* Without the row of the binlog file, the directory is the one of the GTID */
+            if (it != migration->dirs.end())
+            {
+                domain_id = it->second.first;
+                server_id = it->second.second;
+            }
+
+            if (!gtid_index_append(migration->index,
+                                   values[3],
+                                   domain_id,
+                                   server_id,
+                                   record,
+                                   &first_in_file))
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * Copy the transactions of the GTID maps database into a new GTID index
+ *
+ * The index is created in a temporary directory that is renamed once all
+ * transactions have been copied, so that an interrupted migration is
+ * started again the next time.
+ *
+ * @param router    The router instance
+ * @param dir       The directory of the GTID index
+ * @return          True on success
+ */
+static bool gtid_index_migrate(ROUTER_INSTANCE* router, const std::string& dir)
+{
+    static const char select_query[] = "SELECT rep_domain, "
+                                       "server_id, "
+                                       "sequence, "
+                                       "binlog_file, "
+                                       "start_pos, "
+                                       "end_pos "
+                                       "FROM gtid_maps "
+                                       "ORDER BY id ASC;";
+    std::string tmp_dir = dir + ".tmp";
+    bool rval = false;
+
+    gtid_index_remove_dir(tmp_dir);
+
+    if (mkdir(tmp_dir.c_str(), 0700) == -1)
+    {
+        MXS_ERROR("%s: Failed to create GTID index directory '%s': %d, %s",
+                  router->service->name,
+                  tmp_dir.c_str(),
+                  errno,
+                  mxs_strerror(errno));
+        return false;
+    }
+
+    BLR_GTID_INDEX* index = gtid_index_alloc(tmp_dir,
+                                             router->storage_type == BLR_BINLOG_STORAGE_TREE);
+    Migration migration;
+    char* errmsg = NULL;
+
+    migration.index = index;
+
+    if (sqlite3_exec(router->gtid_maps,
+                     select_query,
+                     gtid_index_migrate_cb,
+                     &migration,
+                     &errmsg) != SQLITE_OK)
+    {
+        MXS_ERROR("%s: Failed to copy the GTIDs of the GTID maps DB "
+                  "into the GTID index: %s",
+                  router->service->name,
+                  errmsg ? errmsg : "database is not available");
+        sqlite3_free(errmsg);
+    }
+    else
+    {
+        uint64_t n_records = 0;
+
+        for (const SIndexFile& file : index->files)
+        {
+            n_records += file->n_records;
+            fsync(file->fd);
+        }
+
+        if (rename(tmp_dir.c_str(), dir.c_str()) == -1)
+        {
+            MXS_ERROR("%s: Failed to rename GTID index directory '%s' to '%s': %d, %s",
+                      router->service->name,
+                      tmp_dir.c_str(),
+                      dir.c_str(),
+                      errno,
+                      mxs_strerror(errno));
+        }
+        else
+        {
+            MXS_NOTICE("%s: Copied %lu GTIDs of %lu binlog files from the GTID maps DB "
+                       "into the GTID index.",
+                       router->service->name,
+                       n_records,
+                       index->files.size());
+            rval = true;
+        }
+    }
+
+    gtid_index_free(index);
+
+    if (!rval)
+    {
+        gtid_index_remove_dir(tmp_dir);
+    }
+
+    return rval;
+}
+
+/**
+ * Open the GTID index of a router instance, creating it from the
+ * transactions in the GTID maps database if it does not exist.
+ *
+ * @param router    The router instance, with the GTID maps database open
+ * @return          The GTID index, or NULL on error
+ */
+BLR_GTID_INDEX* blr_gtid_index_open(ROUTER_INSTANCE* router)
+{
+    std::string dir = std::string(router->binlogdir) + "/" + GTID_INDEX_DIR;
+
+    if (access(dir.c_str(), F_OK) == -1 && !gtid_index_migrate(router, dir))
+    {
+        return NULL;
+    }
+
+    BLR_GTID_INDEX* index = gtid_index_alloc(dir,
+                                             router->storage_type == BLR_BINLOG_STORAGE_TREE);
+
+    if (!gtid_index_load(index))
+    {
+        gtid_index_free(index);
+        index = NULL;
+    }
+
+    return index;
+}
+
+/**
+ * Close the GTID index
+ *
+ * @param index     The GTID index, may be NULL
+ */
+void blr_gtid_index_close(BLR_GTID_INDEX* index)
+{
+    if (index)
+    {
+        gtid_index_free(index);
+    }
+}
+
+/**
+ * Add a transaction to the GTID index
+ *
+ * @param index          The GTID index
+ * @param info           The GTID, the binlog file and the positions of the transaction
+ * @param domain_id      The domain directory of the binlog file
+ * @param server_id      The server directory of the binlog file
+ * @param first_in_file  Set to true if this is the first transaction
+ *                       added for the binlog file
+ * @return               True on success
+ */
+bool blr_gtid_index_add(BLR_GTID_INDEX* index,
+                        const MARIADB_GTID_INFO* info,
+                        uint32_t domain_id,
+                        uint32_t server_id,
+                        bool* first_in_file)
+{
+    IndexRecord record;
+    record.domain_id = info->gtid_elms.domain_id;
+    record.server_id = info->gtid_elms.server_id;
+    record.seq_no = info->gtid_elms.seq_no;
+    record.start = info->start;
+    record.end = info->end;
+
+    pthread_mutex_lock(&index->lock);
+    bool rval = gtid_index_append(index,
+                                  info->binlog_name,
+                                  domain_id,
+                                  server_id,
+                                  record,
+                                  first_in_file);
+    pthread_mutex_unlock(&index->lock);
+
+    return rval;
+}
+
+/**
+ * Find the binlog file and the positions of a transaction
+ *
+ * If the GTID is in several binlog files, the most recent one is returned.
+ * With tree storage, the domain and server of the result are the directory
+ * of the binlog file.
+ *
+ * @param index     The GTID index
+ * @param gtid      The GTID to look for
+ * @param result    The output data to fill
+ * @return          True if the GTID was found
+ */
+bool blr_gtid_index_find(BLR_GTID_INDEX* index,
+                         const MARIADB_GTID_ELEMS* gtid,
+                         MARIADB_GTID_INFO* result)
+{
+    std::vector<IndexRange> ranges;
+    bool found = false;
+
+    pthread_mutex_lock(&index->lock);
+
+    for (auto it = index->files.rbegin(); it != index->files.rend(); ++it)
+    {
+        IndexRange range;
+
+        if (gtid_index_find_range(*it, gtid, &range))
+        {
+            ranges.push_back(range);
+        }
+    }
+
+    pthread_mutex_unlock(&index->lock);
+
+    /* The files are read without the lock, so that adding a GTID is not held up */
+    for (auto it = ranges.begin(); !found && it != ranges.end(); ++it)
+    {
+        IndexRecord record;
+
+        if (gtid_index_read_range(*it, gtid, &record))
+        {
+            gtid_index_fill_info(index, it->file.get(), record, result);
+            found = true;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Get the last transaction added to the GTID index
+ *
+ * @param index     The GTID index
+ * @param result    The output data to fill
+ * @return          True if the index is not empty
+ */
+bool blr_gtid_index_last(BLR_GTID_INDEX* index,
+                         MARIADB_GTID_INFO* result)
+{
+    bool found = false;
+
+    pthread_mutex_lock(&index->lock);
+
+    if (index->last)
+    {
+        gtid_index_fill_info(index, index->last, index->last_record, result);
+        found = true;
+    }
+
+    pthread_mutex_unlock(&index->lock);
+
+    return found;
+}
+
+/**
+ * Remove the index files of a purged binlog file
+ *
+ * @param index         The GTID index
+ * @param binlog_name   The binlog file
+ * @param domain_id     The domain directory of the binlog file
+ * @param server_id     The server directory of the binlog file
+ */
+void blr_gtid_index_purge(BLR_GTID_INDEX* index,
+                          const char* binlog_name,
+                          uint32_t domain_id,
+                          uint32_t server_id)
+{
+    pthread_mutex_lock(&index->lock);
+
+    for (auto it = index->files.begin(); it != index->files.end();)
+    {
+        IndexFile* file = it->get();
+
+        if (file != index->last
+            && gtid_index_is_file_of(index, file, binlog_name, domain_id, server_id))
+        {
+            if (unlink(file->path.c_str()) == -1 && errno != ENOENT)
+            {
+                MXS_ERROR("Failed to remove GTID index file '%s': %d, %s",
+                          file->path.c_str(),
+                          errno,
+                          mxs_strerror(errno));
+            }
+
+            /* A lookup reading the file closes it */
+            it = index->files.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    pthread_mutex_unlock(&index->lock);
+}
@@ -49,6 +49,7 @@
 #include <maxscale/protocol/mysql.h>
 #include <maxscale/router.h>
 #include <maxscale/routingworker.h>
+#include <maxscale/routingworker.hh>
 #include <maxbase/worker.hh>
 #include <maxscale/server.h>
 #include <maxscale/service.h>
@@ -469,6 +470,9 @@ void blr_master_reconnect(ROUTER_INSTANCE* router)
  */
 void blr_master_close(ROUTER_INSTANCE* router)
 {
+    /* The master sends the events following the ones received so far */
+    blr_file_commit_deferred(router);
+
     dcb_close(router->master);
     router->master = NULL;
 
@@ -1084,6 +1088,14 @@ void blr_handle_binlog_record(ROUTER_INSTANCE* router, GWBUF* pkt)
         }
     }
 
+    /* Write the batched events and let the slaves read the complete transactions */
+    if (!blr_file_commit_deferred(router))
+    {
+        blr_master_close(router);
+        blr_start_master_in_main(router);
+        return;
+    }
+
     blr_file_flush(router);
 }
 
@@ -1682,30 +1694,27 @@ bool blr_send_packet(ROUTER_SLAVE* slave, uint8_t* buf, uint32_t len, bool first
 }
 
 /**
- * Send a single replication event to a slave
+ * Check that none of the events in a range has already been sent to a slave
  *
- * This sends the complete replication event to a slave. If the event size exceeds
- * the maximum size of a MySQL packet, it will be sent in multiple packets.
+ * The position of the last event sent to the slave is recorded, so that an
+ * event sent by both the master and the slave thread is detected.
  *
- * @param role  What is the role of the caller, slave or master.
- * @param binlog_name The name of the binlogfile.
- * @param binlog_pos The position in the binlogfile.
- * @param slave Slave where the event is sent to
- * @param hdr   Replication header
- * @param buf   Pointer to the replication event as it was read from the disk
- * @return True on success, false if memory allocation failed
+ * @param role          What is the role of the caller, slave or master.
+ * @param binlog_name   The name of the binlogfile.
+ * @param binlog_pos    The position of the first event in the binlogfile.
+ * @param end_pos       The position following the last event.
+ * @param slave         Slave where the events are to be sent
+ * @return True if the events can be sent, false if one of them has already been sent
  */
-bool blr_send_event(blr_thread_role_t role,
-                    const char* binlog_name,
-                    uint32_t binlog_pos,
-                    ROUTER_SLAVE* slave,
-                    REP_HEADER*   hdr,
-                    uint8_t* buf)
+bool blr_events_not_sent(blr_thread_role_t role,
+                         const char* binlog_name,
+                         uint32_t binlog_pos,
+                         uint32_t end_pos,
+                         ROUTER_SLAVE* slave)
 {
-    bool rval = true;
-
     if ((strcmp(slave->lsi_binlog_name, binlog_name) == 0)
-        && (slave->lsi_binlog_pos == binlog_pos))
+        && (slave->lsi_binlog_pos >= binlog_pos)
+        && (slave->lsi_binlog_pos < end_pos))
     {
         std::stringstream t1;
         std::stringstream t2;
@@ -1720,7 +1729,7 @@ bool blr_send_event(blr_thread_role_t role,
                   dcb_get_port(slave->dcb),
                   slave->serverid,
                   binlog_name,
-                  binlog_pos,
+                  slave->lsi_binlog_pos,
                   t1.str().c_str(),
                   ROLETOSTR(role),
                   t2.str().c_str(),
@@ -1731,6 +1740,37 @@ bool blr_send_event(blr_thread_role_t role,
         return false;
     }
 
+    return true;
+}
+
+/**
+ * Send a single replication event to a slave
+ *
+ * This sends the complete replication event to a slave. If the event size exceeds
+ * the maximum size of a MySQL packet, it will be sent in multiple packets.
+ *
+ * @param role  What is the role of the caller, slave or master.
+ * @param binlog_name The name of the binlogfile.
+ * @param binlog_pos The position in the binlogfile.
+ * @param slave Slave where the event is sent to
+ * @param hdr   Replication header
+ * @param buf   Pointer to the replication event as it was read from the disk
+ * @return True on success, false if memory allocation failed
+ */
+bool blr_send_event(blr_thread_role_t role,
+                    const char* binlog_name,
+                    uint32_t binlog_pos,
+                    ROUTER_SLAVE* slave,
+                    REP_HEADER*   hdr,
+                    uint8_t* buf)
+{
+    bool rval = true;
+
+    if (!blr_events_not_sent(role, binlog_name, binlog_pos, binlog_pos + 1, slave))
+    {
+        return false;
+    }
+
     /** Check if the event and the OK byte fit into a single packet  */
     if (hdr->event_size + 1 < MYSQL_PACKET_LENGTH_MAX)
     {
@@ -1936,19 +1976,20 @@ static int blr_get_master_semisync(GWBUF* buf)
 }
 
 /**
- * Notify all the registered slaves to read from binlog file
- * the new events just received
+ * Notify the waiting slaves of a worker to read the new events
  *
- * @param   router      The router instance
+ * This is called on the worker, which is the only one accessing its slaves.
+ *
+ * @param w     The worker
  */
-void blr_notify_all_slaves(ROUTER_INSTANCE* router)
+static void blr_notify_worker_slaves(BLR_WORKER* w)
 {
-    ROUTER_SLAVE* slave;
     int notified = 0;
 
-    pthread_mutex_lock(&router->lock);
-    slave = router->slaves;
-    while (slave)
+    /* Cleared first, so that events written from now on cause a new notification */
+    atomic_store_int(&w->notify_pending, 0);
+
+    for (ROUTER_SLAVE* slave = w->slaves; slave; slave = slave->worker_next)
     {
         /* Notify a slave that has CS_WAIT_DATA bit set */
         if (slave->state == BLRS_DUMPING
@@ -1956,10 +1997,7 @@ void blr_notify_all_slaves(ROUTER_INSTANCE* router)
         {
             notified++;
         }
-
-        slave = slave->next;
     }
-    pthread_mutex_unlock(&router->lock);
 
     if (notified > 0)
     {
@@ -1967,6 +2005,45 @@ void blr_notify_all_slaves(ROUTER_INSTANCE* router)
     }
 }
 
+/**
+ * Notify all the registered slaves to read from binlog file
+ * the new events just received
+ *
+ * The slaves are notified by the workers they are dumping on, so this only
+ * posts one notification to each worker with dumping slaves. A worker that
+ * has not yet handled the previous notification is not notified again.
+ *
+ * @param   router      The router instance
+ */
+void blr_notify_all_slaves(ROUTER_INSTANCE* router)
+{
+    BLR_WORKER* w = (BLR_WORKER*)atomic_load_ptr((void**)&router->workers);
+
+    for (; w; w = w->next)
+    {
+        if (atomic_load_int(&w->n_slaves) > 0
+            && atomic_exchange_int(&w->notify_pending, 1) == 0)
+        {
+            if (!w->worker->execute([w]() {
+                                        blr_notify_worker_slaves(w);
+                                    }, mxs::RoutingWorker::EXECUTE_QUEUED))
+            {
+                atomic_store_int(&w->notify_pending, 0);
+            }
+        }
+    }
+}
+
+/**
+ * Interface for testing the notification of the slaves of a worker
+ *
+ * @param w     The worker
+ */
+void blr_test_notify_worker_slaves(BLR_WORKER* w)
+{
+    blr_notify_worker_slaves(w);
+}
+
 /**
  * Slave Protocol registration to Master:
  *
@@ -2950,6 +3027,7 @@ bool blr_handle_fake_rotate(ROUTER_INSTANCE* router,
          *
          * The slave will automatically try to re-connect.
          */
+        blr_event_ring_reset(router);
         router->last_written = BINLOG_MAGIC_SIZE;
         router->current_pos = BINLOG_MAGIC_SIZE;
         router->binlog_position = BINLOG_MAGIC_SIZE;
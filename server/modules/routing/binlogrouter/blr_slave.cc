@@ -62,13 +62,14 @@ using std::vector;
  */
 typedef struct
 {
-    int         seq_no;     /* Output sequence in result set */
-    char*       last_file;  /* Last binlog file found in GTID repo */
-    const char* binlogdir;  /* Binlog files cache dir */
-    DCB*        client;     /* Connected client DCB */
-    bool        use_tree;   /* Binlog structure type */
-    size_t      n_files;    /* How many files */
-    uint64_t    rowid;      /* ROWID of router current file*/
+    int             seq_no;     /* Output sequence in result set */
+    char*           last_file;  /* Last binlog file found in GTID repo */
+    const char*     binlogdir;  /* Binlog files cache dir */
+    DCB*            client;     /* Connected client DCB */
+    bool            use_tree;   /* Binlog structure type */
+    size_t          n_files;    /* How many files */
+    uint64_t        rowid;      /* ROWID of router current file*/
+    BLR_GTID_INDEX* gtid_index; /* GTID index of the purged files */
 } BINARY_LOG_DATA_RESULT;
 
 /** Slave file read EOF handling */
@@ -331,6 +332,11 @@ extern void blr_close_master_in_main(void* data);
 static bool blr_check_connecting_slave(const ROUTER_INSTANCE* router,
                                        ROUTER_SLAVE* slave,
                                        enum blr_slave_check check);
+static bool blr_slave_send_bulk(ROUTER_INSTANCE* router,
+                                ROUTER_SLAVE* slave,
+                                BLFILE* file,
+                                int* burst,
+                                long* burst_size);
 static void blr_abort_change_master(ROUTER_INSTANCE* router,
                                     const MasterServerConfig& current_master,
                                     const char* error);
@@ -2220,6 +2226,22 @@ static int blr_slave_binlog_dump(ROUTER_INSTANCE* router, ROUTER_SLAVE* slave, G
         slave->lastEventReceived = MARIADB10_GTID_GTID_LIST_EVENT;
     }
 
+    /* The slave is notified of new events by its own worker */
+    if (!blr_slave_worker_add(router, slave))
+    {
+        char errmsg[BINLOG_ERROR_MSG_LEN + 1];
+        snprintf(errmsg,
+                 BINLOG_ERROR_MSG_LEN,
+                 "Cannot register the slave for binlog '%s'",
+                 slave->binlog_name);
+        errmsg[BINLOG_ERROR_MSG_LEN] = '\0';
+        blr_slave_abort_dump_request(slave, errmsg);
+        slave->state = BLRS_ERRORED;
+        dcb_close(slave->dcb);
+        gwbuf_free(fde);
+        return 1;
+    }
+
     /* Set dcb_callback for the events reading routine */
     dcb_add_callback(slave->dcb, DCB_REASON_DRAINED, blr_slave_callback, slave);
 
@@ -2289,6 +2311,219 @@ uint8_t* blr_build_header(GWBUF* pkt, REP_HEADER* hdr)
     return ptr;
 }
 
+/**
+ * Find the events at the start of a range of a binlog file that can be sent
+ * to a slave in bulk.
+ *
+ * The range ends at the first event that needs the per-event path of
+ * blr_slave_catchup(): a partial event, a rotate or start encryption event,
+ * an event that does not fit into one packet or one with an inconsistent
+ * header. Ignorable events and, unless requested, annotate rows events are
+ * included in the range but not counted, as they are not sent.
+ *
+ * @param router      The binlog router
+ * @param slave       The slave the events are sent to
+ * @param start       The range, read at the slave position
+ * @param len         The length of the range
+ * @param max_events  The maximum number of events to send
+ * @param n_events    The number of events to send
+ * @param out_len     The length of the packets of the events to send
+ * @param last_pos    The position of the last event to send
+ * @return            The length of the events, sent or skipped, in the range
+ */
+unsigned long blr_slave_bulk_events(const ROUTER_INSTANCE* router,
+                                    const ROUTER_SLAVE* slave,
+                                    const uint8_t* start,
+                                    unsigned long len,
+                                    int max_events,
+                                    int* n_events,
+                                    unsigned long* out_len,
+                                    unsigned long* last_pos)
+{
+    uint8_t max_event_type = router->mariadb10_compat ?
+        MAX_EVENT_TYPE_MARIADB10 : MAX_EVENT_TYPE;
+    unsigned long end = 0;
+
+    *n_events = 0;
+    *out_len = 0;
+    *last_pos = 0;
+
+    while (*n_events < max_events && end + BINLOG_EVENT_HDR_LEN <= len)
+    {
+        uint8_t* ptr = const_cast<uint8_t*>(start + end);
+        uint8_t event_type = ptr[4];
+        uint32_t event_size = extract_field(&ptr[9], 32);
+        uint32_t next_pos = extract_field(&ptr[13], 32);
+
+        if (event_size < BINLOG_EVENT_HDR_LEN
+            || end + event_size > len
+            || next_pos != slave->binlog_pos + end + event_size
+            || event_size + 1 >= MYSQL_PACKET_LENGTH_MAX
+            || event_type > max_event_type
+            || event_type == ROTATE_EVENT
+            || event_type == MARIADB10_START_ENCRYPTION_EVENT)
+        {
+            break;
+        }
+
+        if (event_type != IGNORABLE_EVENT
+            && (slave->annotate_rows || event_type != MARIADB_ANNOTATE_ROWS_EVENT))
+        {
+            *out_len += MYSQL_HEADER_LEN + 1 + event_size;
+            *last_pos = slave->binlog_pos + end;
+            (*n_events)++;
+        }
+
+        end += event_size;
+    }
+
+    return end;
+}
+
+/**
+ * Send the events following the slave position in bulk.
+ *
+ * A range of the binlog file is read with a single system call and the events
+ * in it are packed into one buffer that is written to the slave at once,
+ * instead of reading, allocating and writing each event separately.
+ *
+ * Only events that are sent as they are stored can be sent this way, see
+ * blr_slave_bulk_events(). The events of an encrypted binlog file are
+ * decrypted all at once. As in blr_send_event(), the events are not sent
+ * if the last event sent to the slave is among them.
+ *
+ * @param router      The binlog router
+ * @param slave       The slave that is behind
+ * @param file        The binlog file the slave is reading
+ * @param burst       The number of events that may be sent, decremented
+ * @param burst_size  The number of bytes that may be sent, decremented
+ * @return            False if the events could not be sent
+ */
+static bool blr_slave_send_bulk(ROUTER_INSTANCE* router,
+                                ROUTER_SLAVE* slave,
+                                BLFILE* file,
+                                int* burst,
+                                long* burst_size)
+{
+    bool rval = true;
+    GWBUF* data = blr_read_binlog_range(router,
+                                        file,
+                                        slave->binlog_pos,
+                                        *burst_size);
+
+    if (data)
+    {
+        uint8_t* start = GWBUF_DATA(data);
+        unsigned long len = GWBUF_LENGTH(data);
+
+        if (slave->encryption_ctx)
+        {
+            /* Only the complete events can be decrypted */
+            len = blr_decrypt_events(router,
+                                     start,
+                                     len,
+                                     slave->binlog_pos,
+                                     slave->encryption_ctx->nonce);
+        }
+        unsigned long last_pos;
+        unsigned long out_len;
+        int n_events;
+
+        /* Find the boundaries of the events that can be sent as they are */
+        unsigned long end = blr_slave_bulk_events(router,
+                                                  slave,
+                                                  start,
+                                                  len,
+                                                  *burst,
+                                                  &n_events,
+                                                  &out_len,
+                                                  &last_pos);
+        GWBUF* out = NULL;
+
+        if (n_events > 0
+            && !blr_events_not_sent(BLR_THREAD_ROLE_SLAVE,
+                                    slave->binlog_name,
+                                    slave->binlog_pos,
+                                    slave->binlog_pos + end,
+                                    slave))
+        {
+            end = 0;
+            rval = false;
+        }
+        else if (n_events > 0 && (out = gwbuf_alloc(out_len)) == NULL)
+        {
+            /* Leave the events to the per-event path */
+            end = 0;
+        }
+
+        if (out)
+        {
+            uint8_t* out_ptr = GWBUF_DATA(out);
+
+            /* Wrap each event in a packet, as blr_send_event() does */
+            for (unsigned long offset = 0; offset < end;)
+            {
+                uint8_t* ptr = start + offset;
+                uint8_t event_type = ptr[4];
+                uint32_t event_size = extract_field(&ptr[9], 32);
+
+                if (event_type != IGNORABLE_EVENT
+                    && (slave->annotate_rows || event_type != MARIADB_ANNOTATE_ROWS_EVENT))
+                {
+                    encode_value(out_ptr, event_size + 1, 24);
+                    out_ptr += 3;
+                    *out_ptr++ = slave->seqno++;
+                    *out_ptr++ = 0;     // OK byte
+                    memcpy(out_ptr, ptr, event_size);
+                    out_ptr += event_size;
+                }
+
+                offset += event_size;
+            }
+
+            slave->stats.n_bytes += out_len;
+            slave->stats.n_events += n_events;
+
+            if (MXS_SESSION_ROUTE_REPLY(slave->dcb->session, out))
+            {
+                strcpy(slave->lsi_binlog_name, slave->binlog_name);
+                slave->lsi_binlog_pos = last_pos;
+                slave->lsi_sender_role = BLR_THREAD_ROLE_SLAVE;
+                slave->lsi_sender_tid = std::this_thread::get_id();
+
+                *burst -= n_events;
+                *burst_size -= out_len;
+            }
+            else
+            {
+                MXS_ERROR("Failed to send %d events of %lu bytes to slave at [%s]:%d.",
+                          n_events,
+                          out_len,
+                          slave->dcb->remote,
+                          dcb_get_port(slave->dcb));
+                rval = false;
+            }
+        }
+
+        if (rval && end > 0)
+        {
+            pthread_mutex_lock(&slave->catch_lock);
+            slave->binlog_pos += end;
+            pthread_mutex_unlock(&slave->catch_lock);
+
+            /* set lastReply for slave heartbeat check */
+            if (router->send_slave_heartbeat)
+            {
+                slave->lastReply = time(0);
+            }
+        }
+
+        gwbuf_free(data);
+    }
+
+    return rval;
+}
+
 /**
  * We have a registered slave that is behind the current leading edge of the
  * binlog. We must replay the log entries to bring this node up to speed.
@@ -2443,6 +2678,35 @@ int blr_slave_catchup(ROUTER_INSTANCE* router, ROUTER_SLAVE* slave, bool large)
 #endif
     int events_before = slave->stats.n_events;
 
+    /**
+     * The events are first sent in bulk, unless the slave is before the
+     * start of the encrypted events of the binlog file
+     */
+    if (!slave->encryption_ctx || slave->binlog_pos >= slave->encryption_ctx->first_enc_event_pos)
+    {
+        if (!blr_slave_send_bulk(router, slave, file, &burst, &burst_size))
+        {
+            MXS_WARNING("Slave %s:%i, server-id %d, binlog '%s%s', position %lu: "
+                        "Slave-thread could not send events to slave, "
+                        "closing connection.",
+                        slave->dcb->remote,
+                        dcb_get_port(slave->dcb),
+                        slave->serverid,
+                        t_prefix,
+                        slave->binlog_name,
+                        (unsigned long)slave->binlog_pos);
+#ifndef BLFILE_IN_SLAVE
+            blr_close_binlog(router, file);
+#endif
+            slave->state = BLRS_ERRORED;
+            dcb_close(slave->dcb);
+            return 0;
+        }
+    }
+
+    /* The read status if the burst was used up by the events sent in bulk */
+    hdr.ok = SLAVE_POS_READ_OK;
+
     /* Loop read binlog events from slave binlog file */
     while (burst-- && burst_size > 0
            &&   /* Read one binlog event */
@@ -6471,6 +6735,94 @@ bool blr_notify_waiting_slave(ROUTER_SLAVE* slave)
     return ret;
 }
 
+/**
+ * Add a slave that starts dumping to the slaves of its routing worker
+ *
+ * This must be called on the worker of the slave.
+ *
+ * @param router    The router instance
+ * @param slave     The slave
+ * @return          True on success, false if the memory allocation failed
+ */
+bool blr_slave_worker_add(ROUTER_INSTANCE* router, ROUTER_SLAVE* slave)
+{
+    mxs::RoutingWorker* worker = (mxs::RoutingWorker*)slave->dcb->poll.owner;
+    mxb_assert(worker == mxs::RoutingWorker::get_current());
+
+    if (slave->worker)
+    {
+        return true;
+    }
+
+    BLR_WORKER* w = (BLR_WORKER*)atomic_load_ptr((void**)&router->workers);
+
+    while (w && w->worker != worker)
+    {
+        w = w->next;
+    }
+
+    if (!w)
+    {
+        /**
+         * Only this worker adds an entry for itself, so the lock is needed
+         * only because other workers may be adding theirs. The list is read
+         * without locking, so an entry is never removed.
+         */
+        if ((w = (BLR_WORKER*)MXS_CALLOC(1, sizeof(BLR_WORKER))) == NULL)
+        {
+            return false;
+        }
+
+        w->worker = worker;
+
+        pthread_mutex_lock(&router->lock);
+        w->next = router->workers;
+        atomic_store_ptr((void**)&router->workers, w);
+        pthread_mutex_unlock(&router->lock);
+    }
+
+    slave->worker = w;
+    slave->worker_next = w->slaves;
+    w->slaves = slave;
+    atomic_add(&w->n_slaves, 1);
+
+    return true;
+}
+
+/**
+ * Remove a slave from the slaves of its routing worker
+ *
+ * This must be called on the worker of the slave. As the notifications
+ * of the worker are handled on the worker as well, the slave will not
+ * be notified after this has been called.
+ *
+ * @param slave     The slave
+ */
+void blr_slave_worker_remove(ROUTER_SLAVE* slave)
+{
+    BLR_WORKER* w = slave->worker;
+
+    if (w)
+    {
+        mxb_assert(w->worker == mxs::RoutingWorker::get_current());
+        ROUTER_SLAVE** pp = &w->slaves;
+
+        while (*pp && *pp != slave)
+        {
+            pp = &(*pp)->worker_next;
+        }
+
+        if (*pp)
+        {
+            *pp = slave->worker_next;
+            atomic_add(&w->n_slaves, -1);
+        }
+
+        slave->worker = NULL;
+        slave->worker_next = NULL;
+    }
+}
+
 /**
  * Read MXS_START_ENCRYPTION_EVENT, after FDE
  *
@@ -7097,29 +7449,10 @@ static bool blr_slave_gtid_request(ROUTER_INSTANCE* router,
     }
     else
     {
-        char dbpath[PATH_MAX + 1];
-        snprintf(dbpath,
-                 sizeof(dbpath),
-                 "/%s/%s",
-                 router->binlogdir,
-                 GTID_MAPS_DB);
-
-        /* Open GTID maps read-only database */
-        if (sqlite3_open_v2(dbpath,
-                            &slave->gtid_maps,
-                            SQLITE_OPEN_READONLY,
-                            NULL) != SQLITE_OK)
+        if (!router->gtid_index)
         {
-            char errmsg[BINLOG_ERROR_MSG_LEN + sizeof(dbpath) + 1];
-            snprintf(errmsg,
-                     sizeof(errmsg),
-                     "Slave %lu: failed to open GTID maps db '%s': %s",
-                     (unsigned long)slave->serverid,
-                     dbpath,
-                     sqlite3_errmsg(slave->gtid_maps));
-            errmsg[BINLOG_ERROR_MSG_LEN] = '\0';
-
-            MXS_ERROR("%s", errmsg);
+            MXS_ERROR("Slave %lu: the GTID index is not available.",
+                      (unsigned long)slave->serverid);
             strcpy(slave->binlog_name, "");
             slave->binlog_pos = 0;
             blr_send_custom_error(slave->dcb,
@@ -7128,19 +7461,11 @@ static bool blr_slave_gtid_request(ROUTER_INSTANCE* router,
                                   "Cannot open GTID maps storage.",
                                   "HY000",
                                   BINLOG_FATAL_ERROR_READING);
-
-            slave->gtid_maps = NULL;
             return false;
         }
-        else
-        {
-            /* Fetch the GTID from the maps storage */
-            blr_fetch_mariadb_gtid(slave, slave->mariadb_gtid, &f_gtid);
 
-            /* Close GTID maps database */
-            sqlite3_close_v2(slave->gtid_maps);
-            slave->gtid_maps = NULL;
-        }
+        /* Fetch the GTID from the GTID index */
+        blr_fetch_mariadb_gtid(slave, slave->mariadb_gtid, &f_gtid);
 
         /* Requested GTID Not Found */
         if (!f_gtid.gtid[0])
@@ -8956,7 +9281,7 @@ static int binary_logs_purge_cb(void* data,
                                 char** values,
                                 char** names)
 {
-    mxb_assert(cols == 2);
+    mxb_assert(cols == 3);
 
     BINARY_LOG_DATA_RESULT* result_data = (BINARY_LOG_DATA_RESULT*)data;
 
@@ -8974,6 +9299,17 @@ static int binary_logs_purge_cb(void* data,
 
         MXS_DEBUG("Deleting binlog file %s", full_path);
 
+        if (unlink(full_path) == -1 && errno != ENOENT)
+        {
+            MXS_ERROR("Failed to remove binlog file '%s': %d, %s",
+                      full_path,
+                      errno,
+                      mxs_strerror(errno));
+        }
+
+        /* The file may have been compressed */
+        strcat(full_path, BLR_COMPRESSED_SUFFIX);
+
         if (unlink(full_path) == -1 && errno != ENOENT)
         {
             MXS_ERROR("Failed to remove binlog file '%s': %d, %s",
@@ -8982,11 +9318,56 @@ static int binary_logs_purge_cb(void* data,
                       mxs_strerror(errno));
         }
         result_data->n_files++;
+
+        /**
+         * With tree storage, only the row added when the binlog file was created,
+         * at position 4, has the domain and server directory of the file. The
+         * other rows have the ones of their GTIDs.
+         */
+        if (result_data->gtid_index
+            && (!result_data->use_tree || (values[2] && atoll(values[2]) <= 4)))
+        {
+            uint32_t domain_id = 0;
+            uint32_t server_id = 0;
+
+            /* values[1] is domain_id/server_id/filename */
+            sscanf(values[1], "%" SCNu32 "/%" SCNu32 "/", &domain_id, &server_id);
+            blr_gtid_index_purge(result_data->gtid_index,
+                                 values[0],
+                                 domain_id,
+                                 server_id);
+        }
     }
 
     return 0;
 }
 
+/**
+ * Interface for testing the removal of a purged binlog file
+ *
+ * @param router    The router instance
+ * @param binlog    The binlog file name
+ * @param file      The binlog file name, prefixed with
+ *                  "domain_id/server_id/" with tree storage
+ * @return          The number of files removed
+ */
+size_t blr_test_purge_binlog_file(ROUTER_INSTANCE* router,
+                                  const char* binlog,
+                                  const char* file)
+{
+    BINARY_LOG_DATA_RESULT result;
+    char* values[3] = {const_cast<char*>(binlog), const_cast<char*>(file), const_cast<char*>("4")};
+
+    memset(&result, 0, sizeof(result));
+    result.binlogdir = router->binlogdir;
+    result.use_tree = router->storage_type == BLR_BINLOG_STORAGE_TREE;
+    result.gtid_index = router->gtid_index;
+
+    binary_logs_purge_cb(&result, 3, values, NULL);
+
+    return result.n_files;
+}
+
 /**
  * Parse the PURGE BINARY LOGS TO 'file' SQL statement.
  *
@@ -9091,7 +9472,8 @@ static bool blr_purge_binary_logs(ROUTER_INSTANCE* router,
     static const char delete_list_tpl[] = "SELECT binlog_file, "
                                           "(rep_domain || '/' || "
                                           "server_id || '/' || "
-                                          "binlog_file) AS file "
+                                          "binlog_file) AS file, "
+                                          "MIN(start_pos) AS start_pos "
                                           "FROM gtid_maps "
                                           "WHERE id < %" PRIu64 " "
                                                                 "GROUP BY file "
@@ -9120,6 +9502,7 @@ static bool blr_purge_binary_logs(ROUTER_INSTANCE* router,
     result.n_files = 0;
     result.binlogdir = router->binlogdir;
     result.use_tree = router->storage_type == BLR_BINLOG_STORAGE_TREE;
+    result.gtid_index = router->gtid_index;
 
     /* Use the provided name, no prefix: find the first row */
     sprintf(sql_stmt,
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+/**
+ * @file profile_encryption.cc - Measures the binlog event encryption
+ *
+ * The events are encrypted and decrypted one at a time, as the master
+ * and the slaves of the binlog router do, and then decrypted in batches,
+ * as blr_slave_send_bulk() does.
+ */
+
+#include "../blr.hh"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+#include <maxscale/log.h>
+#include <maxscale/paths.h>
+
+using namespace std;
+
+namespace
+{
+
+char USAGE[] = "usage: profile_binlog_encryption -n count [-s event size] [-a aes_cbc|aes_ctr]\n";
+
+double seconds_since(const timespec& start)
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1000000000.0;
+}
+
+void report(const char* zWhat, int nCount, int nSize, double secs)
+{
+    cout << setw(20) << left << zWhat
+         << "Time:" << fixed << setprecision(3) << secs
+         << " Events/s:" << setprecision(0) << nCount / secs
+         << " MB/s:" << setprecision(1) << (double)nCount * nSize / secs / 1000000 << endl;
+}
+
+/**
+ * Run the profile
+ *
+ * @param router  Router with the encryption settings
+ * @param nCount  Number of events
+ * @param nSize   Size of each event
+ * @return        True if the events decrypted to what was encrypted
+ */
+bool profile(ROUTER_INSTANCE* router, int nCount, int nSize)
+{
+    uint8_t nonce[BLRM_NONCE_LENGTH];
+    vector<uint8_t> events((size_t)nCount * nSize);
+
+    for (size_t i = 0; i < sizeof(nonce); i++)
+    {
+        nonce[i] = rand();
+    }
+
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        events[i] = rand();
+    }
+
+    for (int i = 0; i < nCount; i++)
+    {
+        uint8_t* event = &events[(size_t)i * nSize];
+        gw_mysql_set_byte4(&event[9], nSize);
+        gw_mysql_set_byte4(&event[13], 4 + (i + 1) * nSize);
+    }
+
+    vector<uint8_t> encrypted(events.size());
+    vector<uint8_t> decrypted(events.size());
+    bool ok = true;
+    timespec start;
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+
+    for (int i = 0; i < nCount; i++)
+    {
+        size_t offset = (size_t)i * nSize;
+        memcpy(&encrypted[offset], &events[offset], nSize);
+    }
+
+    report("copy", nCount, nSize, seconds_since(start));
+
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+
+    for (int i = 0; ok && i < nCount; i++)
+    {
+        size_t offset = (size_t)i * nSize;
+        ok = blr_crypt_event(router,
+                             &events[offset],
+                             &encrypted[offset],
+                             nSize,
+                             4 + offset,
+                             nonce,
+                             BINLOG_FLAG_ENCRYPT);
+    }
+
+    report("encrypt", nCount, nSize, seconds_since(start));
+
+    decrypted = encrypted;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+
+    for (int i = 0; ok && i < nCount; i++)
+    {
+        size_t offset = (size_t)i * nSize;
+        ok = blr_crypt_event(router,
+                             &decrypted[offset],
+                             &decrypted[offset],
+                             nSize,
+                             4 + offset,
+                             nonce,
+                             BINLOG_FLAG_DECRYPT);
+    }
+
+    report("decrypt", nCount, nSize, seconds_since(start));
+
+    vector<uint8_t> batch = encrypted;
+    unsigned long len = 0;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+
+    /* The batches are as large as a default burst */
+    for (unsigned long offset = 0; ok && offset < batch.size(); offset += len)
+    {
+        unsigned long size = min(batch.size() - offset, (size_t)atol(DEF_BURST_SIZE));
+        len = blr_decrypt_events(router, &batch[offset], size, 4 + offset, nonce);
+        ok = len > 0;
+    }
+
+    report("decrypt in batches", nCount, nSize, seconds_since(start));
+
+    if (ok && batch != decrypted)
+    {
+        cerr << "error: The events decrypted in batches differ from the ones decrypted one at a time."
+             << endl;
+        ok = false;
+    }
+
+    return ok;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    int rc = EXIT_SUCCESS;
+
+    int nCount = 0;
+    int nSize = 200;
+    const char* zAlgorithm = "aes_ctr";
+
+    int c;
+    while ((c = getopt(argc, argv, "n:s:a:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            nCount = atoi(optarg);
+            break;
+
+        case 's':
+            nSize = atoi(optarg);
+            break;
+
+        case 'a':
+            zAlgorithm = optarg;
+            break;
+
+        default:
+            rc = EXIT_FAILURE;
+        }
+    }
+
+    int algorithm = blr_check_encryption_algorithm(zAlgorithm);
+
+    if ((rc == EXIT_SUCCESS) && (nCount > 0) && (nSize >= BINLOG_EVENT_HDR_LEN) && (algorithm != -1))
+    {
+        rc = EXIT_FAILURE;
+
+        set_datadir(strdup("/tmp"));
+        set_langdir(strdup("."));
+        set_process_datadir(strdup("/tmp"));
+
+        if (mxs_log_init(NULL, ".", MXS_LOG_TARGET_DEFAULT))
+        {
+            ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(calloc(1, sizeof(ROUTER_INSTANCE)));
+
+            if (router)
+            {
+                router->encryption.enabled = 1;
+                router->encryption.encryption_algorithm = algorithm;
+                router->encryption.key_len = BINLOG_AES_MAX_KEY_LEN;
+
+                for (int i = 0; i < BINLOG_AES_MAX_KEY_LEN; i++)
+                {
+                    router->encryption.key_value[i] = rand();
+                }
+
+                cout << zAlgorithm << ", " << nCount << " events of " << nSize << " bytes" << endl;
+
+                if (profile(router, nCount, nSize))
+                {
+                    rc = EXIT_SUCCESS;
+                }
+
+                free(router);
+            }
+
+            mxs_log_finish();
+        }
+        else
+        {
+            cerr << "error: Could not initialize log." << endl;
+        }
+    }
+    else
+    {
+        cout << USAGE << endl;
+    }
+
+    return rc;
+}
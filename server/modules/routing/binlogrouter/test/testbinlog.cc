@@ -37,6 +37,7 @@
 #include <time.h>
 #include <maxscale/log.h>
 #include <maxscale/paths.h>
+#include <maxscale/routingworker.hh>
 #include <maxscale/alloc.h>
 #include <maxscale/utils.hh>
 #include "../../../../core/internal/modules.h"
@@ -44,8 +45,16 @@
 
 #include <maxscale/protocol/mysql.h>
 #include <ini.h>
+#include <openssl/evp.h>
+#include <signal.h>
+#include <sys/resource.h>
 #include <sys/stat.h>
 #include <getopt.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include <maxscale/version.h>
 
@@ -56,11 +65,24 @@
 static void printVersion(const char* progname);
 static void printUsage(const char* progname);
 static void master_free_parsed_options(ChangeMasterOptions* options);
+static int  test_event_ring(int* tests);
+static int  test_bulk_events(int* tests);
+static int  test_gtid_index(SERVICE* service, int* tests);
+static int  test_compression(SERVICE* service, int* tests);
+static int  test_encryption(int* tests);
+static int  test_write_batching(SERVICE* service, int* tests);
+static int  test_slave_workers(int* tests);
 extern int  blr_test_parse_change_master_command(char* input,
                                                  char* error_string,
                                                  ChangeMasterOptions* config);
 extern char* blr_test_set_master_logfile(ROUTER_INSTANCE* router, const char* filename, char* error);
 extern int   blr_test_handle_change_master(ROUTER_INSTANCE* router, char* command, char* error);
+extern void  encode_value(unsigned char* data, unsigned int value, int len);
+extern bool  blr_test_compress_binlog(ROUTER_INSTANCE* router, const char* path, uint64_t* saved);
+extern size_t blr_test_purge_binlog_file(ROUTER_INSTANCE* router, const char* binlog, const char* file);
+extern uint32_t blr_slave_get_file_size(const char* filename);
+extern void  blr_test_notify_worker_slaves(BLR_WORKER* w);
+extern bool  blr_test_file_is_complete(ROUTER_INSTANCE* router, BLFILE* file);
 
 static struct option long_options[] =
 {
@@ -905,6 +927,19 @@ int main(int argc, char** argv)
         return 1;
     }
 
+    tests++;
+
+    if (test_event_ring(&tests)
+        || test_bulk_events(&tests)
+        || test_gtid_index(service, &tests)
+        || test_compression(service, &tests)
+        || test_encryption(&tests)
+        || test_write_batching(service, &tests)
+        || test_slave_workers(&tests))
+    {
+        return 1;
+    }
+
     MXS_FREE(inst->user);
     MXS_FREE(inst->password);
     MXS_FREE(inst->fileroot);
@@ -912,6 +947,202 @@ int main(int argc, char** argv)
     return 0;
 }
 
+/**
+ * Create an event of the given type and size, with its payload bytes
+ * set to the low byte of the position.
+ */
+static void create_event(uint8_t* buf, uint64_t pos, uint8_t type, uint32_t size)
+{
+    memset(buf, pos & 0xff, size);
+    encode_value(&buf[0], 0, 32);               // timestamp
+    buf[4] = type;                              // event type
+    encode_value(&buf[5], 1, 32);               // server id
+    encode_value(&buf[9], size, 32);            // event size
+    encode_value(&buf[13], pos + size, 32);     // next pos
+    encode_value(&buf[17], 0, 16);              // flags
+}
+
+/**
+ * Add an event of the given size to the event ring
+ */
+static void event_ring_add(ROUTER_INSTANCE* router, uint64_t pos, uint32_t size)
+{
+    uint8_t* buf = static_cast<uint8_t*>(MXS_MALLOC(size));
+
+    create_event(buf, pos, QUERY_EVENT, size);
+    blr_event_ring_add(router, blr_ring_event_alloc(pos, false, size, buf));
+    MXS_FREE(buf);
+}
+
+/**
+ * Check whether an event is read from the event ring, with its content intact
+ */
+static bool event_ring_has(ROUTER_INSTANCE* router, BLFILE* file, uint64_t pos, uint32_t size)
+{
+    REP_HEADER hdr;
+    GWBUF* event = blr_event_ring_read(router, file, pos, &hdr, NULL);
+    bool rval = false;
+
+    if (event)
+    {
+        uint8_t* data = GWBUF_DATA(event);
+
+        rval = GWBUF_LENGTH(event) == size
+            && hdr.ok == SLAVE_POS_READ_OK
+            && hdr.event_size == size
+            && hdr.next_pos == pos + size
+            && data[BINLOG_EVENT_HDR_LEN] == (pos & 0xff)
+            && data[size - 1] == (pos & 0xff);
+
+        gwbuf_free(event);
+    }
+
+    return rval;
+}
+
+/**
+ * Test the ring of recently written events: hits, misses,
+ * the eviction of the oldest events and the resets
+ *
+ * @param tests The number of the test, incremented for each test
+ * @return      0 on success, 1 on failure
+ */
+static int test_event_ring(int* tests)
+{
+    const uint32_t size = 100;
+    ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(MXS_CALLOC(1, sizeof(ROUTER_INSTANCE)));
+    BLFILE file;
+    BLFILE next_file;
+    int rval = 0;
+
+    memset(&file, 0, sizeof(file));
+    memset(&next_file, 0, sizeof(next_file));
+    strcpy(file.binlog_name, "mysql-bin.000001");
+    strcpy(next_file.binlog_name, "mysql-bin.000002");
+
+    pthread_mutex_init(&router->binlog_lock, NULL);
+    router->storage_type = BLR_BINLOG_STORAGE_FLAT;
+    router->binlog_generation = 1;
+    strcpy(router->binlog_name, file.binlog_name);
+    router->event_ring.max_events = 4;
+    router->event_ring.max_size = 1024 * 1024;
+
+    if (!blr_event_ring_init(router))
+    {
+        printf("Test %d: event ring allocation FAILED\n", *tests);
+        return 1;
+    }
+
+    /* Events at 4, 104 and 204, of which the last one is not yet safe to read */
+    for (uint64_t pos = 4; pos < 4 + 3 * size; pos += size)
+    {
+        event_ring_add(router, pos, size);
+    }
+    router->binlog_position = 4 + 2 * size;
+
+    if (!event_ring_has(router, &file, 4 + size, size) || router->stats.n_ringhits != 1)
+    {
+        printf("Test %d: event ring hit FAILED\n", *tests);
+        rval = 1;
+    }
+    else if (event_ring_has(router, &file, 4 + 2 * size, size)
+             || event_ring_has(router, &file, 4 + 3 * size, size))
+    {
+        printf("Test %d: event ring returned an event beyond the safe position, FAILED\n", *tests);
+        rval = 1;
+    }
+    else if (event_ring_has(router, &file, 4 + size + 1, size) || router->stats.n_ringmisses != 1)
+    {
+        printf("Test %d: event ring miss at a position that is not an event FAILED\n", *tests);
+        rval = 1;
+    }
+    else
+    {
+        printf("Test %d PASSED, event ring hits and misses\n", *tests);
+    }
+
+    (*tests)++;
+
+    /* Three more events, of which only the last four fit */
+    for (uint64_t pos = 4 + 3 * size; pos < 4 + 6 * size; pos += size)
+    {
+        event_ring_add(router, pos, size);
+    }
+    router->binlog_position = 4 + 6 * size;
+
+    if (rval == 0)
+    {
+        if (event_ring_has(router, &file, 4, size)
+            || event_ring_has(router, &file, 4 + size, size)
+            || router->stats.n_ringmisses != 3)
+        {
+            printf("Test %d: event ring eviction of the oldest events FAILED\n", *tests);
+            rval = 1;
+        }
+        else if (!event_ring_has(router, &file, 4 + 2 * size, size)
+                 || !event_ring_has(router, &file, 4 + 5 * size, size)
+                 || router->event_ring.count != 4)
+        {
+            printf("Test %d: event ring wrap around FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, event ring wrap around\n", *tests);
+        }
+
+        (*tests)++;
+    }
+
+    /* The router moves on to the next file, the events of which replace the earlier ones */
+    router->binlog_generation++;
+    strcpy(router->binlog_name, next_file.binlog_name);
+    router->binlog_position = 4 + size;
+
+    if (rval == 0)
+    {
+        if (event_ring_has(router, &file, 4 + 5 * size, size))
+        {
+            printf("Test %d: event ring returned an event of an earlier file, FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            event_ring_add(router, 4, size);
+
+            if (!event_ring_has(router, &next_file, 4, size) || router->event_ring.count != 1)
+            {
+                printf("Test %d: event ring reset at the next file FAILED\n", *tests);
+                rval = 1;
+            }
+            else
+            {
+                blr_event_ring_reset(router);
+
+                if (event_ring_has(router, &next_file, 4, size)
+                    || router->event_ring.count != 0
+                    || router->event_ring.generation != 0)
+                {
+                    printf("Test %d: event ring reset FAILED\n", *tests);
+                    rval = 1;
+                }
+                else
+                {
+                    printf("Test %d PASSED, event ring reset\n", *tests);
+                }
+            }
+        }
+
+        (*tests)++;
+    }
+
+    blr_event_ring_free(router);
+    pthread_mutex_destroy(&router->binlog_lock);
+    MXS_FREE(router);
+
+    return rval;
+}
+
 static void master_free_parsed_options(ChangeMasterOptions* options)
 {
     options->host.clear();
@@ -921,3 +1152,1466 @@ static void master_free_parsed_options(ChangeMasterOptions* options)
     options->binlog_file.clear();
     options->binlog_pos.clear();
 }
+
+/**
+ * Read a range of a binlog file as blr_slave_send_bulk() does and find the
+ * events in it that can be sent in bulk
+ *
+ * @return The length of the range, or 0 if nothing could be read
+ */
+static unsigned long bulk_read(ROUTER_INSTANCE* router,
+                               ROUTER_SLAVE* slave,
+                               BLFILE* file,
+                               unsigned long max_len,
+                               unsigned long* end,
+                               int* n_events,
+                               unsigned long* last_pos)
+{
+    GWBUF* data = blr_read_binlog_range(router, file, slave->binlog_pos, max_len);
+    unsigned long len = 0;
+    unsigned long out_len;
+
+    *end = 0;
+    *n_events = 0;
+    *last_pos = 0;
+
+    if (data)
+    {
+        len = GWBUF_LENGTH(data);
+        *end = blr_slave_bulk_events(router,
+                                     slave,
+                                     GWBUF_DATA(data),
+                                     len,
+                                     100,
+                                     n_events,
+                                     &out_len,
+                                     last_pos);
+        gwbuf_free(data);
+    }
+
+    return len;
+}
+
+/**
+ * Test reading the events of a binlog file in bulk: the events end at a
+ * partial event, at a rotate event, at the safe position of the current
+ * binlog file and at the events of the event ring
+ *
+ * @param tests The number of the test, incremented for each test
+ * @return      0 on success, 1 on failure
+ */
+static int test_bulk_events(int* tests)
+{
+    const uint32_t size = 100;
+    const uint32_t rotate_size = 50;
+    const uint8_t magic[BINLOG_MAGIC_SIZE] = {0xfe, 0x62, 0x69, 0x6e};
+    ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(MXS_CALLOC(1, sizeof(ROUTER_INSTANCE)));
+    ROUTER_SLAVE* slave = static_cast<ROUTER_SLAVE*>(MXS_CALLOC(1, sizeof(ROUTER_SLAVE)));
+    char path[] = "/tmp/testbinlog_bulk_XXXXXX";
+    uint8_t buf[size];
+    BLFILE file;
+    unsigned long len;
+    unsigned long end;
+    unsigned long last_pos;
+    int n_events;
+    int rval = 0;
+
+    memset(&file, 0, sizeof(file));
+    strcpy(file.binlog_name, "mysql-bin.000001");
+    file.fd = mkstemp(path);
+
+    pthread_mutex_init(&router->binlog_lock, NULL);
+    router->storage_type = BLR_BINLOG_STORAGE_FLAT;
+    router->mariadb10_compat = 1;
+    router->binlog_generation = 1;
+    strcpy(router->binlog_name, "mysql-bin.000002");
+    router->event_ring.max_events = 4;
+    router->event_ring.max_size = 1024 * 1024;
+
+    strcpy(slave->binlog_name, file.binlog_name);
+    slave->binlog_pos = BINLOG_MAGIC_SIZE;
+
+    /* Three events followed by a rotate event */
+    bool written = file.fd != -1 && write(file.fd, magic, sizeof(magic)) == sizeof(magic);
+
+    for (uint64_t pos = BINLOG_MAGIC_SIZE; written && pos < BINLOG_MAGIC_SIZE + 3 * size; pos += size)
+    {
+        create_event(buf, pos, QUERY_EVENT, size);
+        written = write(file.fd, buf, size) == size;
+    }
+
+    create_event(buf, BINLOG_MAGIC_SIZE + 3 * size, ROTATE_EVENT, rotate_size);
+
+    if (!written
+        || write(file.fd, buf, rotate_size) != rotate_size
+        || !blr_event_ring_init(router))
+    {
+        printf("Test %d: creating binlog file %s FAILED\n", *tests, path);
+        rval = 1;
+    }
+
+    if (rval == 0)
+    {
+        len = bulk_read(router, slave, &file, 1000, &end, &n_events, &last_pos);
+
+        if (len != 3 * size + rotate_size
+            || end != 3 * size
+            || n_events != 3
+            || last_pos != BINLOG_MAGIC_SIZE + 2 * size)
+        {
+            printf("Test %d: bulk events ending at a rotate event FAILED, "
+                   "read %lu, events end at %lu\n", *tests, len, end);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, bulk events end at a rotate event\n", *tests);
+        }
+
+        (*tests)++;
+    }
+
+    if (rval == 0)
+    {
+        len = bulk_read(router, slave, &file, 2 * size + size / 2, &end, &n_events, &last_pos);
+
+        if (len != 2 * size + size / 2
+            || end != 2 * size
+            || n_events != 2
+            || last_pos != BINLOG_MAGIC_SIZE + size)
+        {
+            printf("Test %d: bulk events ending at a partial event FAILED, "
+                   "read %lu, events end at %lu\n", *tests, len, end);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, bulk events end at a partial event\n", *tests);
+        }
+
+        (*tests)++;
+    }
+
+    /* The file becomes the current one, of which two events are safe to read */
+    router->binlog_generation++;
+    strcpy(router->binlog_name, file.binlog_name);
+    router->binlog_position = BINLOG_MAGIC_SIZE + 2 * size;
+
+    if (rval == 0)
+    {
+        len = bulk_read(router, slave, &file, 1000, &end, &n_events, &last_pos);
+
+        if (len != 2 * size || end != 2 * size || n_events != 2)
+        {
+            printf("Test %d: bulk events ending at the safe position FAILED, "
+                   "read %lu, events end at %lu\n", *tests, len, end);
+            rval = 1;
+        }
+        else
+        {
+            /* The second and the third event are kept in the event ring */
+            for (uint64_t pos = BINLOG_MAGIC_SIZE + size; pos < BINLOG_MAGIC_SIZE + 3 * size; pos += size)
+            {
+                event_ring_add(router, pos, size);
+            }
+            router->binlog_position = BINLOG_MAGIC_SIZE + 3 * size;
+
+            len = bulk_read(router, slave, &file, 1000, &end, &n_events, &last_pos);
+
+            slave->binlog_pos = BINLOG_MAGIC_SIZE + size;
+            GWBUF* data = blr_read_binlog_range(router, &file, slave->binlog_pos, 1000);
+
+            if (len != size || end != size || n_events != 1 || data)
+            {
+                printf("Test %d: bulk events ending at the event ring FAILED, "
+                       "read %lu, events end at %lu\n", *tests, len, end);
+                rval = 1;
+            }
+            else
+            {
+                printf("Test %d PASSED, bulk events end at the safe position and the event ring\n",
+                       *tests);
+            }
+
+            gwbuf_free(data);
+        }
+
+        (*tests)++;
+    }
+
+    if (file.fd != -1)
+    {
+        close(file.fd);
+        unlink(path);
+    }
+
+    blr_event_ring_free(router);
+    pthread_mutex_destroy(&router->binlog_lock);
+    MXS_FREE(slave);
+    MXS_FREE(router);
+
+    return rval;
+}
+
+/**
+ * Look up a GTID in the GTID index
+ *
+ * @return True if the GTID was found in the given binlog file, in the
+ *         directory 0/10, with the positions of the tests
+ */
+static bool gtid_index_has(BLR_GTID_INDEX* index, uint64_t seq_no, const char* binlog_name)
+{
+    MARIADB_GTID_ELEMS gtid = {0, 20, seq_no};
+    MARIADB_GTID_INFO info;
+    char expected[GTID_MAX_LEN + 1];
+
+    memset(&info, 0, sizeof(info));
+    sprintf(expected, "0-20-%lu", (unsigned long)seq_no);
+
+    return blr_gtid_index_find(index, &gtid, &info)
+           && strcmp(info.gtid, expected) == 0
+           && strcmp(info.binlog_name, binlog_name) == 0
+           && info.start == seq_no * 100
+           && info.end == seq_no * 100 + 100
+           && info.gtid_elms.domain_id == 0
+           && info.gtid_elms.server_id == 10;
+}
+
+/**
+ * Add a GTID of the server 20 to the GTID index, in the directory 0/10
+ */
+static bool gtid_index_add(BLR_GTID_INDEX* index,
+                           uint64_t seq_no,
+                           const char* binlog_name,
+                           bool* first_in_file)
+{
+    MARIADB_GTID_INFO info;
+
+    memset(&info, 0, sizeof(info));
+    sprintf(info.gtid, "0-20-%lu", (unsigned long)seq_no);
+    strcpy(info.binlog_name, binlog_name);
+    info.start = seq_no * 100;
+    info.end = seq_no * 100 + 100;
+    info.gtid_elms.domain_id = 0;
+    info.gtid_elms.server_id = 20;
+    info.gtid_elms.seq_no = seq_no;
+
+    return blr_gtid_index_add(index, &info, 0, 10, first_in_file);
+}
+
+/**
+ * Remove the files of a directory and the directory itself
+ */
+static void remove_dir(const std::string& dir)
+{
+    DIR* dirp = opendir(dir.c_str());
+    struct dirent* dp;
+
+    if (dirp)
+    {
+        while ((dp = readdir(dirp)) != NULL)
+        {
+            if (dp->d_name[0] != '.')
+            {
+                unlink((dir + "/" + dp->d_name).c_str());
+            }
+        }
+
+        closedir(dirp);
+    }
+
+    rmdir(dir.c_str());
+}
+
+/**
+ * Test the GTID index with tree storage: the migration from the GTID maps
+ * database, adding, finding and purging GTIDs and reloading the index.
+ *
+ * The binlog files are in the directory 0/10 and contain the GTIDs of
+ * the server 20, so that the directory is not the one of the GTIDs.
+ *
+ * @param service   The service of the router
+ * @param tests     The number of the test, incremented for each test
+ * @return          0 on success, 1 on failure
+ */
+static int test_gtid_index(SERVICE* service, int* tests)
+{
+    static const char setup[] =
+        "CREATE TABLE gtid_maps("
+        "id INTEGER PRIMARY KEY AUTOINCREMENT, "
+        "rep_domain INT, "
+        "server_id INT, "
+        "sequence BIGINT, "
+        "binlog_rdir VARCHAR(255), "
+        "binlog_file VARCHAR(255), "
+        "start_pos BIGINT, "
+        "end_pos BIGINT);"
+        "INSERT INTO gtid_maps(rep_domain, server_id, sequence, binlog_file, start_pos, end_pos) "
+        "VALUES (0, 10, 0, 'mysql-bin.000001', 4, 4), "
+        "(0, 20, 1, 'mysql-bin.000001', 100, 200), "
+        "(0, 20, 2, 'mysql-bin.000001', 200, 300), "
+        "(0, 10, 0, 'mysql-bin.000002', 4, 4), "
+        "(0, 20, 3, 'mysql-bin.000002', 300, 400);";
+    ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(MXS_CALLOC(1, sizeof(ROUTER_INSTANCE)));
+    char dir[] = "/tmp/testbinlog_gtid_XXXXXX";
+    BLR_GTID_INDEX* index = NULL;
+    MARIADB_GTID_INFO last;
+    bool first_in_file = false;
+    bool added = true;
+    int rval = 0;
+
+    router->service = service;
+    router->storage_type = BLR_BINLOG_STORAGE_TREE;
+    router->binlogdir = mkdtemp(dir);
+
+    if (!router->binlogdir
+        || sqlite3_open(":memory:", &router->gtid_maps) != SQLITE_OK
+        || sqlite3_exec(router->gtid_maps, setup, NULL, NULL, NULL) != SQLITE_OK
+        || (index = blr_gtid_index_open(router)) == NULL)
+    {
+        printf("Test %d: GTID index migration FAILED\n", *tests);
+        rval = 1;
+    }
+    else if (!gtid_index_has(index, 2, "mysql-bin.000001")
+             || !gtid_index_has(index, 3, "mysql-bin.000002")
+             || gtid_index_has(index, 4, "mysql-bin.000002"))
+    {
+        printf("Test %d: GTIDs migrated into the directory of the binlog file FAILED\n", *tests);
+        rval = 1;
+    }
+    else
+    {
+        printf("Test %d PASSED, GTID index migration\n", *tests);
+    }
+
+    (*tests)++;
+
+    if (rval == 0)
+    {
+        /* More GTIDs than are sampled in memory */
+        for (uint64_t seq_no = 4; added && seq_no < 200; seq_no++)
+        {
+            added = gtid_index_add(index, seq_no, "mysql-bin.000002", &first_in_file) && !first_in_file;
+        }
+
+        memset(&last, 0, sizeof(last));
+
+        if (!added
+            || !gtid_index_add(index, 200, "mysql-bin.000003", &first_in_file)
+            || !first_in_file)
+        {
+            printf("Test %d: adding GTIDs to the GTID index FAILED\n", *tests);
+            rval = 1;
+        }
+        else if (!gtid_index_has(index, 3, "mysql-bin.000002")
+                 || !gtid_index_has(index, 150, "mysql-bin.000002")
+                 || !gtid_index_has(index, 200, "mysql-bin.000003")
+                 || !blr_gtid_index_last(index, &last)
+                 || strcmp(last.gtid, "0-20-200") != 0
+                 || last.gtid_elms.server_id != 10)
+        {
+            printf("Test %d: finding added GTIDs in the GTID index FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, GTID index add and find\n", *tests);
+        }
+
+        (*tests)++;
+    }
+
+    if (rval == 0)
+    {
+        /* Only the file in the directory of the binlog file is purged */
+        blr_gtid_index_purge(index, "mysql-bin.000001", 0, 10);
+        blr_gtid_index_purge(index, "mysql-bin.000002", 0, 20);
+
+        if (gtid_index_has(index, 2, "mysql-bin.000001")
+            || !gtid_index_has(index, 3, "mysql-bin.000002"))
+        {
+            printf("Test %d: GTID index purge FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            /* The index is loaded from the files, not migrated again */
+            blr_gtid_index_close(index);
+            memset(&last, 0, sizeof(last));
+
+            if ((index = blr_gtid_index_open(router)) == NULL
+                || gtid_index_has(index, 2, "mysql-bin.000001")
+                || !gtid_index_has(index, 150, "mysql-bin.000002")
+                || !blr_gtid_index_last(index, &last)
+                || strcmp(last.gtid, "0-20-200") != 0)
+            {
+                printf("Test %d: GTID index reload after purge FAILED\n", *tests);
+                rval = 1;
+            }
+            else
+            {
+                printf("Test %d PASSED, GTID index purge and reload\n", *tests);
+            }
+        }
+
+        (*tests)++;
+    }
+
+    blr_gtid_index_close(index);
+    sqlite3_close_v2(router->gtid_maps);
+
+    if (router->binlogdir)
+    {
+        remove_dir(std::string(router->binlogdir) + "/gtid_index");
+        rmdir(router->binlogdir);
+    }
+
+    MXS_FREE(router);
+
+    return rval;
+}
+
+/** The size of the chunks of a compressed binlog file */
+static const size_t COMPRESSED_CHUNK_SIZE = 128 * 1024;
+
+/**
+ * The content of the binlog file of the compression test, which compresses
+ * well but differs at each position of a chunk
+ */
+static uint8_t compression_content(uint64_t pos)
+{
+    return (pos / 100) % 251;
+}
+
+/**
+ * Read from a compressed binlog file and check the content
+ */
+static bool compressed_has(BLR_COMPRESSED* file, uint64_t pos, size_t len, size_t expected_len)
+{
+    std::vector<uint8_t> buf(len);
+    bool rval = blr_compressed_pread(file, buf.data(), len, pos) == static_cast<ssize_t>(expected_len);
+
+    for (size_t i = 0; rval && i < expected_len; i++)
+    {
+        rval = buf[i] == compression_content(pos + i);
+    }
+
+    return rval;
+}
+
+/**
+ * Write a copy of a compressed file with 64-bit fields of the header
+ * replaced, and check whether the copy can be opened
+ *
+ * @param path      The compressed file
+ * @param fields    The offsets of the fields and their values
+ * @return          True if the copy could be opened
+ */
+static bool compressed_opens_with(const std::string& path,
+                                  const std::vector<std::pair<size_t, uint64_t>>& fields)
+{
+    std::string copy = path + ".copy";
+    int in = open(path.c_str(), O_RDONLY);
+    int out = open(copy.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0660);
+    struct stat statb;
+    bool rval = false;
+
+    if (in != -1 && out != -1 && fstat(in, &statb) == 0)
+    {
+        std::vector<uint8_t> data(statb.st_size);
+
+        if (pread(in, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size()))
+        {
+            for (const auto& field : fields)
+            {
+                memcpy(&data[field.first], &field.second, sizeof(field.second));
+            }
+
+            if (pwrite(out, data.data(), data.size(), 0) == static_cast<ssize_t>(data.size()))
+            {
+                BLR_COMPRESSED* file = blr_compressed_open(out);
+                rval = file != NULL;
+                blr_compressed_close(file);
+            }
+        }
+    }
+
+    if (in != -1)
+    {
+        close(in);
+    }
+
+    if (out != -1)
+    {
+        close(out);
+    }
+
+    unlink(copy.c_str());
+
+    return rval;
+}
+
+/**
+ * Test the compression of binlog files: reading a compressed file across
+ * chunks and past the cached chunks, rejecting a damaged file, and the
+ * opening, size and purging of a binlog file that has been compressed
+ *
+ * @param service   The service of the router
+ * @param tests     The number of the test, incremented for each test
+ * @return          0 on success, 1 on failure
+ */
+static int test_compression(SERVICE* service, int* tests)
+{
+    /* More chunks than are cached, the last one partial */
+    const uint64_t size = 6 * COMPRESSED_CHUNK_SIZE + 1000;
+    const uint64_t chunk = COMPRESSED_CHUNK_SIZE;
+    ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(MXS_CALLOC(1, sizeof(ROUTER_INSTANCE)));
+    char dir[] = "/tmp/testbinlog_compress_XXXXXX";
+    std::string path;
+    std::string compressed;
+    std::vector<uint8_t> content(size);
+    uint64_t saved = 0;
+    BLFILE* file = NULL;
+    int rval = 0;
+
+    for (uint64_t pos = 0; pos < size; pos++)
+    {
+        content[pos] = compression_content(pos);
+    }
+
+    router->service = service;
+    router->storage_type = BLR_BINLOG_STORAGE_FLAT;
+    router->binlogdir = mkdtemp(dir);
+    strcpy(router->binlog_name, "mysql-bin.000002");
+    pthread_mutex_init(&router->fileslock, NULL);
+    pthread_mutex_init(&router->binlog_lock, NULL);
+
+    if (router->binlogdir)
+    {
+        path = std::string(router->binlogdir) + "/mysql-bin.000001";
+        compressed = path + BLR_COMPRESSED_SUFFIX;
+
+        int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0660);
+
+        if (fd != -1)
+        {
+            if (write(fd, content.data(), size) != static_cast<ssize_t>(size))
+            {
+                rval = 1;
+            }
+
+            close(fd);
+        }
+        else
+        {
+            rval = 1;
+        }
+    }
+    else
+    {
+        rval = 1;
+    }
+
+    if (rval == 0
+        && (!blr_test_compress_binlog(router, path.c_str(), &saved)
+            || saved == 0
+            || access(path.c_str(), F_OK) == 0
+            || access(compressed.c_str(), F_OK) != 0
+            || blr_slave_get_file_size(path.c_str()) != size))
+    {
+        printf("Test %d: binlog file compression FAILED\n", *tests);
+        rval = 1;
+    }
+    else if (rval == 0)
+    {
+        printf("Test %d PASSED, binlog file compressed, saved %lu bytes\n",
+               *tests, (unsigned long)saved);
+    }
+    else
+    {
+        printf("Test %d: creating binlog file in %s FAILED\n", *tests, dir);
+    }
+
+    (*tests)++;
+
+    if (rval == 0)
+    {
+        file = blr_open_binlog(router, "mysql-bin.000001", NULL);
+
+        if (!file || !file->compressed)
+        {
+            printf("Test %d: opening a compressed binlog file FAILED\n", *tests);
+            rval = 1;
+        }
+        else if (!compressed_has(file->compressed, 0, 100, 100)
+                 || !compressed_has(file->compressed, chunk - 10, 20, 20)
+                 || !compressed_has(file->compressed, chunk - 5, 2 * chunk + 10, 2 * chunk + 10))
+        {
+            printf("Test %d: reading across chunks of a compressed binlog file FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            bool read = true;
+
+            /* Each chunk once, so that the first ones are evicted, and then backwards */
+            for (uint64_t i = 0; read && i <= size / chunk; i++)
+            {
+                read = compressed_has(file->compressed, i * chunk + 1, 10, 10);
+            }
+
+            for (uint64_t i = size / chunk + 1; read && i-- > 0;)
+            {
+                read = compressed_has(file->compressed, i * chunk + 2, 10, 10);
+            }
+
+            if (!read
+                || !compressed_has(file->compressed, size - 10, 100, 10)
+                || !compressed_has(file->compressed, size, 100, 0))
+            {
+                printf("Test %d: reading evicted chunks and the end of "
+                       "a compressed binlog file FAILED\n", *tests);
+                rval = 1;
+            }
+            else
+            {
+                printf("Test %d PASSED, compressed binlog file read\n", *tests);
+            }
+        }
+
+        if (file)
+        {
+            blr_close_binlog(router, file);
+        }
+
+        (*tests)++;
+    }
+
+    if (rval == 0)
+    {
+        /* The offsets of size, n_chunks and index_offset in the header */
+        const size_t size_offset = 16;
+        const size_t n_chunks_offset = 24;
+        const size_t index_offset_offset = 32;
+        const uint64_t huge = 1ULL << 60;
+
+        if (!compressed_opens_with(compressed, {})
+            || compressed_opens_with(compressed, {{size_offset, huge}, {n_chunks_offset, huge / chunk}})
+            || compressed_opens_with(compressed, {{index_offset_offset, 1024 * 1024 * 1024}})
+            || compressed_opens_with(compressed, {{index_offset_offset, 8}}))
+        {
+            printf("Test %d: rejecting a damaged compressed binlog file FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, damaged compressed binlog file rejected\n", *tests);
+        }
+
+        (*tests)++;
+    }
+
+    if (rval == 0)
+    {
+        if (blr_test_purge_binlog_file(router, "mysql-bin.000001", "0/0/mysql-bin.000001") != 1
+            || access(compressed.c_str(), F_OK) == 0)
+        {
+            printf("Test %d: purging a compressed binlog file FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, compressed binlog file purged\n", *tests);
+        }
+
+        (*tests)++;
+    }
+
+    if (router->binlogdir)
+    {
+        unlink(path.c_str());
+        unlink(compressed.c_str());
+        rmdir(router->binlogdir);
+    }
+
+    pthread_mutex_destroy(&router->fileslock);
+    pthread_mutex_destroy(&router->binlog_lock);
+    MXS_FREE(router);
+
+    return rval;
+}
+
+/**
+ * Create an event whose payload bytes all differ from those of the
+ * neighbouring positions
+ */
+static void encryption_event(uint8_t* buf, uint64_t pos, uint32_t size)
+{
+    create_event(buf, pos, QUERY_EVENT, size);
+
+    for (uint32_t i = BINLOG_EVENT_HDR_LEN; i < size; i++)
+    {
+        buf[i] = (pos + i) * 131;
+    }
+}
+
+/**
+ * Encrypt an event as the binlog files have always stored them, with an
+ * independent implementation of the format: the bytes from offset 4 onwards,
+ * with the first four bytes in place of the event size, are encrypted with
+ * the IV made of the nonce and the position, and the encrypted bytes in place
+ * of the event size are then moved to the beginning. With AES_CBC the bytes
+ * after the last full block are XORed with the IV encrypted with AES_ECB.
+ */
+static std::vector<uint8_t> encryption_reference(const uint8_t* key,
+                                                 const uint8_t* nonce,
+                                                 int algorithm,
+                                                 const uint8_t* event,
+                                                 uint32_t size,
+                                                 uint32_t pos)
+{
+    std::vector<uint8_t> data(event + 4, event + size);
+    std::vector<uint8_t> encrypted(data.size() + AES_BLOCK_SIZE);
+    std::vector<uint8_t> out(size);
+    size_t full = data.size();
+    uint8_t iv[BLRM_IV_LENGTH];
+    int len;
+
+    memcpy(iv, nonce, BLRM_NONCE_LENGTH);
+    gw_mysql_set_byte4(iv + BLRM_NONCE_LENGTH, pos);
+    memcpy(&data[BINLOG_EVENT_LEN_OFFSET - 4], event, 4);
+
+    if (algorithm == BLR_AES_CBC)
+    {
+        full -= full % AES_BLOCK_SIZE;
+    }
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    EVP_EncryptInit_ex(ctx,
+                       algorithm == BLR_AES_CBC ? EVP_aes_256_cbc() : EVP_aes_256_ctr(),
+                       NULL,
+                       key,
+                       iv);
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+    EVP_EncryptUpdate(ctx, &encrypted[0], &len, &data[0], full);
+
+    if (full < data.size())
+    {
+        uint8_t mask[AES_BLOCK_SIZE];
+
+        EVP_EncryptInit_ex(ctx, EVP_aes_256_ecb(), NULL, key, NULL);
+        EVP_CIPHER_CTX_set_padding(ctx, 0);
+        EVP_EncryptUpdate(ctx, mask, &len, iv, sizeof(mask));
+
+        for (size_t i = full; i < data.size(); i++)
+        {
+            encrypted[i] = data[i] ^ mask[i - full];
+        }
+    }
+
+    EVP_CIPHER_CTX_free(ctx);
+
+    memcpy(&out[0], &encrypted[BINLOG_EVENT_LEN_OFFSET - 4], 4);
+    memcpy(&out[4], &encrypted[0], size - 4);
+    memcpy(&out[BINLOG_EVENT_LEN_OFFSET], event + BINLOG_EVENT_LEN_OFFSET, 4);
+
+    return out;
+}
+
+/**
+ * Test the binlog event encryption with AES_CBC and AES_CTR: the format of
+ * the encrypted events, decrypting one at a time, also in place, and
+ * decrypting in batches of events of mixed sizes
+ *
+ * @param tests The number of the test, incremented for each test
+ * @return      0 on success, 1 on failure
+ */
+static int test_encryption(int* tests)
+{
+    /**
+     * Events with and without an AES_CBC tail, or with nothing but a tail,
+     * on both sides of the size up to which AES_CTR events are batched
+     */
+    const uint32_t sizes[] =
+    {
+        BINLOG_EVENT_HDR_LEN, 20, 35, 100, 399, 400, 401, 33, 1000, 36, 4096, 250, 21
+    };
+    const int n_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    const int algorithms[] = {BLR_AES_CBC, BLR_AES_CTR};
+    uint8_t nonce[BLRM_NONCE_LENGTH];
+    int rval = 0;
+
+    for (size_t i = 0; i < sizeof(nonce); i++)
+    {
+        nonce[i] = 0xa0 + i;
+    }
+
+    for (size_t a = 0; rval == 0 && a < sizeof(algorithms) / sizeof(algorithms[0]); a++)
+    {
+        ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(MXS_CALLOC(1, sizeof(ROUTER_INSTANCE)));
+        const char* name = blr_get_encryption_algorithm(algorithms[a]);
+        std::vector<uint8_t> events;
+        std::vector<uint8_t> encrypted;
+        std::vector<size_t> offsets;
+
+        router->encryption.enabled = 1;
+        router->encryption.encryption_algorithm = algorithms[a];
+        router->encryption.key_len = BINLOG_AES_MAX_KEY_LEN;
+
+        for (int i = 0; i < BINLOG_AES_MAX_KEY_LEN; i++)
+        {
+            router->encryption.key_value[i] = 17 * i + 3;
+        }
+
+        /* The events as they are written to a binlog file from position 4 */
+        for (int i = 0; i < n_sizes; i++)
+        {
+            offsets.push_back(events.size());
+            events.resize(events.size() + sizes[i]);
+            encryption_event(&events[offsets[i]], 4 + offsets[i], sizes[i]);
+        }
+
+        encrypted.resize(events.size());
+        bool ok = true;
+
+        for (int i = 0; ok && i < n_sizes; i++)
+        {
+            const uint8_t* event = &events[offsets[i]];
+            std::vector<uint8_t> expected = encryption_reference(router->encryption.key_value,
+                                                                 nonce,
+                                                                 algorithms[a],
+                                                                 event,
+                                                                 sizes[i],
+                                                                 4 + offsets[i]);
+            std::vector<uint8_t> in_place(event, event + sizes[i]);
+
+            ok = blr_crypt_event(router,
+                                 event,
+                                 &encrypted[offsets[i]],
+                                 sizes[i],
+                                 4 + offsets[i],
+                                 nonce,
+                                 BINLOG_FLAG_ENCRYPT)
+                && blr_crypt_event(router,
+                                   &in_place[0],
+                                   &in_place[0],
+                                   sizes[i],
+                                   4 + offsets[i],
+                                   nonce,
+                                   BINLOG_FLAG_ENCRYPT)
+                && memcmp(&encrypted[offsets[i]], &expected[0], sizes[i]) == 0
+                && in_place == expected;
+        }
+
+        if (!ok)
+        {
+            printf("Test %d: %s encryption in the binlog file format FAILED\n", *tests, name);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, %s encryption in the binlog file format\n", *tests, name);
+        }
+
+        (*tests)++;
+
+        if (rval == 0)
+        {
+            std::vector<uint8_t> decrypted(events.size());
+            std::vector<uint8_t> in_place = encrypted;
+
+            for (int i = 0; ok && i < n_sizes; i++)
+            {
+                ok = blr_crypt_event(router,
+                                     &encrypted[offsets[i]],
+                                     &decrypted[offsets[i]],
+                                     sizes[i],
+                                     4 + offsets[i],
+                                     nonce,
+                                     BINLOG_FLAG_DECRYPT)
+                    && blr_crypt_event(router,
+                                       &in_place[offsets[i]],
+                                       &in_place[offsets[i]],
+                                       sizes[i],
+                                       4 + offsets[i],
+                                       nonce,
+                                       BINLOG_FLAG_DECRYPT);
+            }
+
+            if (!ok || decrypted != events || in_place != events)
+            {
+                printf("Test %d: %s decryption of single events FAILED\n", *tests, name);
+                rval = 1;
+            }
+            else
+            {
+                printf("Test %d PASSED, %s decryption of single events\n", *tests, name);
+            }
+
+            (*tests)++;
+        }
+
+        if (rval == 0)
+        {
+            /**
+             * All the events and then the events from the third one on, both
+             * followed by the beginning of the largest event, which is left
+             * as it is
+             */
+            const size_t partial = 30;
+            const int firsts[] = {0, 2};
+            size_t largest = 0;
+
+            for (int i = 1; i < n_sizes; i++)
+            {
+                if (sizes[i] > sizes[largest])
+                {
+                    largest = i;
+                }
+            }
+
+            for (size_t f = 0; rval == 0 && f < sizeof(firsts) / sizeof(firsts[0]); f++)
+            {
+                size_t start = offsets[firsts[f]];
+                std::vector<uint8_t> batch(encrypted.begin() + start, encrypted.end());
+                batch.insert(batch.end(),
+                             encrypted.begin() + offsets[largest],
+                             encrypted.begin() + offsets[largest] + partial);
+
+                unsigned long len = blr_decrypt_events(router, &batch[0], batch.size(), 4 + start, nonce);
+
+                if (len != events.size() - start
+                    || memcmp(&batch[0], &events[start], len) != 0
+                    || memcmp(&batch[len], &encrypted[offsets[largest]], partial) != 0)
+                {
+                    printf("Test %d: %s decryption of events in batches FAILED\n", *tests, name);
+                    rval = 1;
+                }
+                else
+                {
+                    printf("Test %d PASSED, %s decryption of %lu bytes of events in a batch\n",
+                           *tests, name, len);
+                }
+
+                (*tests)++;
+            }
+        }
+
+        MXS_FREE(router);
+    }
+
+    return rval;
+}
+
+/**
+ * The size of an open file
+ */
+static uint64_t file_size(int fd)
+{
+    struct stat st;
+    return fstat(fd, &st) == 0 ? st.st_size : 0;
+}
+
+/**
+ * Pass an event of the given size and type to the router as if it had been
+ * received from the master, at the current position of the router
+ */
+static bool write_batch_event(ROUTER_INSTANCE* router, uint32_t size, uint8_t type)
+{
+    std::vector<uint8_t> buf(size);
+    REP_HEADER hdr;
+
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.event_type = type;
+    hdr.event_size = size;
+    hdr.next_pos = router->current_pos + size;
+    create_event(buf.data(), router->current_pos, type, size);
+
+    return blr_write_binlog_record(router, &hdr, size, buf.data()) == static_cast<int>(size);
+}
+
+/**
+ * Let the slaves read the events written so far, as blr_master.cc does
+ * when a transaction has been committed
+ */
+static void write_batch_commit_done(ROUTER_INSTANCE* router)
+{
+    router->binlog_position = router->current_pos;
+    router->current_safe_event = router->current_pos;
+}
+
+/**
+ * Test the batching of binlog writes: the events of a transaction and of
+ * a time window are written together, a failed write is truncated and
+ * the router positions reset to the last committed transaction, and the
+ * binlog file is synced as each sync policy requires
+ *
+ * @param service   The service of the router
+ * @param tests     The number of the test, incremented for each test
+ * @return          0 on success, 1 on failure
+ */
+static int test_write_batching(SERVICE* service, int* tests)
+{
+    const uint32_t size = 100;
+    const uint8_t magic[BINLOG_MAGIC_SIZE] = {0xfe, 0x62, 0x69, 0x6e};
+    ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(MXS_CALLOC(1, sizeof(ROUTER_INSTANCE)));
+    char path[] = "/tmp/testbinlog_batch_XXXXXX";
+    int rval = 0;
+
+    pthread_mutex_init(&router->binlog_lock, NULL);
+    router->service = service;
+    router->binlog_fd = mkstemp(path);
+    strcpy(router->binlog_name, "mysql-bin.000001");
+    router->current_pos = BINLOG_MAGIC_SIZE;
+    router->last_written = BINLOG_MAGIC_SIZE;
+    router->binlog_position = BINLOG_MAGIC_SIZE;
+    router->current_safe_event = BINLOG_MAGIC_SIZE;
+
+    if (router->binlog_fd == -1
+        || write(router->binlog_fd, magic, sizeof(magic)) != sizeof(magic)
+        || !blr_event_ring_init(router))
+    {
+        printf("Test %d: creating binlog file %s FAILED\n", *tests, path);
+        rval = 1;
+    }
+
+    /* The events of a transaction are written at commit, with one write */
+    if (rval == 0)
+    {
+        router->write_batch.mode = BLR_WRITE_BATCH_TRANSACTION;
+        router->write_batch.sync = BLR_SYNC_NONE;
+
+        bool ok = write_batch_event(router, size, QUERY_EVENT)
+            && write_batch_event(router, size, QUERY_EVENT)
+            && write_batch_event(router, size, XID_EVENT);
+        uint64_t batched_size = file_size(router->binlog_fd);
+        uint64_t batched_writes = router->stats.n_writes;
+
+        ok = ok && blr_file_commit(router) == BLR_COMMIT_DONE;
+
+        if (!ok
+            || batched_size != BINLOG_MAGIC_SIZE
+            || batched_writes != 0
+            || file_size(router->binlog_fd) != BINLOG_MAGIC_SIZE + 3 * size
+            || router->stats.n_writes != 1
+            || router->stats.n_written_events != 3
+            || router->current_pos != BINLOG_MAGIC_SIZE + 3 * size
+            || router->last_written != BINLOG_MAGIC_SIZE + 3 * size)
+        {
+            printf("Test %d: batching the events of a transaction FAILED, "
+                   "%lu writes, file size %lu\n",
+                   *tests, router->stats.n_writes, file_size(router->binlog_fd));
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, the events of a transaction are written at commit\n", *tests);
+        }
+
+        write_batch_commit_done(router);
+        (*tests)++;
+    }
+
+    /* The transactions of a window are written together, by the deferred commit */
+    if (rval == 0)
+    {
+        router->write_batch.mode = BLR_WRITE_BATCH_WINDOW;
+        router->write_batch.window = 60 * 1000;
+        uint64_t committed = router->binlog_position;
+
+        bool ok = write_batch_event(router, size, XID_EVENT)
+            && blr_file_commit(router) == BLR_COMMIT_DEFERRED
+            && write_batch_event(router, size, XID_EVENT)
+            && blr_file_commit(router) == BLR_COMMIT_DEFERRED;
+
+        ok = ok
+            && router->write_batch.commit_pos == committed + 2 * size
+            && file_size(router->binlog_fd) == committed
+            && router->binlog_position == committed
+            && blr_file_commit_deferred(router);
+
+        if (!ok
+            || file_size(router->binlog_fd) != committed + 2 * size
+            || router->binlog_position != committed + 2 * size
+            || router->write_batch.commit_pos != 0
+            || router->stats.n_writes != 2)
+        {
+            printf("Test %d: batching the transactions of a window FAILED, "
+                   "%lu writes, file size %lu\n",
+                   *tests, router->stats.n_writes, file_size(router->binlog_fd));
+            rval = 1;
+        }
+        else
+        {
+            /* Once the window has passed, a commit writes at once */
+            router->write_batch.window = 0;
+
+            if (!write_batch_event(router, size, XID_EVENT)
+                || blr_file_commit(router) != BLR_COMMIT_DONE
+                || file_size(router->binlog_fd) != committed + 3 * size)
+            {
+                printf("Test %d: committing after the window FAILED\n", *tests);
+                rval = 1;
+            }
+            else
+            {
+                printf("Test %d PASSED, the transactions of a window are written together\n", *tests);
+            }
+        }
+
+        write_batch_commit_done(router);
+        (*tests)++;
+    }
+
+    /* A partially written batch is truncated to the last committed transaction */
+    if (rval == 0)
+    {
+        router->write_batch.mode = BLR_WRITE_BATCH_TRANSACTION;
+        uint64_t committed = router->binlog_position;
+        struct rlimit old_limit;
+        struct rlimit limit;
+
+        /* Writing beyond the limit fails instead of raising SIGXFSZ */
+        signal(SIGXFSZ, SIG_IGN);
+        getrlimit(RLIMIT_FSIZE, &old_limit);
+        limit = old_limit;
+        limit.rlim_cur = committed + size + size / 2;
+
+        bool ok = setrlimit(RLIMIT_FSIZE, &limit) == 0
+            && write_batch_event(router, size, QUERY_EVENT)
+            && write_batch_event(router, size, XID_EVENT)
+            && blr_file_commit(router) == BLR_COMMIT_ERROR;
+
+        setrlimit(RLIMIT_FSIZE, &old_limit);
+        signal(SIGXFSZ, SIG_DFL);
+
+        if (!ok
+            || file_size(router->binlog_fd) != committed
+            || router->current_pos != committed
+            || router->last_written != committed
+            || router->binlog_position != committed
+            || router->write_batch.size != 0
+            || router->write_batch.n_events != 0
+            || router->write_batch.commit_pos != 0)
+        {
+            printf("Test %d: truncating a failed write FAILED, file size %lu, position %lu\n",
+                   *tests, file_size(router->binlog_fd), router->current_pos);
+            rval = 1;
+        }
+        else if (!write_batch_event(router, size, XID_EVENT)
+                 || blr_file_commit(router) != BLR_COMMIT_DONE
+                 || file_size(router->binlog_fd) != committed + size)
+        {
+            printf("Test %d: writing after a failed write FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, a failed write is truncated and the batch reset\n", *tests);
+        }
+
+        write_batch_commit_done(router);
+        (*tests)++;
+    }
+
+    /* Each sync policy syncs at its own point: after a read from the master
+     * or at a commit, per interval or never */
+    if (rval == 0)
+    {
+        struct
+        {
+            blr_sync_policy policy;
+            uint64_t        interval;
+            uint64_t        flush_syncs;    /*< Syncs by blr_file_flush() */
+            uint64_t        commit_syncs;   /*< Syncs by blr_file_commit() */
+            uint64_t        pending_syncs;  /*< Syncs by blr_file_sync_pending() */
+        } policies[] =
+        {
+            {BLR_SYNC_RESPONSE,    0,       1, 0, 1},
+            {BLR_SYNC_NONE,        0,       0, 0, 0},
+            {BLR_SYNC_TRANSACTION, 0,       0, 1, 1},
+            {BLR_SYNC_INTERVAL,    0,       1, 1, 1},
+            {BLR_SYNC_INTERVAL,    3600000, 0, 0, 1},
+        };
+        bool ok = true;
+
+        /* Each event is written at once, so that a flush has something to sync */
+        router->write_batch.mode = BLR_WRITE_BATCH_OFF;
+
+        for (size_t i = 0; ok && i < sizeof(policies) / sizeof(policies[0]); i++)
+        {
+            router->write_batch.sync = policies[i].policy;
+            router->write_batch.sync_interval = policies[i].interval;
+
+            /* Starts the interval from now */
+            router->write_batch.unsynced = true;
+            blr_file_sync_pending(router);
+
+            uint64_t syncs = router->stats.n_syncs;
+
+            ok = write_batch_event(router, size, XID_EVENT)
+                && blr_file_commit(router) == BLR_COMMIT_DONE;
+            uint64_t commit_syncs = router->stats.n_syncs - syncs;
+
+            ok = ok && write_batch_event(router, size, XID_EVENT);
+            blr_file_flush(router);
+            uint64_t flush_syncs = router->stats.n_syncs - syncs - commit_syncs;
+
+            /* As if the flush had not synced the events of the read */
+            router->write_batch.unsynced = true;
+            blr_file_sync_pending(router);
+            uint64_t pending_syncs = router->stats.n_syncs - syncs - commit_syncs - flush_syncs;
+
+            ok = ok && blr_file_commit(router) == BLR_COMMIT_DONE;
+            write_batch_commit_done(router);
+
+            if (!ok
+                || commit_syncs != policies[i].commit_syncs
+                || flush_syncs != policies[i].flush_syncs
+                || pending_syncs != policies[i].pending_syncs)
+            {
+                printf("Test %d: sync policy %d with the interval %lu FAILED, "
+                       "%lu syncs at commit, %lu at flush and %lu pending\n",
+                       *tests, policies[i].policy, policies[i].interval,
+                       commit_syncs, flush_syncs, pending_syncs);
+                ok = false;
+            }
+        }
+
+        if (ok)
+        {
+            printf("Test %d PASSED, the binlog file is synced as the sync policies require\n", *tests);
+        }
+        else
+        {
+            rval = 1;
+        }
+
+        (*tests)++;
+    }
+
+    if (router->binlog_fd != -1)
+    {
+        close(router->binlog_fd);
+        unlink(path);
+    }
+
+    blr_event_ring_free(router);
+    pthread_mutex_destroy(&router->binlog_lock);
+    MXS_FREE(router->write_batch.data);
+    MXS_FREE(router);
+
+    return rval;
+}
+
+/**
+ * Create a dumping slave of the current worker
+ */
+static ROUTER_SLAVE* create_worker_slave()
+{
+    ROUTER_SLAVE* slave = static_cast<ROUTER_SLAVE*>(MXS_CALLOC(1, sizeof(ROUTER_SLAVE)));
+    slave->dcb = static_cast<DCB*>(MXS_CALLOC(1, sizeof(DCB)));
+    slave->dcb->poll.owner = mxs::RoutingWorker::get_current();
+    slave->state = BLRS_DUMPING;
+    pthread_mutex_init(&slave->catch_lock, NULL);
+
+    return slave;
+}
+
+static void free_worker_slave(ROUTER_SLAVE* slave)
+{
+    pthread_mutex_destroy(&slave->catch_lock);
+    MXS_FREE(slave->dcb);
+    MXS_FREE(slave);
+}
+
+/**
+ * Check the slaves of a worker, in the order they are listed
+ */
+static bool worker_has_slaves(BLR_WORKER* w, const std::vector<ROUTER_SLAVE*>& slaves)
+{
+    std::vector<ROUTER_SLAVE*> listed;
+
+    for (ROUTER_SLAVE* slave = w->slaves; slave; slave = slave->worker_next)
+    {
+        if (slave->worker != w)
+        {
+            return false;
+        }
+
+        listed.push_back(slave);
+    }
+
+    return listed == slaves && w->n_slaves == (int)slaves.size();
+}
+
+/**
+ * Test the slaves of the workers: adding and removing slaves, the
+ * coalescing of the notifications of a worker and the completeness
+ * of the binlog files, cached for the generation of the current file
+ *
+ * The test is not run on a routing worker, so the slaves are added to
+ * the entry of no worker. The notifications that would be posted to it
+ * must not be, as it cannot execute them.
+ *
+ * @param tests The number of the test, incremented for each test
+ * @return      0 on success, 1 on failure
+ */
+static int test_slave_workers(int* tests)
+{
+    ROUTER_INSTANCE* router = static_cast<ROUTER_INSTANCE*>(MXS_CALLOC(1, sizeof(ROUTER_INSTANCE)));
+    BLR_WORKER* other = static_cast<BLR_WORKER*>(MXS_CALLOC(1, sizeof(BLR_WORKER)));
+    ROUTER_SLAVE* s1 = create_worker_slave();
+    ROUTER_SLAVE* s2 = create_worker_slave();
+    ROUTER_SLAVE* s3 = create_worker_slave();
+    int rval = 0;
+
+    pthread_mutex_init(&router->lock, NULL);
+    pthread_mutex_init(&router->binlog_lock, NULL);
+
+    /* The entry of another worker, that has no slaves */
+    other->worker = reinterpret_cast<mxs::RoutingWorker*>(other);
+    router->workers = other;
+
+    /* The slaves of a worker share one entry, a slave is added only once */
+    bool ok = blr_slave_worker_add(router, s1)
+        && blr_slave_worker_add(router, s2)
+        && blr_slave_worker_add(router, s1)
+        && blr_slave_worker_add(router, s3);
+    BLR_WORKER* w = router->workers;
+
+    if (!ok
+        || w == other
+        || w->next != other
+        || w->worker != mxs::RoutingWorker::get_current()
+        || !worker_has_slaves(w, {s3, s2, s1})
+        || other->n_slaves != 0)
+    {
+        printf("Test %d: adding slaves to their worker FAILED\n", *tests);
+        rval = 1;
+    }
+    else
+    {
+        printf("Test %d PASSED, the slaves of a worker are added to one entry\n", *tests);
+    }
+
+    (*tests)++;
+
+    /* Removing the slaves in the middle and at the head, and twice */
+    if (rval == 0)
+    {
+        blr_slave_worker_remove(s2);
+        bool middle = worker_has_slaves(w, {s3, s1}) && !s2->worker && !s2->worker_next;
+
+        blr_slave_worker_remove(s3);
+        blr_slave_worker_remove(s3);
+        bool head = worker_has_slaves(w, {s1}) && !s3->worker;
+
+        /* A removed slave is added back to the same entry */
+        ok = middle && head && blr_slave_worker_add(router, s2);
+
+        if (!ok
+            || router->workers != w
+            || !worker_has_slaves(w, {s2, s1}))
+        {
+            printf("Test %d: removing slaves from their worker FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, the slaves are removed from their worker\n", *tests);
+        }
+
+        (*tests)++;
+    }
+
+    /**
+     * A worker is notified only once until it has handled the notification,
+     * and a worker without slaves is not notified at all. Were a notification
+     * posted, the test would crash as there is no worker to execute it.
+     */
+    if (rval == 0)
+    {
+        w->notify_pending = 1;
+        blr_notify_all_slaves(router);
+        blr_notify_all_slaves(router);
+        bool coalesced = w->notify_pending == 1 && other->notify_pending == 0;
+
+        /* Handling the notification clears it, without waking the slaves that do not wait */
+        s1->cstate = 0;
+        s2->cstate = 0;
+        blr_test_notify_worker_slaves(w);
+        bool handled = w->notify_pending == 0 && s1->cstate == 0 && s2->cstate == 0;
+
+        blr_slave_worker_remove(s1);
+        blr_slave_worker_remove(s2);
+        blr_notify_all_slaves(router);
+        bool no_slaves = w->n_slaves == 0 && w->notify_pending == 0;
+
+        if (!coalesced || !handled || !no_slaves)
+        {
+            printf("Test %d: coalescing the notifications of a worker FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, the notifications of a worker are coalesced\n", *tests);
+        }
+
+        (*tests)++;
+    }
+
+    /* A file is complete once it is not the current file, rechecked only when the generation changes */
+    if (rval == 0)
+    {
+        BLFILE file = {};
+        strcpy(file.binlog_name, "mysql-bin.000001");
+
+        router->storage_type = BLR_BINLOG_STORAGE_FLAT;
+        strcpy(router->binlog_name, "mysql-bin.000001");
+        router->binlog_generation = 1;
+
+        bool current = !blr_test_file_is_complete(router, &file);
+
+        /* The cached result is used until the generation changes */
+        strcpy(router->binlog_name, "mysql-bin.000002");
+        bool cached = !blr_test_file_is_complete(router, &file);
+
+        router->binlog_generation++;
+        bool rotated = blr_test_file_is_complete(router, &file);
+
+        strcpy(router->binlog_name, "mysql-bin.000001");
+        bool complete_cached = blr_test_file_is_complete(router, &file);
+
+        if (!current || !cached || !rotated || !complete_cached)
+        {
+            printf("Test %d: checking the completeness of a binlog file FAILED\n", *tests);
+            rval = 1;
+        }
+        else
+        {
+            printf("Test %d PASSED, the completeness of a binlog file is cached "
+                   "for the generation of the current file\n",
+                   *tests);
+        }
+
+        (*tests)++;
+    }
+
+    free_worker_slave(s1);
+    free_worker_slave(s2);
+    free_worker_slave(s3);
+
+    while (router->workers)
+    {
+        BLR_WORKER* next = router->workers->next;
+        MXS_FREE(router->workers);
+        router->workers = next;
+    }
+
+    pthread_mutex_destroy(&router->binlog_lock);
+    pthread_mutex_destroy(&router->lock);
+    MXS_FREE(router);
+
+    return rval;
+}
@@ -20,6 +20,7 @@
 #include <string.h>
 #include <strings.h>
 #include <cmath>
+#include <limits>
 #include <new>
 #include <sstream>
 
@@ -76,15 +77,54 @@ static bool handle_max_slaves(Config& config, const char* str)
     return rval;
 }
 
+namespace
+{
+// The key used when all tables are considered written
+const char ALL_TABLES[] = "*";
+
+// The time of a write that has not been done
+const int64_t NEVER = std::numeric_limits<int64_t>::min();
+
+bool within_window(int64_t time, int64_t now, int64_t window)
+{
+    return time != NEVER && now - time <= window;
+}
+
+// The writes of the sessions of different workers may be recorded in any order
+void store_latest(std::atomic<int64_t>* latest, int64_t now)
+{
+    int64_t prev = latest->load();
+
+    while (prev < now && !latest->compare_exchange_weak(prev, now))
+    {
+    }
+}
+
+size_t shard_index(const std::string& table, size_t n_shards)
+{
+    return std::hash<std::string>()(table) % n_shards;
+}
+}
+
 RWSplit::RWSplit(SERVICE* service, const Config& config)
     : mxs::Router<RWSplit, RWSplitSession>(service)
     , m_service(service)
     , m_config(config)
+    , m_all_written(NEVER)
+    , m_latest_write(NEVER)
 {
+    for (auto& shard : m_written_tables)
+    {
+        pthread_rwlock_init(&shard.lock, NULL);
+    }
 }
 
 RWSplit::~RWSplit()
 {
+    for (auto& shard : m_written_tables)
+    {
+        pthread_rwlock_destroy(&shard.lock);
+    }
 }
 
 SERVICE* RWSplit::service() const
@@ -130,6 +170,96 @@ maxscale::SrvStatMap RWSplit::all_server_stats() const
     return stats;
 }
 
+void RWSplit::table_written(const std::string& table, int64_t now, int64_t window)
+{
+    WrittenTablesShard& shard = m_written_tables[shard_index(table, N_WRITTEN_TABLES_SHARDS)];
+
+    pthread_rwlock_wrlock(&shard.lock);
+    shard.tables.add(table, now, window);
+    pthread_rwlock_unlock(&shard.lock);
+
+    store_latest(&m_latest_write, now);
+}
+
+void RWSplit::all_tables_written(int64_t now, int64_t window)
+{
+    store_latest(&m_all_written, now);
+    store_latest(&m_latest_write, now);
+}
+
+bool RWSplit::table_recently_written(const std::string& table, int64_t now, int64_t window) const
+{
+    bool rval = within_window(m_all_written.load(), now, window);
+
+    if (!rval)
+    {
+        const WrittenTablesShard& shard = m_written_tables[shard_index(table, N_WRITTEN_TABLES_SHARDS)];
+
+        pthread_rwlock_rdlock(&shard.lock);
+        rval = shard.tables.contains(table, now, window);
+        pthread_rwlock_unlock(&shard.lock);
+    }
+
+    return rval;
+}
+
+bool RWSplit::any_table_recently_written(int64_t now, int64_t window) const
+{
+    return within_window(m_latest_write.load(), now, window);
+}
+
+void WrittenTables::add(const std::string& table, int64_t now, int64_t window)
+{
+    m_tables[table] = now;
+    m_latest = std::max(m_latest, now);
+
+    if (m_tables.size() >= m_prune_limit)
+    {
+        prune(now, window);
+    }
+}
+
+void WrittenTables::add_all(int64_t now, int64_t window)
+{
+    add(ALL_TABLES, now, window);
+}
+
+bool WrittenTables::contains(const std::string& table, int64_t now, int64_t window) const
+{
+    bool rval = false;
+
+    for (const auto& name : {table, std::string(ALL_TABLES)})
+    {
+        auto it = m_tables.find(name);
+
+        if (it != m_tables.end() && now - it->second <= window)
+        {
+            rval = true;
+            break;
+        }
+    }
+
+    return rval;
+}
+
+void WrittenTables::prune(int64_t now, int64_t window)
+{
+    for (auto it = m_tables.begin(); it != m_tables.end();)
+    {
+        if (now - it->second > window)
+        {
+            it = m_tables.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Don't prune again until the map has grown enough to make it worthwhile
+    m_prune_limit = std::max((size_t)64, m_tables.size() * 2);
+}
+
 int RWSplit::max_slave_count() const
 {
     int router_nservers = m_service->n_dbref;
@@ -274,8 +404,11 @@ void RWSplit::diagnostics(DCB* dcb)
                "\tstrict_sp_calls:           %s\n",
                cnf.strict_sp_calls ? "true" : "false");
     dcb_printf(dcb,
-               "\tprune_sescmd_history:    %s\n",
+               "\tprune_sescmd_history:      %s\n",
                cnf.prune_sescmd_history ? "true" : "false");
+    dcb_printf(dcb,
+               "\tcompact_sescmd_history:    %s\n",
+               cnf.compact_sescmd_history ? "true" : "false");
     dcb_printf(dcb,
                "\tdisable_sescmd_history:    %s\n",
                cnf.disable_sescmd_history ? "true" : "false");
@@ -343,6 +476,15 @@ void RWSplit::diagnostics(DCB* dcb)
     dcb_printf(dcb,
                "\tNumber of replayed transactions:        %" PRIu64 "\n",
                stats().n_trx_replay);
+    dcb_printf(dcb,
+               "\tNumber of pipelined queries:            %" PRIu64 "\n",
+               stats().n_pipelined);
+    dcb_printf(dcb,
+               "\tNumber of reads of written tables:      %" PRIu64 "\n",
+               stats().n_written_table_reads);
+    dcb_printf(dcb,
+               "\tNumber of causal reads without waiting: %" PRIu64 "\n",
+               stats().n_causal_no_wait);
 
     if (*weightby)
     {
@@ -403,6 +545,9 @@ json_t* RWSplit::diagnostics_json() const
     json_object_set_new(rval, "rw_transactions", json_integer(stats().n_rw_trx));
     json_object_set_new(rval, "ro_transactions", json_integer(stats().n_ro_trx));
     json_object_set_new(rval, "replayed_transactions", json_integer(stats().n_trx_replay));
+    json_object_set_new(rval, "pipelined_queries", json_integer(stats().n_pipelined));
+    json_object_set_new(rval, "written_table_reads", json_integer(stats().n_written_table_reads));
+    json_object_set_new(rval, "causal_reads_without_wait", json_integer(stats().n_causal_no_wait));
 
     const char* weightby = serviceGetWeightingParameter(service());
 
@@ -508,6 +653,7 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
             {"max_slave_connections",      MXS_MODULE_PARAM_STRING,  MAX_SLAVE_COUNT},
             {"retry_failed_reads",         MXS_MODULE_PARAM_BOOL,    "true"         },
             {"prune_sescmd_history",       MXS_MODULE_PARAM_BOOL,    "false"        },
+            {"compact_sescmd_history",     MXS_MODULE_PARAM_BOOL,    "false"        },
             {"disable_sescmd_history",     MXS_MODULE_PARAM_BOOL,    "false"        },
             {"max_sescmd_history",         MXS_MODULE_PARAM_COUNT,   "50"           },
             {"strict_multi_stmt",          MXS_MODULE_PARAM_BOOL,    "false"        },
@@ -521,7 +667,17 @@ extern "C" MXS_MODULE* MXS_CREATE_MODULE()
             {"delayed_retry_timeout",      MXS_MODULE_PARAM_COUNT,   "10"           },
             {"transaction_replay",         MXS_MODULE_PARAM_BOOL,    "false"        },
             {"transaction_replay_max_size",MXS_MODULE_PARAM_SIZE,    "1Mi"          },
+            {"transaction_replay_window",  MXS_MODULE_PARAM_COUNT,   "1"            },
             {"optimistic_trx",             MXS_MODULE_PARAM_BOOL,    "false"        },
+            {"pipeline_queries",           MXS_MODULE_PARAM_BOOL,    "false"        },
+            {
+                "track_written_tables",
+                MXS_MODULE_PARAM_ENUM,
+                "none",
+                MXS_MODULE_OPT_NONE,
+                track_written_tables_values
+            },
+            {"written_tables_window",      MXS_MODULE_PARAM_COUNT,   "10"           },
             {MXS_END_MODULE_PARAMS}
         }
     };
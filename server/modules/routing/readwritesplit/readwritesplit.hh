@@ -20,6 +20,7 @@
 
 #include <maxscale/ccdefs.hh>
 
+#include <atomic>
 #include <unordered_set>
 #include <unordered_map>
 #include <map>
@@ -66,7 +67,8 @@ enum select_criteria_t
     LEAST_ROUTER_CONNECTIONS,   /**< connections established by this router */
     LEAST_BEHIND_MASTER,
     LEAST_CURRENT_OPERATIONS,
-    ADAPTIVE_ROUTING
+    ADAPTIVE_ROUTING,
+    LEAST_SERVER_LOAD           /**< current operations blended with monitored server load */
 };
 
 /**
@@ -79,6 +81,16 @@ enum failure_mode
     RW_ERROR_ON_WRITE           /**< Don't close the connection but send an error for writes */
 };
 
+/**
+ * Controls whose writes are tracked when reads are checked for modified tables
+ */
+enum table_tracking_t
+{
+    TRACK_TABLES_NONE,      /**< Written tables are not tracked */
+    TRACK_TABLES_SESSION,   /**< Track the tables written by the session itself */
+    TRACK_TABLES_SERVICE    /**< Track the tables written by all sessions of the service */
+};
+
 /**
  * Enum values for router parameters
  */
@@ -95,6 +107,7 @@ static const MXS_ENUM_VALUE slave_selection_criteria_values[] =
     {"LEAST_ROUTER_CONNECTIONS", LEAST_ROUTER_CONNECTIONS},
     {"LEAST_BEHIND_MASTER",      LEAST_BEHIND_MASTER     },
     {"LEAST_CURRENT_OPERATIONS", LEAST_CURRENT_OPERATIONS},
+    {"LEAST_SERVER_LOAD",        LEAST_SERVER_LOAD       },
     {"ADAPTIVE_ROUTING",         ADAPTIVE_ROUTING        },
     {NULL}
 };
@@ -107,6 +120,14 @@ static const MXS_ENUM_VALUE master_failure_mode_values[] =
     {NULL}
 };
 
+static const MXS_ENUM_VALUE track_written_tables_values[] =
+{
+    {"none",    TRACK_TABLES_NONE   },
+    {"session", TRACK_TABLES_SESSION},
+    {"service", TRACK_TABLES_SERVICE},
+    {NULL}
+};
+
 #define BREF_IS_NOT_USED(s)       ((s)->bref_state & ~BREF_IN_USE)
 #define BREF_IS_IN_USE(s)         ((s)->bref_state & BREF_IN_USE)
 #define BREF_IS_WAITING_RESULT(s) ((s)->bref_num_result_wait > 0)
@@ -152,6 +173,7 @@ struct Config
                 params, "master_failure_mode", master_failure_mode_values))
         , max_sescmd_history(config_get_integer(params, "max_sescmd_history"))
         , prune_sescmd_history(config_get_bool(params, "prune_sescmd_history"))
+        , compact_sescmd_history(config_get_bool(params, "compact_sescmd_history"))
         , disable_sescmd_history(config_get_bool(params, "disable_sescmd_history"))
         , master_accept_reads(config_get_bool(params, "master_accept_reads"))
         , strict_multi_stmt(config_get_bool(params, "strict_multi_stmt"))
@@ -168,7 +190,13 @@ struct Config
         , delayed_retry_timeout(config_get_integer(params, "delayed_retry_timeout"))
         , transaction_replay(config_get_bool(params, "transaction_replay"))
         , trx_max_size(config_get_size(params, "transaction_replay_max_size"))
+        , trx_replay_window(config_get_integer(params, "transaction_replay_window"))
         , optimistic_trx(config_get_bool(params, "optimistic_trx"))
+        , pipeline_queries(config_get_bool(params, "pipeline_queries"))
+        , track_written_tables(
+            (table_tracking_t)config_get_enum(
+                params, "track_written_tables", track_written_tables_values))
+        , written_tables_window(config_get_integer(params, "written_tables_window"))
     {
         if (causal_reads)
         {
@@ -207,6 +235,7 @@ struct Config
     failure_mode master_failure_mode;   /**< Master server failure handling mode */
     uint64_t     max_sescmd_history;    /**< Maximum amount of session commands to store */
     bool         prune_sescmd_history;  /**< Prune session command history */
+    bool         compact_sescmd_history;/**< Remove superseded SET statements from the history */
     bool         disable_sescmd_history;/**< Disable session command history */
     bool         master_accept_reads;   /**< Use master for reads */
     bool         strict_multi_stmt;     /**< Force non-multistatement queries to be routed to
@@ -226,7 +255,71 @@ struct Config
     uint64_t    delayed_retry_timeout;  /**< How long to delay until an error is returned */
     bool        transaction_replay;     /**< Replay failed transactions */
     size_t      trx_max_size;           /**< Max transaction size for replaying */
+    int64_t     trx_replay_window;      /**< Max number of replayed statements sent at once */
     bool        optimistic_trx;         /**< Enable optimistic transactions */
+    bool        pipeline_queries;       /**< Route pipelined queries without waiting for replies */
+
+    table_tracking_t track_written_tables;  /**< Whose written tables are tracked */
+    int64_t          written_tables_window; /**< How long a written table is considered modified */
+};
+
+/**
+ * Tables modified by writes
+ *
+ * The time of the latest write is stored for each table so that reads done shortly
+ * after it can be routed in a consistent manner. The time is in the units of
+ * mxs_clock(). A write whose tables could not be resolved marks all tables as written.
+ */
+class WrittenTables
+{
+public:
+    /**
+     * Mark a table as written
+     *
+     * @param table  Fully qualified table name
+     * @param now    Current time
+     * @param window How long the write is relevant
+     */
+    void add(const std::string& table, int64_t now, int64_t window);
+
+    /**
+     * Mark all tables as written
+     *
+     * @param now    Current time
+     * @param window How long the write is relevant
+     */
+    void add_all(int64_t now, int64_t window);
+
+    /**
+     * Check if a table was written recently
+     *
+     * @param table  Fully qualified table name
+     * @param now    Current time
+     * @param window How long a write is relevant
+     *
+     * @return True if the table was written within the window
+     */
+    bool contains(const std::string& table, int64_t now, int64_t window) const;
+
+    /**
+     * Check if any table was written recently
+     *
+     * @param now    Current time
+     * @param window How long a write is relevant
+     *
+     * @return True if a table was written within the window
+     */
+    bool any(int64_t now, int64_t window) const
+    {
+        return !m_tables.empty() && now - m_latest <= window;
+    }
+
+private:
+    void prune(int64_t now, int64_t window);
+
+    std::unordered_map<std::string, int64_t> m_tables;
+    size_t                                   m_prune_limit = 64;
+    int64_t                                  m_latest = 0;  // Time of the latest write
 };
 
 /**
@@ -242,6 +335,9 @@ struct Stats
     uint64_t n_trx_replay = 0;      /**< Number of replayed transactions */
     uint64_t n_ro_trx = 0;          /**< Read-only transaction count */
     uint64_t n_rw_trx = 0;          /**< Read-write transaction count */
+    uint64_t n_pipelined = 0;       /**< Number of pipelined queries */
+    uint64_t n_written_table_reads = 0; /**< Reads of recently written tables */
+    uint64_t n_causal_no_wait = 0;      /**< Causal reads routed to up-to-date slaves without waiting */
 };
 
 using maxscale::ServerStats;
@@ -277,6 +373,13 @@ public:
                                         mxs::SessionCommandList* sescmd_list,
                                         int* expected_responses,
                                         connection_type type);
+
+    // Tables written by all sessions, used with `track_written_tables=service`
+    void table_written(const std::string& table, int64_t now, int64_t window);
+    void all_tables_written(int64_t now, int64_t window);
+    bool table_recently_written(const std::string& table, int64_t now, int64_t window) const;
+    bool any_table_recently_written(int64_t now, int64_t window) const;
+
     // API functions
 
     /**
@@ -347,6 +450,23 @@ private:
     mxs::rworker_local<Config>     m_config;
     Stats                          m_stats;
     mxs::rworker_local<SrvStatMap> m_server_stats;
+
+    /**
+     * The tables written by all sessions are sharded by the table name, so that
+     * the sessions of different workers seldom wait for each other. A write
+     * marking all tables is only stored in m_all_written.
+     */
+    struct WrittenTablesShard
+    {
+        WrittenTables            tables;
+        mutable pthread_rwlock_t lock;
+    };
+
+    static const size_t N_WRITTEN_TABLES_SHARDS = 16;
+
+    WrittenTablesShard   m_written_tables[N_WRITTEN_TABLES_SHARDS];
+    std::atomic<int64_t> m_all_written;     /**< Time all tables were last written */
+    std::atomic<int64_t> m_latest_write;    /**< Time of the latest write of any table */
 };
 
 static inline const char* select_criteria_to_str(select_criteria_t type)
@@ -368,6 +488,9 @@ static inline const char* select_criteria_to_str(select_criteria_t type)
     case ADAPTIVE_ROUTING:
         return "ADAPTIVE_ROUTING";
 
+    case LEAST_SERVER_LOAD:
+        return "LEAST_SERVER_LOAD";
+
     default:
         return "UNDEFINED_CRITERIA";
     }
@@ -435,3 +558,17 @@ void close_all_connections(mxs::SRWBackendList& backends);
  * @return String representation of the error
  */
 std::string extract_error(GWBUF* buffer);
+
+/**
+ * Get the variable a SET statement assigns
+ *
+ * Only statements that assign a literal value to exactly one session or user
+ * variable are recognized. A later statement of this kind supersedes an earlier
+ * one that sets the same variable as the new value does not depend on the old one.
+ *
+ * @param sql The SQL of the statement
+ *
+ * @return The lowercase name of the variable or an empty string if the statement
+ *         is not a simple SET statement
+ */
+std::string simple_set_variable(const std::string& sql);
@@ -19,6 +19,9 @@
 #include <string.h>
 #include <strings.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <maxbase/atomic.hh>
 #include <maxscale/alloc.h>
 #include <maxscale/clock.h>
@@ -26,6 +29,7 @@
 #include <maxscale/modutil.hh>
 #include <maxscale/router.h>
 #include <maxscale/server.h>
+#include <maxscale/server.hh>
 #include <maxscale/session_command.hh>
 #include <maxscale/utils.hh>
 
@@ -127,6 +131,42 @@ uint32_t extract_binary_ps_id(GWBUF* buffer)
     uint8_t* ptr = GWBUF_DATA(buffer) + MYSQL_PS_ID_OFFSET;
     return gw_mysql_get_byte4(ptr);
 }
+
+/**
+ * Get the tables accessed by a query as lowercase, fully qualified names
+ *
+ * Unqualified names are skipped if no default database is set as the server
+ * will reject the query.
+ *
+ * @param buffer The query
+ * @param db     The default database
+ *
+ * @return The table names
+ */
+std::vector<std::string> get_qualified_tables(GWBUF* buffer, const char* db)
+{
+    std::vector<std::string> rval;
+    int n_tables = 0;
+    char** tables = qc_get_table_names(buffer, &n_tables, true);
+
+    for (int i = 0; i < n_tables; i++)
+    {
+        bool qualified = strchr(tables[i], '.') != NULL;
+
+        if (qualified || (db && *db))
+        {
+            std::string table = qualified ? tables[i] : std::string(db) + "." + tables[i];
+            std::transform(table.begin(), table.end(), table.begin(), ::tolower);
+            rval.push_back(std::move(table));
+        }
+
+        MXS_FREE(tables[i]);
+    }
+
+    MXS_FREE(tables);
+
+    return rval;
+}
 }
 
 bool RWSplitSession::have_connected_slaves() const
@@ -181,6 +221,143 @@ bool RWSplitSession::track_optimistic_trx(GWBUF** buffer)
     return store_stmt;
 }
 
+/**
+ * Record the tables modified by a write
+ *
+ * @param querybuf The write
+ * @param now      Current time
+ * @param window   How long the write is relevant
+ *
+ * @return True if the tables were recorded, false if all tables were marked as written
+ */
+bool RWSplitSession::record_written_tables(GWBUF* querybuf, int64_t now, int64_t window)
+{
+    bool service_scope = m_config.track_written_tables == TRACK_TABLES_SERVICE;
+    bool rval = qc_parse(querybuf, QC_COLLECT_TABLES) == QC_QUERY_PARSED;
+    std::vector<std::string> tables = get_qualified_tables(querybuf,
+                                                           mxs_mysql_get_current_db(m_client->session));
+
+    if (tables.empty())
+    {
+        // A write that touches no known tables, e.g. a call to a stored procedure
+        rval = false;
+    }
+
+    if (rval)
+    {
+        for (const auto& table : tables)
+        {
+            if (service_scope)
+            {
+                m_router->table_written(table, now, window);
+            }
+            else
+            {
+                m_written_tables.add(table, now, window);
+            }
+        }
+    }
+    else if (service_scope)
+    {
+        m_router->all_tables_written(now, window);
+    }
+    else
+    {
+        m_written_tables.add_all(now, window);
+    }
+
+    return rval;
+}
+
+/**
+ * Check if a read accesses recently written tables
+ *
+ * A read that could not be fully parsed is considered to access them. The
+ * read is not parsed at all if no table was written within the window.
+ *
+ * @param querybuf The read
+ * @param now      Current time
+ * @param window   How long a write is relevant
+ *
+ * @return True if the read accesses tables written within the window
+ */
+bool RWSplitSession::reads_written_tables(GWBUF* querybuf, int64_t now, int64_t window)
+{
+    bool service_scope = m_config.track_written_tables == TRACK_TABLES_SERVICE;
+    bool rval = false;
+
+    if (service_scope ?
+        m_router->any_table_recently_written(now, window) :
+        m_written_tables.any(now, window))
+    {
+        rval = qc_parse(querybuf, QC_COLLECT_TABLES) != QC_QUERY_PARSED;
+
+        if (!rval)
+        {
+            for (const auto& table : get_qualified_tables(querybuf, mxs_mysql_get_current_db(m_client->session)))
+            {
+                if (service_scope ?
+                    m_router->table_recently_written(table, now, window) :
+                    m_written_tables.contains(table, now, window))
+                {
+                    rval = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return rval;
+}
+
+/**
+ * Track the tables written by the client and route reads of them consistently
+ *
+ * Writes record the tables they modify. A read that would go to a slave but
+ * accesses a table written within `written_tables_window` seconds is either
+ * done as a causal read, if the session knows the GTID of its latest write,
+ * or routed to the master.
+ *
+ * @param querybuf     The query being routed
+ * @param qtype        Query type mask
+ * @param route_target The target the query would be routed to
+ *
+ * @return The target where the query should be routed
+ */
+route_target_t RWSplitSession::handle_written_tables(GWBUF* querybuf, uint32_t qtype,
+                                                     route_target_t route_target)
+{
+    int64_t now = mxs_clock();
+    int64_t window = MXS_SEC_TO_CLOCK(m_config.written_tables_window);
+
+    if (TARGET_IS_MASTER(route_target) && qc_query_is_type(qtype, QUERY_TYPE_WRITE))
+    {
+        if (!record_written_tables(querybuf, now, window))
+        {
+            MXS_INFO("Could not resolve the tables of a write, treating all tables as written");
+        }
+    }
+    else if (TARGET_IS_SLAVE(route_target) && reads_written_tables(querybuf, now, window))
+    {
+        mxb::atomic::add(&m_router->stats().n_written_table_reads, 1, mxb::atomic::RELAXED);
+
+        if (m_config.causal_reads
+            && m_config.track_written_tables == TRACK_TABLES_SESSION
+            && !m_gtid_pos.empty())
+        {
+            // The session has seen the GTID of its own writes, the slave can wait for it
+            m_causal_read_required = true;
+        }
+        else if (m_current_master && m_current_master->in_use())
+        {
+            MXS_INFO("Routing read of a recently written table to the master");
+            route_target = TARGET_MASTER;
+        }
+    }
+
+    return route_target;
+}
+
 /**
  * Routing function. Find out query type, backend type, and target DCB(s).
  * Then route query to found target(s).
@@ -229,6 +406,16 @@ bool RWSplitSession::route_single_stmt(GWBUF* querybuf)
             m_otrx_state = OTRX_ACTIVE;
         }
 
+        m_causal_read_required = false;
+
+        if (m_config.track_written_tables != TRACK_TABLES_NONE
+            && command == MXS_COM_QUERY
+            && !m_qc.large_query()
+            && m_otrx_state == OTRX_INACTIVE)
+        {
+            route_target = handle_written_tables(querybuf, qtype, route_target);
+        }
+
         // If delayed query retry is enabled, we need to store the current statement
         bool store_stmt = m_config.delayed_retry;
 
@@ -364,27 +551,67 @@ bool RWSplitSession::route_single_stmt(GWBUF* querybuf)
     return succp;
 }
 
+namespace
+{
+
+std::string simple_set_variable(mxs::SessionCommand& sescmd)
+{
+    return sescmd.get_command() == MXS_COM_QUERY ? ::simple_set_variable(sescmd.to_string()) : "";
+}
+
+/**
+ * Check if the history may be compacted for a variable
+ *
+ * The character set and the SQL mode variables change how the statements that
+ * follow them are parsed. Their assignments are always kept in the history.
+ *
+ * @param variable Variable name returned by simple_set_variable()
+ *
+ * @return True if earlier assignments of the variable can be removed
+ */
+bool can_compact_variable(const std::string& variable)
+{
+    return !variable.empty()
+           && variable != "names"
+           && variable != "sql_mode"
+           && variable.compare(0, 14, "character_set_") != 0
+           && variable.compare(0, 10, "collation_") != 0;
+}
+}
+
 /**
  * Compress session command history
  *
  * This function removes data duplication by sharing buffers between session
- * commands that have identical data. Only one copy of the actual data is stored
- * for each unique session command.
+ * commands that have identical data. The buffers are shared with the sessions
+ * of the same worker thread so only one copy of the actual data is stored for
+ * each unique session command.
+ *
+ * If `compact_sescmd_history` is enabled, simple SET statements that assign
+ * the same variable as the new command are removed from the end of the history.
+ * The search stops at the first command that is not a simple SET statement of
+ * the same variable so that the relative order of all other commands is
+ * preserved.
  *
  * @param sescmd Executed session command
  */
 void RWSplitSession::compress_history(mxs::SSessionCommand& sescmd)
 {
-    auto eq = [&](mxs::SSessionCommand& scmd) {
-            return scmd->eq(*sescmd);
-        };
+    sescmd->intern();
 
-    auto first = std::find_if(m_sescmd_list.begin(), m_sescmd_list.end(), eq);
-
-    if (first != m_sescmd_list.end())
+    if (m_config.compact_sescmd_history)
     {
-        // Duplicate command, use a reference of the old command instead of duplicating it
-        sescmd->mark_as_duplicate(**first);
+        std::string variable = simple_set_variable(*sescmd);
+
+        if (can_compact_variable(variable))
+        {
+            while (!m_sescmd_list.empty() && simple_set_variable(*m_sescmd_list.back()) == variable)
+            {
+                MXS_INFO("Removing superseded session command: %s",
+                         m_sescmd_list.back()->to_string().c_str());
+                m_sescmd_list.pop_back();
+            }
+        }
     }
 }
 
@@ -692,6 +919,25 @@ SRWBackend RWSplitSession::get_slave_backend(int max_rlag)
         }
     }
 
+    if (causal_read_required())
+    {
+        // Prefer slaves that the monitor has seen to be at or past the GTID of the latest write
+        SRWBackendVector caught_up;
+
+        for (auto candidate : candidates)
+        {
+            if ((*candidate)->is_slave() && mxs::server_gtid_pos_reached((*candidate)->server(), m_gtid_target))
+            {
+                caught_up.push_back(candidate);
+            }
+        }
+
+        if (!caught_up.empty())
+        {
+            candidates = std::move(caught_up);
+        }
+    }
+
     SRWBackendVector::const_iterator rval = find_best_backend(candidates,
                                                               m_config.backend_select_fct,
                                                               m_config.master_accept_reads);
@@ -1187,15 +1433,22 @@ bool RWSplitSession::handle_got_target(GWBUF* querybuf, SRWBackend& target, bool
     uint8_t cmd = mxs_mysql_get_command(querybuf);
     GWBUF* send_buf = gwbuf_clone(querybuf);
 
-    if (m_config.causal_reads && cmd == COM_QUERY && !m_gtid_pos.empty()
-        && target->is_slave())
+    if (cmd == COM_QUERY && target->is_slave() && causal_read_required())
     {
-        // Perform the causal read only when the query is routed to a slave
-        send_buf = add_prefix_wait_gtid(target->server(), send_buf);
-        m_wait_gtid = WAITING_FOR_HEADER;
+        if (mxs::server_gtid_pos_reached(target->server(), m_gtid_target))
+        {
+            // The monitor has already seen the slave replicate the latest write, no need to wait for it
+            mxb::atomic::add(&m_router->stats().n_causal_no_wait, 1, mxb::atomic::RELAXED);
+        }
+        else
+        {
+            // Perform the causal read only when the query is routed to a slave
+            send_buf = add_prefix_wait_gtid(target->server(), send_buf);
+            m_wait_gtid = WAITING_FOR_HEADER;
 
-        // The storage for causal reads is done inside add_prefix_wait_gtid
-        store = false;
+            // The storage for causal reads is done inside add_prefix_wait_gtid
+            store = false;
+        }
     }
 
     if (m_qc.load_data_state() != QueryClassifier::LOAD_DATA_ACTIVE
@@ -1207,13 +1460,12 @@ bool RWSplitSession::handle_got_target(GWBUF* querybuf, SRWBackend& target, bool
     bool large_query = is_large_query(querybuf);
 
     /**
-     * We should not be routing a query to a server that is busy processing a result.
-     *
-     * TODO: This effectively disables pipelining of queries, very bad for batch insert performance. Replace
-     *       with proper, per server tracking of which responses need to be sent to the client. This would
-     *       also solve MXS-2009 by speeding up session commands.
+     * We should not be routing a query to a server that is busy processing a result unless the
+     * query is pipelined. Pipelined queries are only routed to the server that executes the previous one.
      */
-    mxb_assert(target->get_reply_state() == REPLY_STATE_DONE || m_qc.large_query());
+    bool pipelined = target->get_reply_state() != REPLY_STATE_DONE && !m_qc.large_query();
+    mxb_assert(!pipelined || (m_config.pipeline_queries && response == mxs::Backend::EXPECT_RESPONSE));
+    mxb_assert(!pipelined || !store);
 
     uint32_t orig_id = 0;
 
@@ -1231,9 +1483,9 @@ bool RWSplitSession::handle_got_target(GWBUF* querybuf, SRWBackend& target, bool
      * will do the replacement of PS IDs which must not be done if we are
      * continuing an ongoing query.
      */
-    bool success = !m_qc.large_query() ?
-        target->write(send_buf, response) :
-        target->continue_write(send_buf);
+    bool success = m_qc.large_query() ? target->continue_write(send_buf) :
+        pipelined ? target->write_pipelined(send_buf) :
+        target->write(send_buf, response);
 
     if (success)
     {
@@ -1251,6 +1503,20 @@ bool RWSplitSession::handle_got_target(GWBUF* querybuf, SRWBackend& target, bool
             /** The server will reply to this command */
             m_expected_responses++;
 
+            if (m_config.pipeline_queries)
+            {
+                if (!pipelined)
+                {
+                    m_in_flight.clear();
+                }
+
+                InFlightQuery query = {};
+                query.load_local = cmd == MXS_COM_QUERY
+                    && m_qc.load_data_state() == QueryClassifier::LOAD_DATA_INACTIVE
+                    && qc_get_operation(querybuf) == QUERY_OP_LOAD_LOCAL;
+                m_in_flight.push_back(query);
+            }
+
             if (m_qc.load_data_state() == QueryClassifier::LOAD_DATA_END)
             {
                 /** The final packet in a LOAD DATA LOCAL INFILE is an empty packet
@@ -120,6 +120,35 @@ SRWBackendVector::iterator backend_cmp_current_load(SRWBackendVector& sBackends)
     return best_score(sBackends, server_score);
 }
 
+/**
+ * Compare the load of the backend servers
+ *
+ * The operations routed by this MaxScale are blended with the load signals that the
+ * monitor reads from the server. Threads_running includes the load that other clients
+ * put on the server and row lock waits are counted as extra operations. A high buffer
+ * pool miss rate means that the operations are slower, so it increases the score. If
+ * the monitor doesn't provide the signals, this is the same as LEAST_CURRENT_OPERATIONS.
+ */
+SRWBackendVector::iterator backend_cmp_server_load(SRWBackendVector& sBackends)
+{
+    static auto server_score = [](SERVER_REF* server) {
+            SERVER_LOAD load = server_get_load(server->server);
+            double ops = server->server->stats.n_current_ops;
+
+            if (load.threads_running >= 0)
+            {
+                // Threads_running also counts the connection of the monitor
+                ops = std::max(ops, (double)load.threads_running - 1) + load.row_lock_waits;
+                ops *= 1 + load.bp_miss_rate;
+            }
+
+            return server->server_weight ? (ops + 1) / server->server_weight :
+                   std::numeric_limits<double>::max();
+        };
+
+    return best_score(sBackends, server_score);
+}
+
 SRWBackendVector::iterator backend_cmp_response_time(SRWBackendVector& sBackends)
 {
     const int SZ = sBackends.size();
@@ -196,6 +225,9 @@ BackendSelectFunction get_backend_select_function(select_criteria_t sc)
 
     case ADAPTIVE_ROUTING:
         return backend_cmp_response_time;
+
+    case LEAST_SERVER_LOAD:
+        return backend_cmp_server_load;
     }
 
     assert(false && "incorrect use of select_criteria_t");
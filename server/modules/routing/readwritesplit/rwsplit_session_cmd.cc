@@ -20,10 +20,169 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include <algorithm>
+
 #include <maxscale/router.h>
 
 using namespace maxscale;
 
+namespace
+{
+
+const char* skip_space(const char* ptr, const char* end)
+{
+    while (ptr < end && isspace(*ptr))
+    {
+        ptr++;
+    }
+
+    return ptr;
+}
+
+const char* skip_word(const char* ptr, const char* end)
+{
+    while (ptr < end && (isalnum(*ptr) || *ptr == '_' || *ptr == '$'))
+    {
+        ptr++;
+    }
+
+    return ptr;
+}
+
+bool skip_keyword(const char** ptr, const char* end, const char* keyword)
+{
+    size_t len = strlen(keyword);
+    bool rval = (size_t)(end - *ptr) > len
+        && strncasecmp(*ptr, keyword, len) == 0
+        && isspace((*ptr)[len]);
+
+    if (rval)
+    {
+        *ptr = skip_space(*ptr + len, end);
+    }
+
+    return rval;
+}
+
+/**
+ * Skip a literal value: a quoted string without escapes, a number or a keyword like ON or DEFAULT
+ */
+const char* skip_literal(const char* ptr, const char* end)
+{
+    if (ptr < end && (*ptr == '\'' || *ptr == '"'))
+    {
+        char quote = *ptr++;
+
+        while (ptr < end && *ptr != quote && *ptr != '\\')
+        {
+            ptr++;
+        }
+
+        return ptr < end && *ptr == quote ? ptr + 1 : NULL;
+    }
+
+    if (ptr < end && (*ptr == '-' || *ptr == '+'))
+    {
+        ptr++;
+    }
+
+    const char* start = ptr;
+
+    while (ptr < end && (isalnum(*ptr) || *ptr == '_' || *ptr == '.'))
+    {
+        ptr++;
+    }
+
+    return ptr > start ? ptr : NULL;
+}
+}
+
+std::string simple_set_variable(const std::string& sql)
+{
+    const char* ptr = sql.c_str();
+    const char* end = ptr + sql.length();
+    std::string rval;
+
+    ptr = skip_space(ptr, end);
+
+    if (skip_keyword(&ptr, end, "SET"))
+    {
+        std::string name;
+        const char* value = NULL;
+
+        if (skip_keyword(&ptr, end, "NAMES"))
+        {
+            // SET NAMES charset [COLLATE collation]
+            name = "names";
+            value = ptr;
+        }
+        else
+        {
+            if (!skip_keyword(&ptr, end, "SESSION") && !skip_keyword(&ptr, end, "LOCAL"))
+            {
+                const char* prefixes[] = {"@@session.", "@@local.", "@@", "@"};
+
+                for (auto prefix : prefixes)
+                {
+                    size_t len = strlen(prefix);
+
+                    if ((size_t)(end - ptr) > len && strncasecmp(ptr, prefix, len) == 0)
+                    {
+                        // User variables keep the @ to separate them from system variables
+                        name = *prefix == '@' && prefix[1] != '@' ? "@" : "";
+                        ptr += len;
+                        break;
+                    }
+                }
+            }
+
+            const char* name_end = skip_word(ptr, end);
+
+            bool is_global = name_end - ptr == 6 && strncasecmp(ptr, "global", 6) == 0;
+
+            if (name_end > ptr && !is_global)
+            {
+                name.append(ptr, name_end);
+                ptr = skip_space(name_end, end);
+
+                if (ptr < end && *ptr == ':')
+                {
+                    ptr++;
+                }
+
+                if (ptr < end && *ptr == '=')
+                {
+                    value = skip_space(ptr + 1, end);
+                }
+            }
+        }
+
+        if (value && (ptr = skip_literal(value, end)))
+        {
+            ptr = skip_space(ptr, end);
+
+            if (name == "names" && skip_keyword(&ptr, end, "COLLATE"))
+            {
+                ptr = skip_literal(ptr, end);
+                ptr = ptr ? skip_space(ptr, end) : NULL;
+            }
+
+            if (ptr && ptr < end && *ptr == ';')
+            {
+                ptr = skip_space(ptr + 1, end);
+            }
+
+            if (ptr == end)
+            {
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                rval = name;
+            }
+        }
+    }
+
+    return rval;
+}
+
 /**
  * Functions for session command handling
  */
@@ -162,7 +162,14 @@ int32_t RWSplitSession::routeQuery(GWBUF* querybuf)
             current_target = QueryClassifier::CURRENT_TARGET_SLAVE;
         }
 
-        if (!m_qc.large_query())
+        if (querybuf == m_classified_query)
+        {
+            /** The query was classified when it was considered for pipelining. Nothing
+             * else has been classified since then, so the current route info is still
+             * the one of this query. */
+            m_classified_query = nullptr;
+        }
+        else if (!m_qc.large_query())
         {
             m_qc.update_route_info(current_target, querybuf);
         }
@@ -171,8 +178,18 @@ int32_t RWSplitSession::routeQuery(GWBUF* querybuf)
         if (route_single_stmt(querybuf))
         {
             rval = 1;
+
+            if (m_is_replay_active)
+            {
+                trx_replay_pipeline_stmts();
+            }
         }
     }
+    else if (can_pipeline_query(querybuf) && route_pipelined_query(querybuf))
+    {
+        /** The query was sent to the server that is executing the previous one */
+        rval = 1;
+    }
     else
     {
         /**
@@ -273,6 +290,172 @@ bool RWSplitSession::route_stored_query()
     return rval;
 }
 
+/**
+ * @brief Check if a query can be pipelined
+ *
+ * A query can be sent while the reply to the previous one is still being read
+ * if only one server is executing queries for this session and the reply to the
+ * new query can be matched to it without knowing the result of the previous query.
+ * Features that may need to resend the queries (transaction replay) or that modify
+ * them (causal reads) disable the pipelining.
+ *
+ * @param querybuf Query to check
+ *
+ * @return True if the query is a candidate for pipelining
+ */
+bool RWSplitSession::can_pipeline_query(GWBUF* querybuf) const
+{
+    return m_config.pipeline_queries
+           && !m_config.transaction_replay
+           && !m_config.causal_reads
+           && m_config.track_written_tables == TRACK_TABLES_NONE
+           && m_query_queue.empty()
+           && !m_is_replay_active
+           && !GWBUF_IS_REPLAYED(querybuf)
+           && m_otrx_state == OTRX_INACTIVE
+           && m_wait_gtid == NONE
+           && !m_qc.large_query()
+           && m_qc.load_data_state() == QueryClassifier::LOAD_DATA_INACTIVE
+           && m_prev_target
+           && m_prev_target->in_use()
+           && m_prev_target->is_waiting_result()
+           && !m_prev_target->has_session_commands()
+           && m_prev_target->current_command() == MXS_COM_QUERY
+           && m_expected_responses == 1 + (int)m_prev_target->pipeline_size()
+           && m_in_flight.size() == 1 + m_prev_target->pipeline_size()
+           && !m_in_flight.back().load_local
+           && mxs_mysql_get_command(querybuf) == MXS_COM_QUERY
+           && gwbuf_length(querybuf) < MYSQL_HEADER_LEN + GW_MYSQL_MAX_PACKET_LEN;
+}
+
+/**
+ * @brief Route a pipelined query
+ *
+ * The query is classified and if it would be routed to the server that is
+ * executing the previous query, it is sent there immediately. If the target
+ * would be some other server, the query must wait for the previous reply. The
+ * query is not classified again when it is routed from the query queue.
+ *
+ * @param querybuf Query to route
+ *
+ * @return True if the query was routed, false if it must be queued
+ */
+bool RWSplitSession::route_pipelined_query(GWBUF* querybuf)
+{
+    QueryClassifier::current_target_t current_target =
+        m_target_node == m_current_master ? QueryClassifier::CURRENT_TARGET_MASTER :
+        m_target_node ? QueryClassifier::CURRENT_TARGET_SLAVE :
+        QueryClassifier::CURRENT_TARGET_UNDEFINED;
+
+    const QueryClassifier::RouteInfo& info = m_qc.update_route_info(current_target, querybuf);
+    route_target_t route_target = info.target();
+    SRWBackend& target = m_prev_target;
+    bool same_target = false;
+
+    if (qc_query_is_type(info.type_mask(), QUERY_TYPE_BEGIN_TRX))
+    {
+        // The start of a transaction can change the target, let the normal routing handle it
+    }
+    else if (qc_get_operation(querybuf) == QUERY_OP_LOAD_LOCAL)
+    {
+        // The server asks for the file and nothing must be sent before the client has sent it
+    }
+    else if (route_target == TARGET_MASTER)
+    {
+        same_target = target == m_current_master && target->is_master();
+    }
+    else if (route_target == TARGET_SLAVE)
+    {
+        same_target = (m_target_node ? target == m_target_node : target->is_slave())
+            && (m_config.max_slave_replication_lag <= 0
+                || target->server()->rlag <= m_config.max_slave_replication_lag);
+    }
+
+    bool rval = false;
+
+    if (same_target)
+    {
+        MXS_INFO("Pipelining query to '%s', %lu queries already pipelined",
+                 target->name(), target->pipeline_size());
+        update_trx_statistics();
+
+        if (TARGET_IS_SLAVE(route_target))
+        {
+            mxb::atomic::add(&m_router->stats().n_slave, 1, mxb::atomic::RELAXED);
+            m_server_stats[target->server()].read++;
+        }
+        else
+        {
+            mxb::atomic::add(&m_router->stats().n_master, 1, mxb::atomic::RELAXED);
+            m_server_stats[target->server()].write++;
+        }
+
+        if ((rval = handle_got_target(querybuf, target, false)))
+        {
+            // The server starts executing the query once the previous reply is complete
+            m_in_flight.back().timed = TARGET_IS_SLAVE(route_target);
+            mxb::atomic::add(&m_router->stats().n_pipelined, 1, mxb::atomic::RELAXED);
+        }
+    }
+
+    if (!rval)
+    {
+        // The query is queued, its route info is used when it is routed
+        m_classified_query = querybuf;
+    }
+
+    return rval;
+}
+
+/**
+ * @brief Start the reply to the next pipelined query
+ *
+ * Called when the reply to a query is complete and the rest of the reply
+ * buffer belongs to the query that was pipelined after it.
+ *
+ * @param backend The backend the queries were pipelined to
+ */
+void RWSplitSession::start_pipelined_reply(SRWBackend& backend)
+{
+    mxb_assert(m_in_flight.size() > 1);
+    mxb_assert(!m_in_flight.front().load_local);
+
+    if (m_in_flight.size() > 1)
+    {
+        m_in_flight.pop_front();
+
+        // Pipelined queries are never retried, the stored query was the previous one
+        m_current_query.reset();
+
+        if (m_in_flight.front().timed)
+        {
+            backend->select_started();
+            backend->response_stat().query_started();
+        }
+    }
+}
+
+/**
+ * @brief Update the response statistics after a complete reply
+ *
+ * @param backend The backend that replied
+ */
+void RWSplitSession::update_response_stats(SRWBackend& backend)
+{
+    ResponseStat& stat = backend->response_stat();
+    stat.query_ended();
+    if (stat.is_valid() && (stat.sync_time_reached()
+                            || server_response_time_num_samples(backend->server()) == 0))
+    {
+        server_add_response_average(backend->server(),
+                                    stat.average().secs(),
+                                    stat.num_samples());
+        stat.reset();
+    }
+
+    backend->select_ended();
+}
+
 /**
  * @bref discard the result of MASTER_GTID_WAIT statement
  *
@@ -416,6 +599,7 @@ GWBUF* RWSplitSession::handle_causal_read_reply(GWBUF* writebuf, SRWBackend& bac
             if (char* tmp = gwbuf_get_property(writebuf, MXS_LAST_GTID))
             {
                 m_gtid_pos = std::string(tmp);
+                m_gtid_target = mxs::gtid_pos_parse(m_gtid_pos);
             }
         }
 
@@ -496,6 +680,87 @@ void RWSplitSession::trx_replay_next_stmt()
     }
 }
 
+/**
+ * Check if a replayed statement can be sent before the previous ones have completed
+ *
+ * The statement is classified without updating the routing state of the session: the state
+ * belongs to the statement that is being executed. Statements that change the session state
+ * are routed normally so that the state is updated when they are executed.
+ *
+ * @param buf The next statement of the replayed transaction
+ *
+ * @return True if the statement can be pipelined
+ */
+static bool can_pipeline_replayed_stmt(GWBUF* buf)
+{
+    const uint32_t state_changes = QUERY_TYPE_SESSION_WRITE | QUERY_TYPE_USERVAR_WRITE
+        | QUERY_TYPE_GSYSVAR_WRITE | QUERY_TYPE_BEGIN_TRX | QUERY_TYPE_ENABLE_AUTOCOMMIT
+        | QUERY_TYPE_DISABLE_AUTOCOMMIT | QUERY_TYPE_ROLLBACK | QUERY_TYPE_COMMIT
+        | QUERY_TYPE_PREPARE_NAMED_STMT | QUERY_TYPE_PREPARE_STMT | QUERY_TYPE_CREATE_TMP_TABLE
+        | QUERY_TYPE_DEALLOC_PREPARE;
+
+    bool rval = false;
+
+    if (mxs_mysql_get_command(buf) == MXS_COM_QUERY
+        && gwbuf_length(buf) < MYSQL_HEADER_LEN + GW_MYSQL_MAX_PACKET_LEN)
+    {
+        qc_query_op_t op = qc_get_operation(buf);
+        rval = (qc_get_type_mask(buf) & state_changes) == 0
+            && op != QUERY_OP_DROP          // Could drop a temporary table
+            && op != QUERY_OP_LOAD_LOCAL;
+    }
+
+    return rval;
+}
+
+/**
+ * Send more statements of the replayed transaction without waiting for the replies
+ *
+ * The statements are written to the master while the previous ones are still being
+ * executed, up to `transaction_replay_window` statements at a time. The replies
+ * arrive in order and are added to the transaction checksum the same way as the
+ * replies to statements replayed one at a time.
+ */
+void RWSplitSession::trx_replay_pipeline_stmts()
+{
+    SRWBackend& target = m_prev_target;
+
+    while (m_replayed_trx.have_stmts()
+           && m_expected_responses > 0
+           && m_expected_responses < m_config.trx_replay_window
+           && m_wait_gtid == NONE
+           && !m_qc.large_query()
+           && m_qc.load_data_state() == QueryClassifier::LOAD_DATA_INACTIVE
+           && target && target->in_use() && target == m_current_master
+           && target->is_waiting_result()
+           && !target->has_session_commands()
+           && target->current_command() == MXS_COM_QUERY)
+    {
+        if (!can_pipeline_replayed_stmt(m_replayed_trx.front_stmt()))
+        {
+            // Routed normally once the previous statements have completed
+            break;
+        }
+
+        GWBUF* buf = m_replayed_trx.pop_stmt();
+        gwbuf_set_type(buf, GWBUF_TYPE_REPLAYED);
+        MXS_INFO("Replaying pipelined: %s", mxs::extract_sql(buf, 1024).c_str());
+
+        if (!target->write_pipelined(gwbuf_clone(buf)))
+        {
+            // The error handling will restart the replay
+            gwbuf_free(buf);
+            break;
+        }
+
+        m_replay_pipeline.emplace_back(buf);
+        m_expected_responses++;
+        mxb::atomic::add(&m_router->stats().n_queries, 1, mxb::atomic::RELAXED);
+        mxb::atomic::add(&target->server()->stats.packets, 1, mxb::atomic::RELAXED);
+        m_server_stats[target->server()].total++;
+    }
+}
+
 void RWSplitSession::manage_transactions(SRWBackend& backend, GWBUF* writebuf)
 {
     if (m_otrx_state == OTRX_ROLLBACK)
@@ -624,6 +889,16 @@ void RWSplitSession::clientReply(GWBUF* writebuf, DCB* backend_dcb)
 
     backend->process_reply(writebuf);
 
+    for (int i = 0; i < backend->completed_pipelined_replies(); i++)
+    {
+        /** The buffer completed a reply that was followed by the reply to a pipelined query */
+        m_expected_responses--;
+        mxb_assert(m_expected_responses > 0);
+        session_book_server_response(m_pSession, backend->backend()->server, false);
+        update_response_stats(backend);
+        start_pipelined_reply(backend);
+    }
+
     if (backend->reply_is_complete())
     {
         /** Got a complete reply, decrement expected response count */
@@ -652,15 +927,11 @@ void RWSplitSession::clientReply(GWBUF* writebuf, DCB* backend_dcb)
             return;
         }
 
-        ResponseStat& stat = backend->response_stat();
-        stat.query_ended();
-        if (stat.is_valid() && (stat.sync_time_reached()
-                                || server_response_time_num_samples(backend->server()) == 0))
+        update_response_stats(backend);
+
+        if (!m_in_flight.empty())
         {
-            server_add_response_average(backend->server(),
-                                        stat.average().secs(),
-                                        stat.num_samples());
-            stat.reset();
+            m_in_flight.pop_front();
         }
 
         if (m_config.causal_reads)
@@ -677,8 +948,6 @@ void RWSplitSession::clientReply(GWBUF* writebuf, DCB* backend_dcb)
             session_set_load_active(m_pSession, true);
         }
 
-        backend->select_ended();
-
         if (m_otrx_state == OTRX_ROLLBACK)
         {
             // Transaction rolled back, start replaying it on the master
@@ -709,11 +978,22 @@ void RWSplitSession::clientReply(GWBUF* writebuf, DCB* backend_dcb)
     {
         mxb_assert(m_config.transaction_replay);
 
+        while (m_replay_pipeline.size() > (size_t)m_expected_responses)
+        {
+            // The reply to a pipelined statement is complete, it's now a part of the transaction
+            m_trx.add_stmt(m_replay_pipeline.front().release());
+            m_replay_pipeline.pop_front();
+        }
+
         if (m_expected_responses == 0)
         {
             // Current statement is complete, continue with the next one
             trx_replay_next_stmt();
         }
+        else if (backend->reply_is_complete())
+        {
+            trx_replay_pipeline_stmts();
+        }
 
         /**
          * If the start of the transaction was interrupted, we need to return
@@ -817,6 +1097,7 @@ bool RWSplitSession::start_trx_replay()
         else
         {
             // Not the first time, copy the original
+            m_replay_pipeline.clear();
             m_replayed_trx.close();
             m_trx.close();
             m_trx = m_orig_trx;
@@ -914,6 +1195,20 @@ void RWSplitSession::handleError(GWBUF* errmsgbuf,
             std::string errmsg;
             bool can_continue = false;
 
+            if (backend->pipeline_size() > 0 && !m_is_replay_active)
+            {
+                /** Pipelined queries are not retried, the client would never get the replies */
+                MXS_ERROR("Lost connection to '%s' while %lu pipelined queries were being executed, "
+                          "closing session. Error caused by: %s",
+                          backend->name(),
+                          backend->pipeline_size(),
+                          extract_error(errmsgbuf).c_str());
+                backend->close();
+                backend->set_close_reason("Pipelined query failed: " + extract_error(errmsgbuf));
+                *succp = false;
+                break;
+            }
+
             if (m_current_master && m_current_master->in_use() && m_current_master == backend)
             {
                 MXS_INFO("Master '%s' failed", backend->name());
@@ -939,6 +1234,13 @@ void RWSplitSession::handleError(GWBUF* errmsgbuf,
                 }
                 else
                 {
+                    if (m_is_replay_active && !m_replay_pipeline.empty())
+                    {
+                        // The pipelined statements are replayed again from the start of the transaction
+                        m_expected_responses -= backend->pipeline_size();
+                        m_replay_pipeline.clear();
+                    }
+
                     // We were expecting a response but we aren't going to get one
                     mxb_assert(m_expected_responses > 0);
                     m_expected_responses--;
@@ -22,6 +22,7 @@
 #include <maxscale/modutil.h>
 #include <maxscale/queryclassifier.hh>
 #include <maxscale/protocol/rwbackend.hh>
+#include <maxscale/server.hh>
 
 #define TARGET_IS_MASTER(t)       maxscale::QueryClassifier::target_is_master(t)
 #define TARGET_IS_SLAVE(t)        maxscale::QueryClassifier::target_is_slave(t)
@@ -153,6 +154,7 @@ public:
     ExecMap                 m_exec_map;         /**< Map of COM_STMT_EXECUTE statement IDs to Backends */
 
     std::string          m_gtid_pos;            /**< Gtid position for causal read */
+    mxs::GtidPos         m_gtid_target;         /**< The parsed m_gtid_pos */
     wait_gtid_state      m_wait_gtid;           /**< State of MASTER_GTID_WAIT reply */
     uint32_t             m_next_seq;            /**< Next packet's sequence number */
     mxs::QueryClassifier m_qc;                  /**< The query classifier. */
@@ -166,9 +168,26 @@ public:
     mxs::Buffer m_interrupted_query;            /**< Query that was interrupted mid-transaction. */
     Trx         m_orig_trx;                     /**< The backup of the transaction we're replaying */
     mxs::Buffer m_orig_stmt;                    /**< The backup of the statement that was interrupted */
+    std::deque<mxs::Buffer> m_replay_pipeline;  /**< Replayed statements sent before the previous
+                                                 * one completed */
+
+    /** A query whose reply is expected from the server that queries are pipelined to */
+    struct InFlightQuery
+    {
+        bool timed;         /**< Whether the response time is measured when the reply starts */
+        bool load_local;    /**< Whether the server will request a file from the client */
+    };
+
+    std::deque<InFlightQuery> m_in_flight;      /**< Queries sent to m_prev_target, the reply to the
+                                                 * first one is being read */
+    GWBUF* m_classified_query = nullptr;        /**< Queued query that was classified when it was
+                                                 * considered for pipelining */
 
     otrx_state m_otrx_state = OTRX_INACTIVE;    /**< Optimistic trx state*/
 
+    WrittenTables m_written_tables;             /**< Tables written by this session */
+    bool          m_causal_read_required = false;/**< Whether the current read must wait for the GTID */
+
     SrvStatMap& m_server_stats;     /**< The server stats local to this thread, cached in the session object.
                                      * This avoids the lookup involved in getting the worker-local value from
                                      * the worker's container.*/
@@ -187,8 +206,25 @@ private:
     void continue_large_session_write(GWBUF* querybuf, uint32_t type);
     bool route_single_stmt(GWBUF* querybuf);
     bool route_stored_query();
+    bool can_pipeline_query(GWBUF* querybuf) const;
+    bool route_pipelined_query(GWBUF* querybuf);
+    void start_pipelined_reply(mxs::SRWBackend& backend);
+    void update_response_stats(mxs::SRWBackend& backend);
     void close_stale_connections();
 
+    route_target_t handle_written_tables(GWBUF* querybuf, uint32_t qtype, route_target_t route_target);
+    bool           record_written_tables(GWBUF* querybuf, int64_t now, int64_t window);
+    bool           reads_written_tables(GWBUF* querybuf, int64_t now, int64_t window);
+
+    /**
+     * Whether the current query must see the latest write of the session when it's routed to a slave
+     */
+    bool causal_read_required() const
+    {
+        return m_config.causal_reads && !m_gtid_pos.empty()
+               && (m_config.track_written_tables == TRACK_TABLES_NONE || m_causal_read_required);
+    }
+
     mxs::SRWBackend get_hinted_backend(const char* name);
     mxs::SRWBackend get_slave_backend(int max_rlag);
     mxs::SRWBackend get_master_backend();
@@ -230,6 +266,7 @@ private:
     void manage_transactions(mxs::SRWBackend& backend, GWBUF* writebuf);
 
     void trx_replay_next_stmt();
+    void trx_replay_pipeline_stmts();
 
     // Do we have at least one open slave connection
     bool have_connected_slaves() const;
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2018 MariaDB Corporation Ab
+ *
+ * Use of this software is governed by the Business Source License included
+ * in the LICENSE.TXT file and at www.mariadb.com/bsl11.
+ *
+ * Change Date: 2022-01-01
+ *
+ * On the date above, in accordance with the Business Source License, use
+ * of this software will be governed by version 2 or later of the General
+ * Public License.
+ */
+
+#include "../readwritesplit.hh"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::cout;
+
+/**
+ * Test the detection of SET statements that can supersede earlier ones
+ *
+ * @return Number of errors
+ */
+int test_simple_set()
+{
+    struct TestCase
+    {
+        string input;
+        string result;
+    };
+
+    std::vector<TestCase> cases = {
+        // Plain assignments
+        {"SET @a = 1",                                "@a"        },
+        {"set @A=1",                                  "@a"        },
+        {"SET @a := -1.5",                            "@a"        },
+        {"SET @a = 1;",                               "@a"        },
+        {"  SET   @a   =   'hello'  ",                "@a"        },
+        {"SET autocommit = ON",                       "autocommit"},
+        {"SET sql_mode = DEFAULT",                    "sql_mode"  },
+        // System variable scopes
+        {"SET SESSION sql_mode = 'ANSI'",             "sql_mode"  },
+        {"SET LOCAL sql_mode = 'ANSI'",               "sql_mode"  },
+        {"SET @@sql_mode = 'ANSI'",                   "sql_mode"  },
+        {"SET @@session.sql_mode = 'ANSI'",           "sql_mode"  },
+        {"SET @@SESSION.sql_mode = 'ANSI'",           "sql_mode"  },
+        {"SET @@local.sql_mode = 'ANSI'",             "sql_mode"  },
+        {"SET GLOBAL sql_mode = 'ANSI'",              ""          },
+        {"SET @@global.sql_mode = 'ANSI'",            ""          },
+        // Character sets
+        {"SET NAMES utf8",                            "names"     },
+        {"SET NAMES 'utf8mb4' COLLATE 'utf8mb4_bin'", "names"     },
+        // Quoting
+        {"SET @a = \"double\"",                       "@a"        },
+        {"SET @a = 'it''s'",                          ""          },
+        {"SET @a = 'back\\\\slash'",                  ""          },
+        {"SET @a = 'unterminated",                    ""          },
+        {"SET @`a` = 1",                              ""          },
+        // Comments
+        {"SET @a = 1 /* comment */",                  ""          },
+        {"SET /* comment */ @a = 1",                  ""          },
+        {"SET @a = 1 -- comment",                     ""          },
+        {"SET @a = 1 # comment",                      ""          },
+        // Multiple assignments
+        {"SET @a = 1, @b = 2",                        ""          },
+        {"SET @a = 1; SET @b = 2",                    ""          },
+        {"SET SESSION sql_mode = 'ANSI', autocommit = 1", ""      },
+        // Values that depend on other state
+        {"SET @a = @b",                               ""          },
+        {"SET @a = (SELECT 1)",                       ""          },
+        {"SET @a = CONCAT('a', 'b')",                 ""          },
+        {"SET @a = @a + 1",                           ""          },
+        // Not SET statements
+        {"SELECT 1",                                  ""          },
+        {"SETX @a = 1",                               ""          },
+        {"SET TRANSACTION READ ONLY",                 ""          },
+        {"",                                          ""          },
+    };
+
+    int errors = 0;
+
+    for (auto& test_case : cases)
+    {
+        string output = simple_set_variable(test_case.input);
+
+        if (output != test_case.result)
+        {
+            cout << "Wrong result: '" << test_case.input << "' produced '" << output << "' while '"
+                 << test_case.result << "' was expected.\n";
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+int main(int argc, char** argv)
+{
+    return test_simple_set();
+}
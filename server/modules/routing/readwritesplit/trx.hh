@@ -78,6 +78,17 @@ public:
         return rval;
     }
 
+    /**
+     * Get the oldest statement in this transaction without removing it
+     *
+     * @return The oldest statement in this transaction
+     */
+    GWBUF* front_stmt()
+    {
+        mxb_assert(!m_log.empty());
+        return m_log.front().get();
+    }
+
     /**
      * Finalize the transaction
      *